@@ -3,7 +3,9 @@
 
 #include "../rbf/pfm.h"
 #include "../rbf/rbfm.h"
+#include "../rbf/wal.h"
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <cstring>
@@ -13,10 +15,8 @@ IndexManager* IndexManager::_index_manager = 0;
 
 IndexManager* IndexManager::instance()
 {
-    if(!_index_manager)
-        _index_manager = new IndexManager();
-
-    return _index_manager;
+    static IndexManager *manager = _index_manager = new IndexManager();
+    return manager;
 }
 
 IndexManager::IndexManager()
@@ -47,6 +47,7 @@ RC IndexManager::createFile(const string &fileName)
     // Initialize the first page with metadata. root page will be page 1
     MetaHeader meta;
     meta.rootPage = 1;
+    meta.freePage = 0;
     setMetaData(meta, pageData);
     rc = handle.appendPage(pageData);
     if (rc)
@@ -78,6 +79,7 @@ RC IndexManager::createFile(const string &fileName)
     leafHeader.prev            = 0;
     leafHeader.entriesNumber   = 0;
     leafHeader.freeSpaceOffset = PAGE_SIZE;
+    leafHeader.prefixLength    = 0;
     setLeafHeader(leafHeader, pageData);
     rc = handle.appendPage(pageData);
     if (rc)
@@ -105,6 +107,7 @@ RC IndexManager::openFile(const string &fileName, IXFileHandle &ixfileHandle)
     PagedFileManager *pfm = PagedFileManager::instance();
     if (pfm->openFile(fileName, ixfileHandle.fh))
         return IX_OPEN_FAILED;
+    ixfileHandle.clearCache();
     return SUCCESS;
 }
 
@@ -113,20 +116,63 @@ RC IndexManager::closeFile(IXFileHandle &ixfileHandle)
     PagedFileManager *pfm = PagedFileManager::instance();
     if (pfm->closeFile(ixfileHandle.fh))
         return IX_CLOSE_FAILED;
+    ixfileHandle.clearCache();
     return SUCCESS;
 }
 
 RC IndexManager::insertEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
+    LogOperation operation;
     ChildEntry childEntry = {.key = NULL, .childPage = 0};
+    ixfileHandle.fh.latchFile(false);
+
+    // Most inserts only change the leaf. Go straight to it, past the cached upper levels,
+    // and if it has room that is all there is to do.
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+    {
+        ixfileHandle.fh.unlatchFile();
+        return IX_MALLOC_FAILED;
+    }
+    int32_t leafPage;
+    RC rc = find(ixfileHandle, attribute, key, leafPage, true, pageData);
+    if (rc == SUCCESS)
+    {
+        rc = insertIntoLeaf(ixfileHandle, attribute, key, rid, pageData);
+        if (rc == SUCCESS && ixfileHandle.writePage(leafPage, pageData))
+            rc = IX_WRITE_FAILED;
+        ixfileHandle.fh.unlatchPage(leafPage);
+    }
+    free(pageData);
+    if (rc != IX_NO_FREE_SPACE)
+    {
+        ixfileHandle.fh.unlatchFile();
+        if (rc)
+            return rc;
+        return operation.commit();
+    }
+
+    // The leaf is full. Latch crabbing: every node on the way down is latched exclusively, and
+    // the latches above a node are let go once the node is safe. The meta page is the parent of the root.
+    vector<PageNum> latched;
+    ixfileHandle.fh.latchPage(0, true);
+    latched.push_back(0);
     int32_t rootPage;
-    RC rc = getRootPageNum(ixfileHandle, rootPage);
+    rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc == SUCCESS)
+    {
+        ixfileHandle.fh.latchPage(rootPage, true);
+        latched.push_back(rootPage);
+        rc = insert(attribute, key, rid, ixfileHandle, rootPage, childEntry, latched);
+    }
+    unlatchPages(ixfileHandle, latched, 0);
+    ixfileHandle.fh.unlatchFile();
     if (rc)
         return rc;
-    return insert(attribute, key, rid, ixfileHandle, rootPage, childEntry);
+    return operation.commit();
 }
 
-RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, ChildEntry &childEntry)
+RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, ChildEntry &childEntry, vector<PageNum> &latched)
 {
     void *pageData = malloc(PAGE_SIZE);
     if(pageData == NULL)
@@ -139,6 +185,10 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
 
     NodeType type = getNodetype(pageData);
 
+    // This node will not split, so nothing above it changes
+    if (isSafe(attribute, key, pageData))
+        unlatchPages(fileHandle, latched, 1);
+
     if (type == IX_TYPE_INTERNAL)
     {
         int32_t childPage = getNextChildPage(attribute, key, pageData);
@@ -147,7 +197,9 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
             return IX_BAD_CHILD;
 
         // Recursively insert
-        RC rc = insert(attribute, key, rid, fileHandle, childPage, childEntry);
+        fileHandle.fh.latchPage(childPage, true);
+        latched.push_back(childPage);
+        RC rc = insert(attribute, key, rid, fileHandle, childPage, childEntry, latched);
         if (rc)
             return rc;
         if(childEntry.key == NULL)
@@ -176,7 +228,9 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
         }
         else if (IX_NO_FREE_SPACE)
         {
-            rc = splitInternal(fileHandle, attribute, pageID, pageData, childEntry);
+            // The root can only split while the meta page above it is still latched
+            bool isRoot = latched.size() >= 2 && latched[0] == 0 && latched[1] == (PageNum) pageID;
+            rc = splitInternal(fileHandle, attribute, pageID, isRoot, pageData, childEntry);
             free(pageData);
             pageData = NULL;
             return rc;
@@ -193,7 +247,7 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
     else // This is a leaf node
     {
         // Try to insert
-        RC rc = insertIntoLeaf(attribute, key, rid, pageData);
+        RC rc = insertIntoLeaf(fileHandle, attribute, key, rid, pageData);
         if (rc == SUCCESS) // We managed to insert the new pair into this leaf.
         {
             // Write our changes
@@ -229,110 +283,85 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
 
 RC IndexManager::splitLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *ins_key, const RID ins_rid, const int32_t pageID, void *originalLeaf, ChildEntry &childEntry)
 {
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(LeafHeader));
     LeafHeader originalHeader = getLeafHeader(originalLeaf);
 
+    // Every slot, with the new entry in the posting list of its key or in a slot of its own
+    vector<LeafEntry> entries;
+    getLeafEntries(attribute, originalLeaf, entries);
+    int i = searchLeaf(attribute, ins_key, originalLeaf, true);
+    if (i < originalHeader.entriesNumber && compareLeafSlot(attribute, ins_key, originalLeaf, i) == 0)
+    {
+        RC rc = addToPosting(fileHandle, entries[i], ins_rid);
+        if (rc)
+            return rc;
+    }
+    else
+    {
+        LeafEntry entry;
+        entry.key.assign((const char*)ins_key, getKeySize(attribute, ins_key));
+        entry.overflow = false;
+        encodePosting(vector<RID>(1, ins_rid), 0, 1, entry.posting);
+        entries.insert(entries.begin() + i, entry);
+    }
+
+    // A posting list that moved to overflow pages may have made room after all
+    int count = entries.size();
+    if (getLeafEntriesSize(attribute, entries, 0, count) <= capacity)
+    {
+        if (writeLeafEntries(attribute, entries, 0, count, originalLeaf))
+            return IX_INSERT_LEAF_FAILED;
+        return fileHandle.writePage(pageID, originalLeaf) ? IX_WRITE_FAILED : SUCCESS;
+    }
+
+    int split = chooseLeafSplit(attribute, entries);
+    if (split == 0)
+        return IX_INSERT_LEAF_FAILED;
+
     // Create new leaf to hold overflow
     void *newLeaf = calloc(PAGE_SIZE, 1);
+    if (newLeaf == NULL)
+        return IX_MALLOC_FAILED;
     setNodeType(IX_TYPE_LEAF, newLeaf);
     LeafHeader newHeader;
     newHeader.prev = pageID;
     newHeader.next = originalHeader.next;
     newHeader.entriesNumber = 0;
     newHeader.freeSpaceOffset = PAGE_SIZE;
+    newHeader.prefixLength = 0;
     setLeafHeader(newHeader, newLeaf);
-
-    int32_t newPageNum = fileHandle.getNumberOfPages();
-    originalHeader.next = newPageNum;
-    setLeafHeader(originalHeader, originalLeaf);
-
-    int size = 0;
-    int i;
-    int lastSize = 0;
-    for (i = 0; i < originalHeader.entriesNumber; i++)
-    {
-        DataEntry entry = getDataEntry(i, originalLeaf);
-        void *key = NULL;
-
-        if (attribute.type == TypeInt)
-            key = &(entry.integer);
-        else if (attribute.type == TypeReal)
-            key = &(entry.real);
-        else
-            key = (char*)originalLeaf + entry.varcharOffset;
-
-        lastSize = getKeyLengthLeaf(attribute, key);
-        size += lastSize;
-        if (size >= PAGE_SIZE / 2)
-        {
-            if (i >= originalHeader.entriesNumber - 1 || compareLeafSlot(attribute, key, originalLeaf, i+1) != 0)
-                break;
-        }
-    }
-    // i is now middle key
-    DataEntry middleEntry = getDataEntry(i, originalLeaf);
-    childEntry.key = malloc(lastSize);
-    if (childEntry.key == NULL)
-        return IX_MALLOC_FAILED;
-    childEntry.childPage = newPageNum;
-    int keySize = attribute.type == TypeVarChar ? lastSize - sizeof(DataEntry) : INT_SIZE;
-    if (attribute.type == TypeVarChar)
-        memcpy(childEntry.key, (char*)originalLeaf + middleEntry.varcharOffset, keySize);
-    else
-        memcpy(childEntry.key, &(middleEntry.integer), keySize);
-
-    void *moving_key = malloc (attribute.length + 4);
-    for (int j = 1; j < originalHeader.entriesNumber - i; j++)
-    {
-        // Grab data entry after the middle entry. We then delete it and the rest are shifted over
-        DataEntry entry = getDataEntry(i + 1, originalLeaf);
-        RID moving_rid = entry.rid;
-        if (attribute.type == TypeVarChar)
-        {
-            int32_t len;
-            memcpy(&len, (char*)originalLeaf + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-            memcpy(moving_key, &len, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)moving_key + VARCHAR_LENGTH_SIZE, (char*)originalLeaf + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-        }
-        else
-        {
-            memcpy(moving_key, &(entry.integer), INT_SIZE);
-        }
-        // Insert into new leaf, delete from old
-        insertIntoLeaf(attribute, moving_key, moving_rid, newLeaf);
-        deleteEntryFromLeaf(attribute, moving_key, moving_rid, originalLeaf);
-    }
-    free(moving_key);
-
-    // Still need to: Write back both (append new leaf)
-    // Add new record to correct page
-    if (compareLeafSlot(attribute, ins_key, originalLeaf, i) <= 0)
-    {
-        if (insertIntoLeaf(attribute, ins_key, ins_rid, originalLeaf))
-        {
-            free(newLeaf);
-            return -1;
-        }
-    }
-    else
+    if (writeLeafEntries(attribute, entries, split, count, newLeaf) ||
+        writeLeafEntries(attribute, entries, 0, split, originalLeaf))
     {
-        if (insertIntoLeaf(attribute, ins_key, ins_rid, newLeaf))
-        {
-            free(newLeaf);
-            return -1;
-        }
+        free(newLeaf);
+        return IX_INSERT_LEAF_FAILED;
     }
 
-    if(fileHandle.writePage(pageID, originalLeaf))
+    string separator;
+    getSeparator(attribute, entries[split - 1].key, entries[split].key, separator);
+    childEntry.key = malloc(separator.size());
+    if (childEntry.key == NULL)
     {
         free(newLeaf);
-        return IX_WRITE_FAILED;
+        return IX_MALLOC_FAILED;
     }
-    if(fileHandle.appendPage(newLeaf))
+    memcpy(childEntry.key, separator.data(), separator.size());
+
+    // The new leaf goes in first, so that its page number is known before the original
+    // points at it. Other inserts may be appending pages at the same time.
+    PageNum newPageNum;
+    if(fileHandle.appendPage(newLeaf, newPageNum))
     {
         free(newLeaf);
         return IX_APPEND_FAILED;
     }
     free(newLeaf);
+    childEntry.childPage = newPageNum;
+    LeafHeader header = getLeafHeader(originalLeaf);
+    header.next = newPageNum;
+    setLeafHeader(header, originalLeaf);
+    if(fileHandle.writePage(pageID, originalLeaf))
+        return IX_WRITE_FAILED;
     return SUCCESS;
 }
 
@@ -344,12 +373,7 @@ RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry,
     if (getFreeSpaceInternal(pageData) < len)
         return IX_NO_FREE_SPACE;
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        if (compareSlot(attribute, entry.key, pageData, i) <= 0)
-            break;
-    }
+    int i = searchInternal(attribute, entry.key, pageData);
 
     // i is slot number where new entry will go
     // i is slot number to move
@@ -378,19 +402,42 @@ RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry,
     return SUCCESS;
 }
 
-RC IndexManager::insertIntoLeaf(const Attribute attribute, const void *key, const RID &rid, void *pageData)
+RC IndexManager::insertIntoLeaf(IXFileHandle &fileHandle, const Attribute attribute, const void *key, const RID &rid, void *pageData)
 {
     LeafHeader header = getLeafHeader(pageData);
+    int i = searchLeaf(attribute, key, pageData, true);
+
+    // The key is on the leaf already: the rid goes in its posting list. Nothing has changed
+    // if there is not enough free space, unless the posting list moved to overflow pages,
+    // which only makes it shorter.
+    if (i < header.entriesNumber && compareLeafSlot(attribute, key, pageData, i) == 0)
+    {
+        LeafEntry entry;
+        getLeafEntry(attribute, i, pageData, entry);
+        RC rc = addToPosting(fileHandle, entry, rid);
+        if (rc)
+            return rc;
+        return setLeafPosting(attribute, i, entry, pageData);
+    }
 
-    int32_t key_len = getKeyLengthLeaf(attribute, key);
-    if (getFreeSpaceLeaf(pageData) < key_len)
+    if (getFreeSpaceLeaf(pageData) < getInsertSpaceLeaf(attribute, key, pageData))
         return IX_NO_FREE_SPACE;
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
+    string posting;
+    RID previous = {0, 0};
+    appendToPosting(rid, previous, posting);
+
+    // A key outside the page's prefix makes the prefix shorter for every key on the page
+    if (attribute.type == TypeVarChar && !hasLeafPrefix(key, pageData))
     {
-        if (compareLeafSlot(attribute, key, pageData, i) < 0)
-            break;
+        vector<LeafEntry> entries;
+        getLeafEntries(attribute, pageData, entries);
+        LeafEntry entry;
+        entry.key.assign((const char*)key, getKeySize(attribute, key));
+        entry.posting = posting;
+        entry.overflow = false;
+        entries.insert(entries.begin() + i, entry);
+        return writeLeafEntries(attribute, entries, 0, entries.size(), pageData);
     }
 
     // i is slot number to move
@@ -400,222 +447,1975 @@ RC IndexManager::insertIntoLeaf(const Attribute attribute, const void *key, cons
     memmove((char*)pageData + start_offset + sizeof(DataEntry), (char*)pageData + start_offset, end_offset - start_offset);
 
     DataEntry newEntry;
-    newEntry.rid = rid;
     if (attribute.type == TypeInt)
         memcpy(&(newEntry.integer), key, INT_SIZE);
     else if (attribute.type == TypeReal)
         memcpy(&(newEntry.real), key, REAL_SIZE);
     else
     {
+        // Only the part after the page's prefix is stored
         int32_t len;
         memcpy(&len, key, VARCHAR_LENGTH_SIZE);
-        newEntry.varcharOffset = header.freeSpaceOffset - (len + VARCHAR_LENGTH_SIZE);
-        memcpy((char*)pageData + newEntry.varcharOffset, key, len + VARCHAR_LENGTH_SIZE);
+        int32_t suffixLength = len - header.prefixLength;
+        newEntry.varcharOffset = header.freeSpaceOffset - (suffixLength + VARCHAR_LENGTH_SIZE);
+        memcpy((char*)pageData + newEntry.varcharOffset, &suffixLength, VARCHAR_LENGTH_SIZE);
+        memcpy((char*)pageData + newEntry.varcharOffset + VARCHAR_LENGTH_SIZE, (char*)key + VARCHAR_LENGTH_SIZE + header.prefixLength, suffixLength);
         header.freeSpaceOffset = newEntry.varcharOffset;
     }
+    newEntry.postingOffset = header.freeSpaceOffset - posting.size();
+    newEntry.postingLength = posting.size();
+    memcpy((char*)pageData + newEntry.postingOffset, posting.data(), posting.size());
+    header.freeSpaceOffset = newEntry.postingOffset;
     header.entriesNumber += 1;
     setLeafHeader(header, pageData);
     setDataEntry(newEntry, i, pageData);
     return SUCCESS;
 }
 
-int IndexManager::getOffsetOfLeafSlot(int slotNum) const
+RC IndexManager::writeLeafEntries(const Attribute attribute, const vector<LeafEntry> &entries, int begin, int end, void *pageData)
 {
-    return sizeof(NodeType) + sizeof(LeafHeader) + slotNum * sizeof(DataEntry);
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(LeafHeader));
+    if (getLeafEntriesSize(attribute, entries, begin, end) > capacity)
+        return IX_NO_FREE_SPACE;
+
+    // The keys are in order, so what the first and last have in common, they all have
+    LeafHeader header = getLeafHeader(pageData);
+    header.entriesNumber = 0;
+    header.prefixLength = getLeafPrefixLength(attribute, entries, begin, end);
+    header.freeSpaceOffset = PAGE_SIZE - header.prefixLength;
+    if (header.prefixLength > 0)
+        memcpy((char*)pageData + header.freeSpaceOffset, entries[begin].key.data() + VARCHAR_LENGTH_SIZE, header.prefixLength);
+
+    for (int i = begin; i < end; i++)
+    {
+        const LeafEntry &leafEntry = entries[i];
+        DataEntry entry;
+        if (attribute.type != TypeVarChar)
+            memcpy(&entry.integer, leafEntry.key.data(), INT_SIZE);
+        else
+        {
+            int32_t suffixLength = leafEntry.key.size() - VARCHAR_LENGTH_SIZE - header.prefixLength;
+            entry.varcharOffset = header.freeSpaceOffset - (suffixLength + VARCHAR_LENGTH_SIZE);
+            memcpy((char*)pageData + entry.varcharOffset, &suffixLength, VARCHAR_LENGTH_SIZE);
+            memcpy((char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, leafEntry.key.data() + VARCHAR_LENGTH_SIZE + header.prefixLength, suffixLength);
+            header.freeSpaceOffset = entry.varcharOffset;
+        }
+        entry.postingOffset = header.freeSpaceOffset - leafEntry.posting.size();
+        entry.postingLength = leafEntry.posting.size() | (leafEntry.overflow ? IX_POSTING_OVERFLOW : 0);
+        memcpy((char*)pageData + entry.postingOffset, leafEntry.posting.data(), leafEntry.posting.size());
+        header.freeSpaceOffset = entry.postingOffset;
+        setDataEntry(entry, header.entriesNumber, pageData);
+        header.entriesNumber += 1;
+    }
+    setLeafHeader(header, pageData);
+    return SUCCESS;
 }
 
-int IndexManager::getOffsetOfInternalSlot(int slotNum) const
+void IndexManager::getLeafEntries(const Attribute attribute, const void *pageData, vector<LeafEntry> &entries) const
 {
-    return sizeof(NodeType) + sizeof(InternalHeader) + slotNum * sizeof(IndexEntry);
+    LeafHeader header = getLeafHeader(pageData);
+    entries.resize(header.entriesNumber);
+    for (int i = 0; i < header.entriesNumber; i++)
+        getLeafEntry(attribute, i, pageData, entries[i]);
 }
 
-RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *original, ChildEntry &childEntry)
+void IndexManager::getLeafEntry(const Attribute attribute, const int slotNum, const void *pageData, LeafEntry &entry) const
 {
-    InternalHeader originalHeader = getInternalHeader(original);
+    DataEntry data = getDataEntry(slotNum, pageData);
+    getLeafSlotKey(attribute, slotNum, pageData, entry.key);
+    entry.posting.assign((char*)pageData + data.postingOffset, data.postingLength & ~IX_POSTING_OVERFLOW);
+    entry.overflow = (data.postingLength & IX_POSTING_OVERFLOW) != 0;
+}
 
-    int32_t newPageNum = fileHandle.getNumberOfPages();
+int IndexManager::getLeafEntrySize(const Attribute attribute, const LeafEntry &entry) const
+{
+    int size = sizeof(DataEntry) + entry.posting.size();
+    if (attribute.type == TypeVarChar)
+        size += entry.key.size();
+    return size;
+}
 
-    int size = 0;
-    int i;
-    int lastSize = 0;
-    for (i = 0; i < originalHeader.entriesNumber; i++)
-    {
-        IndexEntry entry = getIndexEntry(i, original);
-        void *key;
+int IndexManager::getLeafSize(int entries, int bytes, int prefixLength) const
+{
+    return bytes - entries * prefixLength + prefixLength;
+}
 
-        if (attribute.type == TypeInt)
-            key = &(entry.integer);
-        else if (attribute.type == TypeReal)
-            key = &(entry.real);
-        else
-            key = (char*)original + entry.varcharOffset;
+int IndexManager::getLeafPrefixLength(const Attribute attribute, const vector<LeafEntry> &entries, int begin, int end) const
+{
+    if (attribute.type != TypeVarChar || end <= begin)
+        return 0;
+    return getCommonPrefixLength(entries[begin].key, entries[end - 1].key);
+}
 
-        lastSize = getKeyLengthInternal(attribute, key);
-        size += lastSize;
-        if (size >= PAGE_SIZE / 2)
-        {
-            break;
-        }
-    }
-    // i is now middle key
-    IndexEntry middleEntry = getIndexEntry(i, original);
+int IndexManager::getLeafEntriesSize(const Attribute attribute, const vector<LeafEntry> &entries, int begin, int end) const
+{
+    int bytes = 0;
+    for (int i = begin; i < end; i++)
+        bytes += getLeafEntrySize(attribute, entries[i]);
+    return getLeafSize(end - begin, bytes, getLeafPrefixLength(attribute, entries, begin, end));
+}
 
-    // Create new leaf to hold overflow
-    void *newIntern = calloc(PAGE_SIZE, 1);
-    setNodeType(IX_TYPE_INTERNAL, newIntern);
-    InternalHeader newHeader;
-    newHeader.entriesNumber = 0;
-    newHeader.freeSpaceOffset = PAGE_SIZE;
-    newHeader.leftChildPage = middleEntry.childPage;
-    setInternalHeader(newHeader, newIntern);
+int IndexManager::chooseLeafSplit(const Attribute attribute, const vector<LeafEntry> &entries) const
+{
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(LeafHeader));
+    int count = entries.size();
 
-    // Get size of middle key, and store middle key for later
-    int keySize = attribute.type == TypeVarChar ? lastSize - sizeof(IndexEntry) : INT_SIZE;
-    void *middleKey = malloc(keySize);
-    if (attribute.type == TypeVarChar)
-        memcpy(middleKey, (char*)original + middleEntry.varcharOffset, keySize);
-    else
-        memcpy(middleKey, &(middleEntry.integer), INT_SIZE);
+    // The bytes the first i slots take without a prefix
+    vector<int> bytes(count + 1, 0);
+    for (int i = 0; i < count; i++)
+        bytes[i + 1] = bytes[i] + getLeafEntrySize(attribute, entries[i]);
 
-    // Create storage for shifting keys from one page to the other
-    void *moving_key = malloc (attribute.length + 4);
-    // Repeatedly insert an entry from one page into the other, then delete the entry from the original page
-    for (int j = 1; j < originalHeader.entriesNumber - i; j++)
+    int best = 0;
+    int bestDifference = 0;
+    for (int split = 1; split < count; split++)
     {
-        // Grab data entry after the middle entry. We then delete it and the rest are shifted over
-        IndexEntry entry = getIndexEntry(i + 1, original);
-        int32_t moving_pagenum = entry.childPage;
-        if (attribute.type == TypeVarChar)
-        {
-            int32_t len;
-            memcpy(&len, (char*)original + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-            memcpy(moving_key, &len, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)moving_key + VARCHAR_LENGTH_SIZE,(char*)original + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-        }
-        else
+        int leftSize = getLeafSize(split, bytes[split], getLeafPrefixLength(attribute, entries, 0, split));
+        int rightSize = getLeafSize(count - split, bytes[count] - bytes[split], getLeafPrefixLength(attribute, entries, split, count));
+        if (leftSize > capacity || rightSize > capacity)
+            continue;
+
+        int difference = abs(leftSize - rightSize);
+        if (best == 0 || difference < bestDifference)
         {
-            memcpy(moving_key, &(entry.integer), INT_SIZE);
+            best = split;
+            bestDifference = difference;
         }
-        ChildEntry tmp;
-        tmp.key = moving_key;
-        tmp.childPage = moving_pagenum;
-        insertIntoInternal(attribute, tmp, newIntern);
-        deleteEntryFromInternal(attribute, moving_key, original);
     }
-    free(moving_key);
-    // Delete middle entry
-    deleteEntryFromInternal(attribute, middleKey, original);
+    return best;
+}
 
-    // If new key is less than middle key, put it in original node, else put it in new node
-    if (compareSlot(attribute, childEntry.key, original, i) < 0)
+RC IndexManager::setLeafPosting(const Attribute attribute, const int slotNum, const LeafEntry &entry, void *pageData)
+{
+    DataEntry data = getDataEntry(slotNum, pageData);
+    int length = data.postingLength & ~IX_POSTING_OVERFLOW;
+
+    // A posting list of another length goes where the free space starts, in place of the old one
+    if ((int) entry.posting.size() != length)
     {
-        if (insertIntoInternal(attribute, childEntry, original))
-        {
-            free(newIntern);
-            return -1;
-        }
+        if (getFreeSpaceLeaf(pageData) + length < (int) entry.posting.size())
+            return IX_NO_FREE_SPACE;
+        removeLeafBytes(attribute, data.postingOffset, length, pageData);
+        LeafHeader header = getLeafHeader(pageData);
+        data = getDataEntry(slotNum, pageData);
+        data.postingOffset = header.freeSpaceOffset - entry.posting.size();
+        header.freeSpaceOffset = data.postingOffset;
+        setLeafHeader(header, pageData);
     }
-    else
+    memcpy((char*)pageData + data.postingOffset, entry.posting.data(), entry.posting.size());
+    data.postingLength = entry.posting.size() | (entry.overflow ? IX_POSTING_OVERFLOW : 0);
+    setDataEntry(data, slotNum, pageData);
+    return SUCCESS;
+}
+
+void IndexManager::removeLeafBytes(const Attribute attribute, int offset, int length, void *pageData)
+{
+    LeafHeader header = getLeafHeader(pageData);
+
+    // Take everything from the start of the free space to offset, and move it over the bytes removed
+    memmove((char*)pageData + header.freeSpaceOffset + length, (char*)pageData + header.freeSpaceOffset, offset - header.freeSpaceOffset);
+    header.freeSpaceOffset += length;
+    // Update all of the slots that are moved over
+    for (int i = 0; i < header.entriesNumber; i++)
     {
-        if (insertIntoInternal(attribute, childEntry, newIntern))
-        {
-            free(newIntern);
-            return -1;
-        }
+        DataEntry entry = getDataEntry(i, pageData);
+        if (attribute.type == TypeVarChar && entry.varcharOffset < offset)
+            entry.varcharOffset += length;
+        if (entry.postingOffset < offset)
+            entry.postingOffset += length;
+        setDataEntry(entry, i, pageData);
     }
+    setLeafHeader(header, pageData);
+}
 
-    if(fileHandle.writePage(pageID, original))
+void IndexManager::deleteLeafSlot(const Attribute attribute, const int slotNum, void *pageData)
+{
+    LeafHeader header = getLeafHeader(pageData);
+    DataEntry entry = getDataEntry(slotNum, pageData);
+
+    // Move entries over, overwriting the slot being deleted
+    unsigned slotStartOffset = getOffsetOfLeafSlot(slotNum);
+    unsigned slotEndOffset = getOffsetOfLeafSlot(header.entriesNumber);
+    memmove((char*)pageData + slotStartOffset, (char*)pageData + slotStartOffset + sizeof(DataEntry), slotEndOffset - slotStartOffset - sizeof(DataEntry));
+    header.entriesNumber -= 1;
+    setLeafHeader(header, pageData);
+
+    // Then the key and the posting list. The one lower on the page goes first, since taking
+    // it out leaves everything above it where it was.
+    int postingLength = entry.postingLength & ~IX_POSTING_OVERFLOW;
+    if (attribute.type != TypeVarChar)
     {
-        free(newIntern);
-        return IX_WRITE_FAILED;
+        removeLeafBytes(attribute, entry.postingOffset, postingLength, pageData);
+        return;
     }
-    if(fileHandle.appendPage(newIntern))
+    int32_t suffixLength;
+    memcpy(&suffixLength, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+    int keyLength = VARCHAR_LENGTH_SIZE + suffixLength;
+    if (entry.varcharOffset < entry.postingOffset)
     {
-        free(newIntern);
-        return IX_APPEND_FAILED;
+        removeLeafBytes(attribute, entry.varcharOffset, keyLength, pageData);
+        removeLeafBytes(attribute, entry.postingOffset, postingLength, pageData);
     }
-    free(newIntern);
+    else
+    {
+        removeLeafBytes(attribute, entry.postingOffset, postingLength, pageData);
+        removeLeafBytes(attribute, entry.varcharOffset, keyLength, pageData);
+    }
+}
 
-    // Take the key of middle entry and allow it to propogate up
-    free(childEntry.key);
-    childEntry.key = middleKey;
-    childEntry.childPage = newPageNum;
+// A rid is the difference of its page from the page of the rid before it, then the difference
+// of its slot from the slot before it if the page is the same, else the slot itself. Each is
+// 7 bits to a byte, lowest first, with the high bit set in every byte but the last. The first
+// rid is taken from page 0, slot 0. Entries added by a table scan come in rid order, so most
+// rids take two bytes.
+void IndexManager::encodePosting(const vector<RID> &rids, int begin, int end, string &posting) const
+{
+    posting.clear();
+    RID previous = {0, 0};
+    for (int i = begin; i < end; i++)
+        appendToPosting(rids[i], previous, posting);
+}
 
-    // Check if we're root, then handle that case if we are
-    int32_t rootPage;
-    getRootPageNum(fileHandle, rootPage);
-    if (pageID == rootPage)
+void IndexManager::appendToPosting(const RID &rid, RID &previous, string &posting) const
+{
+    uint32_t values[2];
+    values[0] = rid.pageNum - previous.pageNum;
+    values[1] = values[0] == 0 ? rid.slotNum - previous.slotNum : rid.slotNum;
+    for (int i = 0; i < 2; i++)
     {
-        // Create new page and set appropriate headers
-        void *newRoot = calloc(PAGE_SIZE, 1);
+        uint32_t value = values[i];
+        while (value >= 0x80)
+        {
+            posting.push_back((char) ((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        posting.push_back((char) value);
+    }
+    previous = rid;
+}
 
-        setNodeType(IX_TYPE_INTERNAL, newRoot);
-        InternalHeader rootHeader;
-        rootHeader.entriesNumber = 0;
-        rootHeader.freeSpaceOffset = PAGE_SIZE;
-        // Left most will be the smaller of these two pages
-        rootHeader.leftChildPage = pageID;
-        setInternalHeader(rootHeader, newRoot);
-        // Insert larger of these two pages after
-        insertIntoInternal(attribute, childEntry, newRoot);
+void IndexManager::decodePosting(const char *posting, int length, vector<RID> &rids) const
+{
+    RID previous = {0, 0};
+    int i = 0;
+    while (i < length)
+    {
+        uint32_t values[2];
+        for (int j = 0; j < 2; j++)
+        {
+            uint32_t value = 0;
+            int shift = 0;
+            unsigned char byte = 0x80;
+            while (i < length && (byte & 0x80) && shift < 35)
+            {
+                byte = posting[i++];
+                value |= (uint32_t) (byte & 0x7f) << shift;
+                shift += 7;
+            }
+            values[j] = value;
+        }
+        RID rid;
+        rid.pageNum = previous.pageNum + values[0];
+        rid.slotNum = values[0] == 0 ? previous.slotNum + values[1] : values[1];
+        rids.push_back(rid);
+        previous = rid;
+    }
+}
 
-        // Update metadata page
-        int newRootPage = fileHandle.getNumberOfPages();
-        if(fileHandle.appendPage(newRoot))
-            return IX_APPEND_FAILED;
-        MetaHeader metahead;
-        metahead.rootPage = newRootPage;
-        setMetaData(metahead, newRoot);
-        if(fileHandle.writePage(0, newRoot))
-            return IX_WRITE_FAILED;
-        // Free memory
-        free(newRoot);
-        free(childEntry.key);
-        childEntry.key = NULL;
+RC IndexManager::getPostingRids(IXFileHandle &fileHandle, const LeafEntry &entry, vector<RID> &rids) const
+{
+    rids.clear();
+    if (!entry.overflow)
+    {
+        decodePosting(entry.posting.data(), entry.posting.size(), rids);
+        return SUCCESS;
+    }
 
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    OverflowPosting overflow;
+    memcpy(&overflow, entry.posting.data(), sizeof(OverflowPosting));
+    PageNum pageNum = overflow.firstPage;
+    while (pageNum != 0)
+    {
+        if (fileHandle.readPage(pageNum, pageData))
+        {
+            free(pageData);
+            return IX_READ_FAILED;
+        }
+        OverflowHeader header = getOverflowHeader(pageData);
+        decodePosting((char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader), header.postingLength, rids);
+        pageNum = header.next;
     }
+    free(pageData);
+    return SUCCESS;
+}
 
+RC IndexManager::addToPosting(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid)
+{
+    if (entry.overflow)
+        return insertIntoOverflow(fileHandle, entry, rid);
+
+    // After any equal rids. Most come after all the others.
+    vector<RID> rids;
+    decodePosting(entry.posting.data(), entry.posting.size(), rids);
+    unsigned i = rids.size();
+    while (i > 0 && compare(rids[i - 1], rid) > 0)
+        i--;
+    rids.insert(rids.begin() + i, rid);
+    encodePosting(rids, 0, rids.size(), entry.posting);
+    if (entry.posting.size() > IX_MAX_POSTING_SIZE)
+        return writeOverflow(fileHandle, rids, NULL, entry);
     return SUCCESS;
 }
 
-RC IndexManager::deleteEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
+RC IndexManager::removeFromPosting(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid, bool canFree)
+{
+    if (entry.overflow)
+        return deleteFromOverflow(fileHandle, entry, rid, canFree);
+
+    vector<RID> rids;
+    decodePosting(entry.posting.data(), entry.posting.size(), rids);
+    unsigned i = 0;
+    while (i < rids.size() && compare(rids[i], rid) != 0)
+        i++;
+    if (i == rids.size())
+        return IX_RECORD_DN_EXIST;
+    rids.erase(rids.begin() + i);
+    encodePosting(rids, 0, rids.size(), entry.posting);
+    return SUCCESS;
+}
+
+RC IndexManager::writeOverflow(IXFileHandle &fileHandle, const vector<RID> &rids, NodePages *pages, LeafEntry &entry)
+{
+    const unsigned capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(OverflowHeader));
+
+    // As many rids to a page as fit, each page's posting list starting over from page 0
+    vector<string> postings(1);
+    vector<unsigned> ends;
+    RID previous = {0, 0};
+    for (unsigned i = 0; i < rids.size(); i++)
+    {
+        unsigned size = postings.back().size();
+        appendToPosting(rids[i], previous, postings.back());
+        if (postings.back().size() <= capacity)
+            continue;
+        postings.back().resize(size);
+        ends.push_back(i);
+        postings.push_back(string());
+        previous.pageNum = 0;
+        previous.slotNum = 0;
+        appendToPosting(rids[i], previous, postings.back());
+    }
+    ends.push_back(rids.size());
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    OverflowPosting overflow;
+    RC rc = SUCCESS;
+    if (pages != NULL)
+    {
+        // Pages from takePage, each knowing the one after it before any is written
+        vector<PageNum> pageNums(postings.size());
+        for (unsigned k = 0; k < postings.size(); k++)
+            pageNums[k] = takePage(*pages);
+        for (unsigned k = 0; k < postings.size() && rc == SUCCESS; k++)
+        {
+            unsigned begin = k == 0 ? 0 : ends[k - 1];
+            setOverflowPage(postings[k], ends[k] - begin, rids[ends[k] - 1], k + 1 < postings.size() ? pageNums[k + 1] : 0, pageData);
+            rc = writeNode(fileHandle, pageNums[k], pageData);
+        }
+        overflow.firstPage = pageNums.front();
+        overflow.lastPage = pageNums.back();
+    }
+    else
+    {
+        // Appended from the last page back, so each page knows the one after it when it is written
+        uint32_t next = 0;
+        for (int k = postings.size() - 1; k >= 0 && rc == SUCCESS; k--)
+        {
+            unsigned begin = k == 0 ? 0 : ends[k - 1];
+            setOverflowPage(postings[k], ends[k] - begin, rids[ends[k] - 1], next, pageData);
+            PageNum pageNum;
+            if (fileHandle.appendPage(pageData, pageNum))
+            {
+                rc = IX_APPEND_FAILED;
+                break;
+            }
+            if (next == 0)
+                overflow.lastPage = pageNum;
+            next = pageNum;
+        }
+        overflow.firstPage = next;
+    }
+    free(pageData);
+    if (rc)
+        return rc;
+
+    overflow.ridsNumber = rids.size();
+    entry.posting.assign((char*)&overflow, sizeof(OverflowPosting));
+    entry.overflow = true;
+    return SUCCESS;
+}
+
+RC IndexManager::insertIntoOverflow(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid)
+{
+    const unsigned capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(OverflowHeader));
+    OverflowPosting overflow;
+    memcpy(&overflow, entry.posting.data(), sizeof(OverflowPosting));
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+
+    // Most rids are larger than every other and go on the last page. Else the rid goes on
+    // the first page whose last rid is not smaller.
+    PageNum pageNum = overflow.lastPage;
+    if (fileHandle.readPage(pageNum, pageData))
+    {
+        free(pageData);
+        return IX_READ_FAILED;
+    }
+    OverflowHeader header = getOverflowHeader(pageData);
+    vector<RID> rids;
+    decodePosting((char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader), header.postingLength, rids);
+    if (!rids.empty() && compare(rid, rids.front()) < 0)
+    {
+        pageNum = overflow.firstPage;
+        while (true)
+        {
+            if (fileHandle.readPage(pageNum, pageData))
+            {
+                free(pageData);
+                return IX_READ_FAILED;
+            }
+            header = getOverflowHeader(pageData);
+            if (header.next == 0 || compare(rid, header.last) <= 0)
+                break;
+            pageNum = header.next;
+        }
+        rids.clear();
+        decodePosting((char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader), header.postingLength, rids);
+    }
+
+    unsigned i = rids.size();
+    while (i > 0 && compare(rids[i - 1], rid) > 0)
+        i--;
+    rids.insert(rids.begin() + i, rid);
+    string posting;
+    encodePosting(rids, 0, rids.size(), posting);
+
+    RC rc = SUCCESS;
+    if (posting.size() <= capacity)
+    {
+        setOverflowPage(posting, rids.size(), rids.back(), header.next, pageData);
+        if (fileHandle.writePage(pageNum, pageData))
+            rc = IX_WRITE_FAILED;
+    }
+    else
+    {
+        // The page is full. A rid larger than every other starts a new last page, else the
+        // page is split in half. The new page goes in first, so that no page points at one
+        // that is not written yet.
+        unsigned split = header.next == 0 && i == rids.size() - 1 ? i : rids.size() / 2;
+        encodePosting(rids, split, rids.size(), posting);
+        setOverflowPage(posting, rids.size() - split, rids.back(), header.next, pageData);
+        PageNum newPageNum;
+        if (fileHandle.appendPage(pageData, newPageNum))
+            rc = IX_APPEND_FAILED;
+        else
+        {
+            encodePosting(rids, 0, split, posting);
+            setOverflowPage(posting, split, rids[split - 1], newPageNum, pageData);
+            if (fileHandle.writePage(pageNum, pageData))
+                rc = IX_WRITE_FAILED;
+            if (header.next == 0)
+                overflow.lastPage = newPageNum;
+        }
+    }
+    free(pageData);
+    if (rc)
+        return rc;
+
+    overflow.ridsNumber += 1;
+    entry.posting.assign((char*)&overflow, sizeof(OverflowPosting));
+    return SUCCESS;
+}
+
+RC IndexManager::deleteFromOverflow(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid, bool canFree)
+{
+    OverflowPosting overflow;
+    memcpy(&overflow, entry.posting.data(), sizeof(OverflowPosting));
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+
+    // The rid can only be on the first page whose last rid is not smaller
+    PageNum prevPage = 0;
+    PageNum pageNum = overflow.firstPage;
+    OverflowHeader header;
+    while (true)
+    {
+        if (fileHandle.readPage(pageNum, pageData))
+        {
+            free(pageData);
+            return IX_READ_FAILED;
+        }
+        header = getOverflowHeader(pageData);
+        if (compare(rid, header.last) <= 0)
+            break;
+        if (header.next == 0)
+        {
+            free(pageData);
+            return IX_RECORD_DN_EXIST;
+        }
+        prevPage = pageNum;
+        pageNum = header.next;
+    }
+    vector<RID> rids;
+    decodePosting((char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader), header.postingLength, rids);
+    unsigned i = 0;
+    while (i < rids.size() && compare(rids[i], rid) != 0)
+        i++;
+    if (i == rids.size())
+    {
+        free(pageData);
+        return IX_RECORD_DN_EXIST;
+    }
+
+    RC rc = SUCCESS;
+    if (rids.size() > 1)
+    {
+        rids.erase(rids.begin() + i);
+        string posting;
+        encodePosting(rids, 0, rids.size(), posting);
+        setOverflowPage(posting, rids.size(), rids.back(), header.next, pageData);
+        if (fileHandle.writePage(pageNum, pageData))
+            rc = IX_WRITE_FAILED;
+    }
+    else if (!canFree)
+    {
+        free(pageData);
+        return IX_FREES_PAGE;
+    }
+    else
+    {
+        // The page's last rid: the page leaves the chain and goes on the free list
+        if (prevPage == 0)
+            overflow.firstPage = header.next;
+        else if (fileHandle.readPage(prevPage, pageData))
+            rc = IX_READ_FAILED;
+        else
+        {
+            OverflowHeader prevHeader = getOverflowHeader(pageData);
+            prevHeader.next = header.next;
+            memcpy((char*)pageData + sizeof(NodeType), &prevHeader, sizeof(OverflowHeader));
+            if (fileHandle.writePage(prevPage, pageData))
+                rc = IX_WRITE_FAILED;
+        }
+        if (overflow.lastPage == pageNum)
+            overflow.lastPage = prevPage;
+        if (rc == SUCCESS)
+            rc = freePage(fileHandle, pageNum, header.next);
+    }
+    free(pageData);
+    if (rc)
+        return rc;
+
+    // The rids left stay on overflow pages until compact, however few. With none left the
+    // posting list is empty.
+    overflow.ridsNumber -= 1;
+    entry.posting.assign((char*)&overflow, sizeof(OverflowPosting));
+    if (overflow.ridsNumber == 0)
+    {
+        entry.posting.clear();
+        entry.overflow = false;
+    }
+    return SUCCESS;
+}
+
+void IndexManager::setOverflowPage(const string &posting, uint16_t ridsNumber, const RID &last, uint32_t next, void *pageData)
+{
+    memset(pageData, 0, PAGE_SIZE);
+    setNodeType(IX_TYPE_OVERFLOW, pageData);
+    OverflowHeader header;
+    header.next = next;
+    header.ridsNumber = ridsNumber;
+    header.postingLength = posting.size();
+    header.last = last;
+    memcpy((char*)pageData + sizeof(NodeType), &header, sizeof(OverflowHeader));
+    memcpy((char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader), posting.data(), posting.size());
+}
+
+RC IndexManager::appendIntoInternal(const Attribute attribute, ChildEntry entry, void *pageData)
+{
+    InternalHeader header = getInternalHeader(pageData);
+
+    if (getFreeSpaceInternal(pageData) < getKeyLengthInternal(attribute, entry.key))
+        return IX_NO_FREE_SPACE;
+
+    IndexEntry newEntry;
+    newEntry.childPage = entry.childPage;
+    if (attribute.type == TypeInt)
+        memcpy(&newEntry.integer, entry.key, INT_SIZE);
+    else if (attribute.type == TypeReal)
+        memcpy(&newEntry.real, entry.key, REAL_SIZE);
+    else
+    {
+        int32_t len;
+        memcpy(&len, entry.key, VARCHAR_LENGTH_SIZE);
+        newEntry.varcharOffset = header.freeSpaceOffset - (len + VARCHAR_LENGTH_SIZE);
+        memcpy((char*)pageData + newEntry.varcharOffset, entry.key, len + VARCHAR_LENGTH_SIZE);
+        header.freeSpaceOffset = newEntry.varcharOffset;
+    }
+    setIndexEntry(newEntry, header.entriesNumber, pageData);
+    header.entriesNumber += 1;
+    setInternalHeader(header, pageData);
+    return SUCCESS;
+}
+
+// Fills leaves with the sorted entries, starting with the leaf firstLeaf. The rest go to pages
+// from takePage(), so when those are new each leaf's next page is the one right after it,
+// unless the overflow pages of a key with too many rids come in between.
+// Returns the leaves in children, each with the shortest key that separates it from the
+// leaf before it, which is what splitLeaf pushes up as well.
+RC IndexManager::bulkLoadLeaves(IXFileHandle &fileHandle, const Attribute &attribute, IX_ExternalSorter &entries, float fillFactor, NodePages &pages, int32_t firstLeaf, vector<BulkLoadChild> &children)
+{
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(LeafHeader));
+    const int limit = capacity * fillFactor;
+
+    void *leaf = calloc(PAGE_SIZE, 1);
+    void *key = malloc(attribute.length + VARCHAR_LENGTH_SIZE);
+    if (leaf == NULL || key == NULL)
+    {
+        free(leaf);
+        free(key);
+        return IX_MALLOC_FAILED;
+    }
+
+    setNodeType(IX_TYPE_LEAF, leaf);
+    LeafHeader header;
+    header.next = 0;
+    header.prev = 0;
+    header.entriesNumber = 0;
+    header.freeSpaceOffset = PAGE_SIZE;
+    header.prefixLength = 0;
+    setLeafHeader(header, leaf);
+
+    children.clear();
+    BulkLoadChild child;
+    child.page = firstLeaf;
+    children.push_back(child);
+
+    // The slots of the leaf being filled, which is written once it is full, and the bytes
+    // they take without a prefix
+    int32_t leafPage = firstLeaf;
+    vector<LeafEntry> leafEntries;
+    int bytes = 0;
+    // The key being read, and its rids so far. Entries with the same key come in rid order.
+    string current;
+    vector<RID> rids;
+    RID rid;
+    RC rc = SUCCESS;
+    while (rc == SUCCESS)
+    {
+        rc = entries.getNextEntry(rid, key);
+        bool more = rc == SUCCESS;
+        if (rc == IX_EOF)
+            rc = SUCCESS;
+        if (rc)
+            break;
+        string next;
+        if (more)
+        {
+            next.assign((char*)key, getKeySize(attribute, key));
+            if (!rids.empty() && next == current)
+            {
+                rids.push_back(rid);
+                continue;
+            }
+        }
+
+        // The key before is done. Its posting list goes to overflow pages if it is too long.
+        if (!rids.empty())
+        {
+            LeafEntry entry;
+            entry.key.swap(current);
+            entry.overflow = false;
+            encodePosting(rids, 0, rids.size(), entry.posting);
+            if (entry.posting.size() > IX_MAX_POSTING_SIZE && (rc = writeOverflow(fileHandle, rids, &pages, entry)))
+                break;
+
+            int entrySize = getLeafEntrySize(attribute, entry);
+            int prefixLength = attribute.type == TypeVarChar ? getCommonPrefixLength(leafEntries.empty() ? entry.key : leafEntries.front().key, entry.key) : 0;
+            int size = getLeafSize(leafEntries.size() + 1, bytes + entrySize, prefixLength);
+            if (!leafEntries.empty() && size > limit)
+            {
+                int32_t nextPage = takePage(pages);
+                header.next = nextPage;
+                setLeafHeader(header, leaf);
+                if ((rc = writeLeafEntries(attribute, leafEntries, 0, leafEntries.size(), leaf)) ||
+                    (rc = writeNode(fileHandle, leafPage, leaf)))
+                    break;
+
+                getSeparator(attribute, leafEntries.back().key, entry.key, child.key);
+                child.page = nextPage;
+                children.push_back(child);
+
+                memset(leaf, 0, PAGE_SIZE);
+                setNodeType(IX_TYPE_LEAF, leaf);
+                header.next = 0;
+                header.prev = leafPage;
+                header.entriesNumber = 0;
+                header.freeSpaceOffset = PAGE_SIZE;
+                header.prefixLength = 0;
+                setLeafHeader(header, leaf);
+                leafPage = nextPage;
+                leafEntries.clear();
+                bytes = 0;
+            }
+            leafEntries.push_back(entry);
+            bytes += entrySize;
+        }
+        if (!more)
+            break;
+        current.swap(next);
+        rids.clear();
+        rids.push_back(rid);
+    }
+
+    // The last leaf, next stays 0
+    if (rc == SUCCESS)
+        rc = writeLeafEntries(attribute, leafEntries, 0, leafEntries.size(), leaf);
+    if (rc == SUCCESS)
+        rc = writeNode(fileHandle, leafPage, leaf);
+
+    free(leaf);
+    free(key);
+    return rc;
+}
+
+// Packs children into internal nodes, each child after the first in a node entered with its key.
+// The first child of every node after the first becomes that node's left child, and its key goes
+// up with the node instead. A level that fits in one node is the root.
+RC IndexManager::bulkLoadInternal(IXFileHandle &fileHandle, const Attribute &attribute, float fillFactor, int32_t rootPage, NodePages &pages, vector<BulkLoadChild> &children)
+{
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(InternalHeader));
+    const int limit = capacity * fillFactor;
+
+    void *node = calloc(PAGE_SIZE, 1);
+    if (node == NULL)
+        return IX_MALLOC_FAILED;
+
+    InternalHeader header;
+    header.entriesNumber = 0;
+    header.freeSpaceOffset = PAGE_SIZE;
+    header.leftChildPage = children[0].page;
+    setNodeType(IX_TYPE_INTERNAL, node);
+    setInternalHeader(header, node);
+
+    vector<BulkLoadChild> parents;
+    BulkLoadChild parent;
+    parent.key = children[0].key;
+    parent.page = 0;
+    parents.push_back(parent);
+
+    for (unsigned i = 1; i < children.size(); i++)
+    {
+        ChildEntry entry;
+        entry.key = (void*) children[i].key.data();
+        entry.childPage = children[i].page;
+
+        int len = getKeyLengthInternal(attribute, entry.key);
+        int freeSpace = getFreeSpaceInternal(node);
+        header = getInternalHeader(node);
+        if (freeSpace < len || (header.entriesNumber > 0 && capacity - freeSpace + len > limit))
+        {
+            // This node is done, and it is not the only one on this level
+            parents.back().page = takePage(pages);
+            RC rc = writeNode(fileHandle, parents.back().page, node);
+            if (rc)
+            {
+                free(node);
+                return rc;
+            }
+
+            memset(node, 0, PAGE_SIZE);
+            header.entriesNumber = 0;
+            header.freeSpaceOffset = PAGE_SIZE;
+            header.leftChildPage = children[i].page;
+            setNodeType(IX_TYPE_INTERNAL, node);
+            setInternalHeader(header, node);
+
+            parent.key = children[i].key;
+            parents.push_back(parent);
+            continue;
+        }
+
+        if (appendIntoInternal(attribute, entry, node))
+        {
+            free(node);
+            return IX_INSERT_INTERNAL_FAILED;
+        }
+    }
+
+    parents.back().page = parents.size() == 1 ? rootPage : takePage(pages);
+    RC rc = writeNode(fileHandle, parents.back().page, node);
+
+    free(node);
+    children.swap(parents);
+    return rc;
+}
+
+PageNum IndexManager::takePage(NodePages &pages)
+{
+    if (pages.reuse.empty())
+        return pages.nextAppend++;
+    PageNum pageNum = pages.reuse.back();
+    pages.reuse.pop_back();
+    return pageNum;
+}
+
+RC IndexManager::writeNode(IXFileHandle &fileHandle, PageNum pageNum, const void *pageData)
+{
+    if (pageNum < fileHandle.getNumberOfPages())
+        return fileHandle.writePage(pageNum, pageData) ? IX_WRITE_FAILED : SUCCESS;
+
+    // New pages are not always written in the order they are taken: the overflow pages of a
+    // key go in before its leaf. The pages before this one are added blank, and are written
+    // when their turn comes.
+    void *blank = calloc(PAGE_SIZE, 1);
+    if (blank == NULL)
+        return IX_MALLOC_FAILED;
+    RC rc = SUCCESS;
+    while (rc == SUCCESS && pageNum > fileHandle.getNumberOfPages())
+        if (fileHandle.appendPage(blank))
+            rc = IX_APPEND_FAILED;
+    free(blank);
+    if (rc)
+        return rc;
+    return fileHandle.appendPage(pageData) ? IX_APPEND_FAILED : SUCCESS;
+}
+
+int IndexManager::getOffsetOfLeafSlot(int slotNum) const
+{
+    return sizeof(NodeType) + sizeof(LeafHeader) + slotNum * sizeof(DataEntry);
+}
+
+int IndexManager::getOffsetOfInternalSlot(int slotNum) const
+{
+    return sizeof(NodeType) + sizeof(InternalHeader) + slotNum * sizeof(IndexEntry);
+}
+
+RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, bool isRoot, void *original, ChildEntry &childEntry)
+{
+    InternalHeader originalHeader = getInternalHeader(original);
+
+    int size = 0;
+    int i;
+    int lastSize = 0;
+    for (i = 0; i < originalHeader.entriesNumber; i++)
+    {
+        IndexEntry entry = getIndexEntry(i, original);
+        void *key;
+
+        if (attribute.type == TypeInt)
+            key = &(entry.integer);
+        else if (attribute.type == TypeReal)
+            key = &(entry.real);
+        else
+            key = (char*)original + entry.varcharOffset;
+
+        lastSize = getKeyLengthInternal(attribute, key);
+        size += lastSize;
+        if (size >= PAGE_SIZE / 2)
+        {
+            break;
+        }
+    }
+    // i is now middle key
+    IndexEntry middleEntry = getIndexEntry(i, original);
+
+    // Create new leaf to hold overflow
+    void *newIntern = calloc(PAGE_SIZE, 1);
+    setNodeType(IX_TYPE_INTERNAL, newIntern);
+    InternalHeader newHeader;
+    newHeader.entriesNumber = 0;
+    newHeader.freeSpaceOffset = PAGE_SIZE;
+    newHeader.leftChildPage = middleEntry.childPage;
+    setInternalHeader(newHeader, newIntern);
+
+    // Get size of middle key, and store middle key for later
+    int keySize = attribute.type == TypeVarChar ? lastSize - sizeof(IndexEntry) : INT_SIZE;
+    void *middleKey = malloc(keySize);
+    if (attribute.type == TypeVarChar)
+        memcpy(middleKey, (char*)original + middleEntry.varcharOffset, keySize);
+    else
+        memcpy(middleKey, &(middleEntry.integer), INT_SIZE);
+
+    // Create storage for shifting keys from one page to the other
+    void *moving_key = malloc (attribute.length + 4);
+    // Repeatedly insert an entry from one page into the other, then delete the entry from the original page
+    for (int j = 1; j < originalHeader.entriesNumber - i; j++)
+    {
+        // Grab data entry after the middle entry. We then delete it and the rest are shifted over
+        IndexEntry entry = getIndexEntry(i + 1, original);
+        int32_t moving_pagenum = entry.childPage;
+        if (attribute.type == TypeVarChar)
+        {
+            int32_t len;
+            memcpy(&len, (char*)original + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+            memcpy(moving_key, &len, VARCHAR_LENGTH_SIZE);
+            memcpy((char*)moving_key + VARCHAR_LENGTH_SIZE,(char*)original + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
+        }
+        else
+        {
+            memcpy(moving_key, &(entry.integer), INT_SIZE);
+        }
+        ChildEntry tmp;
+        tmp.key = moving_key;
+        tmp.childPage = moving_pagenum;
+        insertIntoInternal(attribute, tmp, newIntern);
+        deleteEntryFromInternal(attribute, moving_key, original);
+    }
+    free(moving_key);
+    // Delete middle entry
+    deleteEntryFromInternal(attribute, middleKey, original);
+
+    // If new key is less than middle key, put it in original node, else put it in new node.
+    // The middle entry is gone from the node by now, so it is compared with the copy.
+    if (compareKey(attribute, childEntry.key, middleKey) < 0)
+    {
+        if (insertIntoInternal(attribute, childEntry, original))
+        {
+            free(newIntern);
+            return -1;
+        }
+    }
+    else
+    {
+        if (insertIntoInternal(attribute, childEntry, newIntern))
+        {
+            free(newIntern);
+            return -1;
+        }
+    }
+
+    if(fileHandle.writePage(pageID, original))
+    {
+        free(newIntern);
+        return IX_WRITE_FAILED;
+    }
+    PageNum newPageNum;
+    if(fileHandle.appendPage(newIntern, newPageNum))
+    {
+        free(newIntern);
+        return IX_APPEND_FAILED;
+    }
+    free(newIntern);
+
+    // Take the key of middle entry and allow it to propogate up
+    free(childEntry.key);
+    childEntry.key = middleKey;
+    childEntry.childPage = newPageNum;
+
+    // Check if we're root, then handle that case if we are
+    if (isRoot)
+    {
+        // Create new page and set appropriate headers
+        void *newRoot = calloc(PAGE_SIZE, 1);
+
+        setNodeType(IX_TYPE_INTERNAL, newRoot);
+        InternalHeader rootHeader;
+        rootHeader.entriesNumber = 0;
+        rootHeader.freeSpaceOffset = PAGE_SIZE;
+        // Left most will be the smaller of these two pages
+        rootHeader.leftChildPage = pageID;
+        setInternalHeader(rootHeader, newRoot);
+        // Insert larger of these two pages after
+        insertIntoInternal(attribute, childEntry, newRoot);
+
+        // Update metadata page, which is latched along with the root
+        PageNum newRootPage;
+        if(fileHandle.appendPage(newRoot, newRootPage))
+            return IX_APPEND_FAILED;
+        if(fileHandle.readPage(0, newRoot))
+            return IX_READ_FAILED;
+        MetaHeader metahead = getMetaData(newRoot);
+        metahead.rootPage = newRootPage;
+        setMetaData(metahead, newRoot);
+        if(fileHandle.writePage(0, newRoot))
+            return IX_WRITE_FAILED;
+        // Free memory
+        free(newRoot);
+        free(childEntry.key);
+        childEntry.key = NULL;
+
+    }
+
+    return SUCCESS;
+}
+
+RC IndexManager::insertEntry(IXFileHandle &ixfileHandle, const IX_KeySchema &schema, const void *key, const RID &rid)
+{
+    string encoded;
+    schema.encode(key, schema.getAttributes().size(), encoded);
+    return insertEntry(ixfileHandle, schema.getKeyAttribute(), encoded.data(), rid);
+}
+
+RC IndexManager::deleteEntry(IXFileHandle &ixfileHandle, const IX_KeySchema &schema, const void *key, const RID &rid)
+{
+    string encoded;
+    schema.encode(key, schema.getAttributes().size(), encoded);
+    return deleteEntry(ixfileHandle, schema.getKeyAttribute(), encoded.data(), rid);
+}
+
+RC IndexManager::deleteEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
+{
+    LogOperation operation;
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+
+    // leafPage is page number of leaf where this entry would be, latched exclusively, and read into pageData
+    ixfileHandle.fh.latchFile(false);
+    int32_t leafPage;
+    RC rc = find(ixfileHandle, attribute, key, leafPage, true, pageData);
+    if (rc)
+    {
+        free(pageData);
+        ixfileHandle.fh.unlatchFile();
+        return rc;
+    }
+    // Delete it from pageData
+    rc = deleteEntryFromLeaf(ixfileHandle, attribute, key, rid, pageData, false);
+    if (rc == SUCCESS)
+        rc = ixfileHandle.writePage(leafPage, pageData);
+    // A leaf with no neighbours is the only one, and is left as it is however small
+    LeafHeader header = getLeafHeader(pageData);
+    bool underflow = rc == SUCCESS && isUnderflow(pageData) && (header.next != 0 || header.prev != 0);
+    bool freesPage = rc == IX_FREES_PAGE;
+    ixfileHandle.fh.unlatchPage(leafPage);
+    ixfileHandle.fh.unlatchFile();
+    if (!underflow && !freesPage)
+    {
+        free(pageData);
+        if (rc)
+            return rc;
+        return operation.commit();
+    }
+
+    // Merges change several nodes on different levels, and a freed page the meta page, so they take the whole file
+    ixfileHandle.fh.latchFile(true);
+    if (freesPage)
+    {
+        rc = find(ixfileHandle, attribute, key, leafPage, true, pageData);
+        if (rc == SUCCESS)
+        {
+            rc = deleteEntryFromLeaf(ixfileHandle, attribute, key, rid, pageData, true);
+            if (rc == SUCCESS && ixfileHandle.writePage(leafPage, pageData))
+                rc = IX_WRITE_FAILED;
+            header = getLeafHeader(pageData);
+            underflow = rc == SUCCESS && isUnderflow(pageData) && (header.next != 0 || header.prev != 0);
+            ixfileHandle.fh.unlatchPage(leafPage);
+        }
+    }
+    free(pageData);
+    if (underflow)
+        rc = rebalance(ixfileHandle, attribute, key, leafPage);
+    ixfileHandle.fh.unlatchFile();
+    if (rc)
+        return rc;
+    return operation.commit();
+}
+
+bool IndexManager::isUnderflow(const void *pageData) const
+{
+    int capacity, freeSpace;
+    if (getNodetype(pageData) == IX_TYPE_LEAF)
+    {
+        capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(LeafHeader));
+        freeSpace = getFreeSpaceLeaf((void*)pageData);
+    }
+    else
+    {
+        capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(InternalHeader));
+        freeSpace = getFreeSpaceInternal((void*)pageData);
+    }
+    return capacity - freeSpace < capacity * IX_MIN_FILL_FACTOR;
+}
+
+RC IndexManager::rebalance(IXFileHandle &fileHandle, const Attribute &attr, const void *key, int32_t leafPage)
+{
+    // The copies of internal nodes that handles hold are no good from here on
+    fileHandle.fh.bumpVersion();
+
+    void *pageData = malloc(PAGE_SIZE);
+    void *parentData = malloc(PAGE_SIZE);
+    void *siblingData = malloc(PAGE_SIZE);
+    if (pageData == NULL || parentData == NULL || siblingData == NULL)
+    {
+        free(pageData);
+        free(parentData);
+        free(siblingData);
+        return IX_MALLOC_FAILED;
+    }
+
+    // The path down to the leaf, and which child was taken at each internal node: 0 for the
+    // left child, i for the child of slot i - 1
+    vector<int32_t> path;
+    vector<int> childIndexes;
+    int32_t rootPage;
+    RC rc = getRootPageNum(fileHandle, rootPage);
+    int32_t pageNum = rootPage;
+    while (rc == SUCCESS)
+    {
+        if (fileHandle.readPage(pageNum, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        path.push_back(pageNum);
+        if (getNodetype(pageData) == IX_TYPE_LEAF)
+            break;
+        // Same choice as getNextChildPage()
+        int i = searchInternal(attr, key, pageData);
+        childIndexes.push_back(i);
+        pageNum = i == 0 ? getInternalHeader(pageData).leftChildPage : getIndexEntry(i - 1, pageData).childPage;
+    }
+
+    // The leaf may have been rebalanced already by an earlier delete, which let go of the file
+    // as well before taking it exclusively.
+    if (rc || path.back() != leafPage)
+    {
+        free(pageData);
+        free(parentData);
+        free(siblingData);
+        return rc;
+    }
+
+    // Up from the leaf for as long as nodes underflow. The root has no siblings.
+    for (int level = path.size() - 1; level > 0 && rc == SUCCESS; level--)
+    {
+        if (fileHandle.readPage(path[level], pageData) || fileHandle.readPage(path[level - 1], parentData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        if (!isUnderflow(pageData))
+            break;
+
+        // A node that is its parent's only child has no sibling to take from
+        InternalHeader parentHeader = getInternalHeader(parentData);
+        if (parentHeader.entriesNumber == 0)
+            break;
+
+        // The sibling to the right if there is one under the same parent, else the one to the left
+        int i = childIndexes[level - 1];
+        int32_t siblingPage;
+        int slotNum;
+        if (i < parentHeader.entriesNumber)
+        {
+            slotNum = i;
+            siblingPage = getIndexEntry(i, parentData).childPage;
+        }
+        else
+        {
+            slotNum = i - 1;
+            siblingPage = i == 1 ? parentHeader.leftChildPage : getIndexEntry(i - 2, parentData).childPage;
+        }
+        if (fileHandle.readPage(siblingPage, siblingData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+
+        bool leaf = getNodetype(pageData) == IX_TYPE_LEAF;
+        if (i < parentHeader.entriesNumber)
+            rc = leaf ? rebalanceLeaves(fileHandle, attr, parentData, slotNum, path[level], pageData, siblingPage, siblingData)
+                      : rebalanceInternal(fileHandle, attr, parentData, slotNum, path[level], pageData, siblingPage, siblingData);
+        else
+            rc = leaf ? rebalanceLeaves(fileHandle, attr, parentData, slotNum, siblingPage, siblingData, path[level], pageData)
+                      : rebalanceInternal(fileHandle, attr, parentData, slotNum, siblingPage, siblingData, path[level], pageData);
+        if (rc == SUCCESS && fileHandle.writePage(path[level - 1], parentData))
+            rc = IX_WRITE_FAILED;
+    }
+
+    // A root left with one child that is an internal node is not needed. The root over a
+    // single leaf stays, as createFile makes it.
+    while (rc == SUCCESS)
+    {
+        if (fileHandle.readPage(rootPage, parentData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        InternalHeader rootHeader = getInternalHeader(parentData);
+        if (rootHeader.entriesNumber != 0)
+            break;
+        if (fileHandle.readPage(rootHeader.leftChildPage, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        if (getNodetype(pageData) != IX_TYPE_INTERNAL)
+            break;
+
+        if (fileHandle.readPage(0, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        MetaHeader meta = getMetaData(pageData);
+        meta.rootPage = rootHeader.leftChildPage;
+        setMetaData(meta, pageData);
+        if (fileHandle.writePage(0, pageData))
+        {
+            rc = IX_WRITE_FAILED;
+            break;
+        }
+        rc = freePage(fileHandle, rootPage, 0);
+        rootPage = rootHeader.leftChildPage;
+    }
+
+    free(pageData);
+    free(parentData);
+    free(siblingData);
+    return rc;
+}
+
+RC IndexManager::rebalanceLeaves(IXFileHandle &fileHandle, const Attribute &attr, void *parentData, int slotNum, int32_t leftPage, void *leftData, int32_t rightPage, void *rightData)
+{
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(LeafHeader));
+    LeafHeader leftHeader = getLeafHeader(leftData);
+    LeafHeader rightHeader = getLeafHeader(rightData);
+
+    // Both leaves' slots in key order. A key is only ever on one leaf, with all its rids.
+    vector<LeafEntry> entries;
+    vector<LeafEntry> rightEntries;
+    getLeafEntries(attr, leftData, entries);
+    getLeafEntries(attr, rightData, rightEntries);
+    entries.insert(entries.end(), rightEntries.begin(), rightEntries.end());
+    int count = entries.size();
+
+    // The slots that stay on the left: all of them if they fit, which merges the leaves,
+    // else about half
+    int split = count;
+    string separator;
+    if (getLeafEntriesSize(attr, entries, 0, count) > capacity)
+    {
+        split = chooseLeafSplit(attr, entries);
+        if (split == 0 || split == leftHeader.entriesNumber)
+            return SUCCESS;
+
+        // The new separator must fit where the old one was
+        getSeparator(attr, entries[split - 1].key, entries[split].key, separator);
+        string oldSeparator;
+        getInternalSlotKey(attr, slotNum, parentData, oldSeparator);
+        int room = getFreeSpaceInternal(parentData) + getKeyLengthInternal(attr, oldSeparator.data());
+        if (room < getKeyLengthInternal(attr, separator.data()))
+            return SUCCESS;
+    }
+
+    void *newLeft = calloc(PAGE_SIZE, 1);
+    if (newLeft == NULL)
+        return IX_MALLOC_FAILED;
+    setNodeType(IX_TYPE_LEAF, newLeft);
+    LeafHeader header = leftHeader;
+    if (split == count)
+        header.next = rightHeader.next;
+    setLeafHeader(header, newLeft);
+    RC rc = writeLeafEntries(attr, entries, 0, split, newLeft);
+    if (rc == SUCCESS && fileHandle.writePage(leftPage, newLeft))
+        rc = IX_WRITE_FAILED;
+
+    if (rc == SUCCESS && split == count)
+    {
+        // Merged: the right leaf leaves the chain and the parent
+        if (rightHeader.next != 0)
+        {
+            if (fileHandle.readPage(rightHeader.next, newLeft))
+                rc = IX_READ_FAILED;
+            else
+            {
+                header = getLeafHeader(newLeft);
+                header.prev = leftPage;
+                setLeafHeader(header, newLeft);
+                if (fileHandle.writePage(rightHeader.next, newLeft))
+                    rc = IX_WRITE_FAILED;
+            }
+        }
+        if (rc == SUCCESS)
+            rc = freePage(fileHandle, rightPage, rightHeader.next);
+        if (rc == SUCCESS)
+            deleteInternalSlot(attr, slotNum, parentData);
+    }
+    else if (rc == SUCCESS)
+    {
+        memset(newLeft, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_LEAF, newLeft);
+        setLeafHeader(rightHeader, newLeft);
+        rc = writeLeafEntries(attr, entries, split, count, newLeft);
+        if (rc == SUCCESS && fileHandle.writePage(rightPage, newLeft))
+            rc = IX_WRITE_FAILED;
+
+        if (rc == SUCCESS)
+        {
+            deleteInternalSlot(attr, slotNum, parentData);
+            ChildEntry entry;
+            entry.key = (void*) separator.data();
+            entry.childPage = rightPage;
+            rc = insertIntoInternal(attr, entry, parentData);
+        }
+    }
+
+    free(newLeft);
+    return rc;
+}
+
+RC IndexManager::rebalanceInternal(IXFileHandle &fileHandle, const Attribute &attr, void *parentData, int slotNum, int32_t leftPage, void *leftData, int32_t rightPage, void *rightData)
+{
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(InternalHeader));
+    InternalHeader leftHeader = getInternalHeader(leftData);
+    InternalHeader rightHeader = getInternalHeader(rightData);
+
+    // The entries of both nodes in key order, with the separator between them coming down
+    // over the right node's left child
+    int count = leftHeader.entriesNumber + 1 + rightHeader.entriesNumber;
+    vector<string> keys(count);
+    vector<uint32_t> children(count);
+    vector<int> sizes(count);
+    int total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (i < leftHeader.entriesNumber)
+        {
+            getInternalSlotKey(attr, i, leftData, keys[i]);
+            children[i] = getIndexEntry(i, leftData).childPage;
+        }
+        else if (i == leftHeader.entriesNumber)
+        {
+            getInternalSlotKey(attr, slotNum, parentData, keys[i]);
+            children[i] = rightHeader.leftChildPage;
+        }
+        else
+        {
+            int slot = i - leftHeader.entriesNumber - 1;
+            getInternalSlotKey(attr, slot, rightData, keys[i]);
+            children[i] = getIndexEntry(slot, rightData).childPage;
+        }
+        sizes[i] = getKeyLengthInternal(attr, keys[i].data());
+        total += sizes[i];
+    }
+
+    // The entry that goes up between the two: none if everything fits on the left, which merges
+    // the nodes, else the one about halfway
+    int middle = count;
+    if (total > capacity)
+    {
+        int size = 0;
+        for (middle = 0; middle < count - 1 && size + sizes[middle] <= (total - sizes[middle]) / 2; middle++)
+            size += sizes[middle];
+        if (size > capacity || total - size - sizes[middle] > capacity || middle == leftHeader.entriesNumber)
+            return SUCCESS;
+
+        int room = getFreeSpaceInternal(parentData) + getKeyLengthInternal(attr, keys[leftHeader.entriesNumber].data());
+        if (room < sizes[middle])
+            return SUCCESS;
+    }
+
+    void *node = calloc(PAGE_SIZE, 1);
+    if (node == NULL)
+        return IX_MALLOC_FAILED;
+    setNodeType(IX_TYPE_INTERNAL, node);
+    InternalHeader header = leftHeader;
+    header.entriesNumber = 0;
+    header.freeSpaceOffset = PAGE_SIZE;
+    setInternalHeader(header, node);
+    for (int i = 0; i < middle; i++)
+    {
+        ChildEntry entry;
+        entry.key = (void*) keys[i].data();
+        entry.childPage = children[i];
+        appendIntoInternal(attr, entry, node);
+    }
+    RC rc = fileHandle.writePage(leftPage, node) ? IX_WRITE_FAILED : SUCCESS;
+
+    if (rc == SUCCESS && middle == count)
+    {
+        rc = freePage(fileHandle, rightPage, 0);
+        if (rc == SUCCESS)
+            deleteInternalSlot(attr, slotNum, parentData);
+    }
+    else if (rc == SUCCESS)
+    {
+        memset(node, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_INTERNAL, node);
+        header.entriesNumber = 0;
+        header.freeSpaceOffset = PAGE_SIZE;
+        header.leftChildPage = children[middle];
+        setInternalHeader(header, node);
+        for (int i = middle + 1; i < count; i++)
+        {
+            ChildEntry entry;
+            entry.key = (void*) keys[i].data();
+            entry.childPage = children[i];
+            appendIntoInternal(attr, entry, node);
+        }
+        rc = fileHandle.writePage(rightPage, node) ? IX_WRITE_FAILED : SUCCESS;
+
+        if (rc == SUCCESS)
+        {
+            deleteInternalSlot(attr, slotNum, parentData);
+            ChildEntry entry;
+            entry.key = (void*) keys[middle].data();
+            entry.childPage = rightPage;
+            rc = insertIntoInternal(attr, entry, parentData);
+        }
+    }
+
+    free(node);
+    return rc;
+}
+
+RC IndexManager::freePage(IXFileHandle &fileHandle, PageNum pageNum, uint32_t next)
+{
+    void *pageData = calloc(PAGE_SIZE, 1);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    if (fileHandle.readPage(0, pageData))
+    {
+        free(pageData);
+        return IX_READ_FAILED;
+    }
+    MetaHeader meta = getMetaData(pageData);
+
+    RC rc = SUCCESS;
+    void *freeData = calloc(PAGE_SIZE, 1);
+    if (freeData == NULL)
+        rc = IX_MALLOC_FAILED;
+    else
+    {
+        setNodeType(IX_TYPE_FREE, freeData);
+        FreeHeader header;
+        header.next = next;
+        header.nextFree = meta.freePage;
+        header.entriesNumber = 0;
+        header.freeSpaceOffset = PAGE_SIZE;
+        header.prefixLength = 0;
+        memcpy((char*)freeData + sizeof(NodeType), &header, sizeof(FreeHeader));
+        if (fileHandle.writePage(pageNum, freeData))
+            rc = IX_WRITE_FAILED;
+        free(freeData);
+    }
+
+    if (rc == SUCCESS)
+    {
+        meta.freePage = pageNum;
+        setMetaData(meta, pageData);
+        if (fileHandle.writePage(0, pageData))
+            rc = IX_WRITE_FAILED;
+    }
+    free(pageData);
+    return rc;
+}
+
+
+RC IndexManager::scan(IXFileHandle &ixfileHandle,
+        const Attribute &attribute,
+        const void      *lowKey,
+        const void      *highKey,
+        bool			lowKeyInclusive,
+        bool        	highKeyInclusive,
+        IX_ScanIterator &ix_ScanIterator)
+{
+    return ix_ScanIterator.initialize(ixfileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+}
+
+RC IndexManager::scan(IXFileHandle &ixfileHandle,
+        const IX_KeySchema &schema,
+        const void      *lowKey,
+        unsigned        lowCount,
+        const void      *highKey,
+        unsigned        highCount,
+        bool			lowKeyInclusive,
+        bool        	highKeyInclusive,
+        IX_ScanIterator &ix_ScanIterator)
+{
+    // The keys that start with a bound's values come right after the encoded bound, and end
+    // before its successor. A bound that takes them in at the top, or leaves them out at the
+    // bottom, is moved to the successor, and the scan goes on as over plain varchar keys.
+    string &low = ix_ScanIterator.lowBound;
+    string &high = ix_ScanIterator.highBound;
+    bool hasLow = lowKey != NULL && lowCount > 0;
+    bool hasHigh = highKey != NULL && highCount > 0;
+    if (hasHigh)
+    {
+        schema.encode(highKey, highCount, high);
+        if (highKeyInclusive)
+        {
+            hasHigh = schema.getSuccessor(high, high);
+            highKeyInclusive = false;
+        }
+    }
+    if (hasLow)
+    {
+        schema.encode(lowKey, lowCount, low);
+        string successor;
+        if (!lowKeyInclusive && schema.getSuccessor(low, successor))
+            low = successor;
+        else if (!lowKeyInclusive)
+        {
+            // Nothing comes after the keys starting with low: an empty range
+            high = low;
+            hasHigh = true;
+            highKeyInclusive = false;
+        }
+        lowKeyInclusive = true;
+    }
+
+    return ix_ScanIterator.initialize(ixfileHandle, schema.getKeyAttribute(), hasLow ? low.data() : NULL,
+            hasHigh ? high.data() : NULL, lowKeyInclusive, highKeyInclusive, &schema);
+}
+
+RC IndexManager::bulkLoad(IXFileHandle &ixfileHandle,
+        const Attribute &attribute,
+        IX_ExternalSorter &entries,
+        float fillFactor)
+{
+    LogOperation operation;
+    if (fillFactor <= 0 || fillFactor > 1)
+        fillFactor = 1;
+
+    // Nothing else may use the index while it is built
+    ixfileHandle.fh.latchFile(true);
+    RC rc = bulkLoadTree(ixfileHandle, attribute, entries, fillFactor);
+    ixfileHandle.fh.unlatchFile();
+    if (rc)
+        return rc;
+    return operation.commit();
+}
+
+RC IndexManager::bulkLoadTree(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_ExternalSorter &entries, float fillFactor)
+{
+
+    RC rc = entries.sort();
+    if (rc)
+        return rc;
+
+    // Only an index that is still as createFile left it can be bulk loaded:
+    // an internal root with no keys over a single empty leaf
+    int32_t rootPage;
+    rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc)
+        return rc;
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    if (ixfileHandle.readPage(rootPage, pageData))
+    {
+        free(pageData);
+        return IX_READ_FAILED;
+    }
+    if (getNodetype(pageData) != IX_TYPE_INTERNAL || getInternalHeader(pageData).entriesNumber != 0)
+    {
+        free(pageData);
+        return IX_NOT_EMPTY;
+    }
+    int32_t firstLeaf = getInternalHeader(pageData).leftChildPage;
+    if (ixfileHandle.readPage(firstLeaf, pageData))
+    {
+        free(pageData);
+        return IX_READ_FAILED;
+    }
+    if (getNodetype(pageData) != IX_TYPE_LEAF || getLeafHeader(pageData).entriesNumber != 0)
+    {
+        free(pageData);
+        return IX_NOT_EMPTY;
+    }
+    free(pageData);
+
+    // Write the leaves, then each level of internal nodes over them until one node is left.
+    // That one goes in the root page. If everything fit in the first leaf, the root is already right.
+    NodePages pages;
+    pages.nextAppend = ixfileHandle.getNumberOfPages();
+    vector<BulkLoadChild> children;
+    rc = bulkLoadLeaves(ixfileHandle, attribute, entries, fillFactor, pages, firstLeaf, children);
+    while (rc == SUCCESS && children.size() > 1)
+        rc = bulkLoadInternal(ixfileHandle, attribute, fillFactor, rootPage, pages, children);
+    return rc;
+}
+
+RC IndexManager::insertEntries(IXFileHandle &ixfileHandle,
+        const Attribute &attribute,
+        IX_ExternalSorter &entries)
+{
+    LogOperation operation;
+    // Leaves are read and written back later without their latches, so nothing
+    // else may use the index meanwhile. insertEntry() latches inside this.
+    ixfileHandle.fh.latchFile(true);
+    RC rc = insertSortedEntries(ixfileHandle, attribute, entries);
+    ixfileHandle.fh.unlatchFile();
+    if (rc)
+        return rc;
+    return operation.commit();
+}
+
+RC IndexManager::insertSortedEntries(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_ExternalSorter &entries)
+{
+    RC rc = entries.sort();
+    if (rc)
+        return rc;
+
+    void *key = malloc(PAGE_SIZE);
+    void *pageData = malloc(PAGE_SIZE);
+    if (key == NULL || pageData == NULL)
+    {
+        free(key);
+        free(pageData);
+        return IX_MALLOC_FAILED;
+    }
+
+    // The leaf we are filling, and the largest key that belongs in it
+    int32_t leafPage = 0;
+    string highKey;
+    bool bounded = false;
+    bool dirty = false;
+
+    RID rid;
+    while ((rc = entries.getNextEntry(rid, key)) == SUCCESS)
+    {
+        // Keys come in order, so the entry goes in the current leaf until it is past the leaf's high key
+        if (leafPage == 0 || (bounded && compareKey(attribute, key, highKey.data()) > 0))
+        {
+            if (dirty && ixfileHandle.writePage(leafPage, pageData))
+            {
+                rc = IX_WRITE_FAILED;
+                break;
+            }
+            dirty = false;
+            if ((rc = findLeaf(ixfileHandle, attribute, key, leafPage, highKey, bounded)))
+                break;
+            if (ixfileHandle.readPage(leafPage, pageData))
+            {
+                rc = IX_READ_FAILED;
+                break;
+            }
+        }
+
+        rc = insertIntoLeaf(ixfileHandle, attribute, key, rid, pageData);
+        if (rc == SUCCESS)
+        {
+            dirty = true;
+            continue;
+        }
+        if (rc != IX_NO_FREE_SPACE)
+            break;
+
+        // The leaf is full: write it back and let insertEntry split it. The next entry
+        // then looks for its leaf again.
+        if (dirty && ixfileHandle.writePage(leafPage, pageData))
+        {
+            rc = IX_WRITE_FAILED;
+            break;
+        }
+        dirty = false;
+        leafPage = 0;
+        if ((rc = insertEntry(ixfileHandle, attribute, key, rid)))
+            break;
+    }
+
+    if (rc == IX_EOF)
+        rc = SUCCESS;
+    if (rc == SUCCESS && dirty && ixfileHandle.writePage(leafPage, pageData))
+        rc = IX_WRITE_FAILED;
+    free(key);
+    free(pageData);
+    return rc;
+}
+
+RC IndexManager::compact(IXFileHandle &ixfileHandle,
+        const Attribute &attribute,
+        float fillFactor)
+{
+    LogOperation operation;
+    if (fillFactor <= 0 || fillFactor > 1)
+        fillFactor = 1;
+
+    ixfileHandle.fh.latchFile(true);
+    RC rc = compactTree(ixfileHandle, attribute, fillFactor);
+    ixfileHandle.fh.unlatchFile();
+    if (rc)
+        return rc;
+    return operation.commit();
+}
+
+RC IndexManager::compactTree(IXFileHandle &ixfileHandle, const Attribute &attribute, float fillFactor)
+{
+    int32_t rootPage;
+    RC rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc)
+        return rc;
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+
+    // Every entry is read out of the leaves before any page is written
+    IX_ExternalSorter entries;
+    rc = entries.initialize(attribute);
+    int32_t pageNum = rootPage;
+    while (rc == SUCCESS)
+    {
+        if (ixfileHandle.readPage(pageNum, pageData))
+            rc = IX_READ_FAILED;
+        else if (getNodetype(pageData) == IX_TYPE_LEAF)
+            break;
+        else
+            pageNum = getInternalHeader(pageData).leftChildPage;
+    }
+    LeafEntry entry;
+    vector<RID> rids;
+    while (rc == SUCCESS)
+    {
+        LeafHeader header = getLeafHeader(pageData);
+        for (int i = 0; i < header.entriesNumber && rc == SUCCESS; i++)
+        {
+            getLeafEntry(attribute, i, pageData, entry);
+            rc = getPostingRids(ixfileHandle, entry, rids);
+            for (unsigned j = 0; j < rids.size() && rc == SUCCESS; j++)
+                rc = entries.addEntry(entry.key.data(), rids[j]);
+        }
+        if (rc || header.next == 0)
+            break;
+        if (ixfileHandle.readPage(header.next, pageData))
+            rc = IX_READ_FAILED;
+    }
+    if (rc == SUCCESS)
+        rc = entries.sort();
+    if (rc)
+    {
+        entries.close();
+        free(pageData);
+        return rc;
+    }
+
+    // Scans read leaves without latches, and notice the version moving on before any leaf changes
+    ixfileHandle.fh.bumpVersion();
+
+    // The tree goes back into the file from the lowest pages up, around the root, which stays where it is
+    NodePages pages;
+    pages.nextAppend = ixfileHandle.getNumberOfPages();
+    for (PageNum i = pages.nextAppend - 1; i > 0; i--)
+        if (i != (PageNum) rootPage)
+            pages.reuse.push_back(i);
+
+    int32_t firstLeaf = takePage(pages);
+    vector<BulkLoadChild> children;
+    rc = bulkLoadLeaves(ixfileHandle, attribute, entries, fillFactor, pages, firstLeaf, children);
+    entries.close();
+    if (rc == SUCCESS && children.size() == 1)
+    {
+        // Everything is in one leaf, under a root with no keys
+        memset(pageData, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_INTERNAL, pageData);
+        InternalHeader header;
+        header.entriesNumber = 0;
+        header.freeSpaceOffset = PAGE_SIZE;
+        header.leftChildPage = firstLeaf;
+        setInternalHeader(header, pageData);
+        if (ixfileHandle.writePage(rootPage, pageData))
+            rc = IX_WRITE_FAILED;
+    }
+    while (rc == SUCCESS && children.size() > 1)
+        rc = bulkLoadInternal(ixfileHandle, attribute, fillFactor, rootPage, pages, children);
+
+    // The pages left over are the new free list, lowest first
+    uint32_t freeList = 0;
+    for (unsigned i = 0; i < pages.reuse.size() && rc == SUCCESS; i++)
+    {
+        memset(pageData, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_FREE, pageData);
+        FreeHeader header;
+        header.next = 0;
+        header.nextFree = freeList;
+        header.entriesNumber = 0;
+        header.freeSpaceOffset = PAGE_SIZE;
+        header.prefixLength = 0;
+        memcpy((char*)pageData + sizeof(NodeType), &header, sizeof(FreeHeader));
+        if (ixfileHandle.writePage(pages.reuse[i], pageData))
+            rc = IX_WRITE_FAILED;
+        freeList = pages.reuse[i];
+    }
+    if (rc == SUCCESS && ixfileHandle.readPage(0, pageData))
+        rc = IX_READ_FAILED;
+    if (rc == SUCCESS)
+    {
+        MetaHeader meta = getMetaData(pageData);
+        meta.freePage = freeList;
+        setMetaData(meta, pageData);
+        if (ixfileHandle.writePage(0, pageData))
+            rc = IX_WRITE_FAILED;
+    }
+
+    free(pageData);
+    return rc;
+}
+
+RC IndexManager::getStatistics(IXFileHandle &ixfileHandle, IndexStatistics &statistics)
+{
+    ixfileHandle.fh.latchFile(false);
+    RC rc = collectStatistics(ixfileHandle, statistics);
+    ixfileHandle.fh.unlatchFile();
+    return rc;
+}
+
+RC IndexManager::collectStatistics(IXFileHandle &ixfileHandle, IndexStatistics &statistics)
 {
-    int32_t leafPage;
-    RC rc = find(ixfileHandle, attribute, key, leafPage);
-    if (rc)
-        return rc;
-    // leafPage is page number of leaf where this entry would be
-    // Read in page
+    memset(&statistics, 0, sizeof(IndexStatistics));
+
     void *pageData = malloc(PAGE_SIZE);
-    if (ixfileHandle.readPage(leafPage, pageData))
+    void *overflowData = malloc(PAGE_SIZE);
+    if (pageData == NULL || overflowData == NULL)
+    {
+        free(pageData);
+        free(overflowData);
+        return IX_MALLOC_FAILED;
+    }
+    if (ixfileHandle.readPage(0, pageData))
     {
         free(pageData);
+        free(overflowData);
         return IX_READ_FAILED;
     }
+    MetaHeader meta = getMetaData(pageData);
 
-    // Delete it from pageData
-    rc = deleteEntryFromLeaf(attribute, key, rid, pageData);
-    if (rc)
+    // The internal nodes a level at a time, down to the first leaf
+    RC rc = SUCCESS;
+    vector<uint32_t> level(1, meta.rootPage);
+    int32_t firstLeaf = -1;
+    while (rc == SUCCESS && firstLeaf < 0)
     {
-        free(pageData);
-        return rc;
+        statistics.height++;
+        vector<uint32_t> children;
+        for (unsigned i = 0; i < level.size(); i++)
+        {
+            if (ixfileHandle.readPage(level[i], pageData))
+            {
+                rc = IX_READ_FAILED;
+                break;
+            }
+            if (getNodetype(pageData) != IX_TYPE_INTERNAL)
+            {
+                firstLeaf = level[0];
+                break;
+            }
+            statistics.internalPages++;
+            InternalHeader header = getInternalHeader(pageData);
+            children.push_back(header.leftChildPage);
+            for (int j = 0; j < header.entriesNumber; j++)
+                children.push_back(getIndexEntry(j, pageData).childPage);
+        }
+        level.swap(children);
+    }
+
+    // Then along the leaves
+    const int capacity = PAGE_SIZE - (sizeof(NodeType) + sizeof(LeafHeader));
+    double used = 0;
+    unsigned outOfOrder = 0;
+    int32_t pageNum = firstLeaf;
+    while (rc == SUCCESS && pageNum != 0)
+    {
+        if (ixfileHandle.readPage(pageNum, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        if (getNodetype(pageData) != IX_TYPE_LEAF)
+        {
+            rc = IX_BAD_PAGE;
+            break;
+        }
+        LeafHeader header = getLeafHeader(pageData);
+        statistics.leafPages++;
+        used += capacity - getFreeSpaceLeaf(pageData);
+        for (int i = 0; i < header.entriesNumber && rc == SUCCESS; i++)
+        {
+            // A rid in a posting list is two numbers, each ending with a byte without the high bit
+            DataEntry entry = getDataEntry(i, pageData);
+            if (!(entry.postingLength & IX_POSTING_OVERFLOW))
+            {
+                unsigned numbers = 0;
+                for (int j = 0; j < entry.postingLength; j++)
+                    if (!(((char*)pageData)[entry.postingOffset + j] & 0x80))
+                        numbers++;
+                statistics.entries += numbers / 2;
+                continue;
+            }
+            OverflowPosting overflow;
+            memcpy(&overflow, (char*)pageData + entry.postingOffset, sizeof(OverflowPosting));
+            statistics.entries += overflow.ridsNumber;
+            for (PageNum overflowPage = overflow.firstPage; overflowPage != 0; overflowPage = getOverflowHeader(overflowData).next)
+            {
+                if (ixfileHandle.readPage(overflowPage, overflowData))
+                {
+                    rc = IX_READ_FAILED;
+                    break;
+                }
+                statistics.overflowPages++;
+            }
+        }
+        if (header.next != 0 && header.next != (uint32_t) pageNum + 1)
+            outOfOrder++;
+        pageNum = header.next;
     }
 
-    rc = ixfileHandle.writePage(leafPage, pageData);
+    pageNum = meta.freePage;
+    while (rc == SUCCESS && pageNum != 0)
+    {
+        if (ixfileHandle.readPage(pageNum, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        FreeHeader header;
+        memcpy(&header, (char*)pageData + sizeof(NodeType), sizeof(FreeHeader));
+        statistics.freePages++;
+        pageNum = header.nextFree;
+    }
     free(pageData);
+    free(overflowData);
+
+    if (rc == SUCCESS && statistics.leafPages > 0)
+    {
+        unsigned fewest = (unsigned) ((used + capacity - 1) / capacity);
+        if (fewest == 0)
+            fewest = 1;
+        statistics.leafFill = used / ((double) statistics.leafPages * capacity);
+        statistics.fragmentation = 1 - (float) fewest / statistics.leafPages;
+        statistics.outOfOrder = statistics.leafPages > 1 ? (float) outOfOrder / (statistics.leafPages - 1) : 0;
+    }
     return rc;
 }
 
-
-RC IndexManager::scan(IXFileHandle &ixfileHandle,
-        const Attribute &attribute,
-        const void      *lowKey,
-        const void      *highKey,
-        bool			lowKeyInclusive,
-        bool        	highKeyInclusive,
-        IX_ScanIterator &ix_ScanIterator)
+void IndexManager::printStatistics(IXFileHandle &ixfileHandle)
 {
-    return ix_ScanIterator.initialize(ixfileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+    IndexStatistics statistics;
+    if (getStatistics(ixfileHandle, statistics))
+        return;
+
+    cout << "{\"height\":" << statistics.height
+         << ",\"internalPages\":" << statistics.internalPages
+         << ",\"leafPages\":" << statistics.leafPages
+         << ",\"overflowPages\":" << statistics.overflowPages
+         << ",\"freePages\":" << statistics.freePages
+         << ",\"entries\":" << statistics.entries
+         << ",\"leafFill\":" << statistics.leafFill
+         << ",\"fragmentation\":" << statistics.fragmentation
+         << ",\"outOfOrder\":" << statistics.outOfOrder << "}" << endl;
 }
 
 void IndexManager::printBtree(IXFileHandle &ixfileHandle, const Attribute &attribute) const
@@ -637,7 +2437,7 @@ void IndexManager::printBtree_rec(IXFileHandle &ixfileHandle, string prefix, con
     NodeType type = getNodetype(pageData);
     if (type == IX_TYPE_LEAF)
     {
-        printLeafNode(pageData, attr);
+        printLeafNode(ixfileHandle, pageData, attr);
     }
     else
     {
@@ -679,86 +2479,37 @@ void IndexManager::printInternalNode(IXFileHandle &ixfileHandle, void *pageData,
     cout << "\n" << prefix << "]";
 }
 
-void IndexManager::printLeafNode(void *pageData, const Attribute &attr) const
+void IndexManager::printLeafNode(IXFileHandle &ixfileHandle, void *pageData, const Attribute &attr) const
 {
     LeafHeader header = getLeafHeader(pageData);
-    void *key = NULL;
-    if (attr.type != TypeVarChar)
-        key = malloc (INT_SIZE);
-    bool first = true;
+    LeafEntry entry;
     vector<RID> key_rids;
 
     cout << "\"keys\":[";
-
-    for (int i = 0; i <= header.entriesNumber; i++)
+    for (int i = 0; i < header.entriesNumber; i++)
     {
-        DataEntry entry = getDataEntry(i, pageData);
-        if (first && i < header.entriesNumber)
-        {
-            key_rids.clear();
-            first = false;
-            if (attr.type == TypeInt)
-                memcpy(key, &(entry.integer), INT_SIZE);
-            else if (attr.type == TypeReal)
-                memcpy(key, &(entry.real), REAL_SIZE);
-            else
-            {
-                // Deal with reading in varchar
-                int len;
-                memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-                free(key);
-                key = malloc(len + VARCHAR_LENGTH_SIZE + 1);
-                memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-                memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-                memset((char*)key + VARCHAR_LENGTH_SIZE + len, 0, 1);
-            }
-        }
-        if ( i < header.entriesNumber && compareLeafSlot(attr, key, pageData, i) == 0)
-        {
-            key_rids.push_back(entry.rid);
-        }
-        else if (i != 0)
-        {
-            cout << "\"";
-            if (attr.type == TypeInt)
-            {
-                cout << "" << *(int*)key;
-                memcpy(key, &(entry.integer), INT_SIZE);
-            }
-            else if (attr.type == TypeReal)
-            {
-                cout << "" << *(float*)key;
-                memcpy(key, &(entry.real), REAL_SIZE);
-            }
-            else
-            {
-                cout << (char*)key + 4;
-
-                int len;
-                memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-                free(key);
-                key = malloc(len + VARCHAR_LENGTH_SIZE + 1);
-                memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-                memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-                memset((char*)key + VARCHAR_LENGTH_SIZE + len, 0, 1);
-            }
+        if (i != 0)
+            cout << ",";
+        getLeafEntry(attr, i, pageData, entry);
+        cout << "\"";
+        if (attr.type == TypeInt)
+            cout << "" << *(int*)entry.key.data();
+        else if (attr.type == TypeReal)
+            cout << "" << *(float*)entry.key.data();
+        else
+            cout << entry.key.substr(VARCHAR_LENGTH_SIZE);
 
-            cout << ":[";
-            for (unsigned j = 0; j < key_rids.size(); j++)
-            {
-                if (j != 0)
-                {
-                    cout << ",";
-                }
-                cout << "(" << key_rids[j].pageNum << "," << key_rids[j].slotNum << ")";
-            }
-            cout << "]\"";
-            key_rids.clear();
-            key_rids.push_back(entry.rid);
+        cout << ":[";
+        getPostingRids(ixfileHandle, entry, key_rids);
+        for (unsigned j = 0; j < key_rids.size(); j++)
+        {
+            if (j != 0)
+                cout << ",";
+            cout << "(" << key_rids[j].pageNum << "," << key_rids[j].slotNum << ")";
         }
+        cout << "]\"";
     }
     cout << "]}";
-    free (key);
 }
 
 void IndexManager::printInternalSlot(const Attribute &attr, const int32_t slotNum, const void *data) const
@@ -787,103 +2538,529 @@ IX_ScanIterator::~IX_ScanIterator()
 {
 }
 
-RC IX_ScanIterator::initialize(IXFileHandle &fh, Attribute attribute, const void *low, const void *high, bool lowInc, bool highInc)
+RC IX_ScanIterator::initialize(IXFileHandle &fh, Attribute attribute, const void *low, const void *high, bool lowInc, bool highInc, const IX_KeySchema *keySchema)
 {
     // Store all parameters because we will need them later
     attr = attribute;
+    composite = keySchema != NULL;
+    if (composite)
+        schema = *keySchema;
     fileHandle = &fh;
     lowKey = low;
     highKey = high;
     lowKeyInclusive = lowInc;
     highKeyInclusive = highInc;
+    hasLast = false;
+    lastKey.clear();
+    skipping = false;
 
     // Initialize our storage
     page = malloc(PAGE_SIZE);
-    if (page == NULL)
+    overflowPage = malloc(PAGE_SIZE);
+    if (page == NULL || overflowPage == NULL)
+    {
+        free(page);
+        free(overflowPage);
         return IX_MALLOC_FAILED;
-    // Initialize starting slot number
-    slotNum = 0;
+    }
 
-    // Find the starting page
-    IndexManager *im = IndexManager::instance();
-    int32_t startPageNum;
-    RC rc = im->find(*fileHandle, attr, lowKey, startPageNum);
+    RC rc = position(lowKey, lowKeyInclusive);
     if (rc)
     {
         free(page);
-        return rc;
+        free(overflowPage);
     }
-    rc = fileHandle->readPage(startPageNum, page);
+    return rc;
+}
+
+RC IX_ScanIterator::position(const void *key, bool inclusive)
+{
+    // Find the starting page. It is latched while it is copied; the leaves after it are
+    // read one at a time as the scan gets to them. Merges take the file exclusively,
+    // so none changes the tree between reading the version and the leaf.
+    IndexManager *im = IndexManager::instance();
+    int32_t startPageNum;
+    fileHandle->fh.latchFile(false);
+    version = fileHandle->fh.getVersion();
+    RC rc = im->find(*fileHandle, attr, key, startPageNum, false, page);
+    if (rc == SUCCESS)
+        fileHandle->fh.unlatchPage(startPageNum);
+    fileHandle->fh.unlatchFile();
     if (rc)
-    {
-        free(page);
         return rc;
+
+    // Find the starting entry
+    slotNum = key == NULL ? 0 : im->searchLeaf(attr, key, page, inclusive);
+    slotRead = false;
+    rids.clear();
+    ridNum = 0;
+    nextOverflow = 0;
+    returnedSlot = -1;
+    return SUCCESS;
+}
+
+RC IX_ScanIterator::reposition()
+{
+    RC rc = hasLast ? position(lastKey.data(), true) : position(lowKey, lowKeyInclusive);
+    if (rc)
+        return rc;
+    skipping = hasLast;
+    return SUCCESS;
+}
+
+void IX_ScanIterator::rememberLast()
+{
+    if (returnedSlot < 0)
+        return;
+    IndexManager::instance()->getLeafSlotKey(attr, returnedSlot, page, lastKey);
+    lastRid = returnedRid;
+    hasLast = true;
+    returnedSlot = -1;
+}
+
+RC IX_ScanIterator::readOverflow(PageNum pageNum)
+{
+    IndexManager *im = IndexManager::instance();
+    rememberLast();
+    rids.clear();
+    ridNum = 0;
+    nextOverflow = 0;
+    // Read without a latch, like the leaves after the first. Overflow pages are split in
+    // place, but only freed by deletes that move the version on.
+    fileHandle->readPage(pageNum, overflowPage);
+    if (fileHandle->fh.getVersion() != version || im->getNodetype(overflowPage) != IX_TYPE_OVERFLOW)
+        return reposition();
+
+    // A page of rids that were all returned before the scan found its place again is passed over whole
+    OverflowHeader header = im->getOverflowHeader(overflowPage);
+    nextOverflow = header.next;
+    if (skipping && im->compare(header.last, lastRid) <= 0)
+        return SUCCESS;
+    im->decodePosting((char*)overflowPage + sizeof(NodeType) + sizeof(OverflowHeader), header.postingLength, rids);
+    return SUCCESS;
+}
+
+RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
+{
+    IndexManager *im = IndexManager::instance();
+    while (true)
+    {
+        LeafHeader header = im->getLeafHeader(page);
+        // If we have run off the end of the page, jump to the next one
+        if (slotNum >= header.entriesNumber)
+        {
+            // If there is no next page, return EOF
+            if (header.next == 0)
+                return IX_EOF;
+
+            rememberLast();
+            slotNum = 0;
+            slotRead = false;
+            fileHandle->readPage(header.next, page);
+            // The next page was read without a latch. If a merge or split has started since the
+            // page before it was read, entries may have moved to leaves the scan has left behind.
+            if (fileHandle->fh.getVersion() != version)
+            {
+                RC rc = reposition();
+                if (rc)
+                    return rc;
+            }
+            continue;
+        }
+
+        if (!slotRead)
+        {
+            // If highkey is null, always carry on
+            // Otherwise, carry on only if highkey is greater than the current key
+            int cmp = highKey == NULL ? 1 : im->compareLeafSlot(attr, highKey, page, slotNum);
+            if (cmp == 0 && !highKeyInclusive)
+                return IX_EOF;
+            if (cmp < 0)
+                return IX_EOF;
+
+            // After finding its place again, the rids of the last key returned are passed over
+            // up to the last one returned
+            if (skipping && im->compareLeafSlot(attr, lastKey.data(), page, slotNum) != 0)
+                skipping = false;
+
+            // The rids in the leaf, or where they start on overflow pages
+            DataEntry entry = im->getDataEntry(slotNum, page);
+            rids.clear();
+            ridNum = 0;
+            nextOverflow = 0;
+            if (entry.postingLength & IX_POSTING_OVERFLOW)
+            {
+                OverflowPosting overflow;
+                memcpy(&overflow, (char*)page + entry.postingOffset, sizeof(OverflowPosting));
+                nextOverflow = overflow.firstPage;
+            }
+            else
+                im->decodePosting((char*)page + entry.postingOffset, entry.postingLength, rids);
+            slotRead = true;
+        }
+
+        if (ridNum < rids.size())
+        {
+            RID next = rids[ridNum++];
+            if (skipping)
+            {
+                if (im->compare(next, lastRid) <= 0)
+                    continue;
+                skipping = false;
+            }
+            rid = next;
+            if (composite)
+            {
+                im->getLeafSlotKey(attr, slotNum, page, returnedKey);
+                schema.decode(returnedKey.data(), key);
+            }
+            else
+                im->copyLeafSlotKey(attr, slotNum, page, key);
+            returnedSlot = slotNum;
+            returnedRid = next;
+            return SUCCESS;
+        }
+
+        if (nextOverflow != 0)
+        {
+            RC rc = readOverflow(nextOverflow);
+            if (rc)
+                return rc;
+            continue;
+        }
+
+        slotNum++;
+        slotRead = false;
+    }
+}
+
+RC IX_ScanIterator::close()
+{
+    free(page);
+    free(overflowPage);
+    return SUCCESS;
+}
+
+IX_KeySchema::IX_KeySchema()
+{
+}
+
+IX_KeySchema::IX_KeySchema(const vector<Attribute> &attributes)
+: attrs(attributes)
+{
+}
+
+const vector<Attribute> &IX_KeySchema::getAttributes() const
+{
+    return attrs;
+}
+
+Attribute IX_KeySchema::getKeyAttribute() const
+{
+    Attribute key;
+    key.type = TypeVarChar;
+    key.length = 0;
+    for (unsigned i = 0; i < attrs.size(); i++)
+    {
+        if (i > 0)
+            key.name += ",";
+        key.name += attrs[i].name;
+        // A varchar with every byte escaped, and its terminator
+        key.length += attrs[i].type == TypeVarChar ? 2 * attrs[i].length + 2 : INT_SIZE;
+    }
+    return key;
+}
+
+void IX_KeySchema::encode(const void *values, unsigned count, string &key) const
+{
+    const char *value = (const char*) values;
+    key.assign(VARCHAR_LENGTH_SIZE, '\0');
+    for (unsigned i = 0; i < count && i < attrs.size(); i++)
+    {
+        if (attrs[i].type == TypeVarChar)
+        {
+            int32_t len;
+            memcpy(&len, value, VARCHAR_LENGTH_SIZE);
+            value += VARCHAR_LENGTH_SIZE;
+            for (int32_t j = 0; j < len; j++)
+            {
+                key.push_back(value[j]);
+                if (value[j] == '\0')
+                    key.push_back((char) 0xFF);
+            }
+            key.push_back('\0');
+            key.push_back(1);
+            value += len;
+            continue;
+        }
+
+        uint32_t bits;
+        memcpy(&bits, value, INT_SIZE);
+        value += INT_SIZE;
+        if (attrs[i].type == TypeInt)
+            bits ^= 0x80000000;
+        else
+        {
+            // -0.0 is equal to 0.0, so it gets the same key
+            float real;
+            memcpy(&real, &bits, REAL_SIZE);
+            if (real == 0)
+                bits = 0;
+            // Negative reals go below positive ones, the larger their magnitude the lower
+            bits = (bits & 0x80000000) ? ~bits : bits ^ 0x80000000;
+        }
+        for (int shift = 24; shift >= 0; shift -= 8)
+            key.push_back((char) (bits >> shift));
+    }
+    int32_t len = key.size() - VARCHAR_LENGTH_SIZE;
+    memcpy(&key[0], &len, VARCHAR_LENGTH_SIZE);
+}
+
+void IX_KeySchema::encode(const void *values, unsigned count, void *key) const
+{
+    string encoded;
+    encode(values, count, encoded);
+    memcpy(key, encoded.data(), encoded.size());
+}
+
+void IX_KeySchema::decode(const void *key, void *values) const
+{
+    const unsigned char *bytes = (const unsigned char*) key + VARCHAR_LENGTH_SIZE;
+    char *value = (char*) values;
+    for (const Attribute &attr : attrs)
+    {
+        if (attr.type == TypeVarChar)
+        {
+            // The terminator is the only 0 byte that is not followed by 0xFF
+            int32_t len = 0;
+            while (bytes[0] != 0 || bytes[1] != 1)
+            {
+                value[VARCHAR_LENGTH_SIZE + len++] = bytes[0];
+                bytes += bytes[0] == 0 ? 2 : 1;
+            }
+            bytes += 2;
+            memcpy(value, &len, VARCHAR_LENGTH_SIZE);
+            value += VARCHAR_LENGTH_SIZE + len;
+            continue;
+        }
+
+        uint32_t bits = 0;
+        for (int j = 0; j < 4; j++)
+            bits = bits << 8 | bytes[j];
+        bytes += 4;
+        if (attr.type == TypeInt)
+            bits ^= 0x80000000;
+        else
+            bits = (bits & 0x80000000) ? bits ^ 0x80000000 : ~bits;
+        memcpy(value, &bits, INT_SIZE);
+        value += INT_SIZE;
+    }
+}
+
+bool IX_KeySchema::getSuccessor(const string &prefix, string &successor) const
+{
+    // The last byte that can go up goes up by one, and the bytes after it are dropped
+    successor = prefix;
+    while (successor.size() > VARCHAR_LENGTH_SIZE && (unsigned char) successor.back() == 0xFF)
+        successor.pop_back();
+    if (successor.size() == VARCHAR_LENGTH_SIZE)
+        return false;
+    successor.back()++;
+    int32_t len = successor.size() - VARCHAR_LENGTH_SIZE;
+    memcpy(&successor[0], &len, VARCHAR_LENGTH_SIZE);
+    return true;
+}
+
+IX_ExternalSorter::IX_ExternalSorter()
+: memoryLimit(IX_SORT_MEMORY), sorted(false), nextOffset(0)
+{
+}
+
+IX_ExternalSorter::~IX_ExternalSorter()
+{
+    close();
+}
+
+RC IX_ExternalSorter::initialize(const Attribute &attribute, size_t limit)
+{
+    close();
+    attr = attribute;
+    memoryLimit = limit;
+    return SUCCESS;
+}
+
+RC IX_ExternalSorter::addEntry(const void *key, const RID &rid)
+{
+    if (sorted)
+        return IX_SORT_FAILED;
+
+    IndexManager *im = IndexManager::instance();
+    int keySize = im->getKeySize(attr, key);
+
+    offsets.push_back(buffer.size());
+    buffer.insert(buffer.end(), (const char*) key, (const char*) key + keySize);
+    buffer.insert(buffer.end(), (const char*) &rid, (const char*) &rid + sizeof(RID));
+
+    // Out of memory: sort what we have and move it to disk
+    if (buffer.size() + offsets.size() * sizeof(uint32_t) >= memoryLimit)
+        return writeRun();
+    return SUCCESS;
+}
+
+RC IX_ExternalSorter::sort()
+{
+    if (sorted)
+        return SUCCESS;
+    sorted = true;
+
+    auto less = [this](uint32_t first, uint32_t second) {return entryLess(&buffer[first], &buffer[second]);};
+
+    // Everything fit in memory, so we just read the entries back in order
+    if (runs.empty())
+    {
+        std::sort(offsets.begin(), offsets.end(), less);
+        nextOffset = 0;
+        return SUCCESS;
+    }
+
+    // Otherwise the rest goes to disk too, and we merge the runs
+    if (!offsets.empty())
+    {
+        RC rc = writeRun();
+        if (rc)
+            return rc;
+    }
+    runHeads.assign(runs.size(), vector<char>());
+    mergeHeap.clear();
+    for (unsigned i = 0; i < runs.size(); i++)
+    {
+        rewind(runs[i]);
+        RC rc = readRunEntry(i);
+        if (rc == SUCCESS)
+            mergeHeap.push_back(i);
+        else if (rc != IX_EOF)
+            return rc;
+    }
+    auto greater = [this](unsigned first, unsigned second) {return entryLess(runHeads[second].data(), runHeads[first].data());};
+    make_heap(mergeHeap.begin(), mergeHeap.end(), greater);
+    return SUCCESS;
+}
+
+RC IX_ExternalSorter::getNextEntry(RID &rid, void *key)
+{
+    if (!sorted)
+        return IX_SORT_FAILED;
+
+    if (runs.empty())
+    {
+        if (nextOffset >= offsets.size())
+            return IX_EOF;
+        copyOut(&buffer[offsets[nextOffset++]], rid, key);
+        return SUCCESS;
     }
 
-    // Find the starting entry
-    LeafHeader header = im->getLeafHeader(page);
-    int i = 0;
-    for (i = 0; i < header.entriesNumber; i++)
+    if (mergeHeap.empty())
+        return IX_EOF;
+
+    // Take the smallest head, then put its run back with its next entry
+    auto greater = [this](unsigned first, unsigned second) {return entryLess(runHeads[second].data(), runHeads[first].data());};
+    pop_heap(mergeHeap.begin(), mergeHeap.end(), greater);
+    unsigned run = mergeHeap.back();
+    copyOut(runHeads[run].data(), rid, key);
+
+    RC rc = readRunEntry(run);
+    if (rc == SUCCESS)
+        push_heap(mergeHeap.begin(), mergeHeap.end(), greater);
+    else if (rc == IX_EOF)
+        mergeHeap.pop_back();
+    else
+        return rc;
+    return SUCCESS;
+}
+
+RC IX_ExternalSorter::close()
+{
+    for (unsigned i = 0; i < runs.size(); i++)
+        fclose(runs[i]);
+    runs.clear();
+    runHeads.clear();
+    mergeHeap.clear();
+    vector<char>().swap(buffer);
+    vector<uint32_t>().swap(offsets);
+    nextOffset = 0;
+    sorted = false;
+    return SUCCESS;
+}
+
+// Entries are ordered by key, then by rid, so that equal keys come out in the order
+// they are in the table
+bool IX_ExternalSorter::entryLess(const char *first, const char *second) const
+{
+    IndexManager *im = IndexManager::instance();
+    int cmp = im->compareKey(attr, first, second);
+    if (cmp != 0)
+        return cmp < 0;
+
+    RID firstRid, secondRid;
+    memcpy(&firstRid, first + im->getKeySize(attr, first), sizeof(RID));
+    memcpy(&secondRid, second + im->getKeySize(attr, second), sizeof(RID));
+    if (firstRid.pageNum != secondRid.pageNum)
+        return firstRid.pageNum < secondRid.pageNum;
+    return firstRid.slotNum < secondRid.slotNum;
+}
+
+// Sorts the entries in memory and writes them to a new temporary file
+RC IX_ExternalSorter::writeRun()
+{
+    auto less = [this](uint32_t first, uint32_t second) {return entryLess(&buffer[first], &buffer[second]);};
+    std::sort(offsets.begin(), offsets.end(), less);
+
+    FILE *run = tmpfile();
+    if (run == NULL)
+        return IX_SORT_FAILED;
+    runs.push_back(run);
+
+    IndexManager *im = IndexManager::instance();
+    for (unsigned i = 0; i < offsets.size(); i++)
     {
-        int cmp = (low == NULL ? -1 : im->compareLeafSlot(attr, lowKey, page, i));
-        if (cmp < 0)
-            break;
-        if (cmp == 0 && lowKeyInclusive)
-            break;
-        if (cmp > 0)
-            continue;
+        const char *entry = &buffer[offsets[i]];
+        size_t size = im->getKeySize(attr, entry) + sizeof(RID);
+        if (fwrite(entry, 1, size, run) != size)
+            return IX_SORT_FAILED;
     }
-    slotNum = i;
+
+    buffer.clear();
+    offsets.clear();
     return SUCCESS;
 }
 
-RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
+// Reads the next entry of a run into its head
+RC IX_ExternalSorter::readRunEntry(unsigned run)
 {
-    IndexManager *im = IndexManager::instance();
-    LeafHeader header = im->getLeafHeader(page);
-    // If we have run off the end of the page, jump to the next one
-    if (slotNum >= header.entriesNumber)
-    {
-        // If there is no next page, return EOF
-        if (header.next == 0)
-            return IX_EOF;
-        slotNum = 0;
-        fileHandle->readPage(header.next, page);
-        return getNextEntry(rid, key);
-    }
-    // If highkey is null, always carry on
-    // Otherwise, carry on only if highkey is greater than the current key
-    int cmp = highKey == NULL ? 1 : im->compareLeafSlot(attr, highKey, page, slotNum);
-    if (cmp == 0 && !highKeyInclusive)
-        return IX_EOF;
-    if (cmp < 0)
-        return IX_EOF;
+    vector<char> &head = runHeads[run];
+    int32_t keySize = INT_SIZE;
+    head.resize(INT_SIZE);
+    if (fread(head.data(), 1, INT_SIZE, runs[run]) != INT_SIZE)
+        return feof(runs[run]) ? IX_EOF : IX_SORT_FAILED;
 
-    // Grab the data entry, grab its rid
-    DataEntry entry = im->getDataEntry(slotNum, page);
-    rid.pageNum = entry.rid.pageNum;
-    rid.slotNum = entry.rid.slotNum;
-    // grab its key
-    if (attr.type == TypeInt)
-        memcpy(key, &(entry.integer), INT_SIZE);
-    else if (attr.type == TypeReal)
-        memcpy(key, &(entry.real), REAL_SIZE);
-    else
+    if (attr.type == TypeVarChar)
     {
-        int len;
-        memcpy(&len, (char*)page + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-        memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-        memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)page + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
+        int32_t len;
+        memcpy(&len, head.data(), VARCHAR_LENGTH_SIZE);
+        keySize = VARCHAR_LENGTH_SIZE + len;
     }
-    // increment slotNum for the next call to getNextEntry
-    slotNum++;
+    head.resize(keySize + sizeof(RID));
+    size_t rest = head.size() - INT_SIZE;
+    if (fread(head.data() + INT_SIZE, 1, rest, runs[run]) != rest)
+        return IX_SORT_FAILED;
     return SUCCESS;
 }
 
-RC IX_ScanIterator::close()
+void IX_ExternalSorter::copyOut(const char *entry, RID &rid, void *key) const
 {
-    free(page);
-    return SUCCESS;
+    int keySize = IndexManager::instance()->getKeySize(attr, entry);
+    memcpy(key, entry, keySize);
+    memcpy(&rid, entry + keySize, sizeof(RID));
 }
 
 
@@ -892,6 +3069,8 @@ IXFileHandle::IXFileHandle()
     ixReadPageCounter = 0;
     ixWritePageCounter = 0;
     ixAppendPageCounter = 0;
+    cachedRoot = -1;
+    cacheVersion = 0;
 }
 
 IXFileHandle::~IXFileHandle()
@@ -915,7 +3094,12 @@ RC IXFileHandle::readPage(PageNum pageNum, void *data)
 RC IXFileHandle::writePage(PageNum pageNum, const void *data)
 {
     ixWritePageCounter++;
-    return fh.writePage(pageNum, data);
+    RC rc = fh.writePage(pageNum, data);
+    // Handles may have copies of the meta page and of internal nodes, but never of leaves or overflow pages
+    NodeType type = *(const NodeType*)data;
+    if (rc == SUCCESS && (pageNum == 0 || (type != IX_TYPE_LEAF && type != IX_TYPE_OVERFLOW)))
+        fh.bumpVersion();
+    return rc;
 }
 
 RC IXFileHandle::appendPage(const void *data)
@@ -924,11 +3108,33 @@ RC IXFileHandle::appendPage(const void *data)
     return fh.appendPage(data);
 }
 
+RC IXFileHandle::appendPage(const void *data, PageNum &pageNum)
+{
+    ixAppendPageCounter++;
+    return fh.appendPage(data, pageNum);
+}
+
 unsigned IXFileHandle::getNumberOfPages()
 {
     return fh.getNumberOfPages();
 }
 
+void IXFileHandle::validateCache()
+{
+    unsigned version = fh.getVersion();
+    if (version == cacheVersion)
+        return;
+    clearCache();
+    cacheVersion = version;
+}
+
+void IXFileHandle::clearCache()
+{
+    cachedRoot = -1;
+    cacheVersion = fh.getVersion();
+    cachedNodes.clear();
+}
+
 // Private helpers -----------------------
 
 void IndexManager::setMetaData(const MetaHeader header, void *pageData)
@@ -1015,6 +3221,13 @@ DataEntry IndexManager::getDataEntry(const int slotNum, const void *pageData) co
     return entry;
 }
 
+OverflowHeader IndexManager::getOverflowHeader(const void *pageData) const
+{
+    OverflowHeader header;
+    memcpy(&header, (char*)pageData + sizeof(NodeType), sizeof(OverflowHeader));
+    return header;
+}
+
 RC IndexManager::getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const
 {
     void *metaPage = malloc(PAGE_SIZE);
@@ -1033,52 +3246,184 @@ RC IndexManager::getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const
     return SUCCESS;
 }
 
-RC IndexManager::find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum)
+RC IndexManager::find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum, bool exclusive, void *leafData)
 {
-    int32_t rootPageNum;
-    RC rc = getRootPageNum(handle, rootPageNum);
-    if (rc)
-        return rc;
-    return treeSearch(handle, attr, key, rootPageNum, resultPageNum);
+    // Every level is read into the same buffer, ending with the leaf
+    void *pageData = leafData;
+    if (pageData == NULL)
+        pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+
+    // A split changed a node we had a copy of. The copies are gone now, so the next try
+    // reads the nodes again.
+    RC rc;
+    bool stale;
+    do
+        rc = treeSearch(handle, attr, key, pageData, resultPageNum, exclusive, stale);
+    while (rc == SUCCESS && stale);
+
+    if (leafData == NULL)
+        free(pageData);
+    return rc;
 }
 
-RC IndexManager::treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum)
+RC IndexManager::treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, void *pageData, int32_t &resultPageNum, bool exclusive, bool &stale)
 {
-    void *pageData = malloc(PAGE_SIZE);
+    stale = false;
+    handle.validateCache();
+    unsigned version = handle.cacheVersion;
+
+    // The node whose latch is held above the current one, -1 while going through copies.
+    // The meta page is the parent of the root.
+    int32_t parentPageNum = -1;
+    int32_t currPageNum = handle.cachedRoot;
+    if (currPageNum < 0)
+    {
+        handle.fh.latchPage(0, false);
+        parentPageNum = 0;
+        if (handle.readPage(0, pageData))
+        {
+            handle.fh.unlatchPage(0);
+            return IX_READ_FAILED;
+        }
+        currPageNum = getMetaData(pageData).rootPage;
+        handle.cachedRoot = currPageNum;
+    }
 
-    if (handle.readPage(currPageNum, pageData))
+    for (unsigned level = 0; ; level++)
     {
-        free (pageData);
-        return IX_READ_FAILED;
+        const void *node = pageData;
+        auto cached = handle.cachedNodes.find(currPageNum);
+        if (cached != handle.cachedNodes.end())
+        {
+            // From here the version stands in for the latches
+            node = &cached->second[0];
+            if (parentPageNum >= 0)
+                handle.fh.unlatchPage(parentPageNum);
+            parentPageNum = -1;
+        }
+        else
+        {
+            handle.fh.latchPage(currPageNum, false);
+            if (handle.readPage(currPageNum, pageData))
+            {
+                handle.fh.unlatchPage(currPageNum);
+                if (parentPageNum >= 0)
+                    handle.fh.unlatchPage(parentPageNum);
+                return IX_READ_FAILED;
+            }
+
+            // An insert splits a leaf only with its parent latched exclusively, so while we hold
+            // the parent the leaf keeps its entries and can be relatched.
+            bool leaf = getNodetype(pageData) == IX_TYPE_LEAF;
+            if (leaf && exclusive)
+            {
+                handle.fh.unlatchPage(currPageNum);
+                handle.fh.latchPage(currPageNum, true);
+            }
+
+            // Reached through copies, which are good only if no split has written an internal
+            // node since. A split holds the latches of the nodes it splits until it has.
+            if (parentPageNum >= 0)
+            {
+                handle.fh.unlatchPage(parentPageNum);
+            }
+            else if (handle.fh.getVersion() != version)
+            {
+                handle.fh.unlatchPage(currPageNum);
+                stale = true;
+                return SUCCESS;
+            }
+            parentPageNum = currPageNum;
+
+            if (leaf)
+            {
+                // The leaf may have changed between the two latches
+                if (exclusive && handle.readPage(currPageNum, pageData))
+                {
+                    handle.fh.unlatchPage(currPageNum);
+                    return IX_READ_FAILED;
+                }
+                resultPageNum = currPageNum;
+                return SUCCESS;
+            }
+            if (level < IX_CACHED_LEVELS)
+                handle.cachedNodes[currPageNum].assign((char*)pageData, (char*)pageData + PAGE_SIZE);
+        }
+
+        currPageNum = getNextChildPage(attr, key, node);
     }
+}
 
-    // Found our leaf!
+bool IndexManager::isSafe(const Attribute &attr, const void *key, void *pageData) const
+{
     if (getNodetype(pageData) == IX_TYPE_LEAF)
+        return getFreeSpaceLeaf(pageData) >= getInsertSpaceLeaf(attr, key, pageData);
+
+    // A split below can push up any key of the attribute
+    int largest = sizeof(IndexEntry);
+    if (attr.type == TypeVarChar)
+        largest += VARCHAR_LENGTH_SIZE + attr.length;
+    return getFreeSpaceInternal(pageData) >= largest;
+}
+
+void IndexManager::unlatchPages(IXFileHandle &handle, vector<PageNum> &latched, unsigned keep)
+{
+    while (latched.size() > keep)
     {
-        resultPageNum = currPageNum;
-        free(pageData);
-        return SUCCESS;
+        handle.fh.unlatchPage(latched.front());
+        latched.erase(latched.begin());
     }
+}
+
+RC IndexManager::findLeaf(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &leafPage, string &highKey, bool &bounded)
+{
+    int32_t pageNum;
+    RC rc = getRootPageNum(handle, pageNum);
+    if (rc)
+        return rc;
 
-    int32_t nextChildPage = getNextChildPage(attr, key, pageData);
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+
+    bounded = false;
+    while (true)
+    {
+        if (handle.readPage(pageNum, pageData))
+        {
+            free(pageData);
+            return IX_READ_FAILED;
+        }
+        if (getNodetype(pageData) == IX_TYPE_LEAF)
+            break;
+
+        // Same choice as getNextChildPage(). The child holds keys up to and including the
+        // key of slot i; the slots below are nested inside it, so their bound is tighter.
+        InternalHeader header = getInternalHeader(pageData);
+        int i = searchInternal(attr, key, pageData);
+        if (i < header.entriesNumber)
+        {
+            getInternalSlotKey(attr, i, pageData, highKey);
+            bounded = true;
+        }
+        pageNum = i == 0 ? header.leftChildPage : getIndexEntry(i - 1, pageData).childPage;
+    }
 
     free(pageData);
-    return treeSearch(handle, attr, key, nextChildPage, resultPageNum);
+    leafPage = pageNum;
+    return SUCCESS;
 }
 
-int32_t IndexManager::getNextChildPage(const Attribute attr, const void *key, void *pageData)
+int32_t IndexManager::getNextChildPage(const Attribute attr, const void *key, const void *pageData)
 {
     InternalHeader header = getInternalHeader(pageData);
     if (key == NULL)
         return header.leftChildPage;
 
-    int i = 0;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        // If key < slot key we have, then the previous entry holds the path
-        if (compareSlot(attr, key, pageData, i) <= 0)
-            break;
-    }
+    // If key <= the key of slot i, then the previous entry holds the path
+    int i = searchInternal(attr, key, pageData);
     int32_t result;
     // Special case where key is less than all entries in this node
     if (i == 0)
@@ -1095,6 +3440,41 @@ int32_t IndexManager::getNextChildPage(const Attribute attr, const void *key, vo
     return result;
 }
 
+int IndexManager::searchInternal(const Attribute attr, const void *key, const void *pageData) const
+{
+    InternalHeader header = getInternalHeader(pageData);
+    // The answer is in [low, high]
+    int low = 0;
+    int high = header.entriesNumber;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (compareSlot(attr, key, pageData, mid) <= 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+int IndexManager::searchLeaf(const Attribute attr, const void *key, const void *pageData, bool inclusive) const
+{
+    LeafHeader header = getLeafHeader(pageData);
+    // The answer is in [low, high]
+    int low = 0;
+    int high = header.entriesNumber;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        int cmp = compareLeafSlot(attr, key, pageData, mid);
+        if (cmp < 0 || (cmp == 0 && inclusive))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
 int IndexManager::compareSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const
 {
     IndexEntry entry = getIndexEntry(slotNum, pageData);
@@ -1112,20 +3492,8 @@ int IndexManager::compareSlot(const Attribute attr, const void *key, const void
     }
     else
     {
-        int32_t key_size;
-        memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
-        char key_text[key_size + 1];
-        key_text[key_size] = '\0';
-        memcpy(key_text, (char*) key + VARCHAR_LENGTH_SIZE, key_size);
-
-        int32_t value_offset = entry.varcharOffset;
-        int32_t value_size;
-        memcpy(&value_size, (char*)pageData + value_offset, VARCHAR_LENGTH_SIZE);
-        char value_text[value_size + 1];
-        value_text[value_size] = '\0';
-        memcpy(value_text, (char*)pageData + value_offset + VARCHAR_LENGTH_SIZE, value_size);
-
-        return compare(key_text, value_text);
+        // The key is stored on the page in the same format, so there is nothing to copy
+        return compareKey(attr, key, (char*)pageData + entry.varcharOffset);
     }
     return 0;
 }
@@ -1147,24 +3515,54 @@ int IndexManager::compareLeafSlot(const Attribute attr, const void *key, const v
     }
     else
     {
-        int32_t key_size;
+        // The stored key is the page's prefix followed by the suffix in the slot. Both are
+        // compared where they are, so there is nothing to copy.
+        LeafHeader header = getLeafHeader(pageData);
+        int32_t key_size, suffix_size;
         memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
-        char key_text[key_size + 1];
-        key_text[key_size] = '\0';
-        memcpy(key_text, (char*) key + VARCHAR_LENGTH_SIZE, key_size);
-
-        int32_t value_offset = entry.varcharOffset;
-        int32_t value_size;
-        memcpy(&value_size, (char*)pageData + value_offset, VARCHAR_LENGTH_SIZE);
-        char value_text[value_size + 1];
-        value_text[value_size] = '\0';
-        memcpy(value_text, (char*)pageData + value_offset + VARCHAR_LENGTH_SIZE, value_size);
-
-        return compare(key_text, value_text);
+        memcpy(&suffix_size, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        int cmp = memcmp((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + PAGE_SIZE - header.prefixLength, min(key_size, (int32_t) header.prefixLength));
+        if (cmp != 0)
+            return cmp;
+        if (key_size < header.prefixLength)
+            return -1;
+        cmp = memcmp((char*)key + VARCHAR_LENGTH_SIZE + header.prefixLength, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, min(key_size - header.prefixLength, suffix_size));
+        if (cmp != 0)
+            return cmp;
+        return compare(key_size, header.prefixLength + suffix_size);
     }
     return 0; // suppress warnings
 }
 
+int IndexManager::compareKey(const Attribute attr, const void *key, const void *value) const
+{
+    if (attr.type == TypeInt)
+    {
+        int32_t int_key, int_value;
+        memcpy(&int_key, key, INT_SIZE);
+        memcpy(&int_value, value, INT_SIZE);
+        return compare(int_key, int_value);
+    }
+    else if (attr.type == TypeReal)
+    {
+        float real_key, real_value;
+        memcpy(&real_key, key, REAL_SIZE);
+        memcpy(&real_value, value, REAL_SIZE);
+        return compare(real_key, real_value);
+    }
+    else
+    {
+        int32_t key_size, value_size;
+        memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
+        memcpy(&value_size, value, VARCHAR_LENGTH_SIZE);
+        // Same order as strcmp on the terminated strings
+        int cmp = memcmp((char*)key + VARCHAR_LENGTH_SIZE, (char*)value + VARCHAR_LENGTH_SIZE, min(key_size, value_size));
+        if (cmp != 0)
+            return cmp;
+        return compare(key_size, value_size);
+    }
+}
+
 int IndexManager::compare(const int key, const int value) const
 {
     if (key == value)
@@ -1187,9 +3585,23 @@ int IndexManager::compare(const float key, const float value) const
     return 0;
 }
 
-int IndexManager::compare(const char *key, const char *value) const
+// Rids in page order, then slot order
+int IndexManager::compare(const RID &rid, const RID &value) const
+{
+    if (rid.pageNum != value.pageNum)
+        return rid.pageNum > value.pageNum ? 1 : -1;
+    if (rid.slotNum != value.slotNum)
+        return rid.slotNum > value.slotNum ? 1 : -1;
+    return 0;
+}
+
+int IndexManager::getKeySize(const Attribute attr, const void *key) const
 {
-    return strcmp(key, value);
+    if (attr.type != TypeVarChar)
+        return INT_SIZE;
+    int32_t key_len;
+    memcpy(&key_len, key, VARCHAR_LENGTH_SIZE);
+    return VARCHAR_LENGTH_SIZE + key_len;
 }
 
 // Get size needed to insert key into page
@@ -1206,17 +3618,67 @@ int IndexManager::getKeyLengthInternal(const Attribute attr, const void *key) co
     return size;
 }
 
-int IndexManager::getKeyLengthLeaf(const Attribute attr, const void *key) const
+int IndexManager::getInsertSpaceLeaf(const Attribute attr, const void *key, const void *pageData) const
 {
-    int size = sizeof(DataEntry);
-    if (attr.type == TypeVarChar)
+    // A key the leaf has already only takes a longer posting list
+    LeafHeader header = getLeafHeader(pageData);
+    int i = searchLeaf(attr, key, pageData, true);
+    if (i < header.entriesNumber && compareLeafSlot(attr, key, pageData, i) == 0)
+        return IX_MAX_RID_SIZE;
+
+    if (attr.type != TypeVarChar)
+        return sizeof(DataEntry) + IX_MAX_RID_SIZE;
+
+    int32_t len;
+    memcpy(&len, key, VARCHAR_LENGTH_SIZE);
+    if (hasLeafPrefix(key, pageData))
+        return sizeof(DataEntry) + IX_MAX_RID_SIZE + VARCHAR_LENGTH_SIZE + len - header.prefixLength;
+
+    // Otherwise the prefix gets as short as what the key has in common with it, and every key
+    // stored on the page takes the bytes the prefix loses. The page might end up with a
+    // longer prefix than that if the keys have more in common, so this is the most it takes.
+    const char *prefix = (char*)pageData + PAGE_SIZE - header.prefixLength;
+    int common = 0;
+    while (common < header.prefixLength && common < len && prefix[common] == ((char*)key)[VARCHAR_LENGTH_SIZE + common])
+        common++;
+    int size = sizeof(DataEntry) + IX_MAX_RID_SIZE + VARCHAR_LENGTH_SIZE + len;
+    if (header.entriesNumber > 0)
+        size += (header.entriesNumber - 1) * (header.prefixLength - common) - common;
+    return size;
+}
+
+bool IndexManager::hasLeafPrefix(const void *key, const void *pageData) const
+{
+    LeafHeader header = getLeafHeader(pageData);
+    int32_t len;
+    memcpy(&len, key, VARCHAR_LENGTH_SIZE);
+    return len >= header.prefixLength &&
+        memcmp((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + PAGE_SIZE - header.prefixLength, header.prefixLength) == 0;
+}
+
+int IndexManager::getCommonPrefixLength(const string &key, const string &value) const
+{
+    int len = min(key.size(), value.size()) - VARCHAR_LENGTH_SIZE;
+    int i = 0;
+    while (i < len && key[VARCHAR_LENGTH_SIZE + i] == value[VARCHAR_LENGTH_SIZE + i])
+        i++;
+    return i;
+}
+
+void IndexManager::getSeparator(const Attribute attr, const string &left, const string &right, string &separator) const
+{
+    separator = left;
+    if (attr.type != TypeVarChar)
+        return;
+
+    // The first bytes of right up to and including the first one that differs from left are
+    // larger than left and smaller than right. Used when that is shorter than left.
+    int32_t len = getCommonPrefixLength(left, right) + 1;
+    if (len < (int32_t) (left.size() - VARCHAR_LENGTH_SIZE) && len < (int32_t) (right.size() - VARCHAR_LENGTH_SIZE))
     {
-        int32_t key_len;
-        memcpy(&key_len, key, VARCHAR_LENGTH_SIZE);
-        size += VARCHAR_LENGTH_SIZE;
-        size += key_len;
+        separator.assign((char*)&len, VARCHAR_LENGTH_SIZE);
+        separator.append(right, VARCHAR_LENGTH_SIZE, len);
     }
-    return size;
 }
 
 int IndexManager::getFreeSpaceInternal(void *pageData) const
@@ -1231,85 +3693,54 @@ int IndexManager::getFreeSpaceLeaf(void *pageData) const
     return header.freeSpaceOffset - (sizeof(NodeType) + sizeof(LeafHeader) + header.entriesNumber * sizeof(DataEntry));
 }
 
-RC IndexManager::deleteEntryFromLeaf(const Attribute attr, const void *key, const RID &rid, void *pageData)
+RC IndexManager::deleteEntryFromLeaf(IXFileHandle &fileHandle, const Attribute attr, const void *key, const RID &rid, void *pageData, bool canFree)
 {
     LeafHeader header = getLeafHeader(pageData);
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        // Find a slot whose key and rid are equal to the given key and rid
-        if(compareLeafSlot(attr, key, pageData, i) == 0)
-        {
-            DataEntry entry = getDataEntry(i, pageData);
-            if (entry.rid.pageNum == rid.pageNum && entry.rid.slotNum == rid.slotNum)
-            {
-                break;
-            }
-        }
-    }
-    // If we failed to find one, error out
-    if (i == header.entriesNumber)
-    {
+    // The slot of the key, if the leaf has it
+    int i = searchLeaf(attr, key, pageData, true);
+    if (i == header.entriesNumber || compareLeafSlot(attr, key, pageData, i) != 0)
         return IX_RECORD_DN_EXIST;
-    }
-
-    DataEntry entry = getDataEntry(i, pageData);
-    // Get position where deleted entry starts
-    // Then get position where entries end. Move all entries to the left, overwriting the entry being deleted.
-    unsigned slotStartOffset = getOffsetOfLeafSlot(i);
-    unsigned slotEndOffset = getOffsetOfLeafSlot(header.entriesNumber);
-    memmove((char*)pageData + slotStartOffset, (char*)pageData + slotStartOffset + sizeof(DataEntry), slotEndOffset - slotStartOffset - sizeof(DataEntry));
 
-    header.entriesNumber -= 1;
+    LeafEntry entry;
+    getLeafEntry(attr, i, pageData, entry);
+    RC rc = removeFromPosting(fileHandle, entry, rid, canFree);
+    if (rc)
+        return rc;
 
-    // Now, if we're a varchar, we need to move all of the varchars over as well
-    if (attr.type == TypeVarChar)
+    // The slot goes with the key's last rid. A posting list never gets longer when a rid is
+    // taken out of it, so the new one fits.
+    if (entry.posting.empty())
     {
-        int32_t varcharOffset = entry.varcharOffset;
-        int32_t varchar_len;
-        memcpy(&varchar_len, (char*)pageData + varcharOffset, VARCHAR_LENGTH_SIZE);
-        int32_t entryLen = varchar_len + VARCHAR_LENGTH_SIZE;
-
-        // Take everything from the start of the free space to the start of the varchar being deleted, and move it over the deleted varchar
-        memmove((char*)pageData + header.freeSpaceOffset + entryLen, (char*)pageData + header.freeSpaceOffset, varcharOffset - header.freeSpaceOffset);
-        header.freeSpaceOffset += entryLen;
-        // Update all of the slots that are moved over
-        for (i = 0; i < header.entriesNumber; i++)
-        {
-            entry = getDataEntry(i, pageData);
-            if (entry.varcharOffset < varcharOffset)
-                entry.varcharOffset += entryLen;
-            setDataEntry(entry, i, pageData);
-        }
+        deleteLeafSlot(attr, i, pageData);
+        return SUCCESS;
     }
-    setLeafHeader(header, pageData);
-    return SUCCESS;
+    return setLeafPosting(attr, i, entry, pageData);
 }
 
 RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key, void *pageData)
 {
     InternalHeader header = getInternalHeader(pageData);
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        // Scan through until we find a matching key
-        if(compareSlot(attr, key, pageData, i) == 0)
-        {
-            break;
-        }
-    }
-    if (i == header.entriesNumber)
+    // The first slot whose key is not smaller, if it is the key
+    int i = searchInternal(attr, key, pageData);
+    if (i == header.entriesNumber || compareSlot(attr, key, pageData, i) != 0)
     {
         // error out if no match
         return IX_RECORD_DN_EXIST;
     }
 
-    IndexEntry entry = getIndexEntry(i, pageData);
+    deleteInternalSlot(attr, i, pageData);
+    return SUCCESS;
+}
+
+void IndexManager::deleteInternalSlot(const Attribute attr, const int slotNum, void *pageData)
+{
+    InternalHeader header = getInternalHeader(pageData);
+    IndexEntry entry = getIndexEntry(slotNum, pageData);
 
     // Get positions where deleted entry starts and end
-    unsigned slotStartOffset = getOffsetOfInternalSlot(i);
+    unsigned slotStartOffset = getOffsetOfInternalSlot(slotNum);
     unsigned slotEndOffset = getOffsetOfInternalSlot(header.entriesNumber);
 
     // Move entries over, overwriting the slot being deleted
@@ -1329,7 +3760,7 @@ RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key,
         memmove((char*)pageData + header.freeSpaceOffset + entryLen, (char*)pageData + header.freeSpaceOffset, varcharOffset - header.freeSpaceOffset);
         header.freeSpaceOffset += entryLen;
         // Update all of the slots that are moved over
-        for (i = 0; i < header.entriesNumber; i++)
+        for (int i = 0; i < header.entriesNumber; i++)
         {
             entry = getIndexEntry(i, pageData);
             if (entry.varcharOffset < varcharOffset)
@@ -1338,5 +3769,53 @@ RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key,
         }
     }
     setInternalHeader(header, pageData);
-    return SUCCESS;
+}
+
+void IndexManager::getLeafSlotKey(const Attribute attr, const int slotNum, const void *pageData, string &key) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    if (attr.type == TypeVarChar)
+    {
+        int32_t len;
+        memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        key.resize(VARCHAR_LENGTH_SIZE + getLeafHeader(pageData).prefixLength + len);
+        copyLeafSlotKey(attr, slotNum, pageData, &key[0]);
+    }
+    else
+    {
+        key.assign((char*)&entry.integer, INT_SIZE);
+    }
+}
+
+void IndexManager::copyLeafSlotKey(const Attribute attr, const int slotNum, const void *pageData, void *key) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    if (attr.type != TypeVarChar)
+    {
+        memcpy(key, &entry.integer, INT_SIZE);
+        return;
+    }
+
+    LeafHeader header = getLeafHeader(pageData);
+    int32_t suffixLength;
+    memcpy(&suffixLength, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+    int32_t len = header.prefixLength + suffixLength;
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+    memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + PAGE_SIZE - header.prefixLength, header.prefixLength);
+    memcpy((char*)key + VARCHAR_LENGTH_SIZE + header.prefixLength, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, suffixLength);
+}
+
+void IndexManager::getInternalSlotKey(const Attribute attr, const int slotNum, const void *pageData, string &key) const
+{
+    IndexEntry entry = getIndexEntry(slotNum, pageData);
+    if (attr.type == TypeVarChar)
+    {
+        int32_t len;
+        memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        key.assign((char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE + len);
+    }
+    else
+    {
+        key.assign((char*)&entry.integer, INT_SIZE);
+    }
 }
@@ -3,12 +3,16 @@
 
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <unordered_map>
 
 #include "../rbf/rbfm.h"
 #include "../rbf/pfm.h"
 
 #define IX_TYPE_LEAF     0
 #define IX_TYPE_INTERNAL 1
+#define IX_TYPE_FREE     2
+#define IX_TYPE_OVERFLOW 3
 
 # define IX_EOF (-1)  // end of the index scan
 #define IX_CREATE_FAILED          1
@@ -24,6 +28,26 @@
 #define IX_INSERT_INTERNAL_FAILED 11
 #define IX_WRITE_FAILED           12
 #define IX_NO_FREE_SPACE          13
+#define IX_NOT_EMPTY              14
+#define IX_SORT_FAILED            15
+#define IX_BAD_PAGE               16
+#define IX_FREES_PAGE             17
+
+// Fraction of each node bulkLoad fills, leaving room for later inserts
+#define IX_DEFAULT_FILL_FACTOR    0.9
+// A node under this fraction of a page after a delete takes entries from a sibling, or is
+// merged with it. Splits leave about half a page in each node, so this is kept below that.
+#define IX_MIN_FILL_FACTOR        0.4
+// Levels of internal nodes, from the root down, that an IXFileHandle keeps copies of
+#define IX_CACHED_LEVELS          2
+// Memory IX_ExternalSorter holds entries in before it writes a sorted run to disk
+#define IX_SORT_MEMORY            (64 * 1024 * 1024)
+// Longest posting list a leaf keeps. The rids of a key with more are moved to overflow pages.
+#define IX_MAX_POSTING_SIZE       (PAGE_SIZE / 4)
+// Set in postingLength of a DataEntry whose key has its rids in overflow pages
+#define IX_POSTING_OVERFLOW       0x8000
+// Most bytes a rid takes in a posting list
+#define IX_MAX_RID_SIZE           10
 
 
 // Headers and data types
@@ -34,14 +58,19 @@ typedef char NodeType;
 // Leaf nodes contain pointers to prev and next nodes in linked list of leafs
 // Also contain number of keys within and pointer to free space
 // 0 is always meta node, so a 0 value for next/prev is like NULL
+// Varchar keys in a leaf are stored without the prefix every key on the page has in common,
+// which is kept once in the last prefixLength bytes of the page.
 typedef struct LeafHeader
 {
 	uint32_t next;
 	uint32_t prev;
 	uint16_t entriesNumber;
 	uint16_t freeSpaceOffset;
+	uint16_t prefixLength;
 } LeafHeader;
 
+// Each key is in one slot of a leaf, with its posting list: the rids of every entry with the
+// key, in order, stored at postingOffset. See encodePosting.
 typedef struct DataEntry
 {
 	union
@@ -50,7 +79,8 @@ typedef struct DataEntry
 		float real;
 		int32_t varcharOffset;
 	};
-	RID rid;
+	uint16_t postingOffset;
+	uint16_t postingLength;  // with IX_POSTING_OVERFLOW set, the posting list is an OverflowPosting
 } DataEntry;
 
 // each entry has offset to key and link to child
@@ -80,15 +110,87 @@ typedef struct ChildEntry
     uint32_t childPage;
 } ChildEntry;
 
+// Used in bulkLoad to carry each finished node up to the level above it.
+// key separates the node from the one before it; it is empty for the first node of a level.
+typedef struct BulkLoadChild
+{
+    string key;
+    uint32_t page;
+} BulkLoadChild;
+
 // Header for metadata page, page 0
-// Contains pointer to root node so that root node can be moved when split
+// Contains pointer to root node so that root node can be moved when split,
+// and the first of the free pages, 0 if there are none
 typedef struct MetaHeader
 {
 	uint32_t rootPage;
+	uint32_t freePage;
 } MetaHeader;
 
+// Pages freed by merges keep the layout of an empty leaf, so a scan that read the leaf before
+// it moves on to the leaf that came after it. nextFree chains the free pages from the meta page.
+typedef struct FreeHeader
+{
+	uint32_t next;
+	uint32_t nextFree;
+	uint16_t entriesNumber;
+	uint16_t freeSpaceOffset;
+	uint16_t prefixLength;
+} FreeHeader;
+
+// The rids of a key with too many to keep on its leaf are in a chain of overflow pages, in
+// order. The rids of each page are a posting list of their own after the header.
+typedef struct OverflowHeader
+{
+	uint32_t next;
+	uint16_t ridsNumber;
+	uint16_t postingLength;
+	RID last;
+} OverflowHeader;
+
+// What a leaf keeps in place of the posting list of a key whose rids are in overflow pages
+typedef struct OverflowPosting
+{
+	uint32_t firstPage;
+	uint32_t lastPage;
+	uint32_t ridsNumber;
+} OverflowPosting;
+
+// A slot taken off a leaf, to be written to one: the whole key, and the posting list as the
+// leaf keeps it. A key with no rids left has an empty posting list.
+typedef struct LeafEntry
+{
+    string key;
+    string posting;
+    bool overflow;
+} LeafEntry;
+
+// Where bulkLoad and compact write nodes: the pages in reuse, lowest first, and then
+// new pages from nextAppend on at the end of the file
+typedef struct NodePages
+{
+    vector<PageNum> reuse;  // largest first, so the next one is at the back
+    PageNum nextAppend;
+} NodePages;
+
+// Shape of an index, from getStatistics
+typedef struct IndexStatistics
+{
+    unsigned height;         // levels, counting the leaves
+    unsigned internalPages;
+    unsigned leafPages;
+    unsigned overflowPages;
+    unsigned freePages;
+    unsigned entries;
+    float leafFill;          // fraction of the leaves' space holding entries
+    float fragmentation;     // fraction of the leaves a full scan reads beyond the fewest that could hold the entries
+    float outOfOrder;        // fraction of the leaves whose next leaf is not the next page of the file
+} IndexStatistics;
+
 class IX_ScanIterator;
+class IX_ExternalSorter;
 class IXFileHandle;
+class IX_KeySchema;
 
 class IndexManager {
 
@@ -122,9 +224,55 @@ class IndexManager {
                 bool highKeyInclusive,
                 IX_ScanIterator &ix_ScanIterator);
 
+        // Composite keys, over the attributes of schema. key holds the value of each attribute
+        // one after the other, each in the format insertEntry takes for it, with no null indicator.
+        RC insertEntry(IXFileHandle &ixfileHandle, const IX_KeySchema &schema, const void *key, const RID &rid);
+        RC deleteEntry(IXFileHandle &ixfileHandle, const IX_KeySchema &schema, const void *key, const RID &rid);
+
+        // Range search over composite keys. lowKey and highKey hold the values of the first lowCount
+        // and highCount attributes of schema; a key counts as equal to a bound it starts with, so a
+        // scan from (c) to (c), both inclusive, returns every key whose first attribute is c.
+        // A bound that is NULL or has no values is open. Keys come out in the format of key above.
+        RC scan(IXFileHandle &ixfileHandle,
+                const IX_KeySchema &schema,
+                const void *lowKey,
+                unsigned lowCount,
+                const void *highKey,
+                unsigned highCount,
+                bool lowKeyInclusive,
+                bool highKeyInclusive,
+                IX_ScanIterator &ix_ScanIterator);
+
+        // Build the index bottom-up from the entries added to the sorter, which can be in any order.
+        // The index must be empty. Nodes are filled to fillFactor of a page.
+        RC bulkLoad(IXFileHandle &ixfileHandle,
+                const Attribute &attribute,
+                IX_ExternalSorter &entries,
+                float fillFactor = IX_DEFAULT_FILL_FACTOR);
+
+        // Insert the entries added to the sorter, which can be in any order, into an index
+        // that may already hold entries. They are inserted in key order, so runs of entries
+        // that fall in the same leaf are added to it with a single read and write.
+        RC insertEntries(IXFileHandle &ixfileHandle,
+                const Attribute &attribute,
+                IX_ExternalSorter &entries);
+
+        // Rewrite the leaves in key order at fillFactor of a page, and the internal nodes over them.
+        // Nodes go to the lowest pages of the file, and the pages left over are freed.
+        // The index stays open, but every other operation on it waits until this is done.
+        RC compact(IXFileHandle &ixfileHandle,
+                const Attribute &attribute,
+                float fillFactor = IX_DEFAULT_FILL_FACTOR);
+
+        // Count the pages and entries of the index, and how far the leaves are from compact
+        RC getStatistics(IXFileHandle &ixfileHandle, IndexStatistics &statistics);
+
         // Print the B+ tree in pre-order (in a JSON record format)
         void printBtree(IXFileHandle &ixfileHandle, const Attribute &attribute) const;
+        // Print getStatistics in the same format
+        void printStatistics(IXFileHandle &ixfileHandle);
         friend class IX_ScanIterator;
+        friend class IX_ExternalSorter;
 				friend class RelationManager;
 
     protected:
@@ -134,12 +282,74 @@ class IndexManager {
     private:
         static IndexManager *_index_manager;
 
-        // Utility function for insertEntry
-        RC insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, ChildEntry &childEntry);
+        // Utility function for insertEntry. pageID is latched exclusively, and is the last of
+        // latched, the pages on the way down whose latches are still held.
+        RC insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, ChildEntry &childEntry, vector<PageNum> &latched);
         // Inserts ChildEntry <key, pageNum> into internal node. Returns an error if there's not enough space
         RC insertIntoInternal(const Attribute attribute, ChildEntry entry, void *pageData);
-        // Inserts <key, rid> into the given leaf node. Returns an error if there's not enough free space
-        RC insertIntoLeaf(const Attribute attribute, const void *key, const RID &rid, void *pageData);
+        // Inserts <key, rid> into the given leaf node, in the posting list of the key if the leaf has it.
+        // Returns an error if there's not enough free space
+        RC insertIntoLeaf(IXFileHandle &fileHandle, const Attribute attribute, const void *key, const RID &rid, void *pageData);
+
+        // Replaces the slots of the leaf with entries from begin to end, which are in key order,
+        // under the longest prefix their keys share. Returns an error if they don't fit
+        RC writeLeafEntries(const Attribute attribute, const vector<LeafEntry> &entries, int begin, int end, void *pageData);
+        // Every slot of the leaf, with the whole keys
+        void getLeafEntries(const Attribute attribute, const void *pageData, vector<LeafEntry> &entries) const;
+        void getLeafEntry(const Attribute attribute, const int slotNum, const void *pageData, LeafEntry &entry) const;
+        // The space a slot takes on a leaf with no prefix
+        int getLeafEntrySize(const Attribute attribute, const LeafEntry &entry) const;
+        // The space slots that take bytes with no prefix take on a leaf with a prefix of prefixLength
+        int getLeafSize(int entries, int bytes, int prefixLength) const;
+        // The prefix the keys of entries from begin to end share
+        int getLeafPrefixLength(const Attribute attribute, const vector<LeafEntry> &entries, int begin, int end) const;
+        // The space the entries from begin to end take when written by writeLeafEntries
+        int getLeafEntriesSize(const Attribute attribute, const vector<LeafEntry> &entries, int begin, int end) const;
+        // Where to split the slots of an overfull leaf so both halves fit, as evenly as it can.
+        // Returns 0 if there is no such place
+        int chooseLeafSplit(const Attribute attribute, const vector<LeafEntry> &entries) const;
+        // Replaces the posting list of slot slotNum with the one of entry. Returns an error if there's not enough free space
+        RC setLeafPosting(const Attribute attribute, const int slotNum, const LeafEntry &entry, void *pageData);
+        // Takes length bytes at offset out of the keys and posting lists at the end of the leaf
+        void removeLeafBytes(const Attribute attribute, int offset, int length, void *pageData);
+        // Deletes slot slotNum of the leaf, with its key and posting list
+        void deleteLeafSlot(const Attribute attribute, const int slotNum, void *pageData);
+
+        // Posting lists: rids in order, each as the difference from the one before it. See appendToPosting.
+        void encodePosting(const vector<RID> &rids, int begin, int end, string &posting) const;
+        void appendToPosting(const RID &rid, RID &previous, string &posting) const;
+        void decodePosting(const char *posting, int length, vector<RID> &rids) const;
+        // Every rid of entry, from the leaf or from its overflow pages
+        RC getPostingRids(IXFileHandle &fileHandle, const LeafEntry &entry, vector<RID> &rids) const;
+        // Adds rid to the posting list of entry. A posting list that gets longer than
+        // IX_MAX_POSTING_SIZE is moved to overflow pages.
+        RC addToPosting(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid);
+        // Removes rid from the posting list of entry. An overflow page it was the last rid of is
+        // freed if canFree, which needs the file latched exclusively, else IX_FREES_PAGE is returned.
+        RC removeFromPosting(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid, bool canFree);
+        // Writes rids to a new chain of overflow pages, and makes it the posting list of entry.
+        // The pages are taken from pages if it is given, else appended.
+        RC writeOverflow(IXFileHandle &fileHandle, const vector<RID> &rids, NodePages *pages, LeafEntry &entry);
+        RC insertIntoOverflow(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid);
+        RC deleteFromOverflow(IXFileHandle &fileHandle, LeafEntry &entry, const RID &rid, bool canFree);
+        // Makes pageData an overflow page holding posting
+        void setOverflowPage(const string &posting, uint16_t ridsNumber, const RID &last, uint32_t next, void *pageData);
+        // Adds ChildEntry <key, pageNum> after every entry of the internal node. Returns an error if there's not enough space
+        RC appendIntoInternal(const Attribute attribute, ChildEntry entry, void *pageData);
+
+        // Helpers for bulkLoad and compact. Each writes out one level of the tree and replaces children
+        // with the nodes of the level above.
+        RC bulkLoadLeaves(IXFileHandle &fileHandle, const Attribute &attribute, IX_ExternalSorter &entries, float fillFactor, NodePages &pages, int32_t firstLeaf, vector<BulkLoadChild> &children);
+        RC bulkLoadInternal(IXFileHandle &fileHandle, const Attribute &attribute, float fillFactor, int32_t rootPage, NodePages &pages, vector<BulkLoadChild> &children);
+        // Takes the page the next node goes to
+        PageNum takePage(NodePages &pages);
+        // Writes a node to a page from takePage, extending the file if it is past the end
+        RC writeNode(IXFileHandle &fileHandle, PageNum pageNum, const void *pageData);
+        // bulkLoad, insertEntries and compact, with the file latched
+        RC bulkLoadTree(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_ExternalSorter &entries, float fillFactor);
+        RC insertSortedEntries(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_ExternalSorter &entries);
+        RC compactTree(IXFileHandle &ixfileHandle, const Attribute &attribute, float fillFactor);
+        RC collectStatistics(IXFileHandle &ixfileHandle, IndexStatistics &statistics);
 
         // Gets offset to a leaf slot with the given slot number
         int getOffsetOfLeafSlot(int slotNum) const;
@@ -149,13 +359,13 @@ class IndexManager {
         // Handles splitting a leaf
         RC splitLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID rid, const int32_t pageID, void *originalLeaf, ChildEntry &childEntry);
         // Handles splitting an internal node, including the case where the root needs to be split
-        RC splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *original, ChildEntry &childEntry);
+        RC splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, bool isRoot, void *original, ChildEntry &childEntry);
 
         // Helper functions for printBtree
         void printBtree_rec(IXFileHandle &ixfileHandle, string prefix, const int32_t currPage, const Attribute &attr) const;
         void printInternalNode(IXFileHandle &, void *pageData, const Attribute &attr, string prefix) const;
         void printInternalSlot(const Attribute &attr, const int32_t slotNum, const void *data) const;
-        void printLeafNode(void *pageData, const Attribute &attr) const;
+        void printLeafNode(IXFileHandle &ixfileHandle, void *pageData, const Attribute &attr) const;
 
         // Each method in this block gets or sets some header data for different types of pages
         void setMetaData(const MetaHeader header, void *pageData);
@@ -170,38 +380,87 @@ class IndexManager {
         IndexEntry getIndexEntry(const int slotNum, const void *pageData) const;
         void setDataEntry(const DataEntry entry, const int slotNum, void *pageData);
         DataEntry getDataEntry(const int slotNum, const void *pageData) const;
+        OverflowHeader getOverflowHeader(const void *pageData) const;
 
         RC getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const;
 
-        // Finds the leaf page that would contain key
-        RC find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum);
-        // Finds the leaf page that would contain key, starting at currPageNum. Utility function for find.
-        RC treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum);
+        // Finds the leaf page that would contain key, and returns with it latched shared or exclusive.
+        // The caller unlatches it. Nodes are latched shared on the way down, each before its parent is let go.
+        // The upper levels cached by the handle are used without reading or latching them.
+        // If leafData is given, the leaf is read into it.
+        RC find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum, bool exclusive, void *leafData = NULL);
+        // One try of find, reading every node into pageData. stale is set, and nothing is left latched,
+        // if a cached node turned out to have changed on the way down. Utility function for find.
+        RC treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, void *pageData, int32_t &resultPageNum, bool exclusive, bool &stale);
+        // A node is safe if inserting key under it cannot split it
+        bool isSafe(const Attribute &attr, const void *key, void *pageData) const;
+        // Unlatches the pages at the front of latched, leaving the last keep of them
+        void unlatchPages(IXFileHandle &handle, vector<PageNum> &latched, unsigned keep);
+        // Finds the leaf page that would contain key, and the largest key that can go in it.
+        // bounded is false if the leaf is the last one, which takes any larger key.
+        RC findLeaf(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &leafPage, string &highKey, bool &bounded);
         // Given an attribute, key, and internal node, returns the pagenumber of the childPage who would contain key
-        int32_t getNextChildPage(const Attribute attr, const void *key, void *pageData);
-
+        int32_t getNextChildPage(const Attribute attr, const void *key, const void *pageData);
+
+        // Binary searches of a node's entries, which are kept in key order.
+        // searchInternal returns the first slot whose key is not smaller than key, or entriesNumber.
+        int searchInternal(const Attribute attr, const void *key, const void *pageData) const;
+        // searchLeaf returns the first slot whose key is larger than key, or also equal to it if
+        // inclusive, or entriesNumber.
+        int searchLeaf(const Attribute attr, const void *key, const void *pageData, bool inclusive) const;
         // Compares key to the value in pageDat at slotNum. For internal nodes.
         int compareSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const;
         // Compares key to the value in pageData at slotNum. For leaf nodes.
         int compareLeafSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const;
+        // Compares two keys in the format passed to insertEntry
+        int compareKey(const Attribute attr, const void *key, const void *value) const;
         // Returns -1, 0, or 1 if key is less than, equal to, or greater than value
         int compare(const int key, const int value) const;
         int compare(const float key, const float value) const;
-        int compare(const char *key, const char *value) const;
+        int compare(const RID &rid, const RID &value) const;
 
+        // Returns the size of key in the format passed to insertEntry
+        int getKeySize(const Attribute attr, const void *key) const;
         // Returns the amount of space requried to store this key in an internal node
         int getKeyLengthInternal(const Attribute attr, const void *key) const;
-        // Returns the amount of space required to store this key in a leaf
-        int getKeyLengthLeaf(const Attribute attr, const void *key) const;
+        // Returns the amount of space inserting this key takes in the leaf, at most
+        int getInsertSpaceLeaf(const Attribute attr, const void *key, const void *pageData) const;
+        // Whether the varchar key starts with the prefix of the leaf
+        bool hasLeafPrefix(const void *key, const void *pageData) const;
+        // The number of characters two varchar keys start with in common
+        int getCommonPrefixLength(const string &key, const string &value) const;
+        // The shortest key that is not smaller than left and smaller than right, to go in the parent
+        void getSeparator(const Attribute attr, const string &left, const string &right, string &separator) const;
         // Returns the amount of free space in the internal node
         int getFreeSpaceInternal(void *pageData) const;
         // Returns the amount of free space in the leaf
         int getFreeSpaceLeaf(void *pageData) const;
 
-        // Deletes an entry with key key and rid rid from leaf given by pageData
-        RC deleteEntryFromLeaf(const Attribute attr, const void *key, const RID &rid, void *pageData);
+        // Deletes an entry with key key and rid rid from leaf given by pageData. See removeFromPosting for canFree.
+        RC deleteEntryFromLeaf(IXFileHandle &fileHandle, const Attribute attr, const void *key, const RID &rid, void *pageData, bool canFree);
         // Deletes key key from the Internal node given by pageData
         RC deleteEntryFromInternal(const Attribute attr, const void *key, void *pageData);
+        // Deletes the entry in slot slotNum of the internal node given by pageData
+        void deleteInternalSlot(const Attribute attr, const int slotNum, void *pageData);
+
+        // Copies the key in slotNum out of a node, in the format passed to insertEntry
+        void getLeafSlotKey(const Attribute attr, const int slotNum, const void *pageData, string &key) const;
+        // Copies the key at slotNum of the leaf to key, in the format passed to insertEntry
+        void copyLeafSlotKey(const Attribute attr, const int slotNum, const void *pageData, void *key) const;
+        void getInternalSlotKey(const Attribute attr, const int slotNum, const void *pageData, string &key) const;
+
+        // A node underflows when less than IX_MIN_FILL_FACTOR of it is in use
+        bool isUnderflow(const void *pageData) const;
+        // After a delete left leafPage underflowing: merges it with a sibling, or moves entries over
+        // from one, and does the same for each parent that underflows in turn. Drops a root left with
+        // a single internal child. The file must be latched exclusively.
+        RC rebalance(IXFileHandle &fileHandle, const Attribute &attr, const void *key, int32_t leafPage);
+        // Merge or even out two neighbouring children of parentData, separated by its slot slotNum.
+        // The parent is changed in place, the caller writes it.
+        RC rebalanceLeaves(IXFileHandle &fileHandle, const Attribute &attr, void *parentData, int slotNum, int32_t leftPage, void *leftData, int32_t rightPage, void *rightData);
+        RC rebalanceInternal(IXFileHandle &fileHandle, const Attribute &attr, void *parentData, int slotNum, int32_t leftPage, void *leftData, int32_t rightPage, void *rightData);
+        // Puts pageNum on the free list. next is where a scan that reads the page goes on to.
+        RC freePage(IXFileHandle &fileHandle, PageNum pageNum, uint32_t next);
 };
 
 class IXFileHandle {
@@ -227,13 +486,63 @@ class IXFileHandle {
 	RC readPage(PageNum pageNum, void *data);
     RC writePage(PageNum pageNum, const void *data);
     RC appendPage(const void *data);
+    RC appendPage(const void *data, PageNum &pageNum);
 
     friend class IndexManager;
+    friend class IX_ScanIterator;
 	private:
         FileHandle fh;
 
+        // The root, and copies of the internal nodes of the top IX_CACHED_LEVELS levels that
+        // searches went through, as they were at version cacheVersion of the file. Writes of
+        // internal nodes and of the meta page move the version on, through any handle.
+        // Like the FileHandle, this is for one thread at a time.
+        int32_t cachedRoot;
+        unsigned cacheVersion;
+        unordered_map<PageNum, vector<char> > cachedNodes;
+
+        // Drops the copies if the file has moved on since they were made
+        void validateCache();
+        void clearCache();
+
 	};
 
+// The attributes of a composite key, in order. Keys compare on their first attribute, then
+// on the second, and so on. The index stores each key as a varchar whose bytes compare with
+// memcmp in that same order (see encode), so the tree, its prefix compression and its scans
+// work on composite keys as they do on any varchar key.
+//  IX_KeySchema schema(attributes);
+//  indexManager->insertEntry(ixfileHandle, schema, values, rid);
+//  indexManager->bulkLoad(ixfileHandle, schema.getKeyAttribute(), sorter);  // of encoded keys
+class IX_KeySchema {
+    public:
+        IX_KeySchema();
+        IX_KeySchema(const vector<Attribute> &attributes);
+
+        const vector<Attribute> &getAttributes() const;
+
+        // The varchar attribute the index holds the encoded keys under, long enough for any of them
+        Attribute getKeyAttribute() const;
+
+        // Encodes the values of the first count attributes into key, a varchar of getKeyAttribute().
+        // values holds them one after the other, each in the format insertEntry takes for it.
+        // Integers and reals become 4 bytes, big-endian with the sign flipped so they sort as
+        // unsigned bytes; a varchar has its 0 bytes escaped to 0 0xFF and ends with 0 1, so it
+        // sorts before every longer varchar it is a prefix of.
+        void encode(const void *values, unsigned count, void *key) const;
+        void encode(const void *values, unsigned count, string &key) const;
+
+        // Decodes a whole key back into the values of every attribute
+        void decode(const void *key, void *values) const;
+
+        // The smallest key after every key that starts with the encoded key prefix.
+        // Returns false if there is none.
+        bool getSuccessor(const string &prefix, string &successor) const;
+
+    private:
+        vector<Attribute> attrs;
+};
+
 class IX_ScanIterator {
     public:
 
@@ -260,12 +569,98 @@ class IX_ScanIterator {
         const void *highKey;
         bool lowKeyInclusive;
         bool highKeyInclusive;
+        // A scan of composite keys keeps its encoded bounds, and decodes the keys it returns
+        bool composite;
+        IX_KeySchema schema;
+        string lowBound;
+        string highBound;
+        string returnedKey;
 
 
         void *page;
         int slotNum;
+        // The rids of slot slotNum that have been read, from the leaf or from an overflow page,
+        // and the next of them to return. nextOverflow is the overflow page with the rids after
+        // them, 0 if there are none.
+        bool slotRead;
+        vector<RID> rids;
+        unsigned ridNum;
+        PageNum nextOverflow;
+        void *overflowPage;
+
+        // The file's version when page was read. If a merge or split has changed the tree
+        // since, the leaf that page points to may not follow it any more, and the scan finds
+        // its place again from the root.
+        unsigned version;
+        // The entry returned last before the scan moved on to another page. When the scan finds
+        // its place again, it skips the entries up to this one.
+        bool hasLast;
+        string lastKey;
+        RID lastRid;
+        bool skipping;
+        // The slot of page and the rid returned last, returnedSlot is -1 if none since page was read
+        int returnedSlot;
+        RID returnedRid;
+
+        RC initialize(IXFileHandle &, Attribute, const void*, const void*, bool, bool, const IX_KeySchema *schema = NULL);
+        // Reads the leaf to start from into page
+        RC position(const void *key, bool inclusive);
+        // Finds the scan's place again after the entry returned last
+        RC reposition();
+        // Keeps the entry returned last, before a page is read
+        void rememberLast();
+        // Reads the rids on overflow page pageNum of slot slotNum
+        RC readOverflow(PageNum pageNum);
+};
+
+// Sorts <key, rid> pairs for IndexManager::bulkLoad. Entries are collected in memory
+// and written out as sorted runs whenever they outgrow the memory limit; the runs are
+// then merged as the entries are read back in key order (ties broken by rid).
+//  IX_ExternalSorter sorter;
+//  sorter.initialize(attribute);
+//  sorter.addEntry(key, rid); ...
+//  indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+//  sorter.close();
+class IX_ExternalSorter {
+    public:
+
+        IX_ExternalSorter();
+        ~IX_ExternalSorter();
+
+        RC initialize(const Attribute &attribute, size_t memoryLimit = IX_SORT_MEMORY);
+
+        // Add an entry. key is in the same format as for insertEntry
+        RC addEntry(const void *key, const RID &rid);
 
-        RC initialize(IXFileHandle &, Attribute, const void*, const void*, bool, bool);
+        // Sort the entries added so far; no entries may be added afterwards
+        RC sort();
+
+        // Get the next entry in key order, IX_EOF after the last one
+        RC getNextEntry(RID &rid, void *key);
+
+        // Release memory and delete the runs
+        RC close();
+
+    private:
+        Attribute attr;
+        size_t memoryLimit;
+        bool sorted;
+
+        // Entries not yet written to a run, each stored as [key][rid] starting at one of offsets
+        vector<char> buffer;
+        vector<uint32_t> offsets;
+        size_t nextOffset;
+
+        // Sorted runs on disk, the entry each of them is at while merging,
+        // and a heap of the runs that still have entries, smallest entry on top
+        vector<FILE*> runs;
+        vector< vector<char> > runHeads;
+        vector<unsigned> mergeHeap;
+
+        bool entryLess(const char *first, const char *second) const;
+        RC writeRun();
+        RC readRunEntry(unsigned run);
+        void copyOut(const char *entry, RID &rid, void *key) const;
 };
 
 #endif
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+// Node search benchmark
+// For an int, a real and a varchar key, inserts numKeys distinct keys in random order
+// and then looks numKeys random keys up (an index scan from the key to itself), and
+// reports inserts and lookups per second. Both are dominated by finding the position
+// of the key in each node on the way down, and in the leaf.
+//
+// Usage: ./ixbench_search [numKeys]
+
+IndexManager *indexManager;
+
+const string indexFileName = "bench_search_idx";
+
+// key i of the given type, in the format insertEntry takes
+void prepareKey(AttrType type, unsigned i, char *key)
+{
+    if (type == TypeInt)
+    {
+        int32_t value = i;
+        memcpy(key, &value, INT_SIZE);
+    }
+    else if (type == TypeReal)
+    {
+        float value = i;
+        memcpy(key, &value, REAL_SIZE);
+    }
+    else
+    {
+        char text[16];
+        int32_t len = snprintf(text, sizeof(text), "key%08u", i);
+        memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+        memcpy(key + VARCHAR_LENGTH_SIZE, text, len);
+    }
+}
+
+void runBenchmark(AttrType type, const string &typeName, unsigned numKeys)
+{
+    Attribute attribute;
+    attribute.name = "Key";
+    attribute.type = type;
+    attribute.length = type == TypeVarChar ? 16 : 4;
+
+    indexManager->destroyFile(indexFileName);
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    vector<unsigned> order(numKeys);
+    for (unsigned i = 0; i < numKeys; i++)
+        order[i] = i;
+    mt19937 generator(numKeys);
+    shuffle(order.begin(), order.end(), generator);
+
+    char key[PAGE_SIZE];
+    RID rid;
+    auto start = chrono::steady_clock::now();
+    for (unsigned i = 0; i < numKeys; i++)
+    {
+        prepareKey(type, order[i], key);
+        rid.pageNum = order[i];
+        rid.slotNum = 0;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    double insertSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    shuffle(order.begin(), order.end(), generator);
+    char returnedKey[PAGE_SIZE];
+    start = chrono::steady_clock::now();
+    for (unsigned i = 0; i < numKeys; i++)
+    {
+        prepareKey(type, order[i], key);
+        IX_ScanIterator ix_ScanIterator;
+        rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+        assert(rc == success && "indexManager::scan() should not fail.");
+        rc = ix_ScanIterator.getNextEntry(rid, returnedKey);
+        assert(rc == success && rid.pageNum == order[i] && "The key should be found.");
+        ix_ScanIterator.close();
+    }
+    double lookupSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << setw(10) << typeName
+         << setw(16) << fixed << setprecision(0) << numKeys / insertSeconds
+         << setw(16) << numKeys / lookupSeconds << endl;
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned numKeys = 200000;
+    if (argc > 1)
+        numKeys = strtoul(argv[1], NULL, 10);
+
+    indexManager = IndexManager::instance();
+
+    cout << numKeys << " keys" << endl;
+    cout << setw(10) << "key" << setw(16) << "inserts/sec" << setw(16) << "lookups/sec" << endl;
+    runBenchmark(TypeInt, "int", numKeys);
+    runBenchmark(TypeReal, "real", numKeys);
+    runBenchmark(TypeVarChar, "varchar", numKeys);
+    return 0;
+}
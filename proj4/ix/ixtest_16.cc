@@ -0,0 +1,244 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+int testCase_16(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Bulk load entries given in random order, sorted through several runs on disk **
+    // 4. Scan entries NO_OP and a range, check the order
+    // 5. Insert and delete entries in the bulk loaded tree
+    // 6. Bulk loading a non-empty index should fail **
+    // 7. Close Index File
+    // 8. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cerr << endl << "***** In IX Test Case 16 *****" << endl;
+
+    RID rid;
+    IXFileHandle ixfileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    IX_ExternalSorter sorter;
+    int key;
+    const int numOfTuples = 30000;
+    const int numOfCopies = 3;
+
+    // create index file
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    // open index file
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // Add every key numOfCopies times, in shuffled order. The small memory limit forces runs to disk.
+    rc = sorter.initialize(attribute, 64 * 1024);
+    assert(rc == success && "IX_ExternalSorter::initialize() should not fail.");
+    srand(16);
+    vector<int> keys;
+    for (int i = 0; i < numOfTuples; i++)
+        for (int j = 0; j < numOfCopies; j++)
+            keys.push_back(i);
+    for (int i = keys.size() - 1; i > 0; i--)
+        swap(keys[i], keys[rand() % (i + 1)]);
+    for (unsigned i = 0; i < keys.size(); i++)
+    {
+        rid.pageNum = keys[i] + 1;
+        rid.slotNum = i;
+        rc = sorter.addEntry(&keys[i], rid);
+        assert(rc == success && "IX_ExternalSorter::addEntry() should not fail.");
+    }
+
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter, 0.7);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    sorter.close();
+
+    // Full scan: keys in order, ties in rid order
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0;
+    int lastKey = -1;
+    unsigned lastSlot = 0;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+    {
+        assert(key >= lastKey && "Keys should come out in order.");
+        assert(rid.pageNum == (unsigned) key + 1 && "rid.pageNum is not correct.");
+        if (key == lastKey)
+            assert(rid.slotNum > lastSlot && "Equal keys should come out in rid order.");
+        lastKey = key;
+        lastSlot = rid.slotNum;
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples * numOfCopies && "scan count is not correct.");
+
+    // Range scan
+    int lowKey = 1000;
+    int highKey = 2000;
+    rc = indexManager->scan(ixfileHandle, attribute, &lowKey, &highKey, true, false, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+    {
+        assert(key >= lowKey && key < highKey && "Key is out of range.");
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == (highKey - lowKey) * numOfCopies && "range scan count is not correct.");
+
+    // The tree keeps working: delete some keys, then insert new ones past the end and in between
+    for (int i = 0; i < numOfTuples; i += 10)
+    {
+        rid.pageNum = i + 1;
+        for (unsigned j = 0; j < keys.size(); j++)
+        {
+            if (keys[j] != i)
+                continue;
+            rid.slotNum = j;
+            rc = indexManager->deleteEntry(ixfileHandle, attribute, &i, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        }
+    }
+    for (int i = 0; i < 2000; i++)
+    {
+        key = (i % 2 == 0) ? numOfTuples + i : i * 7;
+        rid.pageNum = key + 1;
+        rid.slotNum = keys.size() + i;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    lastKey = -1;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+    {
+        assert(key >= lastKey && "Keys should come out in order.");
+        assert(rid.pageNum == (unsigned) key + 1 && "rid.pageNum is not correct.");
+        lastKey = key;
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples * numOfCopies - (numOfTuples / 10) * numOfCopies + 2000 && "scan count is not correct.");
+
+    // Only an empty index can be bulk loaded
+    rc = sorter.initialize(attribute);
+    assert(rc == success && "IX_ExternalSorter::initialize() should not fail.");
+    rid.pageNum = 1;
+    rid.slotNum = 1;
+    key = 1;
+    sorter.addEntry(&key, rid);
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+    assert(rc != success && "indexManager::bulkLoad() into a non-empty index should fail.");
+    sorter.close();
+
+    // Close index file
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+
+    // Destroy Index
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int testCase_16_varchar(const string &indexFileName, const Attribute &attribute)
+{
+    // Bulk load varchar keys of different lengths and check them with a scan
+    RID rid;
+    IXFileHandle ixfileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    IX_ExternalSorter sorter;
+    const int numOfTuples = 20000;
+
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    rc = sorter.initialize(attribute, 64 * 1024);
+    assert(rc == success && "IX_ExternalSorter::initialize() should not fail.");
+
+    char key[100];
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        // Keys "k<number>" padded with a run of 'x' so they differ in length
+        int value = (i * 7919) % numOfTuples;
+        int len = sprintf(key + 4, "k%05d", value);
+        int pad = value % 20;
+        memset(key + 4 + len, 'x', pad);
+        len += pad;
+        memcpy(key, &len, 4);
+
+        rid.pageNum = value;
+        rid.slotNum = 0;
+        rc = sorter.addEntry(key, rid);
+        assert(rc == success && "IX_ExternalSorter::addEntry() should not fail.");
+    }
+
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    sorter.close();
+
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        // The numbers are zero padded, so key order is number order
+        assert(rid.pageNum == (unsigned) count && "Keys should come out in order.");
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples && "scan count is not correct.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    const string indexFileName = "age_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    const string indexEmpNameFileName = "EmpName_idx";
+    Attribute attrEmpName;
+    attrEmpName.length = 30;
+    attrEmpName.name = "EmpName";
+    attrEmpName.type = TypeVarChar;
+
+    remove("age_idx");
+    remove("EmpName_idx");
+
+    RC result = testCase_16(indexFileName, attrAge);
+    if (result == success)
+        result = testCase_16_varchar(indexEmpNameFileName, attrEmpName);
+    if (result == success) {
+        cerr << "***** IX Test Case 16 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 16 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,147 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+int testCase_17(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries one at a time
+    // 4. Insert a batch of entries given in random order into the same tree, splitting leaves **
+    // 5. Scan entries NO_OP, check the order and the rids
+    // 6. Close Index File
+    // 7. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cerr << endl << "***** In IX Test Case 17 *****" << endl;
+
+    RID rid;
+    IXFileHandle ixfileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    IX_ExternalSorter sorter;
+    int key;
+    const int numOfTuples = 20000;
+
+    // create index file
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    // open index file
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // Every third key goes in on its own, so the batch lands in a tree with several levels
+    for (int i = 0; i < numOfTuples; i += 3)
+    {
+        rid.pageNum = i + 1;
+        rid.slotNum = 0;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, &i, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    // The rest, shuffled, plus a second copy of every tenth key
+    rc = sorter.initialize(attribute);
+    assert(rc == success && "IX_ExternalSorter::initialize() should not fail.");
+    srand(17);
+    vector<int> keys;
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        if (i % 3 != 0)
+            keys.push_back(i);
+        if (i % 10 == 0)
+            keys.push_back(i);
+    }
+    for (int i = keys.size() - 1; i > 0; i--)
+        swap(keys[i], keys[rand() % (i + 1)]);
+    for (unsigned i = 0; i < keys.size(); i++)
+    {
+        rid.pageNum = keys[i] + 1;
+        rid.slotNum = 1;
+        rc = sorter.addEntry(&keys[i], rid);
+        assert(rc == success && "IX_ExternalSorter::addEntry() should not fail.");
+    }
+
+    unsigned readPageCount, writePageCount, appendPageCount;
+    unsigned readPageCountBefore, writePageCountBefore, appendPageCountBefore;
+    ixfileHandle.collectCounterValues(readPageCountBefore, writePageCountBefore, appendPageCountBefore);
+    rc = indexManager->insertEntries(ixfileHandle, attribute, sorter);
+    assert(rc == success && "indexManager::insertEntries() should not fail.");
+    sorter.close();
+
+    // Entries that share a leaf are written together, so there are far fewer writes than entries
+    ixfileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    cerr << "Batch of " << keys.size() << " entries: " << readPageCount - readPageCountBefore << " reads, "
+         << writePageCount - writePageCountBefore << " writes" << endl;
+    assert(writePageCount - writePageCountBefore < keys.size() / 4 && "Entries in the same leaf should be written together.");
+
+    // Full scan: every key in order, with both copies of every tenth key
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0;
+    int lastKey = -1;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+    {
+        assert(key >= lastKey && "Keys should come out in order.");
+        assert(rid.pageNum == (unsigned) key + 1 && "rid.pageNum is not correct.");
+        lastKey = key;
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples + numOfTuples / 10 && "scan count is not correct.");
+
+    // Each key can be found on its own
+    for (int i = 0; i < numOfTuples; i += 97)
+    {
+        rc = indexManager->scan(ixfileHandle, attribute, &i, &i, true, true, ix_ScanIterator);
+        assert(rc == success && "indexManager::scan() should not fail.");
+        count = 0;
+        while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+        {
+            assert(key == i && "Key is out of range.");
+            count++;
+        }
+        ix_ScanIterator.close();
+        assert(count == (i % 10 == 0 ? 2 : 1) && "Every entry of the key should be found.");
+    }
+
+    // Close index file
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+
+    // Destroy Index
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    const string indexFileName = "age_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    remove("age_idx");
+
+    RC result = testCase_17(indexFileName, attrAge);
+    if (result == success) {
+        cerr << "***** IX Test Case 17 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 17 failed. *****" << endl;
+        return fail;
+    }
+}
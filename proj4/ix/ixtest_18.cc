@@ -0,0 +1,166 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const unsigned keyLength = 50;
+
+// Zero padded, so the keys sort like the numbers
+void prepareKey(unsigned i, char *key)
+{
+    char text[keyLength + 1];
+    snprintf(text, sizeof(text), "%050u", i);
+    int32_t len = keyLength;
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+    memcpy(key + VARCHAR_LENGTH_SIZE, text, keyLength);
+}
+
+// Looks key i up and checks it is there once, with its rid. Returns the pages read.
+unsigned lookUp(IXFileHandle &ixfileHandle, const Attribute &attribute, unsigned i)
+{
+    char key[PAGE_SIZE];
+    char returnedKey[PAGE_SIZE];
+    RID rid;
+    IX_ScanIterator ix_ScanIterator;
+    prepareKey(i, key);
+
+    unsigned readPageCount, writePageCount, appendPageCount;
+    unsigned readPageCountBefore, writePageCountBefore, appendPageCountBefore;
+    ixfileHandle.collectCounterValues(readPageCountBefore, writePageCountBefore, appendPageCountBefore);
+    RC rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    ixfileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+
+    rc = ix_ScanIterator.getNextEntry(rid, returnedKey);
+    assert(rc == success && "The key should be found.");
+    assert(memcmp(key, returnedKey, VARCHAR_LENGTH_SIZE + keyLength) == 0 && "The key found should be the one looked up.");
+    assert(rid.pageNum == i + 1 && rid.slotNum == i % 7 && "rid is not correct.");
+    rc = ix_ScanIterator.getNextEntry(rid, returnedKey);
+    assert(rc == IX_EOF && "The key should be there once.");
+    ix_ScanIterator.close();
+
+    return readPageCount - readPageCountBefore;
+}
+
+int testCase_18(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File twice
+    // 3. Insert entries, splitting nodes at every level
+    // 4. Scan for single keys - the upper levels come from the handle, only the leaf is read **
+    // 5. Insert entries through the other handle, splitting the nodes the first one has copies of
+    // 6. Scan for single keys through the first handle - it sees the new nodes **
+    // 7. Delete entries through the first handle, and scan through the other
+    // 8. Close Index File
+    // 9. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cerr << endl << "***** In IX Test Case 18 *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    IXFileHandle otherHandle;
+    char key[PAGE_SIZE];
+    RID rid;
+    const unsigned numOfTuples = 20000;
+
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, otherHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // The even keys in a scattered order. With keys this long, the tree gets three levels.
+    for (unsigned j = 0; j < numOfTuples / 2; j++)
+    {
+        unsigned i = (j * 7919) % (numOfTuples / 2) * 2;
+        prepareKey(i, key);
+        rid.pageNum = i + 1;
+        rid.slotNum = i % 7;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    // Once the handle has the upper levels, a lookup only reads the leaf
+    for (unsigned i = 0; i < numOfTuples; i += 2)
+        lookUp(ixfileHandle, attribute, i);
+    for (unsigned i = 0; i < numOfTuples; i += 2)
+        assert(lookUp(ixfileHandle, attribute, i) == 1 && "A lookup should only read the leaf.");
+
+    // The odd keys through the other handle split the nodes the first one has copies of
+    for (unsigned j = 0; j < numOfTuples / 2; j++)
+    {
+        unsigned i = (j * 7919) % (numOfTuples / 2) * 2 + 1;
+        prepareKey(i, key);
+        rid.pageNum = i + 1;
+        rid.slotNum = i % 7;
+        rc = indexManager->insertEntry(otherHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    for (unsigned i = 0; i < numOfTuples; i++)
+        lookUp(ixfileHandle, attribute, i);
+
+    // Deletes through the first handle are seen by the other
+    for (unsigned i = 0; i < numOfTuples; i += 3)
+    {
+        prepareKey(i, key);
+        rid.pageNum = i + 1;
+        rid.slotNum = i % 7;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    IX_ScanIterator ix_ScanIterator;
+    rc = indexManager->scan(otherHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    unsigned count = 0;
+    unsigned expected = 1;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        assert(rid.pageNum == expected + 1 && "Keys should come out in order, without the deleted ones.");
+        count++;
+        expected++;
+        if (expected % 3 == 0)
+            expected++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples - (numOfTuples + 2) / 3 && "scan count is not correct.");
+
+    rc = indexManager->closeFile(otherHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    const string indexFileName = "name_idx";
+    Attribute attrName;
+    attrName.length = keyLength;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    remove("name_idx");
+
+    RC result = testCase_18(indexFileName, attrName);
+    if (result == success) {
+        cerr << "***** IX Test Case 18 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 18 failed. *****" << endl;
+        return fail;
+    }
+}
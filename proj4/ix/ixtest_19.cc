@@ -0,0 +1,173 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Keys of different lengths that still sort like the numbers
+void prepareKey(int i, char *key)
+{
+    char text[64];
+    int32_t len = snprintf(text, sizeof(text), "%06d", i);
+    memset(text + len, 'x', i % 37);
+    len += i % 37;
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+    memcpy(key + VARCHAR_LENGTH_SIZE, text, len);
+}
+
+// Scans every entry and checks they are the keys i with i % step == 0, in order
+void checkEntries(IXFileHandle &ixfileHandle, const Attribute &attribute, int numOfTuples, int step)
+{
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    char key[PAGE_SIZE];
+    char expected[PAGE_SIZE];
+    RC rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int i = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        assert(i < numOfTuples && "There are more entries than were left.");
+        prepareKey(i, expected);
+        assert(memcmp(key, expected, VARCHAR_LENGTH_SIZE + *(int32_t*)expected) == 0 && "Entries should come out in order.");
+        assert(rid.pageNum == (unsigned) i + 1 && "rid is not correct.");
+        i += step;
+    }
+    assert(i >= numOfTuples && "Entries are missing.");
+    ix_ScanIterator.close();
+}
+
+int testCase_19(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries
+    // 4. Delete most of them - leaves and internal nodes are merged or take entries from a sibling **
+    // 5. Get Statistics **
+    // 6. Compact **
+    // 7. Delete each entry as a scan returns it - the scan goes on past the merges **
+    // 8. Close Index File
+    // 9. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cerr << endl << "***** In IX Test Case 19 *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    IndexStatistics full, deleted, compacted;
+    char key[PAGE_SIZE];
+    RID rid;
+    const int numOfTuples = 20000;
+
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    for (int j = 0; j < numOfTuples; j++)
+    {
+        int i = (j * 7919) % numOfTuples;
+        prepareKey(i, key);
+        rid.pageNum = i + 1;
+        rid.slotNum = 0;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    rc = indexManager->getStatistics(ixfileHandle, full);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    assert(full.entries == (unsigned) numOfTuples && "Every entry should be counted.");
+    assert(full.height >= 3 && "The tree should have more than one level of internal nodes.");
+
+    // Nine in ten go, in a scattered order
+    for (int j = 0; j < numOfTuples; j++)
+    {
+        int i = (j * 7919) % numOfTuples;
+        if (i % 10 == 0)
+            continue;
+        prepareKey(i, key);
+        rid.pageNum = i + 1;
+        rid.slotNum = 0;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    rc = indexManager->getStatistics(ixfileHandle, deleted);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    indexManager->printStatistics(ixfileHandle);
+    assert(deleted.entries == (unsigned) numOfTuples / 10 && "Every entry left should be counted.");
+    assert(deleted.leafPages <= full.leafPages / 4 && "Leaves should have been merged.");
+    assert(deleted.freePages > 0 && "Merged pages should be free.");
+    assert(deleted.leafFill >= IX_MIN_FILL_FACTOR && "Leaves should be kept from going nearly empty.");
+    checkEntries(ixfileHandle, attribute, numOfTuples, 10);
+
+    // Packed full, in the lowest pages of the file; every other page is free
+    unsigned numberOfPages = ixfileHandle.getNumberOfPages();
+    rc = indexManager->compact(ixfileHandle, attribute, 1);
+    assert(rc == success && "indexManager::compact() should not fail.");
+    rc = indexManager->getStatistics(ixfileHandle, compacted);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    indexManager->printStatistics(ixfileHandle);
+    assert(ixfileHandle.getNumberOfPages() == numberOfPages && "Compact should not grow the file.");
+    assert(compacted.entries == deleted.entries && "Compact should keep every entry.");
+    assert(compacted.fragmentation == 0 && "Compacted leaves should be full.");
+    assert(compacted.leafPages < deleted.leafPages && "Compact should need fewer leaves.");
+    assert(compacted.internalPages + compacted.leafPages + compacted.freePages + 1 == numberOfPages && "Every page should be in the tree or free.");
+    checkEntries(ixfileHandle, attribute, numOfTuples, 10);
+
+    // Every entry, deleted as the scan returns it. The leaves behind the scan are merged into
+    // the ones ahead of it, and it should still return each entry once.
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0;
+    unsigned last = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        assert(rid.pageNum > last && "Entries should come out once, in order.");
+        last = rid.pageNum;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples / 10 && "The scan should return every entry.");
+
+    // Back to the root over one leaf
+    rc = indexManager->getStatistics(ixfileHandle, deleted);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    assert(deleted.entries == 0 && deleted.height == 2 && deleted.leafPages == 1 && "The tree should be down to one leaf.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    const string indexFileName = "name_idx";
+    Attribute attrName;
+    attrName.length = 50;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    remove("name_idx");
+
+    RC result = testCase_19(indexFileName, attrName);
+    if (result == success) {
+        cerr << "***** IX Test Case 19 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 19 failed. *****" << endl;
+        return fail;
+    }
+}
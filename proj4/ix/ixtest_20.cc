@@ -0,0 +1,202 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numOfKeys = 6000;
+const int ridsPerKey = 3;
+
+// Long keys that mostly differ in their last characters. Every fifth one is from another
+// site, so some leaves hold keys with little in common.
+void prepareKey(int i, char *key)
+{
+    char text[PAGE_SIZE];
+    int32_t len;
+    if (i % 5 == 0)
+        len = snprintf(text, sizeof(text), "https://mirror.example.org/pub/%08d", i);
+    else
+        len = snprintf(text, sizeof(text), "https://www.example.com/catalog/products/item%08d", i);
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+    memcpy(key + VARCHAR_LENGTH_SIZE, text, len);
+}
+
+// Key i in scan order: the mirror keys come before the others
+int keyInOrder(int j)
+{
+    const int mirrorKeys = (numOfKeys + 4) / 5;
+    if (j < mirrorKeys)
+        return j * 5;
+    j -= mirrorKeys;
+    return j / 4 * 5 + j % 4 + 1;
+}
+
+bool isDeleted(int i, int k)
+{
+    return i % 4 == 0 || k == 1;
+}
+
+// Scans from key low to key high (in scan order), and checks every entry is there once, in
+// order, with the whole key. Returns the entries.
+int checkEntries(IXFileHandle &ixfileHandle, const Attribute &attribute, int low, int high, bool deleted)
+{
+    IX_ScanIterator ix_ScanIterator;
+    char lowKey[PAGE_SIZE];
+    char highKey[PAGE_SIZE];
+    char key[PAGE_SIZE];
+    char expected[PAGE_SIZE];
+    RID rid;
+    prepareKey(keyInOrder(low), lowKey);
+    prepareKey(keyInOrder(high), highKey);
+    RC rc = indexManager->scan(ixfileHandle, attribute, lowKey, highKey, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+
+    int count = 0;
+    for (int j = low; j <= high; j++)
+    {
+        int i = keyInOrder(j);
+        prepareKey(i, expected);
+        for (int k = 0; k < ridsPerKey; k++)
+        {
+            if (deleted && isDeleted(i, k))
+                continue;
+            rc = ix_ScanIterator.getNextEntry(rid, key);
+            assert(rc == success && "Entries are missing.");
+            assert(memcmp(key, expected, VARCHAR_LENGTH_SIZE + *(int32_t*)expected) == 0 && "Keys should come out whole and in order.");
+            assert(rid.pageNum == (unsigned) i + 1 && rid.slotNum == (unsigned) k && "rid is not correct.");
+            count++;
+        }
+    }
+    assert(ix_ScanIterator.getNextEntry(rid, key) == IX_EOF && "There are more entries than there should be.");
+    ix_ScanIterator.close();
+    return count;
+}
+
+int testCase_20(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert keys with long common prefixes, each with several rids - leaves keep the prefix once **
+    // 4. Scan the whole index and ranges in it - keys come out whole **
+    // 5. Delete entries
+    // 6. Compact
+    // 7. Close Index File
+    // 8. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cerr << endl << "***** In IX Test Case 20 *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    IndexStatistics statistics;
+    char key[PAGE_SIZE];
+    RID rid;
+
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // What the entries would take with every key stored whole
+    unsigned uncompressed = 0;
+    for (int k = 0; k < ridsPerKey; k++)
+    {
+        for (int j = 0; j < numOfKeys; j++)
+        {
+            int i = (j * 1997) % numOfKeys;
+            prepareKey(i, key);
+            rid.pageNum = i + 1;
+            rid.slotNum = k;
+            rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+            assert(rc == success && "indexManager::insertEntry() should not fail.");
+            uncompressed += sizeof(DataEntry) + VARCHAR_LENGTH_SIZE + *(int32_t*)key;
+        }
+    }
+
+    rc = indexManager->getStatistics(ixfileHandle, statistics);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    indexManager->printStatistics(ixfileHandle);
+    assert(statistics.entries == (unsigned) numOfKeys * ridsPerKey && "Every entry should be counted.");
+    assert(statistics.leafPages * PAGE_SIZE < uncompressed / 2 && "Leaves should take less than half the space of the whole keys.");
+
+    assert(checkEntries(ixfileHandle, attribute, 0, numOfKeys - 1, false) == numOfKeys * ridsPerKey);
+    // Ranges that start and end inside leaves, one across the change of site
+    assert(checkEntries(ixfileHandle, attribute, 1000, 1999, false) == 1000 * ridsPerKey);
+    assert(checkEntries(ixfileHandle, attribute, 1150, 1250, false) == 101 * ridsPerKey);
+
+    // Keys before every key, between keys and after every key find nothing
+    const char *missing[] = { "a", "https://www.example.com/catalog/products/item", "https://www.example.com/catalog/products/item00000001x", "zzz" };
+    for (int m = 0; m < 4; m++)
+    {
+        int32_t len = strlen(missing[m]);
+        memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+        memcpy(key + VARCHAR_LENGTH_SIZE, missing[m], len);
+        IX_ScanIterator ix_ScanIterator;
+        rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+        assert(rc == success && "indexManager::scan() should not fail.");
+        assert(ix_ScanIterator.getNextEntry(rid, key) == IX_EOF && "A key that was not inserted should not be found.");
+        ix_ScanIterator.close();
+    }
+
+    // One rid of every key, and every fourth key altogether
+    for (int j = 0; j < numOfKeys; j++)
+    {
+        int i = (j * 1997) % numOfKeys;
+        prepareKey(i, key);
+        for (int k = 0; k < ridsPerKey; k++)
+        {
+            if (!isDeleted(i, k))
+                continue;
+            rid.pageNum = i + 1;
+            rid.slotNum = k;
+            rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        }
+    }
+    int left = checkEntries(ixfileHandle, attribute, 0, numOfKeys - 1, true);
+    assert(left == numOfKeys / 4 * 3 * (ridsPerKey - 1) && "Deleted entries should be gone.");
+
+    rc = indexManager->compact(ixfileHandle, attribute, 1);
+    assert(rc == success && "indexManager::compact() should not fail.");
+    rc = indexManager->getStatistics(ixfileHandle, statistics);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    indexManager->printStatistics(ixfileHandle);
+    assert(statistics.entries == (unsigned) left && "Compact should keep every entry.");
+    assert(checkEntries(ixfileHandle, attribute, 0, numOfKeys - 1, true) == left);
+    assert(checkEntries(ixfileHandle, attribute, 1150, 1250, true) > 0);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    const string indexFileName = "url_idx";
+    Attribute attrUrl;
+    attrUrl.length = 100;
+    attrUrl.name = "url";
+    attrUrl.type = TypeVarChar;
+
+    remove("url_idx");
+
+    RC result = testCase_20(indexFileName, attrUrl);
+    if (result == success) {
+        cerr << "***** IX Test Case 20 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 20 failed. *****" << endl;
+        return fail;
+    }
+}
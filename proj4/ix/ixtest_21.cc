@@ -0,0 +1,217 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numOfTuples = 60000;
+const int slotsPerPage = 50;
+
+// A status column: three values shared by most records, and one only a few have
+int statusOf(int i)
+{
+    if (i % 1000 == 0)
+        return 5;
+    return i % 3;
+}
+
+RID ridOf(int i)
+{
+    RID rid;
+    rid.pageNum = i / slotsPerPage + 1;
+    rid.slotNum = i % slotsPerPage;
+    return rid;
+}
+
+bool isDeleted(int i)
+{
+    // Status 2 goes altogether, and every other record of status 0
+    return statusOf(i) == 2 || (statusOf(i) == 0 && ridOf(i).slotNum % 2 == 0);
+}
+
+// Scans the entries with the given status and checks they are the records that have it,
+// in rid order. Returns how many there are.
+int checkStatus(IXFileHandle &ixfileHandle, const Attribute &attribute, int status, bool deleted)
+{
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    int key;
+    RC rc = indexManager->scan(ixfileHandle, attribute, &status, &status, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+
+    int count = 0;
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        if (statusOf(i) != status || (deleted && isDeleted(i)))
+            continue;
+        rc = ix_ScanIterator.getNextEntry(rid, &key);
+        assert(rc == success && "Entries are missing.");
+        assert(key == status && "The key is not correct.");
+        assert(rid.pageNum == ridOf(i).pageNum && rid.slotNum == ridOf(i).slotNum && "The rids of a key should come out in order.");
+        count++;
+    }
+    assert(ix_ScanIterator.getNextEntry(rid, &key) == IX_EOF && "There are more entries than there should be.");
+    ix_ScanIterator.close();
+    return count;
+}
+
+int testCase_21(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries with a few keys - each key is stored once with its rids **
+    // 4. Scan each key - the rids come out in order, from the leaf or from overflow pages **
+    // 5. Delete every entry of a key, and half of another's as a scan returns them **
+    // 6. Compact
+    // 7. Close Index File
+    // 8. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cerr << endl << "***** In IX Test Case 21 *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    IndexStatistics inserted, deleted, compacted;
+    RID rid;
+    int key;
+
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // In a scattered order, so rids go into the middle of overflow pages as well as at the end
+    for (int j = 0; j < numOfTuples; j++)
+    {
+        int i = (int) (((long long) j * 7919) % numOfTuples);
+        key = statusOf(i);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, &key, ridOf(i));
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    // One slot per entry would take this many pages
+    unsigned slotPages = numOfTuples * (sizeof(int32_t) + sizeof(RID)) / PAGE_SIZE;
+    rc = indexManager->getStatistics(ixfileHandle, inserted);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    indexManager->printStatistics(ixfileHandle);
+    assert(inserted.entries == (unsigned) numOfTuples && "Every entry should be counted.");
+    assert(inserted.leafPages == 1 && "Four keys should fit in one leaf.");
+    assert(inserted.overflowPages > 0 && "The rids of the common keys should be on overflow pages.");
+    assert((inserted.leafPages + inserted.overflowPages) * 2 < slotPages && "Posting lists should take less than half the space.");
+
+    int counts[6];
+    for (int status = 0; status < 6; status++)
+        counts[status] = checkStatus(ixfileHandle, attribute, status, false);
+    assert(counts[5] == numOfTuples / 1000 && counts[3] == 0 && counts[4] == 0);
+
+    // Every entry, keys in order and the rids of each key in order
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0;
+    int lastKey = -1;
+    RID lastRid = {0, 0};
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+    {
+        assert(key >= lastKey && "Keys should come out in order.");
+        assert((key > lastKey || rid.pageNum > lastRid.pageNum || (rid.pageNum == lastRid.pageNum && rid.slotNum > lastRid.slotNum)) && "rids should come out in order.");
+        lastKey = key;
+        lastRid = rid;
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples && "The scan should return every entry.");
+
+    // Status 2 goes altogether, which frees its overflow pages
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        if (statusOf(i) != 2)
+            continue;
+        key = 2;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, ridOf(i));
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    key = 2;
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, ridOf(2));
+    assert(rc != success && "An entry should not be deleted twice.");
+
+    // Every other entry of status 0, as a scan returns them. Pages it frees move the version
+    // on, and the scan should still return each entry once.
+    key = 0;
+    rc = indexManager->scan(ixfileHandle, attribute, &key, &key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    lastRid.pageNum = 0;
+    lastRid.slotNum = 0;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+    {
+        assert((rid.pageNum > lastRid.pageNum || (rid.pageNum == lastRid.pageNum && rid.slotNum > lastRid.slotNum)) && "Entries should come out once, in order.");
+        lastRid = rid;
+        count++;
+        if (rid.slotNum % 2 == 0)
+        {
+            rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        }
+    }
+    ix_ScanIterator.close();
+    assert(count == counts[0] && "The scan should return every entry.");
+
+    rc = indexManager->getStatistics(ixfileHandle, deleted);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    indexManager->printStatistics(ixfileHandle);
+    int left = 0;
+    for (int status = 0; status < 6; status++)
+        left += checkStatus(ixfileHandle, attribute, status, true);
+    assert(deleted.entries == (unsigned) left && "Every entry left should be counted.");
+    assert(checkStatus(ixfileHandle, attribute, 2, true) == 0 && "A key with no entries left should be gone.");
+    assert(deleted.freePages > inserted.freePages && "Emptied overflow pages should be free.");
+    assert(deleted.overflowPages < inserted.overflowPages && "Emptied overflow pages should leave their chains.");
+
+    // Packed full
+    rc = indexManager->compact(ixfileHandle, attribute, 1);
+    assert(rc == success && "indexManager::compact() should not fail.");
+    rc = indexManager->getStatistics(ixfileHandle, compacted);
+    assert(rc == success && "indexManager::getStatistics() should not fail.");
+    indexManager->printStatistics(ixfileHandle);
+    assert(compacted.entries == deleted.entries && "Compact should keep every entry.");
+    assert(compacted.overflowPages < deleted.overflowPages && "Compact should fill overflow pages.");
+    assert((compacted.leafPages + compacted.overflowPages) * 5 < slotPages && "Compacted posting lists should take less than a fifth of the space.");
+    for (int status = 0; status < 6; status++)
+        checkStatus(ixfileHandle, attribute, status, true);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    const string indexFileName = "status_idx";
+    Attribute attrStatus;
+    attrStatus.length = 4;
+    attrStatus.name = "status";
+    attrStatus.type = TypeInt;
+
+    remove("status_idx");
+
+    RC result = testCase_21(indexFileName, attrStatus);
+    if (result == success) {
+        cerr << "***** IX Test Case 21 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 21 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,274 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <climits>
+#include <algorithm>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Orders by (customer_id, order_date, amount), and every key has ridsPerKey entries.
+// Customers from -3000 to 3000 in steps of 30, and the smallest and largest ints.
+const int numOfCustomers = 203;
+// Dates that are prefixes of each other, and one with a 0 byte in it
+const string dates[] = { "2024-01-05", "2024-01", "2023-12-31", string("2024\0x", 6), "2024-1", "", "2024-01-05z" };
+const int numOfDates = sizeof(dates) / sizeof(dates[0]);
+const float amounts[] = { -100.0f, -1.5f, 0.0f, 2.25f, 1e9f };
+const int numOfAmounts = sizeof(amounts) / sizeof(amounts[0]);
+const int ridsPerKey = 2;
+
+int customerOf(int c)
+{
+    if (c == 0)
+        return INT_MIN;
+    if (c == numOfCustomers - 1)
+        return INT_MAX;
+    return (c - 101) * 30;
+}
+
+typedef struct Row
+{
+    int customer;
+    string date;
+    float amount;
+    RID rid;
+} Row;
+
+// Lexicographic, one attribute after the other, then by rid
+bool rowLess(const Row &first, const Row &second)
+{
+    if (first.customer != second.customer)
+        return first.customer < second.customer;
+    if (first.date != second.date)
+        return first.date < second.date;
+    if (first.amount != second.amount)
+        return first.amount < second.amount;
+    if (first.rid.pageNum != second.rid.pageNum)
+        return first.rid.pageNum < second.rid.pageNum;
+    return first.rid.slotNum < second.rid.slotNum;
+}
+
+// Writes the values of the first count attributes of row, one after the other
+void prepareKey(const Row &row, int count, char *key)
+{
+    int offset = 0;
+    memcpy(key, &row.customer, sizeof(int));
+    offset += sizeof(int);
+    if (count < 2)
+        return;
+    int32_t len = row.date.length();
+    memcpy(key + offset, &len, VARCHAR_LENGTH_SIZE);
+    memcpy(key + offset + VARCHAR_LENGTH_SIZE, row.date.data(), len);
+    offset += VARCHAR_LENGTH_SIZE + len;
+    if (count < 3)
+        return;
+    memcpy(key + offset, &row.amount, sizeof(float));
+}
+
+void readKey(const char *key, Row &row)
+{
+    memcpy(&row.customer, key, sizeof(int));
+    int32_t len;
+    memcpy(&len, key + sizeof(int), VARCHAR_LENGTH_SIZE);
+    row.date.assign(key + sizeof(int) + VARCHAR_LENGTH_SIZE, len);
+    memcpy(&row.amount, key + sizeof(int) + VARCHAR_LENGTH_SIZE + len, sizeof(float));
+}
+
+// Scans from low to high, and checks the entries are the rows from first to last in order
+void checkScan(IXFileHandle &ixfileHandle, const IX_KeySchema &schema, const vector<Row> &rows,
+        const Row *low, int lowCount, bool lowInclusive, const Row *high, int highCount, bool highInclusive, int first, int last)
+{
+    IX_ScanIterator ix_ScanIterator;
+    char lowKey[PAGE_SIZE];
+    char highKey[PAGE_SIZE];
+    char key[PAGE_SIZE];
+    RID rid;
+    if (low != NULL)
+        prepareKey(*low, lowCount, lowKey);
+    if (high != NULL)
+        prepareKey(*high, highCount, highKey);
+    RC rc = indexManager->scan(ixfileHandle, schema, low == NULL ? NULL : lowKey, lowCount,
+            high == NULL ? NULL : highKey, highCount, lowInclusive, highInclusive, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+
+    for (int i = first; i < last; i++)
+    {
+        rc = ix_ScanIterator.getNextEntry(rid, key);
+        assert(rc == success && "Entries are missing.");
+        Row returned;
+        readKey(key, returned);
+        assert(returned.customer == rows[i].customer && returned.date == rows[i].date && returned.amount == rows[i].amount && "Keys should come out whole and in order.");
+        assert(rid.pageNum == rows[i].rid.pageNum && rid.slotNum == rows[i].rid.slotNum && "rid is not correct.");
+    }
+    assert(ix_ScanIterator.getNextEntry(rid, key) == IX_EOF && "There are more entries than there should be.");
+    ix_ScanIterator.close();
+}
+
+// The first row not before row in the first count attributes, or after it if after is set
+int findRow(const vector<Row> &rows, const Row &row, int count, bool after)
+{
+    for (unsigned i = 0; i < rows.size(); i++)
+    {
+        int cmp = rows[i].customer < row.customer ? -1 : rows[i].customer > row.customer;
+        if (cmp == 0 && count > 1)
+            cmp = rows[i].date.compare(row.date) < 0 ? -1 : rows[i].date.compare(row.date) > 0;
+        if (cmp == 0 && count > 2)
+            cmp = rows[i].amount < row.amount ? -1 : rows[i].amount > row.amount;
+        if (cmp > 0 || (cmp == 0 && !after))
+            return i;
+    }
+    return rows.size();
+}
+
+int testCase_22(const string &indexFileName, const vector<Attribute> &attributes)
+{
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries with composite keys of an int, a varchar and a real **
+    // 4. Scan the whole index - keys come out in order of each attribute in turn **
+    // 5. Scan ranges with bounds on the first attributes only, inclusive and exclusive **
+    // 6. Delete entries with composite keys **
+    // 7. Close Index File
+    // 8. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cerr << endl << "***** In IX Test Case 22 *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    IX_KeySchema schema(attributes);
+    char key[PAGE_SIZE];
+
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    vector<Row> rows;
+    for (int c = 0; c < numOfCustomers; c++)
+        for (int d = 0; d < numOfDates; d++)
+            for (int a = 0; a < numOfAmounts; a++)
+                for (int k = 0; k < ridsPerKey; k++)
+                {
+                    Row row = { customerOf(c), dates[d], amounts[a], { 0, 0 } };
+                    row.rid.pageNum = rows.size() / 10 + 1;
+                    row.rid.slotNum = rows.size() % 10;
+                    rows.push_back(row);
+                }
+
+    // In a scattered order
+    for (unsigned j = 0; j < rows.size(); j++)
+    {
+        const Row &row = rows[(j * 2311) % rows.size()];
+        prepareKey(row, 3, key);
+        rc = indexManager->insertEntry(ixfileHandle, schema, key, row.rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    sort(rows.begin(), rows.end(), rowLess);
+
+    // Everything, and each whole key
+    checkScan(ixfileHandle, schema, rows, NULL, 0, true, NULL, 0, true, 0, rows.size());
+    for (unsigned i = 0; i < rows.size(); i += ridsPerKey * 7)
+        checkScan(ixfileHandle, schema, rows, &rows[i], 3, true, &rows[i], 3, true, i, i + ridsPerKey);
+
+    // -0.0 is the same amount as 0.0
+    Row zero = { 60, "2024-01", -0.0f, { 0, 0 } };
+    checkScan(ixfileHandle, schema, rows, &zero, 3, true, &zero, 3, true, findRow(rows, zero, 3, false), findRow(rows, zero, 3, true));
+
+    // Every order of a customer, and of a customer on a date. A date that is the start of
+    // another takes in none of the other's orders.
+    for (int c = 0; c < numOfCustomers; c++)
+    {
+        Row customer = { customerOf(c), "", 0, { 0, 0 } };
+        int first = findRow(rows, customer, 1, false);
+        int last = findRow(rows, customer, 1, true);
+        assert(last - first == numOfDates * numOfAmounts * ridsPerKey);
+        checkScan(ixfileHandle, schema, rows, &customer, 1, true, &customer, 1, true, first, last);
+        for (int d = 0; d < numOfDates; d++)
+        {
+            customer.date = dates[d];
+            first = findRow(rows, customer, 2, false);
+            last = findRow(rows, customer, 2, true);
+            assert(last - first == numOfAmounts * ridsPerKey);
+            checkScan(ixfileHandle, schema, rows, &customer, 2, true, &customer, 2, true, first, last);
+        }
+    }
+
+    // Customers between two others, either left out or taken in. Nothing comes after INT_MAX.
+    Row low = { -90, "", 0, { 0, 0 } };
+    Row high = { 210, "", 0, { 0, 0 } };
+    Row max = { INT_MAX, "", 0, { 0, 0 } };
+    checkScan(ixfileHandle, schema, rows, &low, 1, false, &high, 1, false, findRow(rows, low, 1, true), findRow(rows, high, 1, false));
+    checkScan(ixfileHandle, schema, rows, &low, 1, true, &high, 1, true, findRow(rows, low, 1, false), findRow(rows, high, 1, true));
+    checkScan(ixfileHandle, schema, rows, &low, 1, false, NULL, 0, true, findRow(rows, low, 1, true), rows.size());
+    checkScan(ixfileHandle, schema, rows, &max, 1, false, NULL, 0, true, rows.size(), rows.size());
+    checkScan(ixfileHandle, schema, rows, NULL, 0, true, &max, 1, true, 0, rows.size());
+
+    // From a customer's orders on a date to the end of the next customer's, bounds of different lengths
+    low.date = "2024-01";
+    low.amount = 0.0f;
+    high.customer = -60;
+    checkScan(ixfileHandle, schema, rows, &low, 2, true, &high, 1, true, findRow(rows, low, 2, false), findRow(rows, high, 1, true));
+    checkScan(ixfileHandle, schema, rows, &low, 3, false, &high, 1, false, findRow(rows, low, 3, true), findRow(rows, high, 1, false));
+
+    // Every order of customer 0 goes
+    Row deleted = { 0, "", 0, { 0, 0 } };
+    int first = findRow(rows, deleted, 1, false);
+    int last = findRow(rows, deleted, 1, true);
+    for (int i = first; i < last; i++)
+    {
+        prepareKey(rows[i], 3, key);
+        rc = indexManager->deleteEntry(ixfileHandle, schema, key, rows[i].rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    prepareKey(rows[first], 3, key);
+    rc = indexManager->deleteEntry(ixfileHandle, schema, key, rows[first].rid);
+    assert(rc != success && "An entry should not be deleted twice.");
+    rows.erase(rows.begin() + first, rows.begin() + last);
+    checkScan(ixfileHandle, schema, rows, &deleted, 1, true, &deleted, 1, true, first, first);
+    checkScan(ixfileHandle, schema, rows, NULL, 0, true, NULL, 0, true, 0, rows.size());
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    const string indexFileName = "orders_idx";
+    vector<Attribute> attributes;
+    Attribute attr;
+    attr.length = 4;
+    attr.name = "customer_id";
+    attr.type = TypeInt;
+    attributes.push_back(attr);
+    attr.length = 20;
+    attr.name = "order_date";
+    attr.type = TypeVarChar;
+    attributes.push_back(attr);
+    attr.length = 4;
+    attr.name = "amount";
+    attr.type = TypeReal;
+    attributes.push_back(attr);
+
+    remove("orders_idx");
+
+    RC result = testCase_22(indexFileName, attributes);
+    if (result == success) {
+        cerr << "***** IX Test Case 22 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 22 failed. *****" << endl;
+        return fail;
+    }
+}
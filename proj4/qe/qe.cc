@@ -1,8 +1,381 @@
 
 #include "qe.h"
+#include "../rbf/predicate.h"
 #include <cstring>
 #include <math.h>
 #include <iostream>
+#include <atomic>
+#include <unistd.h>
+
+// --------------------------------Tuple helpers------------------------
+// Tuples use the api format: a null indicator followed by the non-null fields.
+
+static unsigned getNullIndicatorSize(const vector<Attribute> &attrs)
+{
+  return ceil(attrs.size() / 8.0);
+}
+
+static bool isFieldNull(const void *data, unsigned i)
+{
+  return *((const char*)data + i/8) & (1 << (7 - i%8));
+}
+
+static unsigned getFieldSize(AttrType type, const void *field)
+{
+  if (type == TypeVarChar) {
+    uint32_t length;
+    memcpy(&length, field, VARCHAR_LENGTH_SIZE);
+    return VARCHAR_LENGTH_SIZE + length;
+  }
+  return INT_SIZE;
+}
+
+// Returns the position of the attribute called name, or attrs.size() if there is none
+static unsigned getAttributeIndex(const vector<Attribute> &attrs, const string &name)
+{
+  unsigned i;
+  for (i = 0; i < attrs.size(); ++i)
+    if (attrs[i].name == name)
+      break;
+  return i;
+}
+
+// Points field at the index-th field of the tuple. Returns false if the field is null.
+static bool getField(const vector<Attribute> &attrs, unsigned index, const void *data, const char *&field)
+{
+  if (index >= attrs.size() || isFieldNull(data, index))
+    return false;
+  const char *p = (const char*)data + getNullIndicatorSize(attrs);
+  for (unsigned i = 0; i < index; ++i)
+    if (!isFieldNull(data, i))
+      p += getFieldSize(attrs[i].type, p);
+  field = p;
+  return true;
+}
+
+static unsigned getTupleSize(const vector<Attribute> &attrs, const void *data)
+{
+  unsigned size = getNullIndicatorSize(attrs);
+  for (unsigned i = 0; i < attrs.size(); ++i)
+    if (!isFieldNull(data, i))
+      size += getFieldSize(attrs[i].type, (const char*)data + size);
+  return size;
+}
+
+// Concatenates a left and a right tuple into data
+static void joinTuples(const vector<Attribute> &leftAttrs, const void *left,
+                       const vector<Attribute> &rightAttrs, const void *right, void *data)
+{
+  unsigned leftNullSize  = getNullIndicatorSize(leftAttrs);
+  unsigned rightNullSize = getNullIndicatorSize(rightAttrs);
+  unsigned nullSize = ceil((leftAttrs.size() + rightAttrs.size()) / 8.0);
+
+  memset(data, 0, nullSize);
+  memcpy(data, left, leftNullSize);
+  for (size_t i = 0; i < rightAttrs.size(); ++i) {
+    size_t j = i + leftAttrs.size();
+    if (isFieldNull(right, i))
+      *((char*)data + j/8) |= (1 << (7 - j%8));
+    else
+      *((char*)data + j/8) &= ~(1 << (7 - j%8));
+  }
+
+  unsigned leftSize  = getTupleSize(leftAttrs, left) - leftNullSize;
+  unsigned rightSize = getTupleSize(rightAttrs, right) - rightNullSize;
+  memcpy((char*)data + nullSize, (const char*)left + leftNullSize, leftSize);
+  memcpy((char*)data + nullSize + leftSize, (const char*)right + rightNullSize, rightSize);
+}
+
+static int compareField(AttrType type, const void *a, const void *b)
+{
+  if (type == TypeInt) {
+    int32_t x, y;
+    memcpy(&x, a, INT_SIZE);
+    memcpy(&y, b, INT_SIZE);
+    return (x > y) - (x < y);
+  }
+  if (type == TypeReal) {
+    float x, y;
+    memcpy(&x, a, REAL_SIZE);
+    memcpy(&y, b, REAL_SIZE);
+    return (x > y) - (x < y);
+  }
+  uint32_t x, y;
+  memcpy(&x, a, VARCHAR_LENGTH_SIZE);
+  memcpy(&y, b, VARCHAR_LENGTH_SIZE);
+  int cmp = memcmp((const char*)a + VARCHAR_LENGTH_SIZE, (const char*)b + VARCHAR_LENGTH_SIZE, min(x, y));
+  if (cmp == 0)
+    return (x > y) - (x < y);
+  return cmp;
+}
+
+static bool checkCompOp(int cmp, CompOp op)
+{
+  switch (op)
+  {
+    case EQ_OP: return cmp == 0;
+    case LT_OP: return cmp <  0;
+    case GT_OP: return cmp >  0;
+    case LE_OP: return cmp <= 0;
+    case GE_OP: return cmp >= 0;
+    case NE_OP: return cmp != 0;
+    case NO_OP: return true;
+    // Should never happen
+    default: return false;
+  }
+}
+
+// Key of a field value in the join hash tables. Equal values give equal keys.
+static string getHashKey(AttrType type, const void *field)
+{
+  if (type == TypeReal) {
+    float value;
+    memcpy(&value, field, REAL_SIZE);
+    // 0.0 and -0.0 compare equal
+    if (value == 0)
+      value = 0;
+    return string((const char*)&value, REAL_SIZE);
+  }
+  return string((const char*)field, getFieldSize(type, field));
+}
+
+// Partition of a hash key. This is FNV-1a rather than the hash of unordered_map,
+// so the tuples of one partition still spread over the in-memory hash table.
+// Repartitioning a partition needs a different seed to split it up.
+static unsigned getPartition(const string &key, unsigned numPartitions, unsigned seed = 0)
+{
+  uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 16777619u;
+  }
+  return hash % numPartitions;
+}
+
+static vector<string> getAttributeNames(const vector<Attribute> &attrs)
+{
+  vector<string> names;
+  for (auto &attr : attrs)
+    names.push_back(attr.name);
+  return names;
+}
+
+// Name for the temporary files of one operator. The pid keeps them apart from those of
+// other processes, and the count from those of other operators in this one.
+static atomic<unsigned> tempFileCount(0);
+
+static string getTempFileName(const string &prefix)
+{
+  return prefix + to_string(getpid()) + "_" + to_string(tempFileCount++);
+}
+
+// --------------------------------TupleBatch----------------------------
+const char *ColumnVector::getValue(unsigned row) const
+{
+  if (type == TypeVarChar) {
+    uint32_t offset;
+    memcpy(&offset, values.data() + row * sizeof(uint32_t), sizeof(uint32_t));
+    return heap.data() + offset;
+  }
+  return values.data() + row * INT_SIZE;
+}
+
+TupleBatch::TupleBatch()
+{
+  numRows = 0;
+  selection.assign((QE_BATCH_SIZE + 63) / 64, 0);
+}
+
+void TupleBatch::init(const vector<Attribute> &attrs)
+{
+  bool sameSchema = attrs.size() == this->attrs.size();
+  for (unsigned i = 0; sameSchema && i < attrs.size(); ++i)
+    sameSchema = attrs[i].name == this->attrs[i].name && attrs[i].type == this->attrs[i].type;
+
+  // Keep the columns, and their memory, when the schema does not change
+  if (!sameSchema) {
+    this->attrs = attrs;
+    columns.assign(attrs.size(), ColumnVector());
+    for (unsigned i = 0; i < attrs.size(); ++i)
+      columns[i].type = attrs[i].type;
+  }
+  clear();
+}
+
+void TupleBatch::clear()
+{
+  numRows = 0;
+  for (auto &column : columns) {
+    column.values.clear();
+    column.heap.clear();
+    column.nulls.clear();
+  }
+  selection.assign((QE_BATCH_SIZE + 63) / 64, 0);
+}
+
+unsigned TupleBatch::nextSelected(unsigned row) const
+{
+  while (row < numRows) {
+    uint64_t word = selection[row / 64] >> (row % 64);
+    if (word)
+      return min(row + __builtin_ctzll(word), numRows);
+    row = (row / 64 + 1) * 64;
+  }
+  return numRows;
+}
+
+unsigned TupleBatch::getSelectedCount() const
+{
+  unsigned count = 0;
+  for (auto word : selection)
+    count += __builtin_popcountll(word);
+  return count;
+}
+
+void TupleBatch::appendTuple(const void *data)
+{
+  const char *field = (const char*)data + getNullIndicatorSize(attrs);
+  for (unsigned i = 0; i < columns.size(); ++i) {
+    ColumnVector &column = columns[i];
+    bool null = isFieldNull(data, i);
+    column.nulls.push_back(null);
+
+    size_t end = column.values.size();
+    column.values.resize(end + INT_SIZE);
+    if (column.type == TypeVarChar) {
+      uint32_t offset = column.heap.size();
+      memcpy(column.values.data() + end, &offset, sizeof(uint32_t));
+      if (!null) {
+        unsigned size = getFieldSize(TypeVarChar, field);
+        column.heap.insert(column.heap.end(), field, field + size);
+        field += size;
+      }
+    }
+    else if (null) {
+      memset(column.values.data() + end, 0, INT_SIZE);
+    }
+    else {
+      memcpy(column.values.data() + end, field, INT_SIZE);
+      field += INT_SIZE;
+    }
+  }
+  selection[numRows / 64] |= 1ULL << (numRows % 64);
+  numRows++;
+}
+
+void TupleBatch::getTuple(unsigned row, void *data) const
+{
+  unsigned nullSize = getNullIndicatorSize(attrs);
+  memset(data, 0, nullSize);
+  char *field = (char*)data + nullSize;
+  for (unsigned i = 0; i < columns.size(); ++i) {
+    if (columns[i].nulls[row]) {
+      *((char*)data + i/8) |= (1 << (7 - i%8));
+      continue;
+    }
+    const char *value = columns[i].getValue(row);
+    unsigned size = getFieldSize(columns[i].type, value);
+    memcpy(field, value, size);
+    field += size;
+  }
+}
+
+// --------------------------------Iterator------------------------------
+RC Iterator::getNextBatch(TupleBatch &batch)
+{
+  vector<Attribute> attrs;
+  getAttributes(attrs);
+  batch.init(attrs);
+
+  char data[PAGE_SIZE];
+  while (!batch.isFull() && getNextTuple(data) == SUCCESS)
+    batch.appendTuple(data);
+  return batch.numRows > 0 ? SUCCESS : QE_EOF;
+}
+
+// --------------------------------IndexScan-----------------------------
+IndexScan::IndexScan(RelationManager &rm, const string &tableName, const string &indexName,
+                     const vector<string> &attrNames, const char *alias):rm(rm)
+{
+  this->tableName = alias ? alias : tableName;
+  relName = tableName;
+  attrName = indexName;
+  projected = true;
+  composite = false;
+  covering = true;
+  rm.getAttributes(tableName, tableAttrs);
+
+  // A composite index of that name, or else the index on the attribute
+  vector<CompositeIndex> indexes;
+  rm.getCompositeIndexes(tableName, indexes);
+  for (const CompositeIndex &index : indexes) {
+    if (index.name != indexName)
+      continue;
+    composite = true;
+    for (const IndexedAttr &iattr : index.attrs)
+      keyAttrs.push_back(iattr.attr);
+  }
+  if (!composite) {
+    unsigned i = getAttributeIndex(tableAttrs, indexName);
+    if (i < tableAttrs.size())
+      keyAttrs.push_back(tableAttrs[i]);
+  }
+
+  string prefix = this->tableName + ".";
+  for (string name : attrNames) {
+    if (name.compare(0, prefix.size(), prefix) == 0)
+      name = name.substr(prefix.size());
+    unsigned tableField = getAttributeIndex(tableAttrs, name);
+    if (tableField == tableAttrs.size())
+      continue;
+    unsigned keyField = getAttributeIndex(keyAttrs, name);
+    if (keyField == keyAttrs.size())
+      covering = false;
+    attrs.push_back(tableAttrs[tableField]);
+    tableFields.push_back(tableField);
+    keyFields.push_back(keyField);
+  }
+
+  iter = new RM_IndexScanIterator();
+  if (composite)
+    rm.indexScan(tableName, indexName, NULL, 0, NULL, 0, true, true, *iter);
+  else
+    rm.indexScan(tableName, indexName, NULL, NULL, true, true, *iter);
+}
+
+RC IndexScan::getNextTuple(void *data)
+{
+  RC rc = iter->getNextEntry(rid, key);
+  if (rc)
+    return rc;
+  if (!projected)
+    return rm.readTuple(relName, rid, data);
+
+  // Only an attribute that is not in the key needs the tuple
+  if (!covering && (rc = rm.readTuple(relName, rid, tuple)))
+    return rc;
+
+  unsigned nullSize = getNullIndicatorSize(attrs);
+  memset(data, 0, nullSize);
+  char *out = (char*)data + nullSize;
+  for (unsigned i = 0; i < attrs.size(); ++i) {
+    const char *field;
+    if (covering) {
+      // The key holds the values of its attributes one after the other. Null values
+      // are never indexed.
+      field = key;
+      for (unsigned j = 0; j < keyFields[i]; ++j)
+        field += getFieldSize(keyAttrs[j].type, field);
+    } else if (!getField(tableAttrs, tableFields[i], tuple, field)) {
+      *((char*)data + i/8) |= 1 << (7 - i%8);
+      continue;
+    }
+    unsigned size = getFieldSize(attrs[i].type, field);
+    memcpy(out, field, size);
+    out += size;
+  }
+  return SUCCESS;
+}
 
 // --------------------------------Filter--------------------------------
 Filter::Filter(Iterator* input, const Condition &condition)
@@ -11,6 +384,14 @@ Filter::Filter(Iterator* input, const Condition &condition)
   this->condition = condition;
   attrs.clear();
   input->getAttributes(attrs);
+  value = malloc(PAGE_SIZE);
+  lhsIndex = getAttributeIndex(attrs, condition.lhsAttr);
+  rhsIndex = condition.bRhsIsAttr ? getAttributeIndex(attrs, condition.rhsAttr) : attrs.size();
+}
+
+Filter::~Filter()
+{
+  free(value);
 }
 
 RC Filter::getNextTuple(void* data)
@@ -20,7 +401,14 @@ RC Filter::getNextTuple(void* data)
   while ((rc = iter->getNextTuple(data)) == SUCCESS) {
     if (condition.op == NO_OP)
       break;
-    void* value = malloc(PAGE_SIZE);
+    if (condition.bRhsIsAttr) {
+      // Both fields are in the tuple, and a null on either side fails
+      const char *lhs, *rhs;
+      if (getField(attrs, lhsIndex, data, lhs) && getField(attrs, rhsIndex, data, rhs) &&
+          checkCompOp(compareField(attrs[lhsIndex].type, lhs, rhs), condition.op))
+        break;
+      continue;
+    }
     if (rm->getFieldFromRecord(condition.lhsAttr, attrs, data, value) != SUCCESS)
       continue;
     if (checkScanCondition(condition.rhsValue.type, value, condition.op, condition.rhsValue.data))
@@ -29,6 +417,58 @@ RC Filter::getNextTuple(void* data)
   return rc;
 }
 
+// Deselects the rows whose INT or REAL value fails the comparison with value.
+// The whole column goes through one compare kernel.
+template <typename T>
+static void selectColumn(TupleBatch &batch, const ColumnVector &column, CompOp op, const void *value)
+{
+  T rhs;
+  memcpy(&rhs, value, sizeof(T));
+  uint64_t mask[(QE_BATCH_SIZE + 63) / 64];
+  evaluatePredicate((const T*)column.values.data(), batch.numRows, op, rhs, mask);
+  for (unsigned i = 0; i < (batch.numRows + 63) / 64; ++i)
+    batch.selection[i] &= mask[i];
+  for (unsigned row = 0; row < batch.numRows; ++row)
+    if (column.nulls[row])
+      batch.deselect(row);
+}
+
+RC Filter::getNextBatch(TupleBatch &batch)
+{
+  RC rc = iter->getNextBatch(batch);
+  if (rc != SUCCESS || condition.op == NO_OP)
+    return rc;
+
+  // As in getNextTuple(), a condition on a missing attribute drops every row
+  if (lhsIndex >= attrs.size() || (condition.bRhsIsAttr && rhsIndex >= attrs.size())) {
+    for (auto &word : batch.selection)
+      word = 0;
+    return rc;
+  }
+
+  const ColumnVector &lhs = batch.columns[lhsIndex];
+  if (condition.bRhsIsAttr) {
+    const ColumnVector &rhs = batch.columns[rhsIndex];
+    for (unsigned row = batch.nextSelected(0); row < batch.numRows; row = batch.nextSelected(row + 1))
+      if (lhs.nulls[row] || rhs.nulls[row] ||
+          !checkCompOp(compareField(lhs.type, lhs.getValue(row), rhs.getValue(row)), condition.op))
+        batch.deselect(row);
+  }
+  else if (lhs.type == TypeInt) {
+    selectColumn<int32_t>(batch, lhs, condition.op, condition.rhsValue.data);
+  }
+  else if (lhs.type == TypeReal) {
+    selectColumn<float>(batch, lhs, condition.op, condition.rhsValue.data);
+  }
+  else {
+    for (unsigned row = batch.nextSelected(0); row < batch.numRows; row = batch.nextSelected(row + 1))
+      if (lhs.nulls[row] ||
+          !checkCompOp(compareField(TypeVarChar, lhs.getValue(row), condition.rhsValue.data), condition.op))
+        batch.deselect(row);
+  }
+  return rc;
+}
+
 void Filter::getAttributes(vector<Attribute> &attrs) const
 {
 	attrs.clear();
@@ -52,13 +492,7 @@ bool Filter::checkScanCondition(AttrType type, void* data, CompOp compOp, void*
   }
   else if (type == TypeVarChar)
   {
-      uint32_t varcharSize;
-      memcpy(&varcharSize, (char*)data, VARCHAR_LENGTH_SIZE);
-      char recordString[varcharSize + 1];
-      memcpy(recordString, (char*)data + VARCHAR_LENGTH_SIZE, varcharSize);
-      recordString[varcharSize] = '\0';
-
-      result = checkScanCondition(recordString, compOp, value);
+      result = compOp == NO_OP || checkCompOp(compareField(TypeVarChar, data, value), compOp);
   }
   return result;
 }
@@ -101,31 +535,6 @@ bool Filter::checkScanCondition(float recordReal, CompOp compOp, const void *val
     }
 }
 
-bool Filter::checkScanCondition(char *recordString, CompOp compOp, const void *value)
-{
-    if (compOp == NO_OP)
-        return true;
-
-    int32_t valueSize;
-    memcpy(&valueSize, value, VARCHAR_LENGTH_SIZE);
-    char valueStr[valueSize + 1];
-    valueStr[valueSize] = '\0';
-    memcpy(valueStr, (char*) value + VARCHAR_LENGTH_SIZE, valueSize);
-
-    int cmp = strcmp(recordString, valueStr);
-    switch (compOp)
-    {
-        case EQ_OP: return cmp == 0;
-        case LT_OP: return cmp <  0;
-        case GT_OP: return cmp >  0;
-        case LE_OP: return cmp <= 0;
-        case GE_OP: return cmp >= 0;
-        case NE_OP: return cmp != 0;
-        // Should never happen
-        default: return false;
-    }
-}
-
 // --------------------------------Project------------------------------
 Project::Project(Iterator *input, const vector<string> &attrNames)
 {
@@ -133,6 +542,21 @@ Project::Project(Iterator *input, const vector<string> &attrNames)
 	iter = input;
   attrs.clear();
 	input->getAttributes(attrs);
+  page  = malloc(PAGE_SIZE);
+  value = malloc(PAGE_SIZE);
+
+  // Same order as getAttributes()
+  for (auto &name : attrNames) {
+    unsigned index = getAttributeIndex(attrs, name);
+    if (index < attrs.size())
+      columnIndexes.push_back(index);
+  }
+}
+
+Project::~Project()
+{
+  free(page);
+  free(value);
 }
 
 RC Project::getNextTuple(void *data)
@@ -140,9 +564,6 @@ RC Project::getNextTuple(void *data)
   RC rc;
   RelationManager *rm = RelationManager::instance();
 
-  void *page  = malloc(PAGE_SIZE);
-  void *value = malloc(PAGE_SIZE);
-
   if ((rc = iter->getNextTuple(page)) == SUCCESS) {
     int offset = ceil(attrNames.size()/8.0);
     memset(data, 0, offset);
@@ -176,8 +597,22 @@ RC Project::getNextTuple(void *data)
     }
   }
 
-  free(page);
-  free(value);
+  return rc;
+}
+
+RC Project::getNextBatch(TupleBatch &batch)
+{
+  RC rc = iter->getNextBatch(inputBatch);
+  if (rc != SUCCESS)
+    return rc;
+
+  vector<Attribute> projectAttrs;
+  getAttributes(projectAttrs);
+  batch.init(projectAttrs);
+  for (unsigned i = 0; i < columnIndexes.size(); ++i)
+    batch.columns[i] = inputBatch.columns[columnIndexes[i]];
+  batch.numRows = inputBatch.numRows;
+  batch.selection = inputBatch.selection;
   return rc;
 }
 
@@ -203,6 +638,16 @@ INLJoin::INLJoin(Iterator *leftIn, IndexScan *rightIn, const Condition &conditio
   innerAttrs.clear();
 	outer->getAttributes(outerAttrs);
 	inner->getAttributes(innerAttrs);
+  outerRelation = calloc(PAGE_SIZE, 1);
+  innerRelation = calloc(PAGE_SIZE, 1);
+  value = calloc(PAGE_SIZE, 1);
+}
+
+INLJoin::~INLJoin()
+{
+  free(outerRelation);
+  free(innerRelation);
+  free(value);
 }
 
 RC INLJoin::getNextTuple(void *data)
@@ -210,9 +655,6 @@ RC INLJoin::getNextTuple(void *data)
   RC rc;
   RelationManager *rm = RelationManager::instance();
 
-  void* outerRelation = calloc(PAGE_SIZE, 1);
-  void* innerRelation = calloc(PAGE_SIZE, 1);
-  void* value = calloc(PAGE_SIZE, 1);
   while ((rc = outer->getNextTuple(outerRelation)) == SUCCESS) {
     // if outer iter have value in this field, set inner iter
     // otherwise, continue to next loop
@@ -289,9 +731,6 @@ RC INLJoin::getNextTuple(void *data)
   memcpy((char*)data + sumNullIndicatorSize, (char*)outerRelation + outerNullIndicatorSize, outerSize);
   memcpy((char*)data + sumNullIndicatorSize + outerSize, (char*)innerRelation + innerNullIndicatorSize, innerSize);
 
-  free(outerRelation);
-  free(innerRelation);
-  free(value);
   return rc;
 }
 
@@ -303,3 +742,618 @@ void INLJoin::getAttributes(vector<Attribute> &attrs) const
  for (auto &attr : innerAttrs)
    attrs.push_back(attr);
 }
+
+
+// --------------------------------BNLJoin------------------------------
+BNLJoin::BNLJoin(Iterator *leftIn, TableScan *rightIn, const Condition &condition, const unsigned numPages)
+{
+  outer = leftIn;
+  inner = rightIn;
+  this->condition = condition;
+  this->numPages = numPages > 0 ? numPages : 1;
+  outerAttrs.clear();
+  innerAttrs.clear();
+  outer->getAttributes(outerAttrs);
+  inner->getAttributes(innerAttrs);
+  outerIndex = getAttributeIndex(outerAttrs, condition.lhsAttr);
+  innerIndex = getAttributeIndex(innerAttrs, condition.rhsAttr);
+
+  block = (char*)malloc(this->numPages * PAGE_SIZE);
+  blockSize = 0;
+  blockLoaded = false;
+  outerTuple = (char*)malloc(PAGE_SIZE);
+  outerPending = false;
+  innerTuple = (char*)malloc(PAGE_SIZE);
+  innerValue = NULL;
+  candidates = NULL;
+  candidate = 0;
+}
+
+BNLJoin::~BNLJoin()
+{
+  free(block);
+  free(outerTuple);
+  free(innerTuple);
+}
+
+// Fills the block with the next outer tuples and indexes them on the join attribute
+RC BNLJoin::loadBlock()
+{
+  blockSize = 0;
+  blockTable.clear();
+  blockTuples.clear();
+  candidates = NULL;
+
+  while (outerPending || outer->getNextTuple(outerTuple) == SUCCESS) {
+    outerPending = false;
+    unsigned size = getTupleSize(outerAttrs, outerTuple);
+    if (blockSize + size > numPages * PAGE_SIZE && blockSize > 0) {
+      // Keep it for the next block
+      outerPending = true;
+      break;
+    }
+
+    // A null join attribute never matches
+    const char *field;
+    if (!getField(outerAttrs, outerIndex, outerTuple, field))
+      continue;
+
+    memcpy(block + blockSize, outerTuple, size);
+    if (condition.op == EQ_OP)
+      blockTable[getHashKey(outerAttrs[outerIndex].type, field)].push_back(blockSize);
+    else
+      blockTuples.push_back(blockSize);
+    blockSize += size;
+  }
+
+  if (blockSize == 0)
+    return QE_EOF;
+  return SUCCESS;
+}
+
+RC BNLJoin::getNextTuple(void *data)
+{
+  if (outerIndex == outerAttrs.size() || innerIndex == innerAttrs.size())
+    return QE_EOF;
+
+  while (true) {
+    // Join the current inner tuple with its remaining matches in the block
+    while (candidates != NULL && candidate < candidates->size()) {
+      char *outerData = block + (*candidates)[candidate++];
+      if (condition.op != EQ_OP) {
+        const char *outerValue;
+        getField(outerAttrs, outerIndex, outerData, outerValue);
+        if (!checkCompOp(compareField(outerAttrs[outerIndex].type, outerValue, innerValue), condition.op))
+          continue;
+      }
+      joinTuples(outerAttrs, outerData, innerAttrs, innerTuple, data);
+      return SUCCESS;
+    }
+    candidates = NULL;
+
+    if (!blockLoaded) {
+      if (loadBlock() != SUCCESS)
+        return QE_EOF;
+      blockLoaded = true;
+    }
+
+    // Stream the inner relation once per block
+    if (inner->getNextTuple(innerTuple) != SUCCESS) {
+      if (loadBlock() != SUCCESS)
+        return QE_EOF;
+      inner->setIterator();
+      continue;
+    }
+
+    const char *field;
+    if (!getField(innerAttrs, innerIndex, innerTuple, field))
+      continue;
+    innerValue = field;
+    candidate = 0;
+    if (condition.op == EQ_OP) {
+      auto it = blockTable.find(getHashKey(innerAttrs[innerIndex].type, field));
+      if (it != blockTable.end())
+        candidates = &it->second;
+    }
+    else {
+      candidates = &blockTuples;
+    }
+  }
+}
+
+void BNLJoin::getAttributes(vector<Attribute> &attrs) const
+{
+  attrs.clear();
+  for (auto &attr : outerAttrs)
+    attrs.push_back(attr);
+  for (auto &attr : innerAttrs)
+    attrs.push_back(attr);
+}
+
+
+// --------------------------------GHJoin-------------------------------
+GHJoin::GHJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const unsigned numPartitions)
+{
+  outer = leftIn;
+  inner = rightIn;
+  this->condition = condition;
+  this->numPartitions = numPartitions > 0 ? numPartitions : 1;
+  outerAttrs.clear();
+  innerAttrs.clear();
+  outer->getAttributes(outerAttrs);
+  inner->getAttributes(innerAttrs);
+  outerIndex = getAttributeIndex(outerAttrs, condition.lhsAttr);
+  innerIndex = getAttributeIndex(innerAttrs, condition.rhsAttr);
+
+  string joinName = getTempFileName("ghjoin");
+  for (unsigned i = 0; i < this->numPartitions; ++i) {
+    outerPartitions.push_back(joinName + "_left_" + to_string(i));
+    innerPartitions.push_back(joinName + "_right_" + to_string(i));
+  }
+  partitioned = false;
+  partition = 0;
+  probing = false;
+  innerTuple = (char*)malloc(PAGE_SIZE);
+  candidates = NULL;
+  candidate = 0;
+}
+
+GHJoin::~GHJoin()
+{
+  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+  if (probing)
+    closePartition();
+  if (partitioned) {
+    for (unsigned i = 0; i < numPartitions; ++i) {
+      rbfm->destroyFile(outerPartitions[i]);
+      rbfm->destroyFile(innerPartitions[i]);
+    }
+  }
+  free(innerTuple);
+}
+
+// Writes every tuple of input into the partition file picked by the hash of its join attribute
+RC GHJoin::partitionInput(Iterator *input, const vector<Attribute> &attrs, unsigned index, const vector<string> &partitions)
+{
+  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+  RC rc;
+  vector<FileHandle> handles(partitions.size());
+  for (unsigned i = 0; i < partitions.size(); ++i) {
+    // Only a process that died with the same pid can have left a file of this name
+    rbfm->destroyFile(partitions[i]);
+    rc = rbfm->createFile(partitions[i]);
+    if (rc == SUCCESS)
+      rc = rbfm->openFile(partitions[i], handles[i]);
+    if (rc != SUCCESS) {
+      for (unsigned j = 0; j < i; ++j)
+        rbfm->closeFile(handles[j]);
+      for (unsigned j = 0; j <= i; ++j)
+        rbfm->destroyFile(partitions[j]);
+      return rc;
+    }
+  }
+
+  void *tuple = malloc(PAGE_SIZE);
+  RID rid;
+  rc = SUCCESS;
+  while (input->getNextTuple(tuple) == SUCCESS) {
+    // A null join attribute never matches
+    const char *field;
+    if (!getField(attrs, index, tuple, field))
+      continue;
+    unsigned i = getPartition(getHashKey(attrs[index].type, field), partitions.size());
+    if ((rc = rbfm->insertRecord(handles[i], attrs, tuple, rid)) != SUCCESS)
+      break;
+  }
+  free(tuple);
+
+  for (unsigned i = 0; i < partitions.size(); ++i)
+    rbfm->closeFile(handles[i]);
+  return rc;
+}
+
+// Builds the hash table over outer partition i and starts the scan over inner partition i
+RC GHJoin::loadPartition(unsigned i)
+{
+  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+  RC rc;
+  partitionTuples.clear();
+  partitionTable.clear();
+
+  FileHandle outerHandle;
+  if ((rc = rbfm->openFile(outerPartitions[i], outerHandle)) != SUCCESS)
+    return rc;
+  RBFM_ScanIterator outerScan;
+  if ((rc = rbfm->scan(outerHandle, outerAttrs, "", NO_OP, NULL, getAttributeNames(outerAttrs), outerScan)) != SUCCESS) {
+    rbfm->closeFile(outerHandle);
+    return rc;
+  }
+
+  char *tuple = (char*)malloc(PAGE_SIZE);
+  RID rid;
+  while (outerScan.getNextRecord(rid, tuple) != RBFM_EOF) {
+    unsigned offset = partitionTuples.size();
+    partitionTuples.insert(partitionTuples.end(), tuple, tuple + getTupleSize(outerAttrs, tuple));
+    const char *field;
+    getField(outerAttrs, outerIndex, tuple, field);
+    partitionTable[getHashKey(outerAttrs[outerIndex].type, field)].push_back(offset);
+  }
+  free(tuple);
+  outerScan.close();
+  rbfm->closeFile(outerHandle);
+
+  // Nothing on the inner side can match an empty partition
+  if (partitionTable.empty())
+    return SUCCESS;
+
+  if ((rc = rbfm->openFile(innerPartitions[i], innerHandle)) != SUCCESS)
+    return rc;
+  if ((rc = rbfm->scan(innerHandle, innerAttrs, "", NO_OP, NULL, getAttributeNames(innerAttrs), innerScan)) != SUCCESS) {
+    rbfm->closeFile(innerHandle);
+    return rc;
+  }
+  probing = true;
+  return SUCCESS;
+}
+
+void GHJoin::closePartition()
+{
+  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+  innerScan.close();
+  rbfm->closeFile(innerHandle);
+  probing = false;
+}
+
+RC GHJoin::getNextTuple(void *data)
+{
+  RC rc;
+  if (outerIndex == outerAttrs.size() || innerIndex == innerAttrs.size())
+    return QE_EOF;
+
+  // Partition both inputs the first time through
+  if (!partitioned) {
+    partitioned = true;
+    if ((rc = partitionInput(outer, outerAttrs, outerIndex, outerPartitions)) != SUCCESS)
+      return rc;
+    if ((rc = partitionInput(inner, innerAttrs, innerIndex, innerPartitions)) != SUCCESS)
+      return rc;
+  }
+
+  RID rid;
+  while (true) {
+    // Join the current inner tuple with its remaining matches in the partition
+    if (candidates != NULL && candidate < candidates->size()) {
+      joinTuples(outerAttrs, &partitionTuples[(*candidates)[candidate++]], innerAttrs, innerTuple, data);
+      return SUCCESS;
+    }
+    candidates = NULL;
+
+    if (!probing) {
+      if (partition == numPartitions)
+        return QE_EOF;
+      if ((rc = loadPartition(partition++)) != SUCCESS)
+        return rc;
+      continue;
+    }
+
+    if (innerScan.getNextRecord(rid, innerTuple) == RBFM_EOF) {
+      closePartition();
+      continue;
+    }
+
+    const char *field;
+    getField(innerAttrs, innerIndex, innerTuple, field);
+    auto it = partitionTable.find(getHashKey(innerAttrs[innerIndex].type, field));
+    if (it != partitionTable.end()) {
+      candidates = &it->second;
+      candidate = 0;
+    }
+  }
+}
+
+void GHJoin::getAttributes(vector<Attribute> &attrs) const
+{
+  attrs.clear();
+  for (auto &attr : outerAttrs)
+    attrs.push_back(attr);
+  for (auto &attr : innerAttrs)
+    attrs.push_back(attr);
+}
+
+
+// --------------------------------Aggregate----------------------------
+// Reads the records of a spill file back as an Iterator
+class SpillScan : public Iterator {
+  public:
+    vector<Attribute> attrs;
+
+    SpillScan(const string &fileName, const vector<Attribute> &attrs)
+    {
+      RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+      this->attrs = attrs;
+      opened = rbfm->openFile(fileName, fileHandle) == SUCCESS;
+      if (opened)
+        rbfm->scan(fileHandle, attrs, "", NO_OP, NULL, getAttributeNames(attrs), scanIterator);
+    }
+    ~SpillScan()
+    {
+      if (opened) {
+        scanIterator.close();
+        RecordBasedFileManager::instance()->closeFile(fileHandle);
+      }
+    }
+
+    RC getNextTuple(void *data)
+    {
+      RID rid;
+      if (!opened || scanIterator.getNextRecord(rid, data) == RBFM_EOF)
+        return QE_EOF;
+      return SUCCESS;
+    }
+    void getAttributes(vector<Attribute> &attrs) const
+    {
+      attrs = this->attrs;
+    }
+
+  private:
+    bool opened;
+    FileHandle fileHandle;
+    RBFM_ScanIterator scanIterator;
+};
+
+Aggregate::Aggregate(Iterator *input, Attribute aggAttr, AggregateOp op)
+{
+  init(input, aggAttr, op);
+  grouped = false;
+  memoryLimit = 0;
+}
+
+Aggregate::Aggregate(Iterator *input, Attribute aggAttr, Attribute groupAttr, AggregateOp op, const unsigned memoryLimit)
+{
+  init(input, aggAttr, op);
+  this->groupAttr = groupAttr;
+  grouped = true;
+  this->memoryLimit = memoryLimit;
+  groupIndex = getAttributeIndex(attrs, groupAttr.name);
+}
+
+void Aggregate::init(Iterator *input, Attribute aggAttr, AggregateOp op)
+{
+  iter = input;
+  this->aggAttr = aggAttr;
+  this->op = op;
+  attrs.clear();
+  input->getAttributes(attrs);
+  aggIndex = getAttributeIndex(attrs, aggAttr.name);
+  groupIndex = attrs.size();
+  started = false;
+  spillCount = 0;
+}
+
+Aggregate::~Aggregate()
+{
+  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+  for (auto &spill : spills)
+    rbfm->destroyFile(spill.first);
+}
+
+void Aggregate::updateState(AggregateState &state, AttrType type, const char *field)
+{
+  double value;
+  if (type == TypeInt) {
+    int32_t intValue;
+    memcpy(&intValue, field, INT_SIZE);
+    value = intValue;
+  }
+  else {
+    float realValue;
+    memcpy(&realValue, field, REAL_SIZE);
+    value = realValue;
+  }
+
+  if (state.count == 0 || value < state.min)
+    state.min = value;
+  if (state.count == 0 || value > state.max)
+    state.max = value;
+  state.sum += value;
+  state.count++;
+}
+
+// Writes the output tuple: the group value unless group is NULL, then the aggregate.
+// An empty group key is the null group.
+void Aggregate::writeTuple(const string *group, const AggregateState &state, void *data)
+{
+  unsigned offset = 1;
+  unsigned aggBit = 7;
+  memset(data, 0, 1);
+  if (group != NULL) {
+    aggBit = 6;
+    if (group->empty())
+      *(char*)data |= (1 << 7);
+    else {
+      memcpy((char*)data + offset, group->data(), group->size());
+      offset += group->size();
+    }
+  }
+
+  // Only COUNT is defined over no values
+  if (state.count == 0 && op != COUNT) {
+    *(char*)data |= (1 << aggBit);
+    return;
+  }
+
+  float result = 0;
+  switch (op)
+  {
+    case MIN:   result = state.min; break;
+    case MAX:   result = state.max; break;
+    case COUNT: result = state.count; break;
+    case SUM:   result = state.sum; break;
+    case AVG:   result = state.sum / state.count; break;
+  }
+  memcpy((char*)data + offset, &result, REAL_SIZE);
+}
+
+// Aggregates input into groups until they take up memoryLimit bytes. Tuples of the
+// groups that did not fit are spilled to files for a later pass.
+RC Aggregate::aggregateGroups(Iterator *input, const vector<Attribute> &inputAttrs, unsigned aggIndex, unsigned groupIndex, unsigned pass)
+{
+  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+  RC rc = SUCCESS;
+  groups.clear();
+  unsigned groupsSize = 0;
+
+  // Spilled tuples hold the group value and the aggregate value
+  vector<Attribute> spillAttrs;
+  spillAttrs.push_back(inputAttrs[groupIndex]);
+  spillAttrs.push_back(inputAttrs[aggIndex]);
+  vector<string> spillFiles;
+  vector<FileHandle> spillHandles(QE_AGG_SPILL_PARTITIONS);
+
+  char *tuple = (char*)malloc(PAGE_SIZE);
+  char *spillTuple = (char*)malloc(PAGE_SIZE);
+  RID rid;
+  while (input->getNextTuple(tuple) == SUCCESS) {
+    const char *groupField = NULL;
+    const char *aggField = NULL;
+    string key;
+    if (getField(inputAttrs, groupIndex, tuple, groupField))
+      key = getHashKey(inputAttrs[groupIndex].type, groupField);
+    bool hasValue = getField(inputAttrs, aggIndex, tuple, aggField);
+
+    auto it = groups.find(key);
+    if (it == groups.end()) {
+      unsigned size = key.size() + sizeof(AggregateState) + QE_AGG_GROUP_OVERHEAD;
+      if (groupsSize + size > memoryLimit && !groups.empty()) {
+        // Out of memory: spill the tuple
+        // Only the files that were opened are kept, to be closed below and destroyed
+        // with the Aggregate
+        if (spillFiles.empty()) {
+          string spillName = getTempFileName("aggregate_spill");
+          for (unsigned i = 0; i < QE_AGG_SPILL_PARTITIONS; ++i) {
+            string spillFile = spillName + "_" + to_string(i);
+            rbfm->destroyFile(spillFile);
+            if ((rc = rbfm->createFile(spillFile)) != SUCCESS)
+              break;
+            if ((rc = rbfm->openFile(spillFile, spillHandles[i])) != SUCCESS) {
+              rbfm->destroyFile(spillFile);
+              break;
+            }
+            spillFiles.push_back(spillFile);
+          }
+          if (rc != SUCCESS)
+            break;
+        }
+
+        unsigned offset = 1;
+        memset(spillTuple, 0, 1);
+        if (groupField == NULL)
+          *spillTuple |= (1 << 7);
+        else {
+          memcpy(spillTuple + offset, key.data(), key.size());
+          offset += key.size();
+        }
+        if (!hasValue)
+          *spillTuple |= (1 << 6);
+        else
+          memcpy(spillTuple + offset, aggField, getFieldSize(inputAttrs[aggIndex].type, aggField));
+
+        unsigned i = getPartition(key, QE_AGG_SPILL_PARTITIONS, pass);
+        if ((rc = rbfm->insertRecord(spillHandles[i], spillAttrs, spillTuple, rid)) != SUCCESS)
+          break;
+        continue;
+      }
+
+      AggregateState state;
+      state.min = state.max = state.sum = 0;
+      state.count = 0;
+      it = groups.insert(make_pair(key, state)).first;
+      groupsSize += size;
+    }
+
+    if (hasValue)
+      updateState(it->second, inputAttrs[aggIndex].type, aggField);
+  }
+  free(tuple);
+  free(spillTuple);
+
+  for (unsigned i = 0; i < spillFiles.size(); ++i) {
+    rbfm->closeFile(spillHandles[i]);
+    spills.push_back(make_pair(spillFiles[i], pass + 1));
+  }
+  return rc;
+}
+
+RC Aggregate::getNextTuple(void *data)
+{
+  RC rc;
+  if (aggIndex == attrs.size() || (grouped && groupIndex == attrs.size()))
+    return QE_EOF;
+
+  // Basic aggregation returns a single tuple
+  if (!grouped) {
+    if (started)
+      return QE_EOF;
+    started = true;
+
+    AggregateState state;
+    state.min = state.max = state.sum = 0;
+    state.count = 0;
+    char *tuple = (char*)malloc(PAGE_SIZE);
+    const char *field;
+    while (iter->getNextTuple(tuple) == SUCCESS)
+      if (getField(attrs, aggIndex, tuple, field))
+        updateState(state, aggAttr.type, field);
+    free(tuple);
+
+    writeTuple(NULL, state, data);
+    return SUCCESS;
+  }
+
+  while (true) {
+    if (started && nextGroup != groups.end()) {
+      writeTuple(&nextGroup->first, nextGroup->second, data);
+      ++nextGroup;
+      return SUCCESS;
+    }
+
+    // The first pass reads the input, later passes read back a spill file
+    if (!started) {
+      started = true;
+      rc = aggregateGroups(iter, attrs, aggIndex, groupIndex, 0);
+    }
+    else if (!spills.empty()) {
+      pair<string, unsigned> spill = spills.front();
+      spills.pop_front();
+
+      vector<Attribute> spillAttrs;
+      spillAttrs.push_back(groupAttr);
+      spillAttrs.push_back(aggAttr);
+      SpillScan *scan = new SpillScan(spill.first, spillAttrs);
+      rc = aggregateGroups(scan, spillAttrs, 1, 0, spill.second);
+      delete scan;
+      RecordBasedFileManager::instance()->destroyFile(spill.first);
+    }
+    else {
+      return QE_EOF;
+    }
+
+    nextGroup = groups.begin();
+    if (rc != SUCCESS)
+      return rc;
+  }
+}
+
+void Aggregate::getAttributes(vector<Attribute> &attrs) const
+{
+  attrs.clear();
+  if (grouped)
+    attrs.push_back(groupAttr);
+
+  Attribute attr;
+  static const char *opNames[] = {"MIN", "MAX", "COUNT", "SUM", "AVG"};
+  attr.name = string(opNames[op]) + "(" + aggAttr.name + ")";
+  attr.type = TypeReal;
+  attr.length = 4;
+  attrs.push_back(attr);
+}
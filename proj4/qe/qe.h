@@ -2,6 +2,9 @@
 #define _qe_h_
 
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <deque>
 
 #include "../rbf/rbfm.h"
 #include "../rm/rm.h"
@@ -9,6 +12,12 @@
 
 #define QE_EOF (-1)  // end of the index scan
 
+#define QE_AGG_MEMORY (16 * 1024 * 1024)  // default memory for the groups of an Aggregate
+#define QE_AGG_GROUP_OVERHEAD 64           // bytes charged per group on top of its value
+#define QE_AGG_SPILL_PARTITIONS 8          // spill files written when the groups run out of memory
+
+#define QE_BATCH_SIZE 1024  // tuples moved by one getNextBatch() call
+
 using namespace std;
 
 typedef enum{ MIN=0, MAX, COUNT, SUM, AVG } AggregateOp;
@@ -33,10 +42,63 @@ struct Condition {
 };
 
 
+// One column of a TupleBatch, one entry per row.
+//    For INT and REAL: values holds the 4 byte value of every row
+//    For VARCHAR: values holds the 4 byte offset of every row's value in heap,
+//                 and heap holds the values in the api format (length, then characters)
+// A null row has nulls set and nothing meaningful in values.
+struct ColumnVector {
+    AttrType type;
+    vector<char> values;
+    vector<char> heap;
+    vector<char> nulls;
+
+    // The row's value in the api format
+    const char *getValue(unsigned row) const;
+};
+
+
+// Up to QE_BATCH_SIZE tuples stored column by column. Rows are never moved out of a
+// batch: an operator that drops rows clears their bit in the selection bitmap instead.
+// The vectors keep their memory between batches, so a batch allocates only while it
+// is filled for the first time.
+class TupleBatch {
+    public:
+        vector<Attribute> attrs;
+        vector<ColumnVector> columns;
+        unsigned numRows;
+        vector<uint64_t> selection;   // bit (row % 64) of word (row / 64) is set if the row is selected
+
+        TupleBatch();
+
+        // Sets the schema of the batch and drops its rows
+        void init(const vector<Attribute> &attrs);
+        // Drops the rows and keeps the schema
+        void clear();
+
+        bool isFull() const { return numRows >= QE_BATCH_SIZE; };
+        bool isSelected(unsigned row) const { return selection[row / 64] & (1ULL << (row % 64)); };
+        void deselect(unsigned row) { selection[row / 64] &= ~(1ULL << (row % 64)); };
+        // First selected row at or after row, numRows if there is none
+        unsigned nextSelected(unsigned row) const;
+        unsigned getSelectedCount() const;
+
+        // Adds a selected row from a tuple in the api format
+        void appendTuple(const void *data);
+        // Writes the row back as a tuple in the api format
+        void getTuple(unsigned row, void *data) const;
+};
+
+
 class Iterator {
     // All the relational operators and access methods are iterators.
     public:
         virtual RC getNextTuple(void *data) = 0;
+        // Fills batch with the next tuples. Returns QE_EOF once there are no rows left;
+        // a batch that is returned may still have none of its rows selected.
+        // The default reads them one by one with getNextTuple(). Do not mix the two
+        // calls on one iterator.
+        virtual RC getNextBatch(TupleBatch &batch);
         virtual void getAttributes(vector<Attribute> &attrs) const = 0;
         virtual ~Iterator() {};
 };
@@ -91,6 +153,21 @@ class TableScan : public Iterator
             return iter->getNextTuple(rid, data);
         };
 
+        // Reads the tuples of the scan straight into the columns of the batch
+        RC getNextBatch(TupleBatch &batch)
+        {
+            vector<Attribute> batchAttrs;
+            getAttributes(batchAttrs);
+            batch.init(batchAttrs);
+
+            char data[PAGE_SIZE];
+            while (!batch.isFull() && iter->getNextTuple(rid, data) == 0)
+            {
+                batch.appendTuple(data);
+            }
+            return batch.numRows > 0 ? 0 : QE_EOF;
+        };
+
         void getAttributes(vector<Attribute> &attrs) const
         {
             attrs.clear();
@@ -121,16 +198,33 @@ class IndexScan : public Iterator
         RelationManager &rm;
         RM_IndexScanIterator *iter;
         string tableName;
-        string attrName;
+        string relName;             // the table in the catalog, tableName may be an alias
+        string attrName;            // the indexed attribute, or the name of a composite index
         vector<Attribute> attrs;
         char key[PAGE_SIZE];
         RID rid;
 
+        // Set by the constructor that takes attrNames. Tuples hold only those attributes, and
+        // if every one of them is in the key they are built from the key without reading
+        // the table at all.
+        bool projected;
+        bool composite;
+        bool covering;
+        vector<Attribute> keyAttrs;     // the attributes of the key, in key order
+        vector<Attribute> tableAttrs;
+        vector<unsigned> keyFields;     // where each attribute of attrs is in the key
+        vector<unsigned> tableFields;   // and in the tuples of the table
+        char tuple[PAGE_SIZE];
+
         IndexScan(RelationManager &rm, const string &tableName, const string &attrName, const char *alias = NULL):rm(rm)
         {
         	// Set members
         	this->tableName = tableName;
+        	this->relName = tableName;
         	this->attrName = attrName;
+        	projected = false;
+        	composite = false;
+        	covering = false;
 
 
             // Get Attributes from RM
@@ -144,29 +238,48 @@ class IndexScan : public Iterator
             if(alias) this->tableName = alias;
         };
 
-        // Start a new iterator given the new key range
+        // Scans the index on attribute indexName, or the composite index called indexName, and
+        // returns tuples of the attributes in attrNames, in that order. Names may be given
+        // as attr or as rel.attr.
+        IndexScan(RelationManager &rm, const string &tableName, const string &indexName,
+                  const vector<string> &attrNames, const char *alias = NULL);
+
+        // Start a new iterator given the new key range. On a composite index the keys are
+        // values of its first attribute.
         void setIterator(void* lowKey,
                          void* highKey,
                          bool lowKeyInclusive,
                          bool highKeyInclusive)
         {
+            if (composite) {
+                setIterator(lowKey, lowKey ? 1 : 0, highKey, highKey ? 1 : 0, lowKeyInclusive, highKeyInclusive);
+                return;
+            }
             iter->close();
             delete iter;
             iter = new RM_IndexScanIterator();
-            rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive,
+            rm.indexScan(relName, attrName, lowKey, highKey, lowKeyInclusive,
                            highKeyInclusive, *iter);
         };
 
-        RC getNextTuple(void *data)
+        // The same on a composite index, with the values of its first lowCount and highCount
+        // attributes. See RelationManager::indexScan.
+        void setIterator(void* lowKey,
+                         unsigned lowCount,
+                         void* highKey,
+                         unsigned highCount,
+                         bool lowKeyInclusive,
+                         bool highKeyInclusive)
         {
-            int rc = iter->getNextEntry(rid, key);
-            if(rc == 0)
-            {
-                rc = rm.readTuple(tableName.c_str(), rid, data);
-            }
-            return rc;
+            iter->close();
+            delete iter;
+            iter = new RM_IndexScanIterator();
+            rm.indexScan(relName, attrName, lowKey, lowCount, highKey, highCount, lowKeyInclusive,
+                           highKeyInclusive, *iter);
         };
 
+        RC getNextTuple(void *data);
+
         void getAttributes(vector<Attribute> &attrs) const
         {
             attrs.clear();
@@ -200,17 +313,22 @@ class Filter : public Iterator {
         Filter(Iterator *input,               // Iterator of input R
                const Condition &condition     // Selection condition
         );
-        ~Filter(){};
+        ~Filter();
 
         RC getNextTuple(void *data);
+        // Deselects the rows of the input batch that fail the condition
+        RC getNextBatch(TupleBatch &batch);
         // For attribute in vector<Attribute>, name it as rel.attr
         void getAttributes(vector<Attribute> &attrs) const;
 
     private:
+        void *value;
+        unsigned lhsIndex;
+        unsigned rhsIndex;
+
         bool checkScanCondition(AttrType type, void* data, CompOp compOp, void* value);
         bool checkScanCondition(int recordInt, CompOp compOp, const void *value);
         bool checkScanCondition(float recordReal, CompOp compOp, const void *value);
-        bool checkScanCondition(char* recordString, CompOp compOp, const void *value);
 };
 
 
@@ -223,11 +341,20 @@ class Project : public Iterator {
 
     Project(Iterator *input,                    // Iterator of input R
           const vector<string> &attrNames);   // vector containing attribute names
-    ~Project(){};
+    ~Project();
 
     RC getNextTuple(void *data);
+    // Picks the projected columns out of a batch of the input
+    RC getNextBatch(TupleBatch &batch);
     // For attribute in vector<Attribute>, name it as rel.attr
     void getAttributes(vector<Attribute> &attrs) const;
+
+  private:
+    void *page;
+    void *value;
+    // Input column of every projected attribute
+    vector<unsigned> columnIndexes;
+    TupleBatch inputBatch;
 };
 
 
@@ -244,11 +371,174 @@ class INLJoin : public Iterator {
                IndexScan *rightIn,          // IndexScan Iterator of input S
                const Condition &condition   // Join condition
         );
-        ~INLJoin(){};
+        ~INLJoin();
+
+        RC getNextTuple(void *data);
+        // For attribute in vector<Attribute>, name it as rel.attr
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        void *outerRelation;
+        void *innerRelation;
+        void *value;
+};
+
+
+class BNLJoin : public Iterator {
+    // Block nested-loop join operator
+    public:
+        Iterator* outer;
+        TableScan* inner;
+        Condition condition;
+        unsigned numPages;
+        vector<Attribute> outerAttrs;
+        vector<Attribute> innerAttrs;
+
+        BNLJoin(Iterator *leftIn,            // Iterator of input R
+               TableScan *rightIn,           // TableScan Iterator of input S
+               const Condition &condition,   // Join condition
+               const unsigned numPages       // # of pages that can be loaded into memory,
+                                             //   i.e., memory block size (decided by the optimizer)
+        );
+        ~BNLJoin();
 
         RC getNextTuple(void *data);
         // For attribute in vector<Attribute>, name it as rel.attr
         void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        // Outer tuples of the current block, packed one after the other
+        char *block;
+        unsigned blockSize;
+        bool blockLoaded;
+        // Join attribute value -> offsets of the block tuples holding it
+        unordered_map<string, vector<unsigned> > blockTable;
+        // Offsets of every block tuple, used when the condition is not an equality
+        vector<unsigned> blockTuples;
+
+        // Outer tuple read past the end of the previous block
+        char *outerTuple;
+        bool outerPending;
+
+        // Current inner tuple and the block tuples still to be joined with it
+        char *innerTuple;
+        const char *innerValue;
+        const vector<unsigned> *candidates;
+        unsigned candidate;
+
+        unsigned outerIndex;
+        unsigned innerIndex;
+
+        RC loadBlock();
+};
+
+
+class GHJoin : public Iterator {
+    // Grace hash join operator
+    public:
+        Iterator* outer;
+        Iterator* inner;
+        Condition condition;
+        unsigned numPartitions;
+        vector<Attribute> outerAttrs;
+        vector<Attribute> innerAttrs;
+
+        GHJoin(Iterator *leftIn,               // Iterator of input R
+               Iterator *rightIn,               // Iterator of input S
+               const Condition &condition,      // Join condition (CompOp is always EQ)
+               const unsigned numPartitions     // # of partitions for each relation (decided by the optimizer)
+        );
+        ~GHJoin();
+
+        RC getNextTuple(void *data);
+        // For attribute in vector<Attribute>, name it as rel.attr
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        // Partition files of both inputs, removed when the join is destroyed
+        vector<string> outerPartitions;
+        vector<string> innerPartitions;
+        bool partitioned;
+        unsigned partition;
+
+        // Outer tuples of the current partition and their hash table on the join attribute
+        vector<char> partitionTuples;
+        unordered_map<string, vector<unsigned> > partitionTable;
+
+        // Probe side: scan over the inner partition of the same number
+        FileHandle innerHandle;
+        RBFM_ScanIterator innerScan;
+        bool probing;
+        char *innerTuple;
+        const vector<unsigned> *candidates;
+        unsigned candidate;
+
+        unsigned outerIndex;
+        unsigned innerIndex;
+
+        RC partitionInput(Iterator *input, const vector<Attribute> &attrs, unsigned index, const vector<string> &partitions);
+        RC loadPartition(unsigned i);
+        void closePartition();
+};
+
+
+class Aggregate : public Iterator {
+    // Aggregation operator
+    public:
+        Iterator *iter;
+        Attribute aggAttr;
+        Attribute groupAttr;
+        AggregateOp op;
+        bool grouped;
+        unsigned memoryLimit;
+        vector<Attribute> attrs;
+
+        // Basic aggregation
+        Aggregate(Iterator *input,          // Iterator of input R
+                  Attribute aggAttr,        // The attribute over which we are computing an aggregate
+                  AggregateOp op            // Aggregate operation
+        );
+
+        // Group-based hash aggregation. Groups that do not fit in memoryLimit bytes
+        // are spilled to disk and aggregated in a later pass.
+        Aggregate(Iterator *input,             // Iterator of input R
+                  Attribute aggAttr,           // The attribute over which we are computing an aggregate
+                  Attribute groupAttr,         // The attribute over which we are grouping the tuples
+                  AggregateOp op,              // Aggregate operation
+                  const unsigned memoryLimit = QE_AGG_MEMORY
+        );
+        ~Aggregate();
+
+        RC getNextTuple(void *data);
+        // Please name the output attribute as aggregateOp(aggAttr)
+        // E.g. Relation=rel, attribute=attr, aggregateOp=MAX
+        // output attrname = "MAX(rel.attr)"
+        // The aggregate is returned as a TypeReal
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        struct AggregateState {
+            double min;
+            double max;
+            double sum;
+            unsigned count;
+        };
+
+        // Groups of the current pass, keyed on the group value ("" for null)
+        unordered_map<string, AggregateState> groups;
+        unordered_map<string, AggregateState>::const_iterator nextGroup;
+        bool started;
+
+        // Spill files still to be aggregated, with the pass that wrote them
+        deque<pair<string, unsigned> > spills;
+        unsigned spillCount;
+        unsigned aggIndex;
+        unsigned groupIndex;
+
+        void init(Iterator *input, Attribute aggAttr, AggregateOp op);
+        void updateState(AggregateState &state, AttrType type, const char *field);
+        void writeTuple(const string *group, const AggregateState &state, void *data);
+        RC aggregateGroups(Iterator *input, const vector<Attribute> &inputAttrs, unsigned aggIndex, unsigned groupIndex, unsigned pass);
 };
 
 
@@ -0,0 +1,148 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+RC testCase_7() {
+	// Mandatory for all
+	// 1. BNLJoin -- on TypeReal Attribute
+	// SELECT * FROM left, right WHERE left.C = right.C
+	cerr << endl << "***** In QE Test Case 7 *****" << endl;
+
+	RC rc = success;
+
+	// Prepare the iterator and condition
+	TableScan *leftIn = new TableScan(*rm, "left");
+	TableScan *rightIn = new TableScan(*rm, "right");
+
+	Condition cond;
+	cond.lhsAttr = "left.C";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "right.C";
+
+	int expectedResultCnt = 75; // 50.0~124.0  left.C: [50.0,149.0], right.C: [25.0,124.0]
+	int actualResultCnt = 0;
+	float valueC = 0;
+	float leftC = 0;
+
+	// Create BNLJoin
+	BNLJoin *bnlJoin = new BNLJoin(leftIn, rightIn, cond, 5);
+
+	// Go over the data through iterator
+	void *data = malloc(bufSize);
+	while (bnlJoin->getNextTuple(data) != QE_EOF) {
+		// No attribute should be NULL
+		if (*(unsigned char *) data != 0) {
+			cerr << endl << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		// Print left.A, left.B, left.C, right.B, right.C, right.D
+		cerr << "left.A " << *(int *) ((char *) data + 1);
+		cerr << "  left.B " << *(int *) ((char *) data + 5);
+		leftC = *(float *) ((char *) data + 9);
+		cerr << "  left.C " << leftC;
+		cerr << "  right.B " << *(int *) ((char *) data + 13);
+		valueC = *(float *) ((char *) data + 17);
+		cerr << "  right.C " << valueC;
+		cerr << "  right.D " << *(int *) ((char *) data + 21) << endl;
+
+		if (valueC != leftC || valueC < 50.0 || valueC > 124.0) {
+			cerr << endl << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		memset(data, 0, bufSize);
+		actualResultCnt++;
+	}
+
+	if (expectedResultCnt != actualResultCnt) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete bnlJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	return rc;
+}
+
+RC testCase_7_VarChar() {
+	// 1. BNLJoin -- on TypeVarChar Attribute, the outer does not fit in one block
+	// SELECT * FROM leftvarchar, rightvarchar WHERE leftvarchar.B = rightvarchar.B
+	RC rc = success;
+
+	TableScan *leftIn = new TableScan(*rm, "leftvarchar");
+	TableScan *rightIn = new TableScan(*rm, "rightvarchar");
+
+	Condition cond;
+	cond.lhsAttr = "leftvarchar.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "rightvarchar.B";
+
+	// B is a run of 1 to 26 letters. Lengths 1~12 occur 39 times in each table, 13~26 occur 38 times.
+	int expectedResultCnt = 12 * 39 * 39 + 14 * 38 * 38;
+	int actualResultCnt = 0;
+
+	BNLJoin *bnlJoin = new BNLJoin(leftIn, rightIn, cond, 1);
+
+	void *data = malloc(bufSize);
+	while (bnlJoin->getNextTuple(data) != QE_EOF) {
+		if (*(unsigned char *) data != 0) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		// leftvarchar.A, leftvarchar.B, rightvarchar.B, rightvarchar.C
+		int offset = 1 + sizeof(int);
+		int leftLength = *(int *) ((char *) data + offset);
+		string leftB((char *) data + offset + sizeof(int), leftLength);
+		offset += sizeof(int) + leftLength;
+		int rightLength = *(int *) ((char *) data + offset);
+		string rightB((char *) data + offset + sizeof(int), rightLength);
+		if (leftB != rightB) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		memset(data, 0, bufSize);
+		actualResultCnt++;
+	}
+
+	if (expectedResultCnt != actualResultCnt) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete bnlJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	return rc;
+}
+
+int main() {
+
+	if (testCase_7() != success || testCase_7_VarChar() != success) {
+		cerr << "***** [FAIL] QE Test Case 7 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 7 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -0,0 +1,148 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+RC testCase_8() {
+	// Mandatory for all
+	// 1. GHJoin -- on TypeInt Attribute
+	// SELECT * FROM left, right WHERE left.B = right.B
+	cerr << endl << "***** In QE Test Case 8 *****" << endl;
+
+	RC rc = success;
+
+	// Prepare the iterator and condition
+	TableScan *leftIn = new TableScan(*rm, "left");
+	TableScan *rightIn = new TableScan(*rm, "right");
+
+	Condition cond;
+	cond.lhsAttr = "left.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "right.B";
+
+	int expectedResultCnt = 90; // 20~109  left.B: [10,109], right.B: [20,119]
+	int actualResultCnt = 0;
+	int valueB = 0;
+	int leftB = 0;
+
+	// Create GHJoin
+	GHJoin *ghJoin = new GHJoin(leftIn, rightIn, cond, 10);
+
+	// Go over the data through iterator
+	void *data = malloc(bufSize);
+	while (ghJoin->getNextTuple(data) != QE_EOF) {
+		// No attribute should be NULL
+		if (*(unsigned char *) data != 0) {
+			cerr << endl << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		// Print left.A, left.B, left.C, right.B, right.C, right.D
+		cerr << "left.A " << *(int *) ((char *) data + 1);
+		leftB = *(int *) ((char *) data + 5);
+		cerr << "  left.B " << leftB;
+		cerr << "  left.C " << *(float *) ((char *) data + 9);
+		valueB = *(int *) ((char *) data + 13);
+		cerr << "  right.B " << valueB;
+		cerr << "  right.C " << *(float *) ((char *) data + 17);
+		cerr << "  right.D " << *(int *) ((char *) data + 21) << endl;
+
+		if (valueB != leftB || valueB < 20 || valueB > 109) {
+			cerr << endl << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		memset(data, 0, bufSize);
+		actualResultCnt++;
+	}
+
+	if (expectedResultCnt != actualResultCnt) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete ghJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	return rc;
+}
+
+RC testCase_8_VarChar() {
+	// 1. GHJoin -- on TypeVarChar Attribute
+	// SELECT * FROM leftvarchar, rightvarchar WHERE leftvarchar.B = rightvarchar.B
+	RC rc = success;
+
+	TableScan *leftIn = new TableScan(*rm, "leftvarchar");
+	TableScan *rightIn = new TableScan(*rm, "rightvarchar");
+
+	Condition cond;
+	cond.lhsAttr = "leftvarchar.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "rightvarchar.B";
+
+	// B is a run of 1 to 26 letters. Lengths 1~12 occur 39 times in each table, 13~26 occur 38 times.
+	int expectedResultCnt = 12 * 39 * 39 + 14 * 38 * 38;
+	int actualResultCnt = 0;
+
+	GHJoin *ghJoin = new GHJoin(leftIn, rightIn, cond, 3);
+
+	void *data = malloc(bufSize);
+	while (ghJoin->getNextTuple(data) != QE_EOF) {
+		if (*(unsigned char *) data != 0) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		// leftvarchar.A, leftvarchar.B, rightvarchar.B, rightvarchar.C
+		int offset = 1 + sizeof(int);
+		int leftLength = *(int *) ((char *) data + offset);
+		string leftB((char *) data + offset + sizeof(int), leftLength);
+		offset += sizeof(int) + leftLength;
+		int rightLength = *(int *) ((char *) data + offset);
+		string rightB((char *) data + offset + sizeof(int), rightLength);
+		if (leftB != rightB) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+
+		memset(data, 0, bufSize);
+		actualResultCnt++;
+	}
+
+	if (expectedResultCnt != actualResultCnt) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete ghJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	return rc;
+}
+
+int main() {
+
+	if (testCase_8() != success || testCase_8_VarChar() != success) {
+		cerr << "***** [FAIL] QE Test Case 8 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 8 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -0,0 +1,88 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+RC checkAggregate(const string &attrName, AttrType type, AggregateOp op, float expectedValue) {
+	RC rc = success;
+
+	TableScan *input = new TableScan(*rm, "left");
+
+	Attribute aggAttr;
+	aggAttr.name = attrName;
+	aggAttr.type = type;
+	aggAttr.length = 4;
+	Aggregate *agg = new Aggregate(input, aggAttr, op);
+
+	vector<Attribute> attrs;
+	agg->getAttributes(attrs);
+	cerr << attrs[0].name << " ";
+
+	int count = 0;
+	void *data = malloc(bufSize);
+	while (agg->getNextTuple(data) != QE_EOF) {
+		// Is the aggregate NULL?
+		bool nullBit = *(unsigned char *) data & (1 << 7);
+		if (nullBit) {
+			cerr << endl << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		float value = *(float *) ((char *) data + 1);
+		cerr << value << endl;
+		if (value != expectedValue) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		count++;
+	}
+
+	if (count != 1) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete agg;
+	delete input;
+	free(data);
+	return rc;
+}
+
+RC testCase_11() {
+	// Mandatory for all
+	// 1. Basic aggregation -- MIN, MAX, COUNT, SUM, AVG
+	// SELECT MAX(left.B) FROM left, SELECT MIN(left.A) FROM left, ...
+	cerr << endl << "***** In QE Test Case 11 *****" << endl;
+
+	// left.A in [0,99], left.B in [10,109], left.C in [50.0,149.0]
+	if (checkAggregate("left.B", TypeInt, MAX, 109) != success)
+		return fail;
+	if (checkAggregate("left.A", TypeInt, MIN, 0) != success)
+		return fail;
+	if (checkAggregate("left.A", TypeInt, COUNT, 100) != success)
+		return fail;
+	if (checkAggregate("left.B", TypeInt, SUM, 5950) != success)
+		return fail;
+	if (checkAggregate("left.C", TypeReal, AVG, 99.5) != success)
+		return fail;
+	return success;
+}
+
+int main() {
+
+	if (testCase_11() != success) {
+		cerr << "***** [FAIL] QE Test Case 11 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 11 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -0,0 +1,156 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+RC checkGroupAggregate(AggregateOp op, unsigned memoryLimit) {
+	RC rc = success;
+
+	TableScan *input = new TableScan(*rm, "group");
+
+	Attribute aggAttr;
+	aggAttr.name = "group.C";
+	aggAttr.type = TypeReal;
+	aggAttr.length = 4;
+
+	Attribute groupAttr;
+	groupAttr.name = "group.B";
+	groupAttr.type = TypeInt;
+	groupAttr.length = 4;
+
+	Aggregate *agg = new Aggregate(input, aggAttr, groupAttr, op, memoryLimit);
+
+	// group.B in [1,5], group k holds group.C = k+49, k+54, ..., k+144
+	bool seen[6] = {false, false, false, false, false, false};
+	int count = 0;
+	void *data = malloc(bufSize);
+	while (agg->getNextTuple(data) != QE_EOF) {
+		if (*(unsigned char *) data != 0) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		int group = *(int *) ((char *) data + 1);
+		float value = *(float *) ((char *) data + 5);
+		cerr << "group.B " << group << "  " << value << endl;
+
+		float expectedValue = 0;
+		if (op == SUM)
+			expectedValue = 20 * group + 1930;
+		else if (op == AVG)
+			expectedValue = group + 96.5;
+		else if (op == MIN)
+			expectedValue = group + 49;
+		if (group < 1 || group > 5 || seen[group] || value != expectedValue) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		seen[group] = true;
+		count++;
+	}
+
+	if (count != 5) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete agg;
+	delete input;
+	free(data);
+	return rc;
+}
+
+RC checkVarCharGroupAggregate(unsigned memoryLimit) {
+	// SELECT leftvarchar.B, COUNT(leftvarchar.A) FROM leftvarchar GROUP BY leftvarchar.B
+	RC rc = success;
+
+	TableScan *input = new TableScan(*rm, "leftvarchar");
+
+	Attribute aggAttr;
+	aggAttr.name = "leftvarchar.A";
+	aggAttr.type = TypeInt;
+	aggAttr.length = 4;
+
+	Attribute groupAttr;
+	groupAttr.name = "leftvarchar.B";
+	groupAttr.type = TypeVarChar;
+	groupAttr.length = 30;
+
+	Aggregate *agg = new Aggregate(input, aggAttr, groupAttr, COUNT, memoryLimit);
+
+	// B is a run of 1 to 26 letters. Lengths 1~12 occur 39 times, 13~26 occur 38 times.
+	int count = 0;
+	void *data = malloc(bufSize);
+	while (agg->getNextTuple(data) != QE_EOF) {
+		int length = *(int *) ((char *) data + 1);
+		float value = *(float *) ((char *) data + 5 + length);
+		if (*(unsigned char *) data != 0 || length < 1 || length > 26 || value != (length <= 12 ? 39 : 38)) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		count++;
+	}
+
+	if (count != 26) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete agg;
+	delete input;
+	free(data);
+	return rc;
+}
+
+RC testCase_12() {
+	// 1. Group-based hash aggregation
+	// SELECT group.B, SUM(group.C) FROM group GROUP BY group.B
+	// 2. The same with so little memory that groups are spilled to disk
+	cerr << endl << "***** In QE Test Case 12 *****" << endl;
+
+	if (checkGroupAggregate(SUM, QE_AGG_MEMORY) != success)
+		return fail;
+	if (checkGroupAggregate(MIN, QE_AGG_MEMORY) != success)
+		return fail;
+	// Room for a single group per pass
+	if (checkGroupAggregate(AVG, 1) != success)
+		return fail;
+	if (checkVarCharGroupAggregate(QE_AGG_MEMORY) != success)
+		return fail;
+	if (checkVarCharGroupAggregate(500) != success)
+		return fail;
+	return success;
+}
+
+int main() {
+	// Tables created: group
+	// Indexes created: none
+
+	if (createGroupTable() != success) {
+		cerr << "***** [FAIL] QE Test Case 12 failed. *****" << endl;
+		return fail;
+	}
+
+	if (populateGroupTable() != success) {
+		cerr << "***** [FAIL] QE Test Case 12 failed. *****" << endl;
+		return fail;
+	}
+
+	if (testCase_12() != success) {
+		cerr << "***** [FAIL] QE Test Case 12 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 12 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -0,0 +1,265 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include "qe_test_util.h"
+
+// Size of a tuple in the api format. Iterators may write past the end of a tuple,
+// so only this much of two tuples can be compared.
+unsigned getTupleLength(const vector<Attribute> &attrs, const void *data) {
+	unsigned nullSize = ceil(attrs.size() / 8.0);
+	unsigned size = nullSize;
+	for (unsigned i = 0; i < attrs.size(); i++) {
+		if (*((unsigned char *) data + i / 8) & (1 << (7 - i % 8)))
+			continue;
+		if (attrs[i].type == TypeVarChar)
+			size += sizeof(int) + *(int *) ((char *) data + size);
+		else
+			size += sizeof(int);
+	}
+	return size;
+}
+
+// Runs both iterators to the end, one with getNextBatch() and one with getNextTuple(),
+// and checks that the selected rows of the batches are the tuples, in the same order.
+RC compareBatches(Iterator *batchIn, Iterator *tupleIn, int expectedResultCnt) {
+	RC rc = success;
+	int actualResultCnt = 0;
+
+	vector<Attribute> attrs;
+	tupleIn->getAttributes(attrs);
+
+	TupleBatch batch;
+	void *batchData = malloc(bufSize);
+	void *tupleData = malloc(bufSize);
+	while (batchIn->getNextBatch(batch) != QE_EOF) {
+		if (batch.numRows > QE_BATCH_SIZE || batch.columns.size() != attrs.size()) {
+			cerr << "***** A returned batch is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		for (unsigned row = batch.nextSelected(0); row < batch.numRows; row = batch.nextSelected(row + 1)) {
+			memset(batchData, 0, bufSize);
+			memset(tupleData, 0, bufSize);
+			batch.getTuple(row, batchData);
+			if (tupleIn->getNextTuple(tupleData) == QE_EOF || memcmp(batchData, tupleData, getTupleLength(attrs, batchData)) != 0) {
+				cerr << "***** A returned value is not correct. *****" << endl;
+				rc = fail;
+				goto clean_up;
+			}
+			actualResultCnt++;
+		}
+	}
+
+	if (tupleIn->getNextTuple(tupleData) != QE_EOF || expectedResultCnt != actualResultCnt) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	free(batchData);
+	free(tupleData);
+	return rc;
+}
+
+RC testCase_13() {
+	// 1. TableScan, Filter and Project moving batches of tuples
+	// SELECT * FROM left
+	// SELECT * FROM left WHERE left.B <= 30
+	// SELECT left.C, left.A FROM left WHERE left.C >= 100.0
+	// 2. Filter comparing two attributes of the tuple
+	cerr << endl << "***** In QE Test Case 13 *****" << endl;
+
+	RC rc = success;
+
+	// left.A in [0,99], left.B in [10,109], left.C in [50.0,149.0]
+	TableScan *batchScan = new TableScan(*rm, "left");
+	TableScan *tupleScan = new TableScan(*rm, "left");
+	rc = compareBatches(batchScan, tupleScan, 100);
+	delete batchScan;
+	delete tupleScan;
+	if (rc != success)
+		return rc;
+
+	Condition cond;
+	cond.lhsAttr = "left.B";
+	cond.op = LE_OP;
+	cond.bRhsIsAttr = false;
+	Value value;
+	value.type = TypeInt;
+	value.data = malloc(bufSize);
+	*(int *) value.data = 30;
+	cond.rhsValue = value;
+
+	batchScan = new TableScan(*rm, "left");
+	tupleScan = new TableScan(*rm, "left");
+	Filter *batchFilter = new Filter(batchScan, cond);
+	Filter *tupleFilter = new Filter(tupleScan, cond);
+	rc = compareBatches(batchFilter, tupleFilter, 21);
+	delete batchFilter;
+	delete tupleFilter;
+	delete batchScan;
+	delete tupleScan;
+	if (rc != success) {
+		free(value.data);
+		return rc;
+	}
+
+	// Two attributes of the tuple, left.A < left.B in every tuple. rhsValue is left set
+	// to a value that only some of the tuples pass, and should not be looked at.
+	// SELECT * FROM left WHERE left.A < left.B
+	// SELECT * FROM left WHERE left.B <= left.A
+	cond.lhsAttr = "left.A";
+	cond.op = LT_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "left.B";
+	*(int *) value.data = 30;
+	for (int expected = 100; expected >= 0; expected -= 100) {
+		batchScan = new TableScan(*rm, "left");
+		tupleScan = new TableScan(*rm, "left");
+		batchFilter = new Filter(batchScan, cond);
+		tupleFilter = new Filter(tupleScan, cond);
+		rc = compareBatches(batchFilter, tupleFilter, expected);
+		delete batchFilter;
+		delete tupleFilter;
+		delete batchScan;
+		delete tupleScan;
+		if (rc != success) {
+			free(value.data);
+			return rc;
+		}
+		cond.lhsAttr = "left.B";
+		cond.op = LE_OP;
+		cond.rhsAttr = "left.A";
+	}
+	cond.bRhsIsAttr = false;
+
+	// The projected columns come back in the order they were asked for
+	cond.lhsAttr = "left.C";
+	cond.op = GE_OP;
+	value.type = TypeReal;
+	*(float *) value.data = 100.0;
+	cond.rhsValue = value;
+
+	vector<string> attrNames;
+	attrNames.push_back("left.C");
+	attrNames.push_back("left.A");
+
+	batchScan = new TableScan(*rm, "left");
+	batchFilter = new Filter(batchScan, cond);
+	Project *project = new Project(batchFilter, attrNames);
+
+	int actualResultCnt = 0;
+	TupleBatch batch;
+	while (project->getNextBatch(batch) != QE_EOF) {
+		for (unsigned row = batch.nextSelected(0); row < batch.numRows; row = batch.nextSelected(row + 1)) {
+			float valueC = *(float *) batch.columns[0].getValue(row);
+			int valueA = *(int *) batch.columns[1].getValue(row);
+			if (valueC < 100.0 || valueC != valueA + 50) {
+				cerr << "***** A returned value is not correct. *****" << endl;
+				rc = fail;
+			}
+			actualResultCnt++;
+		}
+	}
+	if (actualResultCnt != 50) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+	delete project;
+	delete batchFilter;
+	delete batchScan;
+	free(value.data);
+	return rc;
+}
+
+RC testCase_13_VarChar() {
+	// 1. Filter on a TypeVarChar attribute
+	// SELECT * FROM leftvarchar WHERE leftvarchar.B = "llllllllllll"
+	RC rc = success;
+
+	Condition cond;
+	cond.lhsAttr = "leftvarchar.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = false;
+	Value value;
+	value.type = TypeVarChar;
+	value.data = malloc(bufSize);
+	int length = 12;
+	*(int *) value.data = length;
+	memset((char *) value.data + sizeof(int), 'l', length);
+	cond.rhsValue = value;
+
+	TableScan *batchScan = new TableScan(*rm, "leftvarchar");
+	TableScan *tupleScan = new TableScan(*rm, "leftvarchar");
+	Filter *batchFilter = new Filter(batchScan, cond);
+	Filter *tupleFilter = new Filter(tupleScan, cond);
+	rc = compareBatches(batchFilter, tupleFilter, 39);
+
+	delete batchFilter;
+	delete tupleFilter;
+	delete batchScan;
+	delete tupleScan;
+	free(value.data);
+	return rc;
+}
+
+RC testCase_13_Join() {
+	// 1. The default getNextBatch() of an operator without its own
+	// 2. Filter comparing two attributes
+	// SELECT * FROM left, right WHERE left.C = right.C AND left.B <> right.B
+	RC rc = success;
+
+	Condition cond;
+	cond.lhsAttr = "left.C";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "right.C";
+
+	TableScan *leftIn = new TableScan(*rm, "left");
+	TableScan *rightIn = new TableScan(*rm, "right");
+	BNLJoin *bnlJoin = new BNLJoin(leftIn, rightIn, cond, 5);
+
+	Condition neCond;
+	neCond.lhsAttr = "left.B";
+	neCond.op = NE_OP;
+	neCond.bRhsIsAttr = true;
+	neCond.rhsAttr = "right.B";
+	Filter *filter = new Filter(bnlJoin, neCond);
+
+	// right.B in [20,119] and right.C in [25.0,124.0], so right.B = right.C - 5
+	// while left.B = left.C - 40: every joined tuple passes
+	int actualResultCnt = 0;
+	TupleBatch batch;
+	while (filter->getNextBatch(batch) != QE_EOF) {
+		actualResultCnt += batch.getSelectedCount();
+	}
+	if (actualResultCnt != 75) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+	delete filter;
+	delete bnlJoin;
+	delete leftIn;
+	delete rightIn;
+	return rc;
+}
+
+int main() {
+
+	if (testCase_13() != success || testCase_13_VarChar() != success || testCase_13_Join() != success) {
+		cerr << "***** [FAIL] QE Test Case 13 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 13 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
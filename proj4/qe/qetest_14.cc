@@ -0,0 +1,288 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+// orders.customer in [0,19], orders.day is one of "day0" to "day8", orders.amount is the
+// number of the order, and every 4th order has a null orders.note
+const int numOfOrders = 300;
+const int numOfCustomers = 20;
+const int numOfDays = 9;
+
+int createOrdersTable() {
+	cerr << "****Create Orders Table****" << endl;
+
+	vector<Attribute> attrs;
+	Attribute attr;
+	attr.name = "customer";
+	attr.type = TypeInt;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	attr.name = "day";
+	attr.type = TypeVarChar;
+	attr.length = 10;
+	attrs.push_back(attr);
+
+	attr.name = "amount";
+	attr.type = TypeReal;
+	attr.length = 4;
+	attrs.push_back(attr);
+
+	attr.name = "note";
+	attr.type = TypeVarChar;
+	attr.length = 20;
+	attrs.push_back(attr);
+
+	return rm->createTable("orders", attrs);
+}
+
+string dayOf(int i) {
+	return "day" + to_string(i % numOfDays);
+}
+
+int populateOrdersTable() {
+	RC rc = success;
+	RID rid;
+	char buf[bufSize];
+	for (int i = 0; i < numOfOrders && rc == success; ++i) {
+		int offset = 1;
+		*(unsigned char *) buf = i % 4 == 0 ? 1 << 4 : 0;
+		int customer = i % numOfCustomers;
+		memcpy(buf + offset, &customer, sizeof(int));
+		offset += sizeof(int);
+		string day = dayOf(i);
+		int length = day.length();
+		memcpy(buf + offset, &length, sizeof(int));
+		memcpy(buf + offset + sizeof(int), day.data(), length);
+		offset += sizeof(int) + length;
+		float amount = i;
+		memcpy(buf + offset, &amount, sizeof(float));
+		offset += sizeof(float);
+		if (i % 4 != 0) {
+			string note = "note" + to_string(i);
+			length = note.length();
+			memcpy(buf + offset, &length, sizeof(int));
+			memcpy(buf + offset + sizeof(int), note.data(), length);
+		}
+		rc = rm->insertTuple("orders", buf, rid);
+	}
+	return rc;
+}
+
+// Moves the file of the table out of the way, so only the catalog and the indexes can be read
+void hideTable(bool hide) {
+	int rc = hide ? rename("orders.t", "orders.t.hidden") : rename("orders.t.hidden", "orders.t");
+	assert(rc == 0 && "Moving the table file should not fail.");
+}
+
+// Reads orders.customer and orders.day out of a tuple with those two attributes
+void readCustomerDay(const char *data, int &customer, string &day) {
+	customer = *(int *) (data + 1);
+	day.assign(data + 9, *(int *) (data + 5));
+}
+
+RC checkKeyScan() {
+	// SELECT orders.customer, orders.day FROM orders, from the index on both
+	RC rc = success;
+	vector<string> attrNames;
+	attrNames.push_back("orders.customer");
+	attrNames.push_back("orders.day");
+	IndexScan *input = new IndexScan(*rm, "orders", "customer_day", attrNames);
+
+	vector<Attribute> attrs;
+	input->getAttributes(attrs);
+	if (!input->covering || attrs.size() != 2 || attrs[0].name != "orders.customer" || attrs[1].name != "orders.day") {
+		cerr << "***** The attributes are not correct. *****" << endl;
+		delete input;
+		return fail;
+	}
+
+	// Everything, in key order
+	char data[bufSize];
+	int count = 0;
+	int lastCustomer = -1;
+	string lastDay;
+	while (input->getNextTuple(data) != QE_EOF) {
+		int customer;
+		string day;
+		readCustomerDay(data, customer, day);
+		if (*(unsigned char *) data != 0 || customer < lastCustomer || (customer == lastCustomer && day < lastDay)) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+		}
+		lastCustomer = customer;
+		lastDay = day;
+		count++;
+	}
+	if (count != numOfOrders) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+	// The orders of a customer, and of a customer on a day
+	int customer = 7;
+	input->setIterator(&customer, &customer, true, true);
+	count = 0;
+	while (input->getNextTuple(data) != QE_EOF) {
+		int returnedCustomer;
+		string day;
+		readCustomerDay(data, returnedCustomer, day);
+		if (returnedCustomer != customer)
+			rc = fail;
+		count++;
+	}
+	if (count != numOfOrders / numOfCustomers) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+	char key[bufSize];
+	string day = "day7";
+	int length = day.length();
+	memcpy(key, &customer, sizeof(int));
+	memcpy(key + 4, &length, sizeof(int));
+	memcpy(key + 8, day.data(), length);
+	input->setIterator(key, 2, key, 2, true, true);
+	count = 0;
+	while (input->getNextTuple(data) != QE_EOF) {
+		int returnedCustomer;
+		string returnedDay;
+		readCustomerDay(data, returnedCustomer, returnedDay);
+		if (returnedCustomer != customer || returnedDay != day)
+			rc = fail;
+		count++;
+	}
+	// Order i is customer 7 on day 7 for i = 7 mod 180
+	if (rc != success || count != 2) {
+		cerr << "***** The lookup is not correct. *****" << endl;
+		rc = fail;
+	}
+
+	delete input;
+	return rc;
+}
+
+RC checkCountByKey() {
+	// SELECT orders.customer, COUNT(orders.customer) FROM orders GROUP BY orders.customer,
+	// from the index on orders.customer
+	RC rc = success;
+	vector<string> attrNames;
+	attrNames.push_back("customer");
+	IndexScan *input = new IndexScan(*rm, "orders", "customer", attrNames);
+
+	Attribute attr;
+	attr.name = "orders.customer";
+	attr.type = TypeInt;
+	attr.length = 4;
+	Aggregate *agg = new Aggregate(input, attr, attr, COUNT);
+
+	char data[bufSize];
+	int count = 0;
+	while (agg->getNextTuple(data) != QE_EOF) {
+		int customer = *(int *) (data + 1);
+		float value = *(float *) (data + 5);
+		if (*(unsigned char *) data != 0 || customer < 0 || customer >= numOfCustomers || value != numOfOrders / numOfCustomers) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+		}
+		count++;
+	}
+	if (count != numOfCustomers) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+	delete agg;
+	delete input;
+	return rc;
+}
+
+RC checkTupleScan() {
+	// SELECT orders.note, orders.day FROM orders, with the tuples read for orders.note
+	RC rc = success;
+	vector<string> attrNames;
+	attrNames.push_back("o.note");
+	attrNames.push_back("o.day");
+	IndexScan *input = new IndexScan(*rm, "orders", "customer_day", attrNames, "o");
+	if (input->covering) {
+		cerr << "***** orders.note is not in the key. *****" << endl;
+		delete input;
+		return fail;
+	}
+
+	char data[bufSize];
+	int count = 0;
+	int nulls = 0;
+	while (input->getNextTuple(data) != QE_EOF) {
+		count++;
+		if (*(unsigned char *) data == 1 << 7) {
+			nulls++;
+			continue;
+		}
+		// orders.note is "note" and the number of the order
+		int length = *(int *) (data + 1);
+		string note(data + 5, length);
+		int i = atoi(note.c_str() + 4);
+		const char *day = data + 5 + length;
+		if (*(unsigned char *) data != 0 || note != "note" + to_string(i) || string(day + 4, *(int *) day) != dayOf(i))
+			rc = fail;
+	}
+	if (rc != success || count != numOfOrders || nulls != numOfOrders / 4) {
+		cerr << "***** The returned values are not correct. *****" << endl;
+		rc = fail;
+	}
+
+	delete input;
+	return rc;
+}
+
+int testCase_14() {
+	// Index-only scans
+	// 1. SELECT orders.customer, orders.day FROM orders, and lookups by key, without the table file
+	// 2. Count by key without the table file
+	// 3. An attribute that is not in the key is read from the tuples
+	cerr << endl << "***** In QE Test Case 14 *****" << endl;
+
+	hideTable(true);
+	RC rc = checkKeyScan();
+	if (rc == success)
+		rc = checkCountByKey();
+	hideTable(false);
+	if (rc == success)
+		rc = checkTupleScan();
+	return rc;
+}
+
+int main() {
+	// Tables created: orders
+	// Indexes created: orders.customer, orders.customer_day
+
+	rm->deleteTable("orders");
+	if (createOrdersTable() != success || populateOrdersTable() != success) {
+		cerr << "***** [FAIL] QE Test Case 14 failed. *****" << endl;
+		return fail;
+	}
+
+	vector<string> key;
+	key.push_back("customer");
+	key.push_back("day");
+	if (rm->createIndex("orders", "customer") != success || rm->createIndex("orders", "customer_day", key) != success) {
+		cerr << "***** [FAIL] QE Test Case 14 failed. *****" << endl;
+		return fail;
+	}
+
+	if (testCase_14() != success) {
+		cerr << "***** [FAIL] QE Test Case 14 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 14 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
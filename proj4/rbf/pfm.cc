@@ -1,24 +1,36 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <algorithm>
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
 
 #include "pfm.h"
+#include "wal.h"
 
 PagedFileManager* PagedFileManager::_pf_manager = NULL;
 
 PagedFileManager* PagedFileManager::instance()
 {
-    if(!_pf_manager)
-        _pf_manager = new PagedFileManager();
-
-    return _pf_manager;
+    // A local static is initialized by exactly one thread, even if several get here at
+    // once, so every manager below is made this way
+    static PagedFileManager *manager = _pf_manager = new PagedFileManager();
+    return manager;
 }
 
 
 PagedFileManager::PagedFileManager()
 {
+    openFileBudget = PFM_DEFAULT_OPEN_FILE_BUDGET;
+    openFileCount = 0;
+    hitCounter = 0;
+    missCounter = 0;
 }
 
 
@@ -29,10 +41,17 @@ PagedFileManager::~PagedFileManager()
 
 RC PagedFileManager::createFile(const string &fileName)
 {
+    // Before filesMutex: the log may be waiting for an operation that opens files
+    LogManager::instance()->resetFile(fileName);
+    lock_guard<recursive_mutex> guard(filesMutex);
+
     // If the file already exists, error
     if (fileExists(fileName))
         return PFM_FILE_EXISTS;
 
+    // Anything still buffered under this name belongs to a file that no longer exists
+    forgetFile(fileName);
+
     // Attempt to open the file for writing
     FILE *pFile = fopen(fileName.c_str(), "wb");
     // Return an error if we fail
@@ -50,28 +69,93 @@ RC PagedFileManager::destroyFile(const string &fileName)
     if (remove(fileName.c_str()) != 0)
         return PFM_REMOVE_FAILED;
 
+    LogManager::instance()->resetFile(fileName);
+    lock_guard<recursive_mutex> guard(filesMutex);
+    forgetFile(fileName);
     return SUCCESS;
 }
 
 
 RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
 {
+    lock_guard<recursive_mutex> guard(filesMutex);
     // If this handle already has an open file, error
-    if (fileHandle.getfd() != NULL)
+    if (fileHandle.getFile() != NULL)
         return PFM_HANDLE_IN_USE;
 
     // If the file doesn't exist, error
-    if (!fileExists(fileName.c_str()))
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) != 0)
         return PFM_FILE_DN_EXIST;
 
-    // Open the file for reading/writing in binary mode
-    FILE *pFile;
-    pFile = fopen(fileName.c_str(), "rb+");
-    // If we fail, error
-    if (pFile == NULL)
-        return PFM_OPEN_FAILED;
+    PagedFile *file;
+    auto it = files.find(fileName);
+    if (it == files.end())
+    {
+        file = new PagedFile();
+        file->fileName = fileName;
+        file->fd = NULL;
+        file->refCount = 0;
+        file->numberOfPages = 0;
+        file->inode = 0;
+        file->size = 0;
+        file->mtime = 0;
+        file->map = NULL;
+        file->mapSize = 0;
+        file->version = 0;
+        files[fileName] = file;
+    }
+    else
+    {
+        file = it->second;
+    }
 
-    fileHandle.setfd(pFile);
+    // Still open from before. If the file was changed behind our back since, or replaced
+    // by another one under the same name, the FILE* and our buffered pages are stale.
+    if (file->refCount == 0 && file->fd != NULL)
+    {
+        if (sb.st_ino == file->inode && sb.st_size == file->size && sb.st_mtime == file->mtime)
+        {
+            idleFiles.erase(file->idlePos);
+            hitCounter++;
+        }
+        else
+        {
+            closeIdleFile(file);
+        }
+    }
+
+    // The first handle on the file opens it, the rest share its FILE*
+    if (file->fd == NULL)
+    {
+        // Open the file for reading/writing in binary mode
+        FILE *pFile;
+        pFile = fopen(fileName.c_str(), "rb+");
+        // If we fail, error
+        if (pFile == NULL)
+            return PFM_OPEN_FAILED;
+        file->fd = pFile;
+        openFileCount++;
+        missCounter++;
+
+        // If the file was changed behind our back since we last had it open, our buffered pages are stale
+        if (fstat(fileno(pFile), &sb) != 0)
+        {
+            fclose(pFile);
+            file->fd = NULL;
+            openFileCount--;
+            return PFM_OPEN_FAILED;
+        }
+        if (sb.st_ino != file->inode || sb.st_size != file->size || sb.st_mtime != file->mtime)
+        {
+            BufferManager::instance()->dropFile(file);
+        }
+        // Filesize is always PAGE_SIZE * number of pages
+        file->numberOfPages = sb.st_size / PAGE_SIZE;
+    }
+    file->refCount++;
+
+    fileHandle.setFile(file);
 
     return SUCCESS;
 }
@@ -79,20 +163,97 @@ RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
 
 RC PagedFileManager::closeFile(FileHandle &fileHandle)
 {
-    FILE *pFile = fileHandle.getfd();
+    lock_guard<recursive_mutex> guard(filesMutex);
+    PagedFile *file = fileHandle.getFile();
 
     // If not an open file, error
-    if (pFile == NULL)
+    if (file == NULL || file->fd == NULL)
         return 1;
 
-    // Flush and close the file
-    fclose(pFile);
+    fileHandle.setFile(NULL);
+    file->refCount--;
+    if (file->refCount > 0)
+        return SUCCESS;
+
+    // Last handle on this file: write back its dirty pages. Its clean pages stay buffered.
+    RC rc = BufferManager::instance()->flushFile(fileHandle, file, true);
+
+    // Remember what the file looks like so we can tell if someone else changes it
+    struct stat sb;
+    if (fstat(fileno(file->fd), &sb) == 0)
+    {
+        file->inode = sb.st_ino;
+        file->size = sb.st_size;
+        file->mtime = sb.st_mtime;
+    }
 
-    fileHandle.setfd(NULL);
+    // Unmap the file, and keep it open for the next openFile() if we have the budget
+    FileHandle::unmapFile(file);
+    file->idlePos = idleFiles.insert(idleFiles.begin(), file);
 
+    // The file was destroyed while we still had it open
+    auto it = files.find(file->fileName);
+    if (it == files.end() || it->second != file)
+    {
+        closeIdleFile(file);
+        BufferManager::instance()->dropFile(file);
+        delete file;
+    }
+    else
+    {
+        trimIdleFiles(openFileBudget);
+    }
+
+    return rc;
+}
+
+void PagedFileManager::setOpenFileBudget(unsigned budget)
+{
+    lock_guard<recursive_mutex> guard(filesMutex);
+    openFileBudget = budget;
+    trimIdleFiles(budget);
+}
+
+unsigned PagedFileManager::getOpenFileBudget()
+{
+    return openFileBudget;
+}
+
+unsigned PagedFileManager::getOpenFileCount()
+{
+    lock_guard<recursive_mutex> guard(filesMutex);
+    return openFileCount;
+}
+
+RC PagedFileManager::collectStatistics(unsigned &hitCount, unsigned &missCount)
+{
+    lock_guard<recursive_mutex> guard(filesMutex);
+    hitCount = hitCounter;
+    missCount = missCounter;
     return SUCCESS;
 }
 
+void PagedFileManager::resetStatistics()
+{
+    lock_guard<recursive_mutex> guard(filesMutex);
+    hitCounter = 0;
+    missCounter = 0;
+}
+
+void PagedFileManager::trimIdleFiles(unsigned budget)
+{
+    while (idleFiles.size() > budget)
+        closeIdleFile(idleFiles.back());
+}
+
+void PagedFileManager::closeIdleFile(PagedFile *file)
+{
+    idleFiles.erase(file->idlePos);
+    fclose(file->fd);
+    file->fd = NULL;
+    openFileCount--;
+}
+
 // Check if a file already exists
 bool PagedFileManager::fileExists(const string &fileName)
 {
@@ -101,14 +262,35 @@ bool PagedFileManager::fileExists(const string &fileName)
     return stat(fileName.c_str(), &sb) == 0;
 }
 
+void PagedFileManager::forgetFile(const string &fileName)
+{
+    auto it = files.find(fileName);
+    if (it == files.end())
+        return;
+
+    PagedFile *file = it->second;
+    files.erase(it);
+    BufferManager::instance()->dropFile(file);
+    // If handles are still open on it, the last closeFile() frees it
+    if (file->refCount == 0)
+    {
+        if (file->fd != NULL)
+            closeIdleFile(file);
+        delete file;
+    }
+}
+
 
 FileHandle::FileHandle()
 {
     readPageCounter = 0;
     writePageCounter = 0;
     appendPageCounter = 0;
+    physicalReadCounter = 0;
+    physicalWriteCounter = 0;
 
-    _fd = NULL;
+    _file = NULL;
+    memoryMapped = false;
 }
 
 
@@ -119,80 +301,202 @@ FileHandle::~FileHandle()
 
 RC FileHandle::readPage(PageNum pageNum, void *data)
 {
-    if (_fd == NULL)
+    if (!isOpen())
         return -1;
     // If pageNum doesn't exist, error
-    if (getNumberOfPages() < pageNum)
+    if (pageNum >= getNumberOfPages())
         return FH_PAGE_DN_EXIST;
 
-    // Try to seek to the specified page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    if (memoryMapped)
+    {
+        const void *page;
+        RC rc = getPage(pageNum, page);
+        if (rc)
+            return rc;
+        memcpy(data, page, PAGE_SIZE);
+        return SUCCESS;
+    }
 
-    // Try to read the specified page
-    if (fread(data, 1, PAGE_SIZE, _fd) != PAGE_SIZE)
-        return FH_READ_FAILED;
+    BufferManager *bm = BufferManager::instance();
+    void *frame;
+    RC rc = bm->pinPage(*this, pageNum, frame);
+    if (rc)
+        return rc;
 
+    latchPage(pageNum, false);
+    memcpy(data, frame, PAGE_SIZE);
+    unlatchPage(pageNum);
     readPageCounter++;
-    return SUCCESS;
+    return bm->unpinPage(*this, pageNum, false);
 }
 
 
 RC FileHandle::writePage(PageNum pageNum, const void *data)
 {
-    if (_fd == NULL)
+    if (!isOpen())
         return -1;
     // Check if the page exists
-    if (getNumberOfPages() < pageNum)
+    if (pageNum >= getNumberOfPages())
         return FH_PAGE_DN_EXIST;
 
-    // Seek to the start of the page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    // The whole page is overwritten, so there is no need to read it in first,
+    // unless the log needs what it was before. A frame that is not read in holds another
+    // page until the copy below, so the latch is taken before the pin makes it visible.
+    LogManager *log = LogManager::instance();
+    LogOperation operation;
+    BufferManager *bm = BufferManager::instance();
+    void *frame;
+    latchPage(pageNum, true);
+    bool load = log->needsBeforeImage(_file, pageNum);
+    RC rc = bm->pinPage(*this, pageNum, frame, load);
+    if (rc)
+    {
+        unlatchPage(pageNum);
+        return rc;
+    }
 
-    // Write the page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+    if (log->isEnabled())
     {
-        // Immediately commit changes to disk
-        fflush(_fd);
-        writePageCounter++;
-        return SUCCESS;
+        LSN lsn;
+        rc = log->logPageWrite(_file, pageNum, frame, false, data, lsn);
+        if (rc)
+        {
+            // A frame that was not read in must not be left behind with the wrong page
+            bm->unpinPage(*this, pageNum, false);
+            if (!load)
+                bm->dropPage(*this, pageNum);
+            unlatchPage(pageNum);
+            return rc;
+        }
+        bm->setPageLSN(_file, pageNum, lsn);
     }
 
-    return FH_WRITE_FAILED;
+    memcpy(frame, data, PAGE_SIZE);
+    unlatchPage(pageNum);
+    writePageCounter++;
+    rc = bm->unpinPage(*this, pageNum, true);
+    if (rc)
+        return rc;
+    return operation.commit();
 }
 
 
 RC FileHandle::appendPage(const void *data)
 {
-    if (_fd == NULL)
+    PageNum pageNum;
+    return appendPage(data, pageNum);
+}
+
+
+RC FileHandle::appendPage(const void *data, PageNum &pageNum)
+{
+    if (!isOpen())
         return -1;
-    // Seek to the end of the file
-    if (fseek(_fd, 0, SEEK_END))
-        return FH_SEEK_FAILED;
 
-    // Write the new page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+    // The operation commits once the file can be appended to again
+    LogOperation operation;
+    RC rc = appendToFile(data, pageNum);
+    if (rc)
+        return rc;
+    return operation.commit();
+}
+
+
+RC FileHandle::appendToFile(const void *data, PageNum &pageNum)
+{
+    LogManager *log = LogManager::instance();
+    lock_guard<mutex> guard(_file->appendMutex);
+    pageNum = _file->numberOfPages;
+    LSN lsn = 0;
+    if (log->isEnabled())
     {
-        fflush(_fd);
+        RC rc = log->logPageWrite(_file, pageNum, NULL, true, data, lsn);
+        if (rc)
+            return rc;
+    }
+
+    // The new page goes to the buffer pool like any other write, and reaches the file
+    // when it is written back
+    BufferManager *bm = BufferManager::instance();
+    void *frame;
+    if (bm->pinPage(*this, pageNum, frame, false) == SUCCESS)
+    {
+        memcpy(frame, data, PAGE_SIZE);
+        bm->setPageLSN(_file, pageNum, lsn);
+        _file->numberOfPages++;
         appendPageCounter++;
+        return bm->unpinPage(*this, pageNum, true);
+    }
+
+    // No frame to spare, write it out right away
+    RC rc = log->flushTo(lsn);
+    if (rc)
+        return rc;
+    rc = BufferManager::writeToDisk(_file, pageNum, data);
+    if (rc)
+        return rc;
+    _file->numberOfPages++;
+    appendPageCounter++;
+    physicalWriteCounter++;
+    return SUCCESS;
+}
+
+
+RC FileHandle::getPage(PageNum pageNum, const void *&data)
+{
+    if (!isOpen())
+        return -1;
+
+    if (!memoryMapped)
+    {
+        pageBuffer.resize(PAGE_SIZE);
+        RC rc = readPage(pageNum, &pageBuffer[0]);
+        if (rc)
+            return rc;
+        data = &pageBuffer[0];
         return SUCCESS;
     }
-    return FH_WRITE_FAILED;
+
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+
+    // A page changed in the buffer pool but not written back yet is newer than the map
+    pageBuffer.resize(PAGE_SIZE);
+    if (BufferManager::instance()->copyDirtyPage(_file, pageNum, &pageBuffer[0]))
+    {
+        data = &pageBuffer[0];
+        readPageCounter++;
+        return SUCCESS;
+    }
+
+    // The file has grown past the end of the map
+    if ((size_t) (pageNum + 1) * PAGE_SIZE > _file->mapSize)
+    {
+        RC rc = mapFile();
+        if (rc)
+            return rc;
+    }
+
+    data = _file->map + (size_t) pageNum * PAGE_SIZE;
+    readPageCounter++;
+    return SUCCESS;
 }
 
 
 unsigned FileHandle::getNumberOfPages()
 {
-    if (_fd == NULL)
+    if (!isOpen())
         return 0;
-    // Use stat to get the file size
-    struct stat sb;
-    if (fstat(fileno(_fd), &sb) != 0)
-        // On error, return 0
-        return 0;
-    // Filesize is always PAGE_SIZE * number of pages
-    return sb.st_size / PAGE_SIZE;
+    lock_guard<mutex> guard(_file->appendMutex);
+    return _file->numberOfPages;
+}
+
+
+RC FileHandle::sync()
+{
+    if (!isOpen())
+        return -1;
+    return BufferManager::instance()->commitFile(*this, _file, true);
 }
 
 
@@ -204,12 +508,696 @@ RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePage
     return SUCCESS;
 }
 
-void FileHandle::setfd(FILE *fd)
+RC FileHandle::collectPhysicalCounterValues(unsigned &readPageCount, unsigned &writePageCount)
+{
+    readPageCount  = physicalReadCounter;
+    writePageCount = physicalWriteCounter;
+    return SUCCESS;
+}
+
+RC FileHandle::latchPage(PageNum pageNum, bool exclusive)
+{
+    if (!isOpen())
+        return -1;
+    latchPage(_file, pageNum, exclusive, true);
+    return SUCCESS;
+}
+
+RC FileHandle::unlatchPage(PageNum pageNum)
+{
+    if (!isOpen())
+        return -1;
+    return unlatchPage(_file, pageNum);
+}
+
+bool FileHandle::latchPage(PagedFile *file, PageNum pageNum, bool exclusive, bool wait)
+{
+    unique_lock<mutex> guard(file->latchMutex);
+    PageLatch &pageLatch = file->latches[pageNum];
+    pageLatch.users++;
+    if (!wait)
+    {
+        if (pageLatch.latch.tryLock(exclusive))
+            return true;
+        if (--pageLatch.users == 0)
+            file->latches.erase(pageNum);
+        return false;
+    }
+    guard.unlock();
+
+    pageLatch.latch.lock(exclusive);
+    return true;
+}
+
+RC FileHandle::unlatchPage(PagedFile *file, PageNum pageNum)
+{
+    lock_guard<mutex> guard(file->latchMutex);
+    auto it = file->latches.find(pageNum);
+    if (it == file->latches.end())
+        return FH_NOT_LATCHED;
+    it->second.latch.unlock();
+    if (--it->second.users == 0)
+        file->latches.erase(it);
+    return SUCCESS;
+}
+
+void FileHandle::latchFile(bool exclusive)
+{
+    if (_file != NULL)
+        _file->fileLatch.lock(exclusive);
+}
+
+void FileHandle::unlatchFile()
+{
+    if (_file != NULL)
+        _file->fileLatch.unlock();
+}
+
+unsigned FileHandle::getVersion()
+{
+    if (_file == NULL)
+        return 0;
+    return _file->version;
+}
+
+void FileHandle::bumpVersion()
+{
+    if (_file != NULL)
+        _file->version++;
+}
+
+void FileHandle::setMemoryMapped(bool memoryMapped)
+{
+    this->memoryMapped = memoryMapped;
+}
+
+bool FileHandle::isMemoryMapped()
+{
+    return memoryMapped;
+}
+
+void FileHandle::setFile(PagedFile *file)
+{
+    _file = file;
+}
+
+PagedFile *FileHandle::getFile()
+{
+    return _file;
+}
+
+bool FileHandle::isOpen()
+{
+    return _file != NULL && _file->fd != NULL;
+}
+
+// Map the whole file, with room to grow
+RC FileHandle::mapFile()
+{
+    size_t mapSize = max((size_t) getNumberOfPages() * PAGE_SIZE * 2, (size_t) FH_MIN_MAP_SIZE);
+    void *map = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fileno(_file->fd), 0);
+    if (map == MAP_FAILED)
+        return FH_MAP_FAILED;
+
+    if (_file->map != NULL)
+        _file->oldMaps.push_back(make_pair(_file->map, _file->mapSize));
+    _file->map = (char*) map;
+    _file->mapSize = mapSize;
+    return SUCCESS;
+}
+
+void FileHandle::unmapFile(PagedFile *file)
+{
+    if (file->map != NULL)
+        munmap(file->map, file->mapSize);
+    for (auto &oldMap : file->oldMaps)
+        munmap(oldMap.first, oldMap.second);
+    file->map = NULL;
+    file->mapSize = 0;
+    file->oldMaps.clear();
+}
+
+
+Latch::Latch()
+: readers(0), writerDepth(0)
+{
+}
+
+void Latch::lock(bool exclusive)
 {
-    _fd = fd;
+    unique_lock<mutex> guard(stateMutex);
+    thread::id self = this_thread::get_id();
+    if (writerDepth > 0 && writer == self)
+    {
+        writerDepth++;
+        return;
+    }
+
+    if (exclusive)
+    {
+        released.wait(guard, [&]{ return writerDepth == 0 && readers == 0; });
+        writer = self;
+        writerDepth = 1;
+    }
+    else
+    {
+        released.wait(guard, [&]{ return writerDepth == 0; });
+        readers++;
+    }
+}
+
+bool Latch::tryLock(bool exclusive)
+{
+    lock_guard<mutex> guard(stateMutex);
+    thread::id self = this_thread::get_id();
+    if (writerDepth > 0 && writer == self)
+    {
+        writerDepth++;
+        return true;
+    }
+    if (writerDepth > 0 || (exclusive && readers > 0))
+        return false;
+
+    if (exclusive)
+    {
+        writer = self;
+        writerDepth = 1;
+    }
+    else
+    {
+        readers++;
+    }
+    return true;
+}
+
+void Latch::unlock()
+{
+    lock_guard<mutex> guard(stateMutex);
+    if (writerDepth > 0 && writer == this_thread::get_id())
+    {
+        if (--writerDepth == 0)
+        {
+            writer = thread::id();
+            released.notify_all();
+        }
+        return;
+    }
+    if (readers > 0 && --readers == 0)
+        released.notify_all();
+}
+
+BufferManager* BufferManager::_bf_manager = NULL;
+
+BufferManager* BufferManager::instance()
+{
+    static BufferManager *manager = []() {
+        _bf_manager = new BufferManager();
+        // Dirty pages of files that are never closed still have to reach the disk
+        atexit(flushAtExit);
+        return _bf_manager;
+    }();
+    return manager;
+}
+
+BufferManager::BufferManager()
+: frameData(NULL), clockHand(0), hitCounter(0), missCounter(0), writeBackCounter(0),
+  groupCommitPages(BM_DEFAULT_GROUP_COMMIT_PAGES), groupCommitInterval(BM_DEFAULT_GROUP_COMMIT_INTERVAL)
+{
+    setNumberOfFrames(BM_DEFAULT_FRAME_COUNT);
+}
+
+BufferManager::~BufferManager()
+{
+    flushAll();
+    free(frameData);
+}
+
+RC BufferManager::setNumberOfFrames(unsigned frameCount)
+{
+    if (frameCount == 0)
+        return BM_NO_FREE_FRAME;
+    RC rc = flushAll();
+    if (rc)
+        return rc;
+
+    lock_guard<recursive_mutex> guard(poolMutex);
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].pinCount > 0)
+            return BM_FRAMES_PINNED;
+    }
+    // Pages changed since the flush. Nothing is pinned, so nothing is changing them.
+    FileHandle nobody;
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].file != NULL && frames[i].dirty && (rc = writeBack(nobody, i)))
+            return rc;
+    }
+
+    char *newFrameData = (char*) malloc((size_t) frameCount * PAGE_SIZE);
+    if (newFrameData == NULL)
+        return BM_MALLOC_FAILED;
+    free(frameData);
+    frameData = newFrameData;
+
+    BufferFrame emptyFrame;
+    emptyFrame.file = NULL;
+    emptyFrame.pageNum = 0;
+    emptyFrame.pinCount = 0;
+    emptyFrame.dirty = false;
+    emptyFrame.referenced = false;
+    emptyFrame.lsn = 0;
+    emptyFrame.changes = 0;
+    frames.assign(frameCount, emptyFrame);
+
+    pageTable.clear();
+    clockHand = 0;
+    return SUCCESS;
+}
+
+unsigned BufferManager::getNumberOfFrames()
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    return frames.size();
+}
+
+RC BufferManager::pinPage(FileHandle &fileHandle, PageNum pageNum, void *&data)
+{
+    if (!fileHandle.isOpen())
+        return -1;
+    if (pageNum >= fileHandle.getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+    return pinPage(fileHandle, pageNum, data, true);
+}
+
+RC BufferManager::pinPage(FileHandle &fileHandle, PageNum pageNum, void *&data, bool load)
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    FrameKey key = {fileHandle.getFile(), pageNum};
+
+    // Already buffered
+    auto it = pageTable.find(key);
+    if (it != pageTable.end())
+    {
+        BufferFrame &frame = frames[it->second];
+        frame.pinCount++;
+        frame.referenced = true;
+        hitCounter++;
+        data = getFrameData(it->second);
+        return SUCCESS;
+    }
+
+    unsigned frameNum;
+    RC rc = getVictimFrame(fileHandle, frameNum);
+    if (rc)
+        return rc;
+
+    if (load)
+    {
+        rc = readFromDisk(key.file, pageNum, getFrameData(frameNum));
+        if (rc)
+            return rc;
+        fileHandle.physicalReadCounter++;
+        missCounter++;
+    }
+
+    BufferFrame &frame = frames[frameNum];
+    frame.file = key.file;
+    frame.pageNum = pageNum;
+    frame.pinCount = 1;
+    frame.dirty = false;
+    frame.referenced = true;
+    frame.lsn = 0;
+    frame.changes = 0;
+    pageTable[key] = frameNum;
+
+    data = getFrameData(frameNum);
+    return SUCCESS;
+}
+
+RC BufferManager::unpinPage(FileHandle &fileHandle, PageNum pageNum, bool dirty)
+{
+    PagedFile *file;
+    {
+        lock_guard<recursive_mutex> guard(poolMutex);
+        FrameKey key = {fileHandle.getFile(), pageNum};
+        auto it = pageTable.find(key);
+        if (it == pageTable.end())
+            return BM_PAGE_NOT_PINNED;
+
+        BufferFrame &frame = frames[it->second];
+        if (frame.pinCount == 0)
+            return BM_PAGE_NOT_PINNED;
+
+        frame.pinCount--;
+        if (!dirty)
+            return SUCCESS;
+
+        frame.dirty = true;
+        frame.changes++;
+        file = frame.file;
+        if (file->dirtyPages.empty())
+            file->dirtySince = chrono::steady_clock::now();
+        file->dirtyPages.insert(pageNum);
+
+        // With the log on, it is the log that is committed, and pages are written back lazily
+        if (LogManager::instance()->isEnabled())
+            return SUCCESS;
+
+        // Group commit
+        bool commit = (groupCommitPages > 0 && file->dirtyPages.size() >= groupCommitPages)
+            || (groupCommitInterval > 0
+                && chrono::steady_clock::now() - file->dirtySince >= chrono::milliseconds(groupCommitInterval));
+        if (!commit)
+            return SUCCESS;
+    }
+    // The caller may hold page latches, so the commit does not wait for any
+    return commitFile(fileHandle, file, false);
+}
+
+RC BufferManager::flushFile(FileHandle &fileHandle)
+{
+    if (!fileHandle.isOpen())
+        return -1;
+    return flushFile(fileHandle, fileHandle.getFile(), true);
+}
+
+RC BufferManager::flushAll()
+{
+    // The files cannot go away meanwhile: their frames are dropped under filesMutex first
+    PagedFileManager *pfm = PagedFileManager::instance();
+    lock_guard<recursive_mutex> filesGuard(pfm->filesMutex);
+    // No handle to charge the writes to
+    FileHandle nobody;
+    for (auto &entry : pfm->files)
+    {
+        RC rc = flushFile(nobody, entry.second, true);
+        if (rc)
+            return rc;
+    }
+    return SUCCESS;
+}
+
+RC BufferManager::collectStatistics(unsigned &hitCount, unsigned &missCount, unsigned &writeBackCount)
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    hitCount = hitCounter;
+    missCount = missCounter;
+    writeBackCount = writeBackCounter;
+    return SUCCESS;
+}
+
+void BufferManager::resetStatistics()
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    hitCounter = 0;
+    missCounter = 0;
+    writeBackCounter = 0;
+}
+
+void BufferManager::setGroupCommit(unsigned pageThreshold, unsigned intervalMillis)
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    groupCommitPages = pageThreshold;
+    groupCommitInterval = intervalMillis;
+}
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+// Clock replacement: sweep the frames, clearing reference bits, until we find
+// an unpinned frame that has not been used since the last sweep
+RC BufferManager::getVictimFrame(FileHandle &requester, unsigned &frameNum)
+{
+    // Two full sweeps are enough to clear every reference bit
+    for (unsigned n = 0; n < 2 * frames.size(); n++)
+    {
+        unsigned i = clockHand;
+        clockHand = (clockHand + 1) % frames.size();
+        BufferFrame &frame = frames[i];
+
+        if (frame.file == NULL)
+        {
+            frameNum = i;
+            return SUCCESS;
+        }
+        if (frame.pinCount > 0)
+            continue;
+        if (frame.referenced)
+        {
+            frame.referenced = false;
+            continue;
+        }
+
+        if (frame.dirty)
+        {
+            RC rc = writeBack(requester, i);
+            if (rc)
+                return rc;
+        }
+        FrameKey key = {frame.file, frame.pageNum};
+        pageTable.erase(key);
+        frame.file = NULL;
+        frameNum = i;
+        return SUCCESS;
+    }
+    return BM_NO_FREE_FRAME;
+}
+
+RC BufferManager::writeBack(FileHandle &requester, unsigned frameNum)
+{
+    BufferFrame &frame = frames[frameNum];
+    // Write-ahead: the log records of the page go to disk first
+    RC rc = LogManager::instance()->flushTo(frame.lsn);
+    if (rc)
+        return rc;
+    rc = writeToDisk(frame.file, frame.pageNum, getFrameData(frameNum));
+    if (rc)
+        return rc;
+    frame.dirty = false;
+    frame.file->dirtyPages.erase(frame.pageNum);
+    requester.physicalWriteCounter++;
+    writeBackCounter++;
+    return SUCCESS;
+}
+
+// Write back the file's dirty pages in file order. Runs of consecutive pages are
+// written with one system call. The frames in a run stay pinned until it is written, so
+// that none is evicted and written back over by its older copy, and the ones that have
+// not changed since they were copied are clean after.
+RC BufferManager::flushFile(FileHandle &requester, PagedFile *file, bool wait)
+{
+    unique_lock<mutex> flushGuard(file->flushMutex, defer_lock);
+    if (wait)
+        flushGuard.lock();
+    else if (!flushGuard.try_lock())
+        return SUCCESS;
+
+    vector<PageNum> pageNums;
+    {
+        lock_guard<recursive_mutex> guard(poolMutex);
+        pageNums.assign(file->dirtyPages.begin(), file->dirtyPages.end());
+    }
+    if (pageNums.empty())
+        return SUCCESS;
+
+    size_t maxRun = min(pageNums.size(), (size_t) IOV_MAX);
+    char *copies = (char*) malloc(maxRun * PAGE_SIZE);
+    if (copies == NULL)
+        return BM_MALLOC_FAILED;
+    vector<const void*> run;
+    vector<unsigned> runFrames;
+    vector<unsigned> runChanges;
+    PageNum runStart = 0;
+    RC rc = SUCCESS;
+
+    unsigned i = 0;
+    while (rc == SUCCESS && (i < pageNums.size() || !run.empty()))
+    {
+        // Extend the current run while the next page follows on
+        if (i < pageNums.size() && (run.empty() || pageNums[i] == runStart + run.size()) && run.size() < maxRun)
+        {
+            PageNum pageNum = pageNums[i++];
+            if (!FileHandle::latchPage(file, pageNum, false, wait))
+                continue;
+            {
+                lock_guard<recursive_mutex> guard(poolMutex);
+                FrameKey key = {file, pageNum};
+                auto it = pageTable.find(key);
+                // Unless it was written back by an eviction since
+                if (it != pageTable.end() && frames[it->second].dirty)
+                {
+                    BufferFrame &frame = frames[it->second];
+                    // Write-ahead: the log records of the page go to disk first
+                    rc = LogManager::instance()->flushTo(frame.lsn);
+                    if (rc == SUCCESS)
+                    {
+                        if (run.empty())
+                            runStart = pageNum;
+                        void *copy = copies + run.size() * PAGE_SIZE;
+                        memcpy(copy, getFrameData(it->second), PAGE_SIZE);
+                        frame.pinCount++;
+                        run.push_back(copy);
+                        runFrames.push_back(it->second);
+                        runChanges.push_back(frame.changes);
+                    }
+                }
+            }
+            FileHandle::unlatchPage(file, pageNum);
+            continue;
+        }
+        // Every page was left out
+        if (run.empty())
+            continue;
+
+        rc = writeToDisk(file, runStart, run);
+        lock_guard<recursive_mutex> guard(poolMutex);
+        for (unsigned j = 0; j < runFrames.size(); j++)
+        {
+            // Dropped with the file while it was written
+            BufferFrame &frame = frames[runFrames[j]];
+            if (frame.file != file || frame.pageNum != runStart + j)
+                continue;
+            frame.pinCount--;
+            if (rc == SUCCESS && frame.changes == runChanges[j])
+            {
+                frame.dirty = false;
+                file->dirtyPages.erase(frame.pageNum);
+            }
+        }
+        if (rc == SUCCESS)
+        {
+            requester.physicalWriteCounter += run.size();
+            writeBackCounter += run.size();
+        }
+        run.clear();
+        runFrames.clear();
+        runChanges.clear();
+    }
+
+    // A run cut short by a failed flush of the log still holds its pins
+    if (!run.empty())
+    {
+        lock_guard<recursive_mutex> guard(poolMutex);
+        for (unsigned j = 0; j < runFrames.size(); j++)
+        {
+            BufferFrame &frame = frames[runFrames[j]];
+            if (frame.file == file && frame.pageNum == runStart + j)
+                frame.pinCount--;
+        }
+    }
+    free(copies);
+    return rc;
+}
+
+// The sync waits for the disk, so it is done without poolMutex
+RC BufferManager::commitFile(FileHandle &requester, PagedFile *file, bool wait)
+{
+    RC rc = flushFile(requester, file, wait);
+    if (rc)
+        return rc;
+    if (fdatasync(fileno(file->fd)) != 0)
+        return FH_SYNC_FAILED;
+    return SUCCESS;
+}
+
+void BufferManager::dropFile(PagedFile *file)
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].file != file)
+            continue;
+        FrameKey key = {file, frames[i].pageNum};
+        pageTable.erase(key);
+        frames[i].file = NULL;
+        frames[i].pinCount = 0;
+        frames[i].dirty = false;
+        frames[i].referenced = false;
+    }
+    file->dirtyPages.clear();
+}
+
+void BufferManager::dropPage(FileHandle &fileHandle, PageNum pageNum)
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    FrameKey key = {fileHandle.getFile(), pageNum};
+    auto it = pageTable.find(key);
+    if (it == pageTable.end())
+        return;
+    BufferFrame &frame = frames[it->second];
+    if (frame.pinCount > 0 || frame.dirty)
+        return;
+    frame.file = NULL;
+    frame.referenced = false;
+    pageTable.erase(it);
+}
+
+void *BufferManager::getFrameData(unsigned frameNum)
+{
+    return frameData + (size_t) frameNum * PAGE_SIZE;
+}
+
+void BufferManager::setPageLSN(PagedFile *file, PageNum pageNum, uint64_t lsn)
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    FrameKey key = {file, pageNum};
+    auto it = pageTable.find(key);
+    if (it != pageTable.end())
+        frames[it->second].lsn = lsn;
+}
+
+bool BufferManager::copyDirtyPage(PagedFile *file, PageNum pageNum, void *data)
+{
+    lock_guard<recursive_mutex> guard(poolMutex);
+    FrameKey key = {file, pageNum};
+    auto it = pageTable.find(key);
+    if (it == pageTable.end() || !frames[it->second].dirty)
+        return false;
+    memcpy(data, getFrameData(it->second), PAGE_SIZE);
+    return true;
+}
+
+RC BufferManager::readFromDisk(PagedFile *file, PageNum pageNum, void *data)
+{
+    // Read the specified page
+    if (pread(fileno(file->fd), data, PAGE_SIZE, (off_t) PAGE_SIZE * pageNum) != PAGE_SIZE)
+        return FH_READ_FAILED;
+
+    return SUCCESS;
+}
+
+RC BufferManager::writeToDisk(PagedFile *file, PageNum pageNum, const void *data)
+{
+    if (file->fd == NULL)
+        return FH_WRITE_FAILED;
+
+    // Write the page. It is up to the caller to fdatasync if it has to be on disk.
+    if (pwrite(fileno(file->fd), data, PAGE_SIZE, (off_t) PAGE_SIZE * pageNum) != PAGE_SIZE)
+        return FH_WRITE_FAILED;
+
+    return SUCCESS;
+}
+
+RC BufferManager::writeToDisk(PagedFile *file, PageNum pageNum, const vector<const void*> &pages)
+{
+    if (file->fd == NULL)
+        return FH_WRITE_FAILED;
+
+    vector<struct iovec> iov(pages.size());
+    for (unsigned i = 0; i < pages.size(); i++)
+    {
+        iov[i].iov_base = (void*) pages[i];
+        iov[i].iov_len = PAGE_SIZE;
+    }
+    ssize_t size = (ssize_t) PAGE_SIZE * pages.size();
+    if (pwritev(fileno(file->fd), &iov[0], iov.size(), (off_t) PAGE_SIZE * pageNum) != size)
+        return FH_WRITE_FAILED;
+
+    return SUCCESS;
 }
 
-FILE *FileHandle::getfd()
+void BufferManager::flushAtExit()
 {
-    return _fd;
+    if (_bf_manager)
+        _bf_manager->flushAll();
 }
@@ -14,18 +14,129 @@
 #define FH_SEEK_FAILED    2
 #define FH_READ_FAILED    3
 #define FH_WRITE_FAILED   4
+#define FH_MAP_FAILED     5
+#define FH_SYNC_FAILED    6
+#define FH_NOT_LATCHED    7
+
+#define BM_NO_FREE_FRAME  1
+#define BM_PAGE_NOT_PINNED 2
+#define BM_FRAMES_PINNED  3
+#define BM_MALLOC_FAILED  4
 
 typedef unsigned PageNum;
 typedef int RC;
 typedef char byte;
 
 #define PAGE_SIZE 4096
+
+// Number of frames in the buffer pool until BufferManager::setNumberOfFrames() is called
+#define BM_DEFAULT_FRAME_COUNT 1024
+
+// Group commit triggers until BufferManager::setGroupCommit() is called: a file is
+// committed once it has this many dirty pages, or its oldest dirty page is this old
+#define BM_DEFAULT_GROUP_COMMIT_PAGES 256
+#define BM_DEFAULT_GROUP_COMMIT_INTERVAL 1000  // milliseconds
+
+// Smallest memory map of a file. Maps are twice the size of the file so it can grow
+// a while before it has to be mapped again.
+#define FH_MIN_MAP_SIZE (1024 * PAGE_SIZE)
+
+// Files kept open after their last close until PagedFileManager::setOpenFileBudget() is called
+#define PFM_DEFAULT_OPEN_FILE_BUDGET 64
+
 #include <string>
 #include <climits>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <set>
+#include <list>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <sys/types.h>
 using namespace std;
 
 class FileHandle;
 
+// Reader/writer latch, held for a short while by one thread. The thread that holds it
+// exclusively can take it again, in either mode. A shared holder cannot upgrade.
+// Shared requests only wait for an exclusive holder, not for waiting writers.
+class Latch
+{
+public:
+    Latch();
+    void lock(bool exclusive);
+    // lock() if it does not have to wait
+    bool tryLock(bool exclusive);
+    void unlock();
+
+private:
+    mutex stateMutex;
+    condition_variable released;
+    unsigned readers;
+    thread::id writer;
+    unsigned writerDepth;
+};
+
+// Latch of a page, while threads hold or wait for it
+struct PageLatch
+{
+    Latch latch;
+    unsigned users;
+
+    PageLatch() : users(0) {}
+};
+
+// All FileHandles opened on the same file share one PagedFile, and so one FILE* and
+// one set of buffered pages. The entry outlives the last close so that the buffer pool
+// can keep serving the file's pages the next time it is opened. The FILE* does too,
+// until the file is pushed out of the open file budget.
+struct PagedFile
+{
+    string fileName;
+    FILE *fd;
+    unsigned refCount;
+    // Position in the list of files that are open but have no handles, if fd is open and refCount is 0
+    list<PagedFile*>::iterator idlePos;
+    // Pages in the file while it is open. Read from the file size on open and kept up
+    // to date by appendPage(), so that page bounds checks do not need an fstat().
+    unsigned numberOfPages;
+
+    // What the file looked like on disk when it was last closed.
+    // If it has changed by the time it is reopened, its buffered pages are stale.
+    ino_t inode;
+    off_t size;
+    time_t mtime;
+
+    // Pages changed in the buffer pool and not written back yet, in file order,
+    // and when the first of them was changed
+    set<PageNum> dirtyPages;
+    chrono::steady_clock::time_point dirtySince;
+
+    // Read-only memory map of the file, used by memory mapped handles. Maps replaced
+    // by a bigger one are kept until the last close, as pages may still point into them.
+    char *map;
+    size_t mapSize;
+    vector<pair<char*, size_t> > oldMaps;
+
+    // Latches of the pages threads are working on, see FileHandle::latchPage()
+    mutex latchMutex;
+    unordered_map<PageNum, PageLatch> latches;
+    Latch fileLatch;
+    // Appends pick their page number under this
+    mutex appendMutex;
+    // Held while the dirty pages of the file are written back, so that two copies
+    // of a page never reach the file out of order
+    mutex flushMutex;
+
+    // See FileHandle::getVersion()
+    atomic<unsigned> version;
+};
+
 class PagedFileManager
 {
 public:
@@ -36,6 +147,20 @@ public:
     RC openFile      (const string &fileName, FileHandle &fileHandle);  // Open a file
     RC closeFile     (FileHandle &fileHandle);                          // Close a file
 
+    // A file stays open after its last handle is closed, so opening it again does not
+    // have to fopen() it. Up to budget such files are kept, and the least recently used
+    // one is closed for good when there are more. 0 closes files with their last handle.
+    // Files with open handles do not count against the budget and are never closed.
+    void setOpenFileBudget(unsigned budget);
+    unsigned getOpenFileBudget();
+    // Files currently open, with or without handles
+    unsigned getOpenFileCount();
+
+    // Opens that found the file still open (hits) and opens that had to fopen() it
+    // (misses), since the last resetStatistics()
+    RC collectStatistics(unsigned &hitCount, unsigned &missCount);
+    void resetStatistics();
+
 protected:
     PagedFileManager();                                                 // Constructor
     ~PagedFileManager();                                                // Destructor
@@ -43,8 +168,28 @@ protected:
 private:
     static PagedFileManager *_pf_manager;
 
+    recursive_mutex filesMutex;
+    // Every file that has been opened, by name
+    unordered_map<string, PagedFile*> files;
+    // Files open without handles, most recently closed first
+    list<PagedFile*> idleFiles;
+    unsigned openFileBudget;
+    unsigned openFileCount;
+
+    unsigned hitCounter;
+    unsigned missCounter;
+
     // Private helper methods
     bool fileExists(const string &fileName);
+    // Drop everything we know about fileName, including its buffered pages
+    void forgetFile(const string &fileName);
+    // Close the least recently used files without handles until we are within budget
+    void trimIdleFiles(unsigned budget);
+    // Close a file without handles for good
+    void closeIdleFile(PagedFile *file);
+
+    friend class LogManager;
+    friend class BufferManager;
 };
 
 
@@ -56,24 +201,198 @@ public:
     unsigned writePageCounter;
     unsigned appendPageCounter;
 
+    // Pages this handle actually had to read from or write to disk. The difference
+    // with the counters above is what the buffer pool saved us.
+    unsigned physicalReadCounter;
+    unsigned physicalWriteCounter;
+
     FileHandle();                                                       // Default constructor
     ~FileHandle();                                                      // Destructor
 
     RC readPage(PageNum pageNum, void *data);                           // Get a specific page
     RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
     RC appendPage(const void *data);                                    // Append a specific page
+    RC appendPage(const void *data, PageNum &pageNum);                  // Append a page, and tell which page it became
+    RC getPage(PageNum pageNum, const void *&data);                     // Point data at a specific page, see below
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
     RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);  // Put the current counter values into variables
+    RC collectPhysicalCounterValues(unsigned &readPageCount, unsigned &writePageCount);                      // Same for the physical I/O counters
+
+    // Write back every dirty page of the file and wait until it is on disk (fdatasync).
+    // Written pages otherwise reach the file when they are evicted, when the file is
+    // closed or at a group commit, and survive a crash only after a group commit.
+    RC sync();
+
+    // A memory mapped handle reads pages from a read-only map of the file instead of
+    // the buffer pool, and getPage() points straight into the map without copying.
+    // Meant for scans of tables that are mostly read. Writes still go through the pool.
+    // getPage() on a handle that is not memory mapped copies the page into the handle.
+    // Either way the page must not be modified, and the pointer is good until the next
+    // getPage() on the handle (memory mapped: until the file is closed).
+    void setMemoryMapped(bool memoryMapped);
+    bool isMemoryMapped();
 
-    // Let PagedFileManager access our private helper methods
+    // Page latches, shared by every handle on the file. readPage() and writePage() take the
+    // latch of the page for the copy, so a page is never read half written. A change that
+    // reads a page, modifies it and writes it back holds the exclusive latch throughout.
+    // Memory mapped reads (getPage()) are not latched.
+    RC latchPage(PageNum pageNum, bool exclusive);
+    RC unlatchPage(PageNum pageNum);
+    // Latch of the file as a whole, for changes that restructure it
+    void latchFile(bool exclusive);
+    void unlatchFile();
+
+    // A counter shared by every handle on the file, for the layers above that keep copies
+    // of pages between operations: when it has moved on, the copies may be stale. It only
+    // changes on bumpVersion(), which the layer above calls when it writes such a page.
+    unsigned getVersion();
+    void bumpVersion();
+
+    // Let PagedFileManager and BufferManager access our private helper methods
     friend class PagedFileManager;
+    friend class BufferManager;
 
 private:
-    FILE *_fd;
+    PagedFile *_file;
+    bool memoryMapped;
+    // Copy of the last page returned by getPage() when it could not point into the map
+    vector<char> pageBuffer;
 
     // Private helper methods
-    void setfd(FILE *fd);
-    FILE *getfd();
+    void setFile(PagedFile *file);
+    PagedFile *getFile();
+    bool isOpen();
+    RC mapFile();
+    static void unmapFile(PagedFile *file);
+    // appendPage() under the append mutex
+    RC appendToFile(const void *data, PageNum &pageNum);
+    // latchPage() and unlatchPage() on a file that may have no handle. If wait is false,
+    // the latch is only taken if that can be done right away.
+    static bool latchPage(PagedFile *file, PageNum pageNum, bool exclusive, bool wait);
+    static RC unlatchPage(PagedFile *file, PageNum pageNum);
+};
+
+
+// A frame of the buffer pool
+typedef struct BufferFrame
+{
+    PagedFile *file;        // NULL if the frame is free
+    PageNum pageNum;
+    unsigned pinCount;
+    bool dirty;
+    bool referenced;        // Second chance bit for the clock
+    uint64_t lsn;           // LSN of the last log record of the page, see wal.h
+    unsigned changes;       // Times the frame was unpinned dirty, so a flush can tell it changed
+} BufferFrame;
+
+typedef struct FrameKey
+{
+    PagedFile *file;
+    PageNum pageNum;
+
+    bool operator==(const FrameKey &other) const
+    {
+        return file == other.file && pageNum == other.pageNum;
+    }
+} FrameKey;
+
+struct FrameKeyHash
+{
+    size_t operator()(const FrameKey &key) const
+    {
+        return hash<uintptr_t>()((uintptr_t)key.file) ^ (key.pageNum * 2654435761u);
+    }
+};
+
+// Process-wide pool of page frames shared by every FileHandle. Pages are replaced with
+// the clock algorithm, and dirty pages are written back when they are evicted or when
+// the last handle on their file is closed. Safe to use from several threads.
+class BufferManager
+{
+public:
+    static BufferManager* instance();
+
+    // Resize the pool. Dirty pages are written back first. Fails if any page is pinned.
+    RC setNumberOfFrames(unsigned frameCount);
+    unsigned getNumberOfFrames();
+
+    // Pin a page of an open file in the pool and point frameData at its frame.
+    // The frame stays valid until the matching unpinPage().
+    RC pinPage(FileHandle &fileHandle, PageNum pageNum, void *&frameData);
+    // Drop a pin. Pass dirty = true if the frame has been modified.
+    RC unpinPage(FileHandle &fileHandle, PageNum pageNum, bool dirty);
+
+    // Write back all dirty pages of the handle's file
+    RC flushFile(FileHandle &fileHandle);
+    // Write back all dirty pages in the pool
+    RC flushAll();
+
+    // Group commit: once a file has pageThreshold dirty pages, or its oldest dirty page
+    // was changed intervalMillis milliseconds ago, its dirty pages are written back and
+    // synced to disk together. 0 turns a trigger off.
+    void setGroupCommit(unsigned pageThreshold, unsigned intervalMillis);
+
+    // Page requests served from the pool (hits), requests that had to read the disk (misses)
+    // and dirty pages written back, over all files since the last resetStatistics()
+    RC collectStatistics(unsigned &hitCount, unsigned &missCount, unsigned &writeBackCount);
+    void resetStatistics();
+
+    friend class PagedFileManager;
+    friend class FileHandle;
+
+protected:
+    BufferManager();
+    ~BufferManager();
+
+private:
+    static BufferManager *_bf_manager;
+
+    // Guards the frames and the page table. The contents of a pinned frame are guarded by
+    // the latch of its page instead, which is taken before this mutex, never after.
+    recursive_mutex poolMutex;
+    vector<BufferFrame> frames;
+    char *frameData;
+    unsigned clockHand;
+    unordered_map<FrameKey, unsigned, FrameKeyHash> pageTable;
+
+    unsigned hitCounter;
+    unsigned missCounter;
+    unsigned writeBackCounter;
+
+    unsigned groupCommitPages;
+    unsigned groupCommitInterval;
+
+    // Pin a page. If load is false the caller is about to overwrite the whole frame,
+    // so a page that is not already buffered is not read from disk. Until then the frame
+    // holds whatever it held before: the caller latches the page exclusively first, or
+    // pins a page nobody else can ask for yet.
+    RC pinPage(FileHandle &fileHandle, PageNum pageNum, void *&frameData, bool load);
+
+    // Find a frame to hold a new page, writing back its old page if needed
+    RC getVictimFrame(FileHandle &requester, unsigned &frameNum);
+    RC writeBack(FileHandle &requester, unsigned frameNum);
+    // Write back the file's dirty pages. Each one is copied under its latch and the copies
+    // are written without holding anything. If wait is false nothing is waited for: pages
+    // that are latched exclusively, or a flush of the file that is already running, are
+    // left for the next one.
+    RC flushFile(FileHandle &requester, PagedFile *file, bool wait);
+    // Write back the file's dirty pages and fdatasync it
+    RC commitFile(FileHandle &requester, PagedFile *file, bool wait);
+    // Throw away every frame of file without writing anything back
+    void dropFile(PagedFile *file);
+    // Throw away the frame of a page, unless it is pinned or dirty
+    void dropPage(FileHandle &fileHandle, PageNum pageNum);
+    void *getFrameData(unsigned frameNum);
+    // Set the LSN of a buffered page
+    void setPageLSN(PagedFile *file, PageNum pageNum, uint64_t lsn);
+    // Copy the page into data if it is buffered and dirty, i.e. newer than the file
+    bool copyDirtyPage(PagedFile *file, PageNum pageNum, void *data);
+
+    static RC readFromDisk(PagedFile *file, PageNum pageNum, void *data);
+    static RC writeToDisk(PagedFile *file, PageNum pageNum, const void *data);
+    // Write consecutive pages, the first one at pageNum, with a single system call
+    static RC writeToDisk(PagedFile *file, PageNum pageNum, const vector<const void*> &pages);
+    static void flushAtExit();
 };
 
 #endif
@@ -0,0 +1,219 @@
+#include "predicate.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PREDICATE_SIMD
+#endif
+
+static PredicateKernel &activeKernel()
+{
+    static PredicateKernel kernel = getBestPredicateKernel();
+    return kernel;
+}
+
+PredicateKernel getBestPredicateKernel()
+{
+#ifdef PREDICATE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return PK_AVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return PK_SSE42;
+#endif
+    return PK_SCALAR;
+}
+
+PredicateKernel getPredicateKernel()
+{
+    return activeKernel();
+}
+
+bool setPredicateKernel(PredicateKernel kernel)
+{
+    if (kernel > getBestPredicateKernel())
+        return false;
+    activeKernel() = kernel;
+    return true;
+}
+
+// OP is known at compile time, so the switch folds away
+template <CompOp OP, typename T>
+static inline bool compareValue(T x, T value)
+{
+    switch (OP)
+    {
+        case EQ_OP: return x == value;
+        case LT_OP: return x <  value;
+        case GT_OP: return x >  value;
+        case LE_OP: return x <= value;
+        case GE_OP: return x >= value;
+        case NE_OP: return x != value;
+        default: return true;
+    }
+}
+
+// Values from begin to n, one at a time. The vector kernels finish their tails with it.
+template <CompOp OP, typename T>
+static inline void scalarKernel(const T *values, unsigned begin, unsigned n, T value, uint64_t *mask)
+{
+    for (unsigned i = begin; i < n; i++)
+        mask[i / 64] |= (uint64_t) compareValue<OP>(values[i], value) << (i % 64);
+}
+
+#ifdef PREDICATE_SIMD
+
+// The integer compares only come as ==, > and <. LE, GE and NE are the complements
+// of GT, LT and EQ, so their lane bits are flipped.
+template <CompOp OP>
+static inline bool isComplement()
+{
+    return OP == LE_OP || OP == GE_OP || OP == NE_OP;
+}
+
+template <CompOp OP>
+__attribute__((target("sse4.2")))
+static void sse42Kernel(const int32_t *values, unsigned n, int32_t value, uint64_t *mask)
+{
+    __m128i rhs = _mm_set1_epi32(value);
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*) (values + i));
+        __m128i result;
+        if (OP == EQ_OP || OP == NE_OP)
+            result = _mm_cmpeq_epi32(x, rhs);
+        else if (OP == LT_OP || OP == GE_OP)
+            result = _mm_cmplt_epi32(x, rhs);
+        else
+            result = _mm_cmpgt_epi32(x, rhs);
+        unsigned bits = _mm_movemask_ps(_mm_castsi128_ps(result));
+        if (isComplement<OP>())
+            bits ^= 0xF;
+        // 4 divides 64, so the bits never straddle two words
+        mask[i / 64] |= (uint64_t) bits << (i % 64);
+    }
+    scalarKernel<OP>(values, i, n, value, mask);
+}
+
+template <CompOp OP>
+__attribute__((target("sse4.2")))
+static void sse42Kernel(const float *values, unsigned n, float value, uint64_t *mask)
+{
+    __m128 rhs = _mm_set1_ps(value);
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(values + i);
+        __m128 result;
+        switch (OP)
+        {
+            case EQ_OP: result = _mm_cmpeq_ps(x, rhs); break;
+            case LT_OP: result = _mm_cmplt_ps(x, rhs); break;
+            case GT_OP: result = _mm_cmpgt_ps(x, rhs); break;
+            case LE_OP: result = _mm_cmple_ps(x, rhs); break;
+            case GE_OP: result = _mm_cmpge_ps(x, rhs); break;
+            default:    result = _mm_cmpneq_ps(x, rhs); break;
+        }
+        mask[i / 64] |= (uint64_t) _mm_movemask_ps(result) << (i % 64);
+    }
+    scalarKernel<OP>(values, i, n, value, mask);
+}
+
+template <CompOp OP>
+__attribute__((target("avx2")))
+static void avx2Kernel(const int32_t *values, unsigned n, int32_t value, uint64_t *mask)
+{
+    __m256i rhs = _mm256_set1_epi32(value);
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (values + i));
+        __m256i result;
+        if (OP == EQ_OP || OP == NE_OP)
+            result = _mm256_cmpeq_epi32(x, rhs);
+        else if (OP == LT_OP || OP == GE_OP)
+            result = _mm256_cmpgt_epi32(rhs, x);
+        else
+            result = _mm256_cmpgt_epi32(x, rhs);
+        unsigned bits = _mm256_movemask_ps(_mm256_castsi256_ps(result));
+        if (isComplement<OP>())
+            bits ^= 0xFF;
+        mask[i / 64] |= (uint64_t) bits << (i % 64);
+    }
+    scalarKernel<OP>(values, i, n, value, mask);
+}
+
+template <CompOp OP>
+__attribute__((target("avx2")))
+static void avx2Kernel(const float *values, unsigned n, float value, uint64_t *mask)
+{
+    __m256 rhs = _mm256_set1_ps(value);
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(values + i);
+        __m256 result;
+        // Ordered compares are false for NaN, and the unordered != is true, as in C++
+        switch (OP)
+        {
+            case EQ_OP: result = _mm256_cmp_ps(x, rhs, _CMP_EQ_OQ); break;
+            case LT_OP: result = _mm256_cmp_ps(x, rhs, _CMP_LT_OQ); break;
+            case GT_OP: result = _mm256_cmp_ps(x, rhs, _CMP_GT_OQ); break;
+            case LE_OP: result = _mm256_cmp_ps(x, rhs, _CMP_LE_OQ); break;
+            case GE_OP: result = _mm256_cmp_ps(x, rhs, _CMP_GE_OQ); break;
+            default:    result = _mm256_cmp_ps(x, rhs, _CMP_NEQ_UQ); break;
+        }
+        mask[i / 64] |= (uint64_t) _mm256_movemask_ps(result) << (i % 64);
+    }
+    scalarKernel<OP>(values, i, n, value, mask);
+}
+
+#endif
+
+template <CompOp OP, typename T>
+static void runKernel(const T *values, unsigned n, T value, uint64_t *mask)
+{
+    switch (activeKernel())
+    {
+#ifdef PREDICATE_SIMD
+        case PK_AVX2:  avx2Kernel<OP>(values, n, value, mask); break;
+        case PK_SSE42: sse42Kernel<OP>(values, n, value, mask); break;
+#endif
+        default: scalarKernel<OP>(values, 0, n, value, mask); break;
+    }
+}
+
+template <typename T>
+static void evaluate(const T *values, unsigned n, CompOp compOp, T value, uint64_t *mask)
+{
+    unsigned words = (n + 63) / 64;
+    memset(mask, 0, words * sizeof(uint64_t));
+    switch (compOp)
+    {
+        case EQ_OP: runKernel<EQ_OP>(values, n, value, mask); break;
+        case LT_OP: runKernel<LT_OP>(values, n, value, mask); break;
+        case GT_OP: runKernel<GT_OP>(values, n, value, mask); break;
+        case LE_OP: runKernel<LE_OP>(values, n, value, mask); break;
+        case GE_OP: runKernel<GE_OP>(values, n, value, mask); break;
+        case NE_OP: runKernel<NE_OP>(values, n, value, mask); break;
+        case NO_OP:
+            memset(mask, 0xFF, words * sizeof(uint64_t));
+            if (n % 64)
+                mask[words - 1] = (1ULL << (n % 64)) - 1;
+            break;
+        // Should never happen
+        default: break;
+    }
+}
+
+void evaluatePredicate(const int32_t *values, unsigned n, CompOp compOp, int32_t value, uint64_t *mask)
+{
+    evaluate(values, n, compOp, value, mask);
+}
+
+void evaluatePredicate(const float *values, unsigned n, CompOp compOp, float value, uint64_t *mask)
+{
+    evaluate(values, n, compOp, value, mask);
+}
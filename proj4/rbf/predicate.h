@@ -0,0 +1,28 @@
+#ifndef _predicate_h_
+#define _predicate_h_
+
+#include <stdint.h>
+
+#include "rbfm.h"
+
+// Compare kernels, evaluating one predicate over a whole column of INT or REAL values.
+// They set bit (i % 64) of mask[i / 64] if "values[i] compOp value" holds and clear it
+// otherwise. mask has to hold (n + 63) / 64 words; the bits past n are cleared too.
+// NO_OP selects every value.
+//
+// The first call picks the widest kernel the CPU supports: AVX2 compares 8 values at
+// once, SSE4.2 compares 4, and the scalar kernel one at a time.
+
+typedef enum { PK_SCALAR = 0, PK_SSE42, PK_AVX2 } PredicateKernel;
+
+void evaluatePredicate(const int32_t *values, unsigned n, CompOp compOp, int32_t value, uint64_t *mask);
+void evaluatePredicate(const float *values, unsigned n, CompOp compOp, float value, uint64_t *mask);
+
+// Widest kernel the CPU supports
+PredicateKernel getBestPredicateKernel();
+// Kernel in use
+PredicateKernel getPredicateKernel();
+// Uses another kernel. Returns false, and keeps the current one, if the CPU does not support it.
+bool setPredicateKernel(PredicateKernel kernel);
+
+#endif
@@ -0,0 +1,291 @@
+#include <string.h>
+#include <algorithm>
+
+#include "pscan.h"
+
+RC RecordBasedFileManager::parallelScan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      const vector<string> &attributeNames,
+      RBFM_ParallelScanIterator &rbfm_ParallelScanIterator,
+      unsigned numThreads,
+      unsigned morselPages)
+{
+    return rbfm_ParallelScanIterator.start(fileHandle, recordDescriptor, conditionAttribute, compOp, value,
+            attributeNames, NULL, numThreads, morselPages);
+}
+
+RC RecordBasedFileManager::parallelScan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      const vector<string> &attributeNames,
+      const ScanConsumer &consumer,
+      unsigned numThreads,
+      unsigned morselPages)
+{
+    RBFM_ParallelScanIterator iterator;
+    RC rc = iterator.start(fileHandle, recordDescriptor, conditionAttribute, compOp, value,
+            attributeNames, &consumer, numThreads, morselPages);
+    if (rc)
+        return rc;
+    return iterator.join();
+}
+
+RBFM_ParallelScanIterator::RBFM_ParallelScanIterator()
+: consumer(NULL), stopping(false), morselCounter(0), stolenCounter(0),
+  resultCapacity(0), runningWorkers(0), workerError(SUCCESS), currentRecord(0)
+{
+}
+
+RBFM_ParallelScanIterator::~RBFM_ParallelScanIterator()
+{
+    close();
+}
+
+RC RBFM_ParallelScanIterator::getNextRecord(RID &rid, void *data)
+{
+    // Done with this batch, wait for the next one
+    if (currentRecord >= current.rids.size())
+    {
+        unique_lock<mutex> guard(resultMutex);
+        notEmpty.wait(guard, [&]{ return !results.empty() || runningWorkers == 0 || workerError != SUCCESS; });
+        if (workerError != SUCCESS)
+            return workerError;
+        if (results.empty())
+            return RBFM_EOF;
+
+        current = move(results.front());
+        results.pop_front();
+        currentRecord = 0;
+        notFull.notify_one();
+    }
+
+    // A record ends where the next one starts
+    unsigned begin = current.offsets[currentRecord];
+    unsigned end = currentRecord + 1 < current.offsets.size() ? current.offsets[currentRecord + 1] : current.data.size();
+    rid = current.rids[currentRecord++];
+    if (end > begin)
+        memcpy(data, &current.data[begin], end - begin);
+    return SUCCESS;
+}
+
+RC RBFM_ParallelScanIterator::close()
+{
+    {
+        lock_guard<mutex> guard(resultMutex);
+        stopping = true;
+        notFull.notify_all();
+    }
+    join();
+
+    results.clear();
+    current = Batch();
+    currentRecord = 0;
+    return SUCCESS;
+}
+
+unsigned RBFM_ParallelScanIterator::getNumberOfWorkers()
+{
+    return morselQueues.size();
+}
+
+RC RBFM_ParallelScanIterator::collectStatistics(unsigned &morselCount, unsigned &stolenCount)
+{
+    morselCount = morselCounter;
+    stolenCount = stolenCounter;
+    return SUCCESS;
+}
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+RC RBFM_ParallelScanIterator::start(FileHandle &fh,
+        const vector<Attribute> &rd,
+        const string &ca,
+        const CompOp co,
+        const void *v,
+        const vector<string> &an,
+        const ScanConsumer *c,
+        unsigned numThreads,
+        unsigned morselPages)
+{
+    if (!workers.empty())
+        return PSCAN_ALREADY_OPEN;
+    if (numThreads == 0)
+        numThreads = thread::hardware_concurrency();
+    if (numThreads == 0)
+        return PSCAN_NO_WORKERS;
+    if (morselPages == 0)
+        morselPages = RBFM_MORSEL_PAGES;
+
+    // A bad condition or projection is reported here rather than by every worker
+    RBFM_ScanIterator check;
+    RC rc = check.scanInit(fh, rd, ca, co, v, an);
+    if (rc)
+        return rc;
+
+    fileHandle = fh;
+    recordDescriptor = rd;
+    conditionAttribute = ca;
+    compOp = co;
+    value = v;
+    attributeNames = an;
+    consumer = c;
+
+    // A memory mapped handle maps the file again once it has grown past the map. Have
+    // that happen now, rather than on several workers at once.
+    unsigned numPages = fileHandle.getNumberOfPages();
+    if (numPages > 0 && fileHandle.isMemoryMapped())
+    {
+        const void *page;
+        if (fileHandle.getPage(numPages - 1, page))
+            return RBFM_READ_FAILED;
+    }
+
+    // Deal the morsels out in turn, so every worker starts at the front of the file
+    morselQueues.clear();
+    for (unsigned i = 0; i < numThreads; i++)
+        morselQueues.push_back(unique_ptr<MorselQueue>(new MorselQueue));
+    unsigned worker = 0;
+    for (PageNum first = 0; first < numPages; first += morselPages)
+    {
+        Morsel morsel;
+        morsel.first = first;
+        morsel.end = min(first + morselPages, numPages);
+        morselQueues[worker]->morsels.push_back(morsel);
+        worker = (worker + 1) % numThreads;
+    }
+
+    stopping = false;
+    morselCounter = 0;
+    stolenCounter = 0;
+    results.clear();
+    resultCapacity = numThreads * PSCAN_QUEUE_BATCHES;
+    runningWorkers = numThreads;
+    workerError = SUCCESS;
+    current = Batch();
+    currentRecord = 0;
+
+    for (unsigned i = 0; i < numThreads; i++)
+        workers.push_back(thread(&RBFM_ParallelScanIterator::runWorker, this, i));
+    return SUCCESS;
+}
+
+RC RBFM_ParallelScanIterator::join()
+{
+    for (thread &t : workers)
+        t.join();
+    workers.clear();
+    return workerError;
+}
+
+void RBFM_ParallelScanIterator::runWorker(unsigned worker)
+{
+    RBFM_ScanIterator scanner;
+    RC rc = scanner.scanInit(fileHandle, recordDescriptor, conditionAttribute, compOp, value, attributeNames);
+
+    // A projected record is never larger than the record on its page
+    vector<char> record(PAGE_SIZE);
+    Batch batch;
+    Morsel morsel;
+    while (rc == SUCCESS && getNextMorsel(worker, morsel))
+    {
+        scanner.setPageRange(morsel.first, morsel.end);
+        RID rid;
+        unsigned size;
+        while (rc == SUCCESS)
+        {
+            rc = scanner.getNextRecord(rid, &record[0], size);
+            if (rc == RBFM_EOF)
+            {
+                rc = SUCCESS;
+                break;
+            }
+            if (rc)
+                break;
+
+            if (consumer != NULL)
+            {
+                rc = (*consumer)(worker, rid, &record[0]);
+                continue;
+            }
+
+            batch.rids.push_back(rid);
+            batch.offsets.push_back(batch.data.size());
+            batch.data.insert(batch.data.end(), record.begin(), record.begin() + size);
+            // Stopping, the next getNextMorsel() ends the loop
+            if (batch.rids.size() >= PSCAN_BATCH_RECORDS && !pushBatch(batch))
+                break;
+        }
+    }
+
+    if (rc == SUCCESS && !batch.rids.empty())
+        pushBatch(batch);
+    finishWorker(rc);
+}
+
+bool RBFM_ParallelScanIterator::getNextMorsel(unsigned worker, Morsel &morsel)
+{
+    if (stopping)
+        return false;
+
+    // Our own morsels first, from the front
+    {
+        MorselQueue &own = *morselQueues[worker];
+        lock_guard<mutex> guard(own.queueMutex);
+        if (!own.morsels.empty())
+        {
+            morsel = own.morsels.front();
+            own.morsels.pop_front();
+            morselCounter++;
+            return true;
+        }
+    }
+
+    // Then from the back of the first worker that still has some. No morsels are added
+    // once the scan has started, so if nobody has any the file is done.
+    for (unsigned i = 1; i < morselQueues.size(); i++)
+    {
+        MorselQueue &victim = *morselQueues[(worker + i) % morselQueues.size()];
+        lock_guard<mutex> guard(victim.queueMutex);
+        if (!victim.morsels.empty())
+        {
+            morsel = victim.morsels.back();
+            victim.morsels.pop_back();
+            morselCounter++;
+            stolenCounter++;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RBFM_ParallelScanIterator::pushBatch(Batch &batch)
+{
+    unique_lock<mutex> guard(resultMutex);
+    notFull.wait(guard, [&]{ return stopping || results.size() < resultCapacity; });
+    if (stopping)
+        return false;
+
+    results.push_back(move(batch));
+    batch = Batch();
+    notEmpty.notify_one();
+    return true;
+}
+
+void RBFM_ParallelScanIterator::finishWorker(RC rc)
+{
+    lock_guard<mutex> guard(resultMutex);
+    // The first error ends the scan for everyone
+    if (rc != SUCCESS && workerError == SUCCESS)
+    {
+        workerError = rc;
+        stopping = true;
+        notFull.notify_all();
+    }
+    runningWorkers--;
+    notEmpty.notify_all();
+}
@@ -0,0 +1,130 @@
+#ifndef _pscan_h_
+#define _pscan_h_
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rbfm.h"
+
+#define PSCAN_NO_WORKERS    1
+#define PSCAN_ALREADY_OPEN  2
+
+// Records a worker puts in a batch before it goes on the queue
+#define PSCAN_BATCH_RECORDS 256
+// Batches the queue holds for each worker before the workers wait for the reader
+#define PSCAN_QUEUE_BATCHES 4
+
+// Parallel scan of a record based file
+//
+// The pages of the file are cut into morsels of RBFM_MORSEL_PAGES pages, dealt out
+// in turn to the workers' own queues. A worker takes morsels from the front of its
+// queue, and once that is empty, steals from the back of the others', so a worker
+// that got slow pages does not hold the scan up. Each worker goes through its
+// morsels with its own RBFM_ScanIterator, so the condition and the projection are
+// applied on the worker, and only the records that qualify leave it.
+//
+// Those records are handed over in batches through a bounded queue, and read with
+// getNextRecord() like from RBFM_ScanIterator, or given straight to a ScanConsumer
+// on the worker (see RecordBasedFileManager::parallelScan()).
+//
+// Every worker reads the pages through its own copy of the file handle. On a memory
+// mapped handle they read the map and do not meet at all; otherwise every page goes
+// through the buffer pool, which takes its mutex for each one.
+//
+//  RBFM_ParallelScanIterator iterator;
+//  rbfm->parallelScan(..., iterator);
+//  while (iterator.getNextRecord(rid, data) != RBFM_EOF) {
+//    process the data;
+//  }
+//  iterator.close();
+class RBFM_ParallelScanIterator {
+public:
+  RBFM_ParallelScanIterator();
+  ~RBFM_ParallelScanIterator();
+
+  // Returns the records in no particular order. A worker running into an error ends
+  // the scan, and its error is returned instead of RBFM_EOF.
+  RC getNextRecord(RID &rid, void *data);
+  // Stops the workers if they are not done, and waits for them
+  RC close();
+
+  unsigned getNumberOfWorkers();
+  // Morsels the workers went through, and how many of them were stolen from another worker
+  RC collectStatistics(unsigned &morselCount, unsigned &stolenCount);
+
+  friend class RecordBasedFileManager;
+
+private:
+  typedef struct Morsel
+  {
+      PageNum first;
+      PageNum end;    // One past the last page
+  } Morsel;
+
+  // The morsels not taken yet of a worker
+  struct MorselQueue
+  {
+      mutex queueMutex;
+      deque<Morsel> morsels;
+  };
+
+  // Records found by a worker. Record i starts at data[offsets[i]], and ends where the next one starts.
+  struct Batch
+  {
+      vector<RID> rids;
+      vector<unsigned> offsets;
+      vector<char> data;
+  };
+
+  FileHandle fileHandle;
+  vector<Attribute> recordDescriptor;
+  string conditionAttribute;
+  CompOp compOp;
+  const void *value;
+  vector<string> attributeNames;
+  const ScanConsumer *consumer;
+
+  vector<thread> workers;
+  vector<unique_ptr<MorselQueue> > morselQueues;
+  atomic<bool> stopping;
+  atomic<unsigned> morselCounter;
+  atomic<unsigned> stolenCounter;
+
+  // The batches on their way to getNextRecord(), guarded by resultMutex
+  mutex resultMutex;
+  condition_variable notFull;
+  condition_variable notEmpty;
+  deque<Batch> results;
+  unsigned resultCapacity;
+  unsigned runningWorkers;
+  RC workerError;
+
+  // The batch getNextRecord() is going through
+  Batch current;
+  unsigned currentRecord;
+
+  RC start(FileHandle &fh,
+        const vector<Attribute> &rd,
+        const string &ca,
+        const CompOp co,
+        const void *v,
+        const vector<string> &an,
+        const ScanConsumer *c,
+        unsigned numThreads,
+        unsigned morselPages);
+  // Waits for the workers, and returns the first error any of them ran into
+  RC join();
+
+  void runWorker(unsigned worker);
+  bool getNextMorsel(unsigned worker, Morsel &morsel);
+  // Puts a batch on the queue, waiting for room. Returns false if the scan is stopping.
+  bool pushBatch(Batch &batch);
+  void finishWorker(RC rc);
+};
+
+#endif
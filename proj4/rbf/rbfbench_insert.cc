@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cassert>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Insert throughput benchmark
+// Inserts numRecords records into a fresh file and reports, for every batch of
+// batchSize records, how long the batch took and how many pages each insert read.
+// With the free space map both should stay flat as the file grows.
+//
+// Usage: ./rbfbench_insert [numRecords] [batchSize]
+int main(int argc, char **argv)
+{
+    unsigned numRecords = 1000000;
+    unsigned batchSize = 100000;
+    if (argc > 1)
+        numRecords = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        batchSize = strtoul(argv[2], NULL, 10);
+    if (batchSize == 0)
+        batchSize = numRecords;
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    string fileName = "bench_insert";
+    remove(fileName.c_str());
+
+    RC rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    int recordSize = 0;
+    RID rid;
+
+    cout << setw(12) << "records" << setw(12) << "pages" << setw(16) << "inserts/sec" << setw(16) << "reads/insert" << endl;
+
+    unsigned inserted = 0;
+    while (inserted < numRecords)
+    {
+        unsigned batch = min(batchSize, numRecords - inserted);
+
+        unsigned readBefore, writeBefore, appendBefore;
+        fileHandle.collectCounterValues(readBefore, writeBefore, appendBefore);
+        auto start = chrono::steady_clock::now();
+
+        for (unsigned i = 0; i < batch; i++)
+        {
+            // Vary the record size a little so pages don't all fill up the same way
+            int nameLength = 8 + (inserted + i) % 24;
+            string name(nameLength, 'a' + (inserted + i) % 26);
+            prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, name, inserted + i, 170.1, 5000, record, &recordSize);
+            rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+            assert(rc == success && "Inserting a record should not fail.");
+        }
+
+        auto end = chrono::steady_clock::now();
+        unsigned readAfter, writeAfter, appendAfter;
+        fileHandle.collectCounterValues(readAfter, writeAfter, appendAfter);
+        inserted += batch;
+
+        double seconds = chrono::duration<double>(end - start).count();
+        cout << setw(12) << inserted
+             << setw(12) << fileHandle.getNumberOfPages()
+             << setw(16) << fixed << setprecision(0) << batch / seconds
+             << setw(16) << setprecision(2) << (double) (readAfter - readBefore) / batch << endl;
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "pscan.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Parallel scan benchmark
+// Scans a file of numRecords records with a condition that keeps one in ten, on 1, 2,
+// 4, ... up to maxThreads workers, for a buffered and a memory mapped handle, and reports
+// the records scanned per second. The "scan" line is RBFM_ScanIterator on one thread.
+// The file is scanned once before timing, so the pages are in the buffer pool or the
+// page cache: this measures the scan, not the disk.
+//
+// Usage: ./rbfbench_pscan [numRecords] [maxThreads]
+
+const string fileName = "bench_pscan";
+
+int main(int argc, char **argv)
+{
+    unsigned numRecords = 1000000;
+    unsigned maxThreads = thread::hardware_concurrency();
+    if (argc > 1)
+        numRecords = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        maxThreads = strtoul(argv[2], NULL, 10);
+    if (maxThreads == 0)
+        maxThreads = 1;
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    remove(fileName.c_str());
+
+    RC rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    int recordSize = 0;
+    RID rid;
+    for (unsigned i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", i % 100, 170.1, i, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+
+    vector<string> attributeNames;
+    attributeNames.push_back("EmpName");
+    attributeNames.push_back("Salary");
+    int ageLimit = 10;
+    char data[PAGE_SIZE];
+
+    cout << numRecords << " records, " << fileHandle.getNumberOfPages() << " pages" << endl;
+    cout << setw(12) << "handle" << setw(10) << "threads" << setw(16) << "records/sec" << setw(12) << "stolen" << endl;
+
+    for (int memoryMapped = 0; memoryMapped <= 1; memoryMapped++)
+    {
+        fileHandle.setMemoryMapped(memoryMapped);
+        const char *handle = memoryMapped ? "mapped" : "buffered";
+
+        // Warm up, and the time on one thread without any of the parallel machinery
+        RBFM_ScanIterator rbfm_ScanIterator;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            auto start = chrono::steady_clock::now();
+            rc = rbfm->scan(fileHandle, recordDescriptor, "Age", LT_OP, &ageLimit, attributeNames, rbfm_ScanIterator);
+            assert(rc == success && "Scanning a file should not fail.");
+            while (rbfm_ScanIterator.getNextRecord(rid, data) != RBFM_EOF)
+                ;
+            rbfm_ScanIterator.close();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (pass == 1)
+                cout << setw(12) << handle << setw(10) << "scan" << setw(16) << fixed << setprecision(0)
+                     << numRecords / seconds << setw(12) << "-" << endl;
+        }
+
+        for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+        {
+            auto start = chrono::steady_clock::now();
+            RBFM_ParallelScanIterator iterator;
+            rc = rbfm->parallelScan(fileHandle, recordDescriptor, "Age", LT_OP, &ageLimit, attributeNames,
+                    iterator, numThreads);
+            assert(rc == success && "Starting a parallel scan should not fail.");
+            unsigned count = 0;
+            while (iterator.getNextRecord(rid, data) != RBFM_EOF)
+                count++;
+            iterator.close();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            assert(count == numRecords / 10 && "The scan should find one record in ten.");
+
+            unsigned morselCount, stolenCount;
+            iterator.collectStatistics(morselCount, stolenCount);
+            cout << setw(12) << handle << setw(10) << numThreads << setw(16) << fixed << setprecision(0)
+                 << numRecords / seconds << setw(12) << stolenCount << endl;
+        }
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+    return 0;
+}
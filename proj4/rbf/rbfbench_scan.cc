@@ -0,0 +1,173 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cassert>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Scan benchmark
+// Scans a file of numRecords records and reports how many system calls the scan makes
+// per page, and how fast it is, for a buffered and a memory mapped handle.
+//
+// System calls are counted by running the scan in a child process under ptrace. A
+// second child only opens and closes the file, and its count is taken off, so what
+// is left is the cost of the scan itself. Each child starts with an empty buffer
+// pool, so every page has to come from the file.
+//
+// Usage: ./rbfbench_scan [numRecords]
+
+const string fileName = "bench_scan";
+
+// Open the file, scan it if scan is set, and close it. Returns the number of records.
+int runScan(bool memoryMapped, bool scan)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle fileHandle;
+    RC rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    fileHandle.setMemoryMapped(memoryMapped);
+
+    int count = 0;
+    if (scan)
+    {
+        vector<Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        vector<string> attributes;
+        attributes.push_back("Age");
+
+        RBFM_ScanIterator rbfm_ScanIterator;
+        rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfm_ScanIterator);
+        assert(rc == success && "Scanning a file should not fail.");
+        RID rid;
+        char data[PAGE_SIZE];
+        while (rbfm_ScanIterator.getNextRecord(rid, data) != RBFM_EOF)
+            count++;
+        rbfm_ScanIterator.close();
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    return count;
+}
+
+// Number of system calls runScan() makes, or -1 if it cannot be traced
+long countSyscalls(bool memoryMapped, bool scan)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        runScan(memoryMapped, scan);
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD) != 0)
+    {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+
+    // The child stops on the way in to and out of every system call
+    long stops = 0;
+    while (true)
+    {
+        ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+        waitpid(pid, &status, 0);
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            break;
+        if (WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80))
+            stops++;
+    }
+    return stops / 2;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned numRecords = 200000;
+    if (argc > 1)
+        numRecords = strtoul(argv[1], NULL, 10);
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    remove(fileName.c_str());
+
+    RC rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    int recordSize = 0;
+    RID rid;
+    for (unsigned i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", i, 170.1, 5000, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Anything still buffered would be inherited by the children
+    BufferManager *bm = BufferManager::instance();
+    bm->setNumberOfFrames(1);
+    bm->setNumberOfFrames(BM_DEFAULT_FRAME_COUNT);
+
+    cout << numRecords << " records, " << numPages << " pages" << endl;
+    cout << setw(12) << "handle" << setw(16) << "syscalls/page" << setw(16) << "pages/sec" << endl;
+
+    for (int memoryMapped = 0; memoryMapped <= 1; memoryMapped++)
+    {
+        long scanCalls = countSyscalls(memoryMapped, true);
+        long baseCalls = countSyscalls(memoryMapped, false);
+
+        // Time the scan without tracing, in a fresh child for a cold buffer pool
+        auto start = chrono::steady_clock::now();
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(runScan(memoryMapped, true) == (int) numRecords ? 0 : 1);
+        int status;
+        waitpid(pid, &status, 0);
+        auto end = chrono::steady_clock::now();
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "The scan should return every record.");
+        double seconds = chrono::duration<double>(end - start).count();
+
+        cout << setw(12) << (memoryMapped ? "mapped" : "buffered");
+        if (scanCalls < 0 || baseCalls < 0)
+            cout << setw(16) << "n/a";
+        else
+            cout << setw(16) << fixed << setprecision(2) << (double) (scanCalls - baseCalls) / numPages;
+        cout << setw(16) << fixed << setprecision(0) << numPages / seconds << endl;
+    }
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+    return 0;
+}
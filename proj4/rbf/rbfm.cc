@@ -8,16 +8,16 @@
 #include <string>
 
 #include "rbfm.h"
+#include "predicate.h"
+#include "wal.h"
 
 RecordBasedFileManager* RecordBasedFileManager::_rbf_manager = NULL;
 PagedFileManager *RecordBasedFileManager::_pf_manager = NULL;
 
 RecordBasedFileManager* RecordBasedFileManager::instance()
 {
-    if(!_rbf_manager)
-        _rbf_manager = new RecordBasedFileManager();
-
-    return _rbf_manager;
+    static RecordBasedFileManager *manager = _rbf_manager = new RecordBasedFileManager();
+    return manager;
 }
 
 RecordBasedFileManager::RecordBasedFileManager()
@@ -36,13 +36,12 @@ RC RecordBasedFileManager::createFile(const string &fileName)
     if (_pf_manager->createFile(fileName))
         return RBFM_CREATE_FAILED;
 
-    // Setting up the first page.
+    // Setting up the first free space map page. Data pages are added as records are inserted.
     void * firstPageData = calloc(PAGE_SIZE, 1);
     if (firstPageData == NULL)
         return RBFM_MALLOC_FAILED;
-    newRecordBasedPage(firstPageData);
 
-    // Adds the first record based page.
+    // Adds the free space map page.
     FileHandle handle;
     if (_pf_manager->openFile(fileName.c_str(), handle))
         return RBFM_OPEN_FAILED;
@@ -72,70 +71,84 @@ RC RecordBasedFileManager::closeFile(FileHandle &fileHandle)
 
 RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid)
 {
+    LogOperation operation;
     // Gets the size of the record.
     unsigned recordSize = getRecordSize(recordDescriptor, data);
 
-    // Cycles through pages looking for enough free space for the new entry.
     void *pageData = malloc(PAGE_SIZE);
     if (pageData == NULL)
         return RBFM_MALLOC_FAILED;
-    bool pageFound = false;
-    unsigned i;
-    unsigned numPages = fileHandle.getNumberOfPages();
-    for (i = 0; i < numPages; i++)
-    {
-        if (fileHandle.readPage(i, pageData))
-            return RBFM_READ_FAILED;
 
-        // When we find a page with enough space (accounting also for the size that will be added to the slot directory), we stop the loop.
-        if (getPageFreeSpaceSize(pageData) >= sizeof(SlotDirectoryRecordEntry) + recordSize)
-        {
-            pageFound = true;
-            break;
-        }
-    }
-
-    // If we can't find a page with enough space, we create a new one
-    if(!pageFound)
+    // Asks the free space map for a page with enough free space (accounting also for the size that will be added to the slot directory).
+    bool pageFound;
+    PageNum pageNum;
+    RC rc = loadFreePage(fileHandle, sizeof(SlotDirectoryRecordEntry) + recordSize, pageData, pageNum, pageFound);
+    if (rc)
     {
-        newRecordBasedPage(pageData);
+        free(pageData);
+        return rc;
     }
 
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
-
-    // Setting the return RID.
-    rid.pageNum = i;
-    rid.slotNum = getOpenSlot(pageData);
-
-    // Adding the new record reference in the slot directory.
-    SlotDirectoryRecordEntry newRecordEntry;
-    newRecordEntry.length = recordSize;
-    newRecordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
-    setSlotDirectoryRecordEntry(pageData, rid.slotNum, newRecordEntry);
-
-    // Updating the slot directory header.
-    slotHeader.freeSpaceOffset = newRecordEntry.offset;
-    if (rid.slotNum == slotHeader.recordEntriesNumber)
-        slotHeader.recordEntriesNumber += 1;
-    setSlotDirectoryHeader(pageData, slotHeader);
-
-    // Adding the record data.
-    setRecordAtOffset (pageData, newRecordEntry.offset, recordDescriptor, data);
+    rid.slotNum = placeRecord(pageData, recordDescriptor, data, recordSize);
 
     // Writing the page to disk.
     if (pageFound)
     {
-        if (fileHandle.writePage(i, pageData))
-            return RBFM_WRITE_FAILED;
+        rc = writeRecordBasedPage(fileHandle, pageNum, pageData);
+        fileHandle.unlatchPage(pageNum);
     }
     else
+        rc = appendRecordBasedPage(fileHandle, pageData, pageNum);
+    rid.pageNum = pageNum;
+
+    free(pageData);
+    if (rc)
+        return rc;
+    return operation.commit();
+}
+
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void*> &data, vector<RID> &rids)
+{
+    LogOperation operation;
+    rids.resize(data.size());
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return RBFM_MALLOC_FAILED;
+
+    // The page being filled, and the first record placed on it since it was loaded
+    bool havePage = false;
+    bool pageFound = false;
+    PageNum pageNum = 0;
+    unsigned firstOnPage = 0;
+    RC rc = SUCCESS;
+
+    for (unsigned i = 0; i < data.size(); i++)
     {
-        if (fileHandle.appendPage(pageData))
-            return RBFM_APPEND_FAILED;
+        unsigned recordSize = getRecordSize(recordDescriptor, data[i]);
+        unsigned spaceNeeded = sizeof(SlotDirectoryRecordEntry) + recordSize;
+
+        // The page is full: write it once for all the records placed on it, and find the next one
+        if (!havePage || getPageFreeSpaceSize(pageData) < spaceNeeded)
+        {
+            if (havePage && (rc = writeBatchPage(fileHandle, pageData, pageFound, pageNum, rids, firstOnPage, i)))
+                break;
+            if ((rc = loadFreePage(fileHandle, spaceNeeded, pageData, pageNum, pageFound)))
+                break;
+            havePage = true;
+            firstOnPage = i;
+        }
+
+        rids[i].slotNum = placeRecord(pageData, recordDescriptor, data[i], recordSize);
     }
 
+    if (rc == SUCCESS && havePage)
+        rc = writeBatchPage(fileHandle, pageData, pageFound, pageNum, rids, firstOnPage, data.size());
+
     free(pageData);
-    return SUCCESS;
+    if (rc)
+        return rc;
+    return operation.commit();
 }
 
 RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data)
@@ -182,15 +195,25 @@ RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attri
 
 RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid)
 {
+    LogOperation operation;
     // Get page
     void *pageData = malloc(PAGE_SIZE);
+    fileHandle.latchPage(rid.pageNum, true);
     if (fileHandle.readPage(rid.pageNum, pageData) != SUCCESS)
+    {
+        fileHandle.unlatchPage(rid.pageNum);
+        free(pageData);
         return RBFM_READ_FAILED;
+    }
 
     // Get page header
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
     if (slotHeader.recordEntriesNumber <= rid.slotNum)
+    {
+        fileHandle.unlatchPage(rid.pageNum);
+        free(pageData);
         return RBFM_SLOT_DN_EXIST;
+    }
 
     // Get slot record entry data
     SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
@@ -198,12 +221,16 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
     // Cannot delete a deleted page
     if (status == DEAD)
     {
+        fileHandle.unlatchPage(rid.pageNum);
         free(pageData);
         return RBFM_SLOT_DN_EXIST;
     }
     // Recursively delete moved pages
     else if (status == MOVED)
     {
+        // Only one data page is latched at a time, so the page is let go meanwhile
+        // and read again after
+        fileHandle.unlatchPage(rid.pageNum);
         RID newRid;
         newRid.pageNum = recordEntry.length;
         newRid.slotNum = -recordEntry.offset;
@@ -213,6 +240,13 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
             free(pageData);
             return rc;
         }
+        fileHandle.latchPage(rid.pageNum, true);
+        if (fileHandle.readPage(rid.pageNum, pageData) != SUCCESS)
+        {
+            fileHandle.unlatchPage(rid.pageNum);
+            free(pageData);
+            return RBFM_READ_FAILED;
+        }
         markSlotDeleted(pageData, rid.slotNum);
     }
     else if (status == VALID)
@@ -222,9 +256,12 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
     }
 
     // Once we've deleted the page(s), write changes to disk
-    RC rc = fileHandle.writePage(rid.pageNum, pageData);
+    RC rc = writeRecordBasedPage(fileHandle, rid.pageNum, pageData);
+    fileHandle.unlatchPage(rid.pageNum);
     free(pageData);
-    return rc;
+    if (rc)
+        return rc;
+    return operation.commit();
 }
 
 // update record
@@ -234,10 +271,13 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
 // same: do nothing
 RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid)
 {
+    LogOperation operation;
     // Retrieve the specific page
     void *pageData = malloc(PAGE_SIZE);
+    fileHandle.latchPage(rid.pageNum, true);
     if (fileHandle.readPage(rid.pageNum, pageData))
     {
+        fileHandle.unlatchPage(rid.pageNum);
         free(pageData);
         return RBFM_READ_FAILED;
     }
@@ -246,6 +286,7 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
     if(slotHeader.recordEntriesNumber <= rid.slotNum)
     {
+        fileHandle.unlatchPage(rid.pageNum);
         free(pageData);
         return RBFM_SLOT_DN_EXIST;
     }
@@ -258,15 +299,22 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     {
         // Error to update a deleted record
         case DEAD:
+            fileHandle.unlatchPage(rid.pageNum);
             free(pageData);
             return RBFM_READ_AFTER_DEL;
         // Get the forwarding address from the record entry and recurse
         case MOVED:
+        {
+            fileHandle.unlatchPage(rid.pageNum);
             free(pageData);
             RID newRid;
             newRid.pageNum = recordEntry.length;
             newRid.slotNum = -recordEntry.offset;
-            return updateRecord(fileHandle, recordDescriptor, data, newRid);
+            RC rc = updateRecord(fileHandle, recordDescriptor, data, newRid);
+            if (rc)
+                return rc;
+            return operation.commit();
+        }
         default:
         break;
     }
@@ -276,9 +324,6 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     if (recordSize  == recordEntry.length)
     {
         setRecordAtOffset(pageData, recordEntry.offset, recordDescriptor, data);
-        RC rc = fileHandle.writePage(rid.pageNum, pageData);
-        free(pageData);
-        return rc;
     }
     else if (recordSize < recordEntry.length)
     {
@@ -286,16 +331,17 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
         recordEntry.length = recordSize;
         setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
         reorganizePage(pageData);
-        RC rc = fileHandle.writePage(rid.pageNum, pageData);
-        free(pageData);
-        return rc;
     }
     else if (recordSize > recordEntry.length)
     {
         unsigned space = getPageFreeSpaceSize(pageData) + recordEntry.length;
         if (recordSize > space)
         {
-            // Need to insert then set forward address then reorganize
+            // Need to insert then set forward address then reorganize.
+            // Only one data page is latched at a time, so the page is let go for the insert
+            // and read again after.
+            string before((char*) pageData + recordEntry.offset, recordEntry.length);
+            fileHandle.unlatchPage(rid.pageNum);
             RID newRid;
             RC rc = insertRecord(fileHandle, recordDescriptor, data, newRid);
             if (rc != SUCCESS)
@@ -303,6 +349,28 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
                 free(pageData);
                 return rc;
             }
+            fileHandle.latchPage(rid.pageNum, true);
+            rc = SUCCESS;
+            if (fileHandle.readPage(rid.pageNum, pageData))
+                rc = RBFM_READ_FAILED;
+            // The record may have been deleted or updated meanwhile, or moved within the page
+            // when others were. Unless it is still what it was, the new copy is not its own.
+            else if (getSlotDirectoryHeader(pageData).recordEntriesNumber <= rid.slotNum)
+                rc = RBFM_RECORD_CHANGED;
+            else
+            {
+                recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
+                if (getSlotStatus(recordEntry) != VALID || recordEntry.length != before.size()
+                    || memcmp((char*) pageData + recordEntry.offset, before.data(), before.size()) != 0)
+                    rc = RBFM_RECORD_CHANGED;
+            }
+            if (rc)
+            {
+                fileHandle.unlatchPage(rid.pageNum);
+                free(pageData);
+                deleteRecord(fileHandle, recordDescriptor, newRid);
+                return rc;
+            }
             recordEntry.length = newRid.pageNum;
             recordEntry.offset = -newRid.slotNum;
             setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
@@ -331,9 +399,12 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
             setRecordAtOffset (pageData, recordEntry.offset, recordDescriptor, data);
         }
     }
-    RC rc = fileHandle.writePage(rid.pageNum, pageData);
+    RC rc = writeRecordBasedPage(fileHandle, rid.pageNum, pageData);
+    fileHandle.unlatchPage(rid.pageNum);
     free(pageData);
-    return rc;
+    if (rc)
+        return rc;
+    return operation.commit();
 }
 
 RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor, const void *data)
@@ -465,14 +536,14 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
 }
 
 RBFM_ScanIterator::RBFM_ScanIterator()
-: currPage(0), currSlot(0), totalPage(0), totalSlot(0)
+: currPage(0), currSlot(0), totalPage(0), totalSlot(0), pageFiltered(false)
 {
     rbfm = RecordBasedFileManager::instance();
 }
 
 RC RBFM_ScanIterator::close()
 {
-    free(pageData);
+    pageData = NULL;
     return SUCCESS;
 }
 
@@ -489,8 +560,8 @@ RC RBFM_ScanIterator::scanInit(FileHandle &fh,
     currSlot = 0;
     totalPage = 0;
     totalSlot = 0;
-    // Keep a buffer to hold the current page
-    pageData = malloc(PAGE_SIZE);
+    // The current page is held by our file handle
+    pageData = NULL;
 
     // Store the variables passed in to
     fileHandle = fh;
@@ -501,20 +572,25 @@ RC RBFM_ScanIterator::scanInit(FileHandle &fh,
     attributeNames = an;
 
     skipList.clear();
+    pageFiltered = false;
 
-    // Get total number of pages
-    totalPage = fh.getNumberOfPages();
-    if (totalPage > 0)
+    // Look the projected attributes up now rather than for every record
+    projection.clear();
+    for (const string &name : attributeNames)
     {
-        if (fh.readPage(0, pageData))
-            return RBFM_READ_FAILED;
+        auto pred = [&](const Attribute &a) {return a.name == name;};
+        auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
+        if (iterPos == recordDescriptor.end())
+            return RBFM_NO_SUCH_ATTR;
+        ProjectedAttribute attr;
+        attr.index = distance(recordDescriptor.begin(), iterPos);
+        attr.type = iterPos->type;
+        projection.push_back(attr);
     }
-    else
-        return SUCCESS;
 
-    // Get number of slots on first page
-    SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
-    totalSlot = header.recordEntriesNumber;
+    // Get total number of pages. Page 0 holds the free space map, so there are no
+    // slots to go through there; the first getNextSlot() moves on to the first data page.
+    totalPage = fh.getNumberOfPages();
 
     // If we don't need to do any comparisons, we can ignore the condition attribute
     if (co == NO_OP)
@@ -527,10 +603,20 @@ RC RBFM_ScanIterator::scanInit(FileHandle &fh,
     if (attrIndex == recordDescriptor.size())
         return RBFM_NO_SUCH_ATTR;
 
+    AttrType type = recordDescriptor[attrIndex].type;
+    pageFiltered = value != NULL && (type == TypeInt || type == TypeReal);
     return SUCCESS;
 }
 
 RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data)
+{
+    unsigned size;
+    return getNextRecord(rid, data, size);
+}
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data, unsigned &size)
 {
     RC rc = getNextSlot();
     if (rc)
@@ -539,78 +625,74 @@ RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data)
     // If we are not returning any results, we can just set the RID and return
     if (attributeNames.size() == 0)
     {
+        size = 0;
         rid.pageNum = currPage;
         rid.slotNum = currSlot++;
         return SUCCESS;
     }
 
+    // scanInit() could not find one of the projected attributes
+    if (projection.size() != attributeNames.size())
+        return RBFM_NO_SUCH_ATTR;
+
     // Prepare null indicator
-    unsigned nullIndicatorSize = rbfm->getNullIndicatorSize(attributeNames.size());
-    char nullIndicator[nullIndicatorSize];
-    memset(nullIndicator, 0, nullIndicatorSize);
+    unsigned nullIndicatorSize = rbfm->getNullIndicatorSize(projection.size());
+    memset(data, 0, nullIndicatorSize);
 
+    // The record is a field count, a null indicator, the offsets of the ends of
+    // the fields, and then the fields. They are copied straight from the page.
     SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
-
-    // Unsure how large each attribute will be, set to size of page to be safe
-    void *buffer = malloc(PAGE_SIZE);
-    if (buffer == NULL)
-        return RBFM_MALLOC_FAILED;
+    const char *record = (const char*)pageData + recordEntry.offset;
+    RecordLength n;
+    memcpy(&n, record, sizeof(RecordLength));
+    const char *recordNullIndicator = record + sizeof(RecordLength);
+    unsigned recordNullIndicatorSize = rbfm->getNullIndicatorSize(n);
+    const char *columnOffsets = recordNullIndicator + recordNullIndicatorSize;
+    ColumnOffset dataStart = sizeof(RecordLength) + recordNullIndicatorSize + n * sizeof(ColumnOffset);
 
     // Keep track of offset into data
-    unsigned dataOffset = nullIndicatorSize;
+    char *out = (char*)data + nullIndicatorSize;
 
-    for (unsigned i = 0; i < attributeNames.size(); i++)
+    for (unsigned i = 0; i < projection.size(); i++)
     {
-        // Get index and type of attribute in record
-        auto pred = [&](Attribute a) {return a.name == attributeNames[i];};
-        auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
-        unsigned index = distance(recordDescriptor.begin(), iterPos);
-        if (index == recordDescriptor.size())
-            return RBFM_NO_SUCH_ATTR;
-        AttrType type = recordDescriptor[index].type;
-
-        // Read attribute into buffer
-        rbfm->getAttributeFromRecord(pageData, recordEntry.offset, index, type, buffer);
-        // Determine if null
-        char null;
-        memcpy (&null, buffer, 1);
-        if (null)
-        {
-            int indicatorIndex = i / CHAR_BIT;
-            char indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
-            nullIndicator[indicatorIndex] |= indicatorMask;
-        }
-        // Read from buffer into data
-        else if (type == TypeInt)
-        {
-            memcpy ((char*)data + dataOffset, (char*)buffer + 1, INT_SIZE);
-            dataOffset += INT_SIZE;
-        }
-        else if (type == TypeReal)
+        unsigned index = projection[i].index;
+        if (recordNullIndicator[index / CHAR_BIT] & (1 << (CHAR_BIT - 1 - (index % CHAR_BIT))))
         {
-            memcpy ((char*)data + dataOffset, (char*)buffer + 1, REAL_SIZE);
-            dataOffset += REAL_SIZE;
+            *((char*)data + i / CHAR_BIT) |= 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
+            continue;
         }
-        else if (type == TypeVarChar)
+
+        // A field starts where the one before it ends
+        ColumnOffset attrStart = dataStart;
+        ColumnOffset attrEnd;
+        if (index > 0)
+            memcpy(&attrStart, columnOffsets + (index - 1) * sizeof(ColumnOffset), sizeof(ColumnOffset));
+        memcpy(&attrEnd, columnOffsets + index * sizeof(ColumnOffset), sizeof(ColumnOffset));
+        uint32_t length = attrEnd - attrStart;
+
+        if (projection[i].type == TypeVarChar)
         {
-            uint32_t varcharSize;
-            memcpy(&varcharSize, (char*)buffer + 1, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)data + dataOffset, &varcharSize, VARCHAR_LENGTH_SIZE);
-            dataOffset += VARCHAR_LENGTH_SIZE;
-            memcpy((char*)data + dataOffset, (char*)buffer + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-            dataOffset += varcharSize;
+            memcpy(out, &length, VARCHAR_LENGTH_SIZE);
+            out += VARCHAR_LENGTH_SIZE;
         }
+        memcpy(out, record + attrStart, length);
+        out += length;
     }
-    // Finally set null indicator of data, clean up and return
-    memcpy((char*)data, nullIndicator, nullIndicatorSize);
 
-    free (buffer);
+    size = out - (char*)data;
     rid.pageNum = currPage;
     rid.slotNum = currSlot++;
     return SUCCESS;
 }
 
-// Private helper methods ///////////////////////////////////////////////////////////////////
+void RBFM_ScanIterator::setPageRange(PageNum first, PageNum end)
+{
+    // The next getNextSlot() finds the slots used up and moves on to page first
+    currPage = first - 1;
+    currSlot = 0;
+    totalSlot = 0;
+    totalPage = end;
+}
 
 RC RBFM_ScanIterator::getNextSlot()
 {
@@ -620,6 +702,9 @@ RC RBFM_ScanIterator::getNextSlot()
         // Reinitialize the current slot and increment page number
         currSlot = 0;
         currPage++;
+        // Free space map pages hold no records
+        while (currPage < totalPage && RecordBasedFileManager::isFreeSpaceMapPage(currPage))
+            currPage++;
         // If we're done with last page, return EOF
         if (currPage >= totalPage)
             return RBFM_EOF;
@@ -643,124 +728,181 @@ RC RBFM_ScanIterator::getNextSlot()
 
 RC RBFM_ScanIterator::getNextPage()
 {
-    // Read in page
-    if (fileHandle.readPage(currPage, pageData))
+    // Get the page. If the handle is memory mapped it is not even copied.
+    const void *page;
+    if (fileHandle.getPage(currPage, page))
         return RBFM_READ_FAILED;
+    // The page is only read from
+    pageData = (void*) page;
 
     // Update slot total
     SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
     totalSlot = header.recordEntriesNumber;
+
+    if (pageFiltered)
+        filterPage();
     return SUCCESS;
 }
 
+// Evaluates the condition for every slot of the current page with one kernel call
+void RBFM_ScanIterator::filterPage()
+{
+    pageValues.resize(totalSlot * INT_SIZE);
+    slotMask.resize((totalSlot + 63) / 64);
+    if (totalSlot == 0)
+        return;
+
+    // Slots without a value hold 0 and are masked out afterwards
+    vector<uint64_t> validMask(slotMask.size(), 0);
+    char field[1 + INT_SIZE];
+    AttrType type = recordDescriptor[attrIndex].type;
+    for (unsigned i = 0; i < totalSlot; i++)
+    {
+        SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, i);
+        memset(pageValues.data() + i * INT_SIZE, 0, INT_SIZE);
+        if (rbfm->getSlotStatus(recordEntry) != VALID)
+            continue;
+        rbfm->getAttributeFromRecord(pageData, recordEntry.offset, attrIndex, type, field);
+        if (field[0])
+            continue;
+        memcpy(pageValues.data() + i * INT_SIZE, field + 1, INT_SIZE);
+        validMask[i / 64] |= 1ULL << (i % 64);
+    }
+
+    if (type == TypeInt)
+    {
+        int32_t intValue;
+        memcpy(&intValue, value, INT_SIZE);
+        evaluatePredicate((const int32_t*) pageValues.data(), totalSlot, compOp, intValue, slotMask.data());
+    }
+    else
+    {
+        float realValue;
+        memcpy(&realValue, value, REAL_SIZE);
+        evaluatePredicate((const float*) pageValues.data(), totalSlot, compOp, realValue, slotMask.data());
+    }
+    for (unsigned i = 0; i < slotMask.size(); i++)
+        slotMask[i] &= validMask[i];
+}
+
 bool RBFM_ScanIterator::checkScanCondition()
 {
     if (compOp == NO_OP) return true;
     if (value == NULL) return false;
+    // INT and REAL conditions were evaluated when the page was read
+    if (pageFiltered)
+        return slotMask[currSlot / 64] & (1ULL << (currSlot % 64));
+
     Attribute attr = recordDescriptor[attrIndex];
-    // Allocate enough memory to hold attribute and 1 byte null indicator
-    void *data = malloc(1 + attr.length);
+    // Room for the attribute and its 1 byte null indicator
+    char data[1 + VARCHAR_LENGTH_SIZE + PAGE_SIZE];
     // Get record entry to get offset
     SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
     // Grab the given attribute and store it in data
     rbfm->getAttributeFromRecord(pageData, recordEntry.offset, attrIndex, attr.type, data);
 
-    char null;
-    memcpy(&null, data, 1);
-
-    bool result = false;
-    if (null)
-    {
-        result = false;
-    }
-    // Checkscan condition on record data and scan value
-    else if (attr.type == TypeInt)
-    {
-        int32_t recordInt;
-        memcpy(&recordInt, (char*)data + 1, INT_SIZE);
-        result = checkScanCondition(recordInt, compOp, value);
-    }
-    else if (attr.type == TypeReal)
-    {
-        float recordReal;
-        memcpy(&recordReal, (char*)data + 1, REAL_SIZE);
-        result = checkScanCondition(recordReal, compOp, value);
-    }
-    else if (attr.type == TypeVarChar)
-    {
-        uint32_t varcharSize;
-        memcpy(&varcharSize, (char*)data + 1, VARCHAR_LENGTH_SIZE);
-        char recordString[varcharSize + 1];
-        memcpy(recordString, (char*)data + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-        recordString[varcharSize] = '\0';
-
-        result = checkScanCondition(recordString, compOp, value);
-    }
-    free (data);
-    return result;
+    // Null never meets the condition
+    if (data[0])
+        return false;
+    return checkScanCondition(data + 1, compOp, value);
 }
 
-bool RBFM_ScanIterator::checkScanCondition(int recordInt, CompOp compOp, const void *value)
+// Compares a varchar with the scan value, both as a 4 byte length followed by the characters
+bool RBFM_ScanIterator::checkScanCondition(const char *varchar, CompOp compOp, const void *value)
 {
-    int32_t intValue;
-    memcpy (&intValue, value, INT_SIZE);
+    uint32_t recordSize, valueSize;
+    memcpy(&recordSize, varchar, VARCHAR_LENGTH_SIZE);
+    memcpy(&valueSize, value, VARCHAR_LENGTH_SIZE);
 
+    int cmp = memcmp(varchar + VARCHAR_LENGTH_SIZE, (const char*) value + VARCHAR_LENGTH_SIZE, min(recordSize, valueSize));
+    if (cmp == 0)
+        cmp = (recordSize > valueSize) - (recordSize < valueSize);
     switch (compOp)
     {
-        case EQ_OP: return recordInt == intValue;
-        case LT_OP: return recordInt < intValue;
-        case GT_OP: return recordInt > intValue;
-        case LE_OP: return recordInt <= intValue;
-        case GE_OP: return recordInt >= intValue;
-        case NE_OP: return recordInt != intValue;
-        case NO_OP: return true;
+        case EQ_OP: return cmp == 0;
+        case LT_OP: return cmp <  0;
+        case GT_OP: return cmp >  0;
+        case LE_OP: return cmp <= 0;
+        case GE_OP: return cmp >= 0;
+        case NE_OP: return cmp != 0;
         // Should never happen
         default: return false;
     }
 }
 
-bool RBFM_ScanIterator::checkScanCondition(float recordReal, CompOp compOp, const void *value)
+// Reads a page with at least spaceNeeded bytes of free space into pageData, according to the
+// free space map, or sets up a new page there if there is none (found is false then).
+// A page that was found is latched exclusively until the caller has written it back.
+RC RecordBasedFileManager::loadFreePage(FileHandle &fileHandle, unsigned spaceNeeded, void *pageData, PageNum &pageNum, bool &found)
 {
-    float realValue;
-    memcpy (&realValue, value, REAL_SIZE);
-
-    switch (compOp)
+    while (true)
     {
-        case EQ_OP: return recordReal == realValue;
-        case LT_OP: return recordReal < realValue;
-        case GT_OP: return recordReal > realValue;
-        case LE_OP: return recordReal <= realValue;
-        case GE_OP: return recordReal >= realValue;
-        case NE_OP: return recordReal != realValue;
-        case NO_OP: return true;
-        // Should never happen
-        default: return false;
+        RC rc = findFreePage(fileHandle, spaceNeeded, pageNum, found);
+        if (rc)
+            return rc;
+        if (!found)
+            break;
+
+        fileHandle.latchPage(pageNum, true);
+        if (fileHandle.readPage(pageNum, pageData))
+        {
+            fileHandle.unlatchPage(pageNum);
+            return RBFM_READ_FAILED;
+        }
+        if (getPageFreeSpaceSize(pageData) >= spaceNeeded)
+            return SUCCESS;
+
+        // The map was out of date for this page, or another thread filled it since; correct it and ask again
+        rc = updateFreeSpaceMap(fileHandle, pageNum, getPageFreeSpaceSize(pageData));
+        fileHandle.unlatchPage(pageNum);
+        if (rc)
+            return rc;
     }
+
+    // If we can't find a page with enough space, we create a new one
+    newRecordBasedPage(pageData);
+    return SUCCESS;
 }
 
-bool RBFM_ScanIterator::checkScanCondition(char *recordString, CompOp compOp, const void *value)
+// Adds the record to the page, which must have room for it, and returns its slot number.
+unsigned RecordBasedFileManager::placeRecord(void *pageData, const vector<Attribute> &recordDescriptor, const void *data, unsigned recordSize)
 {
-    if (compOp == NO_OP)
-        return true;
+    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
 
-    int32_t valueSize;
-    memcpy(&valueSize, value, VARCHAR_LENGTH_SIZE);
-    char valueStr[valueSize + 1];
-    valueStr[valueSize] = '\0';
-    memcpy(valueStr, (char*) value + VARCHAR_LENGTH_SIZE, valueSize);
+    unsigned slotNum = getOpenSlot(pageData);
 
-    int cmp = strcmp(recordString, valueStr);
-    switch (compOp)
+    // Adding the new record reference in the slot directory.
+    SlotDirectoryRecordEntry newRecordEntry;
+    newRecordEntry.length = recordSize;
+    newRecordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
+    setSlotDirectoryRecordEntry(pageData, slotNum, newRecordEntry);
+
+    // Updating the slot directory header.
+    slotHeader.freeSpaceOffset = newRecordEntry.offset;
+    if (slotNum == slotHeader.recordEntriesNumber)
+        slotHeader.recordEntriesNumber += 1;
+    setSlotDirectoryHeader(pageData, slotHeader);
+
+    // Adding the record data.
+    setRecordAtOffset (pageData, newRecordEntry.offset, recordDescriptor, data);
+    return slotNum;
+}
+
+// Writes or appends a page filled by insertRecords(), and sets the page number of the
+// records from begin to end, which were placed on it. Unlatches a page from loadFreePage().
+RC RecordBasedFileManager::writeBatchPage(FileHandle &fileHandle, void *pageData, bool found, PageNum &pageNum, vector<RID> &rids, unsigned begin, unsigned end)
+{
+    RC rc;
+    if (found)
     {
-        case EQ_OP: return cmp == 0;
-        case LT_OP: return cmp <  0;
-        case GT_OP: return cmp >  0;
-        case LE_OP: return cmp <= 0;
-        case GE_OP: return cmp >= 0;
-        case NE_OP: return cmp != 0;
-        // Should never happen
-        default: return false;
+        rc = writeRecordBasedPage(fileHandle, pageNum, pageData);
+        fileHandle.unlatchPage(pageNum);
     }
+    else
+        rc = appendRecordBasedPage(fileHandle, pageData, pageNum);
+    for (unsigned i = begin; i < end; i++)
+        rids[i].pageNum = pageNum;
+    return rc;
 }
 
 // Configures a new record based page, and puts it in "page".
@@ -774,6 +916,224 @@ void RecordBasedFileManager::newRecordBasedPage(void * page)
     setSlotDirectoryHeader(page, slotHeader);
 }
 
+bool RecordBasedFileManager::isFreeSpaceMapPage(PageNum pageNum)
+{
+    return pageNum % (FSM_ENTRIES_PER_PAGE + 1) == 0;
+}
+
+// Free space is stored in buckets of FSM_BUCKET_SIZE bytes, rounded down.
+uint8_t RecordBasedFileManager::getFreeSpaceBucket(unsigned freeSpace)
+{
+    return min(freeSpace / FSM_BUCKET_SIZE, (unsigned) FSM_MAX_BUCKET);
+}
+
+FreeSpaceMapHeader RecordBasedFileManager::getFreeSpaceMapHeader(void * page)
+{
+    FreeSpaceMapHeader fsmHeader;
+    memcpy (&fsmHeader, page, sizeof(FreeSpaceMapHeader));
+    return fsmHeader;
+}
+
+void RecordBasedFileManager::setFreeSpaceMapHeader(void * page, FreeSpaceMapHeader fsmHeader)
+{
+    memcpy (page, &fsmHeader, sizeof(FreeSpaceMapHeader));
+}
+
+// Looks for a data page with at least size bytes of free space, reading only free space map pages.
+RC RecordBasedFileManager::findFreePage(FileHandle &fileHandle, unsigned size, PageNum &pageNum, bool &found)
+{
+    found = false;
+
+    // The smallest bucket that is guaranteed to hold size bytes. Anything bigger than the
+    // largest bucket can only go on a new page.
+    unsigned bucketNeeded = (size + FSM_BUCKET_SIZE - 1) / FSM_BUCKET_SIZE;
+    if (bucketNeeded > FSM_MAX_BUCKET)
+        return SUCCESS;
+
+    void *fsmData = malloc(PAGE_SIZE);
+    if (fsmData == NULL)
+        return RBFM_MALLOC_FAILED;
+
+    // Start with the map page the last insert went to, then go around the others
+    if (fileHandle.readPage(0, fsmData))
+    {
+        free(fsmData);
+        return RBFM_READ_FAILED;
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    unsigned numMapPages = (numPages + FSM_ENTRIES_PER_PAGE) / (FSM_ENTRIES_PER_PAGE + 1);
+    PageNum lastMapPage = getFreeSpaceMapHeader(fsmData).nextMapPage;
+    unsigned firstMap = lastMapPage / (FSM_ENTRIES_PER_PAGE + 1);
+    if (firstMap >= numMapPages)
+        firstMap = 0;
+
+    for (unsigned m = 0; m < numMapPages && !found; m++)
+    {
+        PageNum fsmPage = ((firstMap + m) % numMapPages) * (FSM_ENTRIES_PER_PAGE + 1);
+        fileHandle.latchPage(fsmPage, true);
+        if (fileHandle.readPage(fsmPage, fsmData))
+        {
+            fileHandle.unlatchPage(fsmPage);
+            free(fsmData);
+            return RBFM_READ_FAILED;
+        }
+
+        FreeSpaceMapHeader fsmHeader = getFreeSpaceMapHeader(fsmData);
+        if (fsmHeader.maxBucket < bucketNeeded)
+        {
+            fileHandle.unlatchPage(fsmPage);
+            continue;
+        }
+
+        uint8_t *buckets = (uint8_t*) fsmData + sizeof(FreeSpaceMapHeader);
+        unsigned entries = min((unsigned) FSM_ENTRIES_PER_PAGE, numPages - fsmPage - 1);
+
+        // Start where the last insert went, so that a run of inserts keeps filling the
+        // same page instead of walking over all the full ones before it every time
+        uint8_t maxBucket = 0;
+        for (unsigned n = 0; n < entries; n++)
+        {
+            unsigned i = (fsmHeader.nextEntry + n) % entries;
+            if (buckets[i] >= bucketNeeded)
+            {
+                found = true;
+                pageNum = fsmPage + 1 + i;
+                break;
+            }
+            maxBucket = max(maxBucket, buckets[i]);
+        }
+
+        if (found)
+        {
+            if (fsmHeader.nextEntry == pageNum - fsmPage - 1)
+            {
+                fileHandle.unlatchPage(fsmPage);
+                break;
+            }
+            fsmHeader.nextEntry = pageNum - fsmPage - 1;
+        }
+        else
+        {
+            // Nothing big enough on this map page; remember that so we can skip it next time
+            fsmHeader.maxBucket = maxBucket;
+        }
+        setFreeSpaceMapHeader(fsmData, fsmHeader);
+        RC rc = fileHandle.writePage(fsmPage, fsmData);
+        fileHandle.unlatchPage(fsmPage);
+        if (rc)
+        {
+            free(fsmData);
+            return RBFM_WRITE_FAILED;
+        }
+    }
+
+    // Point the next search at the map page we found room on
+    RC rc = SUCCESS;
+    PageNum mapPage = found ? pageNum - pageNum % (FSM_ENTRIES_PER_PAGE + 1) : lastMapPage;
+    if (mapPage != lastMapPage)
+    {
+        fileHandle.latchPage(0, true);
+        if (fileHandle.readPage(0, fsmData))
+            rc = RBFM_READ_FAILED;
+        else
+        {
+            FreeSpaceMapHeader fsmHeader = getFreeSpaceMapHeader(fsmData);
+            fsmHeader.nextMapPage = mapPage;
+            setFreeSpaceMapHeader(fsmData, fsmHeader);
+            if (fileHandle.writePage(0, fsmData))
+                rc = RBFM_WRITE_FAILED;
+        }
+        fileHandle.unlatchPage(0);
+    }
+
+    free(fsmData);
+    return rc;
+}
+
+// Appends a data page to the file, starting a new free space map page first if one is due.
+// Appends hold the file latch, so that they agree on the page numbers.
+RC RecordBasedFileManager::appendRecordBasedPage(FileHandle &fileHandle, void * page, PageNum &pageNum)
+{
+    fileHandle.latchFile(true);
+    pageNum = fileHandle.getNumberOfPages();
+    if (isFreeSpaceMapPage(pageNum))
+    {
+        void *fsmData = calloc(PAGE_SIZE, 1);
+        if (fsmData == NULL)
+        {
+            fileHandle.unlatchFile();
+            return RBFM_MALLOC_FAILED;
+        }
+        RC rc = fileHandle.appendPage(fsmData);
+        free(fsmData);
+        if (rc)
+        {
+            fileHandle.unlatchFile();
+            return RBFM_APPEND_FAILED;
+        }
+        pageNum++;
+    }
+
+    RC rc = fileHandle.appendPage(page);
+    fileHandle.unlatchFile();
+    if (rc)
+        return RBFM_APPEND_FAILED;
+
+    return updateFreeSpaceMap(fileHandle, pageNum, getPageFreeSpaceSize(page));
+}
+
+// Writes a data page and keeps its free space map entry in sync with it.
+RC RecordBasedFileManager::writeRecordBasedPage(FileHandle &fileHandle, PageNum pageNum, void * page)
+{
+    if (fileHandle.writePage(pageNum, page))
+        return RBFM_WRITE_FAILED;
+
+    return updateFreeSpaceMap(fileHandle, pageNum, getPageFreeSpaceSize(page));
+}
+
+RC RecordBasedFileManager::updateFreeSpaceMap(FileHandle &fileHandle, PageNum pageNum, unsigned freeSpace)
+{
+    PageNum fsmPage = pageNum - pageNum % (FSM_ENTRIES_PER_PAGE + 1);
+    unsigned entry = pageNum - fsmPage - 1;
+
+    void *fsmData = malloc(PAGE_SIZE);
+    if (fsmData == NULL)
+        return RBFM_MALLOC_FAILED;
+    fileHandle.latchPage(fsmPage, true);
+    if (fileHandle.readPage(fsmPage, fsmData))
+    {
+        fileHandle.unlatchPage(fsmPage);
+        free(fsmData);
+        return RBFM_READ_FAILED;
+    }
+
+    uint8_t *buckets = (uint8_t*) fsmData + sizeof(FreeSpaceMapHeader);
+    uint8_t bucket = getFreeSpaceBucket(freeSpace);
+
+    // Most writes don't move a page into another bucket
+    if (buckets[entry] == bucket)
+    {
+        fileHandle.unlatchPage(fsmPage);
+        free(fsmData);
+        return SUCCESS;
+    }
+
+    buckets[entry] = bucket;
+    FreeSpaceMapHeader fsmHeader = getFreeSpaceMapHeader(fsmData);
+    if (bucket > fsmHeader.maxBucket)
+    {
+        fsmHeader.maxBucket = bucket;
+        setFreeSpaceMapHeader(fsmData, fsmHeader);
+    }
+
+    RC rc = SUCCESS;
+    if (fileHandle.writePage(fsmPage, fsmData))
+        rc = RBFM_WRITE_FAILED;
+    fileHandle.unlatchPage(fsmPage);
+    free(fsmData);
+    return rc;
+}
+
 SlotDirectoryHeader RecordBasedFileManager::getSlotDirectoryHeader(void * page)
 {
     // Getting the slot directory header.
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <climits>
+#include <functional>
 
 #include "../rbf/pfm.h"
 
@@ -22,6 +23,7 @@
 #define RBFM_SLOT_DN_EXIST  7
 #define RBFM_READ_AFTER_DEL 8
 #define RBFM_NO_SUCH_ATTR   9
+#define RBFM_RECORD_CHANGED 10  // Changed by someone else while an update was moving it
 
 using namespace std;
 
@@ -82,6 +84,22 @@ typedef struct IndexedRecordEntry
 
 typedef SlotDirectoryRecordEntry* SlotDirectory;
 
+// Free space map pages
+// Page 0 of every record based file is a free space map page, and so is every
+// (FSM_ENTRIES_PER_PAGE + 1)th page after it. Each one holds a byte per data page
+// that follows it, recording that page's free space in units of FSM_BUCKET_SIZE
+// bytes (rounded down, so a page always has at least as much room as it claims).
+typedef struct FreeSpaceMapHeader
+{
+    uint16_t nextEntry;     // Where the next search starts; the page the last insert went to
+    uint16_t maxBucket;     // No entry on this page is larger than this
+    uint32_t nextMapPage;   // Page 0 only: the map page the last insert went to
+} FreeSpaceMapHeader;
+
+#define FSM_BUCKET_SIZE      16
+#define FSM_MAX_BUCKET       255
+#define FSM_ENTRIES_PER_PAGE (PAGE_SIZE - sizeof(FreeSpaceMapHeader))
+
 typedef uint16_t ColumnOffset;
 
 typedef uint16_t RecordLength;
@@ -102,6 +120,14 @@ The scan iterator is NOT required to be implemented for the part 1 of the projec
 //  }
 //  rbfmScanIterator.close();
 class RecordBasedFileManager;
+class RBFM_ParallelScanIterator;
+
+// Pages in a unit of work of a parallel scan
+#define RBFM_MORSEL_PAGES 32
+
+// Receives the records of a parallel scan, on the thread of the worker that found them.
+// worker is in [0, number of workers). Returning anything but SUCCESS stops the scan.
+typedef function<RC(unsigned worker, const RID &rid, const void *data)> ScanConsumer;
 
 class RBFM_ScanIterator {
 public:
@@ -115,6 +141,7 @@ public:
   RC close();
 
   friend class RecordBasedFileManager;
+  friend class RBFM_ParallelScanIterator;
 
 private:
   RecordBasedFileManager *rbfm;
@@ -137,8 +164,23 @@ private:
   const void* value;
   vector<string> attributeNames;
 
+  // The projection, resolved once by scanInit(): where each projected attribute
+  // is in the record descriptor, and its type
+  struct ProjectedAttribute {
+    unsigned index;
+    AttrType type;
+  };
+  vector<ProjectedAttribute> projection;
+
   vector<RID> skipList;
 
+  // Conditions on an INT or REAL attribute are evaluated for a whole page at once:
+  // the values of the page's slots go in pageValues, and bit i of slotMask is set
+  // if slot i is valid and meets the condition
+  bool pageFiltered;
+  vector<char> pageValues;
+  vector<uint64_t> slotMask;
+
   RC scanInit(FileHandle &fh,
         const vector<Attribute> rd,
         const string &ca,
@@ -146,14 +188,18 @@ private:
         const void *v,
         const vector<string> &an);
 
+  // Same as getNextRecord(), and also tells how many bytes of data were written
+  RC getNextRecord(RID &rid, void *data, unsigned &size);
+  // Only go through pages [first, end) from now on
+  void setPageRange(PageNum first, PageNum end);
+
   RC getNextSlot();
   RC getNextPage();
+  void filterPage();
   RC handleMovedRecord(bool &status, const RID rid, void *data);
   bool checkScanCondition();
   RC checkScanCondition(bool &result, const RID rid);
-  bool checkScanCondition(int, CompOp, const void*);
-  bool checkScanCondition(float, CompOp, const void*);
-  bool checkScanCondition(char*, CompOp, const void*);
+  bool checkScanCondition(const char*, CompOp, const void*);
 };
 
 
@@ -186,6 +232,10 @@ public:
   // For example, refer to the Q6 of Project 1 Environment document.
   RC insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid);
 
+  // Inserts every record of data and puts their RIDs in rids, in the same order. Records
+  // are placed on a page until it is full, and each page is written once.
+  RC insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void*> &data, vector<RID> &rids);
+
   RC readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data);
 
   // This method will be mainly used for debugging/testing.
@@ -214,8 +264,34 @@ IMPORTANT, PLEASE READ: All methods below this comment (other than the construct
       const vector<string> &attributeNames, // a list of projected attributes
       RBFM_ScanIterator &rbfm_ScanIterator);
 
+  // Same as scan(), with the pages of the file split among numThreads worker threads
+  // (0 for one per core). See pscan.h. The records come back in no particular order.
+  RC parallelScan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      const vector<string> &attributeNames,
+      RBFM_ParallelScanIterator &rbfm_ParallelScanIterator,
+      unsigned numThreads = 0,
+      unsigned morselPages = RBFM_MORSEL_PAGES);
+
+  // Same, but instead of queueing the records for the caller, each worker hands the
+  // records it finds to consumer itself. Returns once the whole file has been scanned,
+  // with the first error a worker or consumer ran into.
+  RC parallelScan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      const vector<string> &attributeNames,
+      const ScanConsumer &consumer,
+      unsigned numThreads = 0,
+      unsigned morselPages = RBFM_MORSEL_PAGES);
+
 public:
   friend class RBFM_ScanIterator;
+  friend class RBFM_ParallelScanIterator;
   friend class RelationManager;
 
 protected:
@@ -229,6 +305,19 @@ private:
   // Private helper methods
 
   void newRecordBasedPage(void * page);
+  RC loadFreePage(FileHandle &fileHandle, unsigned spaceNeeded, void *pageData, PageNum &pageNum, bool &found);
+  unsigned placeRecord(void *pageData, const vector<Attribute> &recordDescriptor, const void *data, unsigned recordSize);
+  RC writeBatchPage(FileHandle &fileHandle, void *pageData, bool found, PageNum &pageNum, vector<RID> &rids, unsigned begin, unsigned end);
+
+  // Free space map helpers
+  static bool isFreeSpaceMapPage(PageNum pageNum);
+  uint8_t getFreeSpaceBucket(unsigned freeSpace);
+  FreeSpaceMapHeader getFreeSpaceMapHeader(void * page);
+  void setFreeSpaceMapHeader(void * page, FreeSpaceMapHeader fsmHeader);
+  RC findFreePage(FileHandle &fileHandle, unsigned size, PageNum &pageNum, bool &found);
+  RC appendRecordBasedPage(FileHandle &fileHandle, void * page, PageNum &pageNum);
+  RC writeRecordBasedPage(FileHandle &fileHandle, PageNum pageNum, void * page);
+  RC updateFreeSpaceMap(FileHandle &fileHandle, PageNum pageNum, unsigned freeSpace);
 
   SlotDirectoryHeader getSlotDirectoryHeader(void * page);
   void setSlotDirectoryHeader(void * page, SlotDirectoryHeader slotHeader);
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_13(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File
+    // 3. Append Page, Write Page, Read Page through a buffer pool smaller than the file
+    // 4. Close File, reopen it and read the pages back
+    // 5. Destroy File
+    cout << endl << "***** In RBF Test Case 13 *****" << endl;
+
+    RC rc;
+    string fileName = "test13";
+    BufferManager *bm = BufferManager::instance();
+
+    const unsigned numberOfFrames = 8;
+    const unsigned numberOfPages = 50;
+
+    rc = bm->setNumberOfFrames(numberOfFrames);
+    assert(rc == success && "Resizing the buffer pool should not fail.");
+    assert(bm->getNumberOfFrames() == numberOfFrames && "The buffer pool should have been resized.");
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // Append more pages than the pool can hold
+    void *data = malloc(PAGE_SIZE);
+    for (unsigned j = 0; j < numberOfPages; j++)
+    {
+        for (unsigned i = 0; i < PAGE_SIZE; i++)
+        {
+            *((char *)data+i) = (i + j) % 94 + 32;
+        }
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    assert(fileHandle.getNumberOfPages() == numberOfPages && "The number of pages is not correct.");
+
+    // Overwrite every page. Dirty pages have to be written back as they are evicted.
+    for (unsigned j = 0; j < numberOfPages; j++)
+    {
+        for (unsigned i = 0; i < PAGE_SIZE; i++)
+        {
+            *((char *)data+i) = (i + 2 * j) % 94 + 32;
+        }
+        rc = fileHandle.writePage(j, data);
+        assert(rc == success && "Writing a page should not fail.");
+    }
+
+    unsigned physicalReadCount = 0;
+    unsigned physicalWriteCount = 0;
+    rc = fileHandle.collectPhysicalCounterValues(physicalReadCount, physicalWriteCount);
+    assert(rc == success && "collectPhysicalCounterValues() should not fail.");
+    assert(physicalWriteCount >= numberOfPages - numberOfFrames && "Evicted dirty pages should have been written back.");
+
+    // Reading the last page written is served from the pool
+    unsigned hitCount, missCount, writeBackCount;
+    bm->resetStatistics();
+    void *buffer = malloc(PAGE_SIZE);
+    rc = fileHandle.readPage(numberOfPages - 1, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    rc = bm->collectStatistics(hitCount, missCount, writeBackCount);
+    assert(rc == success && "collectStatistics() should not fail.");
+    assert(hitCount == 1 && missCount == 0 && "The last page written should still be buffered.");
+
+    // Reading the first page has to go to disk
+    rc = fileHandle.readPage(0, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    rc = bm->collectStatistics(hitCount, missCount, writeBackCount);
+    assert(rc == success && "collectStatistics() should not fail.");
+    assert(missCount == 1 && "The first page should have been evicted.");
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Reopen the file and check every page made it to disk
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    for (unsigned j = 0; j < numberOfPages; j++)
+    {
+        for (unsigned i = 0; i < PAGE_SIZE; i++)
+        {
+            *((char *)data+i) = (i + 2 * j) % 94 + 32;
+        }
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        rc = memcmp(data, buffer, PAGE_SIZE);
+        assert(rc == success && "Checking the integrity of a page should not fail.");
+    }
+
+    // Reading past the end of the file is an error
+    rc = fileHandle.readPage(numberOfPages, buffer);
+    assert(rc != success && "Reading a page that does not exist should fail.");
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    free(data);
+    free(buffer);
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    rc = bm->setNumberOfFrames(BM_DEFAULT_FRAME_COUNT);
+    assert(rc == success && "Resizing the buffer pool should not fail.");
+
+    cout << "RBF Test Case 13 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the buffer pool beneath the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test13");
+
+    RC rcmain = RBFTest_13(pfm);
+    return rcmain;
+}
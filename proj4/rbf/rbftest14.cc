@@ -0,0 +1,129 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_14(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open Record-Based File
+    // 3. Insert Record - enough to fill several pages
+    // 4. Delete Record - empty the first data page
+    // 5. Insert Record - should reuse the space instead of growing the file
+    // 6. Scan - should skip the free space map pages
+    // 7. Close Record-Based File
+    // 8. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 14 *****" << endl;
+
+    RC rc;
+    string fileName = "test14";
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    int recordSize = 0;
+    void *record = malloc(100);
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    // Fill a few pages
+    const int numRecords = 1000;
+    vector<RID> rids;
+    for (int i = 0; i < numRecords; i++)
+    {
+        RID rid;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", i, 170.1, 5000, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        // Page 0 holds the free space map
+        assert(rid.pageNum != 0 && "A record should never be placed on the free space map page.");
+        rids.push_back(rid);
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    assert(numPages > 3 && "The records should take up several pages.");
+
+    // Empty the first data page
+    unsigned deleted = 0;
+    for (int i = 0; i < numRecords; i++)
+    {
+        if (rids[i].pageNum != rids[0].pageNum)
+            continue;
+        rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+        assert(rc == success && "Deleting a record should not fail.");
+        deleted++;
+    }
+
+    // The same number of records fits in again without adding pages
+    for (unsigned i = 0; i < deleted; i++)
+    {
+        RID rid;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", numRecords + i, 170.1, 5000, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    assert(fileHandle.getNumberOfPages() == numPages && "Inserts should have reused the freed space.");
+
+    // A scan sees every live record once
+    vector<string> attributes;
+    attributes.push_back("Age");
+    RBFM_ScanIterator rbfm_ScanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfm_ScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    RID rid;
+    void *returnedData = malloc(100);
+    int count = 0;
+    while (rbfm_ScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+        count++;
+    rbfm_ScanIterator.close();
+    assert(count == numRecords && "The scan should return every record.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 14 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test14");
+
+    RC rcmain = RBFTest_14(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,180 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+void fillPage(void *data, unsigned pageNum, unsigned version)
+{
+    for (unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((char *)data+i) = (i + pageNum + version) % 94 + 32;
+    }
+}
+
+int RBFTest_15(PagedFileManager *pfm, RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File, memory mapped
+    // 3. Get Page - points into the map, sees writes still in the buffer pool **
+    // 4. Append Page - past the end of the map, which has to grow **
+    // 5. Scan over a memory mapped handle **
+    // 6. Close File
+    // 7. Destroy File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RBF Test Case 15 *****" << endl;
+
+    RC rc;
+    string fileName = "test15";
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    fileHandle.setMemoryMapped(true);
+    assert(fileHandle.isMemoryMapped() && "The handle should be memory mapped.");
+
+    void *data = malloc(PAGE_SIZE);
+    const unsigned numberOfPages = 10;
+    for (unsigned j = 0; j < numberOfPages; j++)
+    {
+        fillPage(data, j, 0);
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    // Until they are written back the pages are only in the buffer pool
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+
+    // Pages come straight from the map
+    const void *page;
+    rc = fileHandle.getPage(5, page);
+    assert(rc == success && "Getting a page should not fail.");
+    fillPage(data, 5, 0);
+    assert(memcmp(page, data, PAGE_SIZE) == 0 && "The page should hold what was appended.");
+    const void *firstPage = page;
+
+    // A write sits in the buffer pool, and getPage() has to return it anyway
+    fillPage(data, 1, 1);
+    rc = fileHandle.writePage(1, data);
+    assert(rc == success && "Writing a page should not fail.");
+    rc = fileHandle.getPage(1, page);
+    assert(rc == success && "Getting a page should not fail.");
+    assert(memcmp(page, data, PAGE_SIZE) == 0 && "The page should hold what was written.");
+
+    // Grow the file past the end of the map
+    const unsigned moreNumberOfPages = FH_MIN_MAP_SIZE / PAGE_SIZE + 10;
+    for (unsigned j = numberOfPages; j < moreNumberOfPages; j++)
+    {
+        fillPage(data, j, 0);
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+    rc = fileHandle.getPage(moreNumberOfPages - 1, page);
+    assert(rc == success && "Getting a page should not fail.");
+    fillPage(data, moreNumberOfPages - 1, 0);
+    assert(memcmp(page, data, PAGE_SIZE) == 0 && "The page should hold what was appended.");
+
+    // Pages handed out before the file was mapped again are still good
+    fillPage(data, 5, 0);
+    assert(memcmp(firstPage, data, PAGE_SIZE) == 0 && "An old page pointer should still be valid.");
+
+    // readPage() goes through the map too
+    void *buffer = malloc(PAGE_SIZE);
+    rc = fileHandle.readPage(moreNumberOfPages / 2, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    fillPage(data, moreNumberOfPages / 2, 0);
+    assert(memcmp(buffer, data, PAGE_SIZE) == 0 && "The page should hold what was appended.");
+
+    rc = fileHandle.getPage(moreNumberOfPages, page);
+    assert(rc != success && "Getting a page that does not exist should fail.");
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    // Scan a record-based file through a memory mapped handle
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    const int numRecords = 2000;
+    int recordSize = 0;
+    RID rid;
+    for (int i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", i, 170.1, 5000, buffer, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, buffer, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+
+    fileHandle.setMemoryMapped(true);
+    vector<string> attributes;
+    attributes.push_back("Age");
+    RBFM_ScanIterator rbfm_ScanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfm_ScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    int count = 0;
+    long sum = 0;
+    while (rbfm_ScanIterator.getNextRecord(rid, buffer) != RBFM_EOF)
+    {
+        sum += *(int *)((char *)buffer + 1);
+        count++;
+    }
+    rbfm_ScanIterator.close();
+    assert(count == numRecords && "The scan should return every record.");
+    assert(sum == (long) numRecords * (numRecords - 1) / 2 && "The scan should return the right records.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(data);
+    free(buffer);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 15 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the memory mapped read path of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test15");
+
+    RC rcmain = RBFTest_15(pfm, rbfm);
+    return rcmain;
+}
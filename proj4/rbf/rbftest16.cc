@@ -0,0 +1,138 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Size of the file on disk, in pages
+unsigned getFileSizeInPages(const string &fileName)
+{
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) != 0)
+        return 0;
+    return sb.st_size / PAGE_SIZE;
+}
+
+int RBFTest_16(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File
+    // 3. Append Page, Write Page - nothing is written until a group commit **
+    // 4. Sync - writes back the dirty pages **
+    // 5. Close File - writes back the dirty pages, reopen and read them back
+    // 6. Destroy File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RBF Test Case 16 *****" << endl;
+
+    RC rc;
+    string fileName = "test16";
+    BufferManager *bm = BufferManager::instance();
+
+    // Commit every 8 dirty pages, never on time
+    const unsigned groupCommitPages = 8;
+    bm->setGroupCommit(groupCommitPages, 0);
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *data = malloc(PAGE_SIZE);
+    unsigned physicalReadCount = 0;
+    unsigned physicalWriteCount = 0;
+
+    // Below the threshold the pages stay in the buffer pool
+    for (unsigned j = 0; j < groupCommitPages - 1; j++)
+    {
+        memset(data, 'a' + j, PAGE_SIZE);
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    assert(fileHandle.getNumberOfPages() == groupCommitPages - 1 && "The number of pages is not correct.");
+    rc = fileHandle.collectPhysicalCounterValues(physicalReadCount, physicalWriteCount);
+    assert(rc == success && "collectPhysicalCounterValues() should not fail.");
+    assert(physicalWriteCount == 0 && "No page should have been written yet.");
+    assert(getFileSizeInPages(fileName) == 0 && "No page should have reached the file yet.");
+
+    // The page that reaches the threshold commits all of them
+    memset(data, 'a' + groupCommitPages - 1, PAGE_SIZE);
+    rc = fileHandle.appendPage(data);
+    assert(rc == success && "Appending a page should not fail.");
+    rc = fileHandle.collectPhysicalCounterValues(physicalReadCount, physicalWriteCount);
+    assert(rc == success && "collectPhysicalCounterValues() should not fail.");
+    assert(physicalWriteCount == groupCommitPages && "The group commit should have written every dirty page.");
+    assert(getFileSizeInPages(fileName) == groupCommitPages && "The pages should have reached the file.");
+
+    // Rewriting a page makes it dirty again until sync()
+    memset(data, 'z', PAGE_SIZE);
+    rc = fileHandle.writePage(2, data);
+    assert(rc == success && "Writing a page should not fail.");
+    rc = fileHandle.collectPhysicalCounterValues(physicalReadCount, physicalWriteCount);
+    assert(physicalWriteCount == groupCommitPages && "The page should not have been written yet.");
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+    rc = fileHandle.collectPhysicalCounterValues(physicalReadCount, physicalWriteCount);
+    assert(physicalWriteCount == groupCommitPages + 1 && "sync() should have written the dirty page.");
+
+    // A page still dirty at close is written back then
+    memset(data, 'y', PAGE_SIZE);
+    rc = fileHandle.writePage(3, data);
+    assert(rc == success && "Writing a page should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    void *buffer = malloc(PAGE_SIZE);
+    for (unsigned j = 0; j < groupCommitPages; j++)
+    {
+        memset(data, j == 2 ? 'z' : j == 3 ? 'y' : 'a' + j, PAGE_SIZE);
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        rc = memcmp(data, buffer, PAGE_SIZE);
+        assert(rc == success && "Checking the integrity of a page should not fail.");
+    }
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    free(data);
+    free(buffer);
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    bm->setGroupCommit(BM_DEFAULT_GROUP_COMMIT_PAGES, BM_DEFAULT_GROUP_COMMIT_INTERVAL);
+
+    cout << "RBF Test Case 16 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the group commit write path of the buffer pool
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test16");
+
+    RC rcmain = RBFTest_16(pfm);
+    return rcmain;
+}
@@ -0,0 +1,207 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <cmath>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "predicate.h"
+#include "test_util.h"
+
+using namespace std;
+
+// The answer of the kernels, one value at a time
+template <typename T>
+bool expectedResult(T x, CompOp compOp, T value)
+{
+    switch (compOp)
+    {
+        case EQ_OP: return x == value;
+        case LT_OP: return x < value;
+        case GT_OP: return x > value;
+        case LE_OP: return x <= value;
+        case GE_OP: return x >= value;
+        case NE_OP: return x != value;
+        default: return true;
+    }
+}
+
+template <typename T>
+void checkKernel(const T *values, unsigned n, CompOp compOp, T value)
+{
+    uint64_t mask[(1000 + 63) / 64 + 1];
+    // Garbage, including in the bits past n, has to be overwritten
+    memset(mask, 0xA5, sizeof(mask));
+    evaluatePredicate(values, n, compOp, value, mask);
+    for (unsigned i = 0; i < (n + 63) / 64 * 64; i++)
+    {
+        bool bit = mask[i / 64] & (1ULL << (i % 64));
+        bool expected = i < n && expectedResult(values[i], compOp, value);
+        assert(bit == expected && "The kernel should set the bit of every value meeting the condition.");
+    }
+}
+
+int RBFTest_17(RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Compare kernels on INT and REAL columns, for every kernel the CPU has **
+    // 2. Create File
+    // 3. Insert Record, Delete Record
+    // 4. Scan with a condition on an INT and on a REAL attribute **
+    // 5. Close File
+    // 6. Destroy File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RBF Test Case 17 *****" << endl;
+
+    RC rc;
+    string fileName = "test17";
+
+    // Lengths around the vector widths and the 64 bit mask words
+    const unsigned lengths[] = {0, 1, 3, 4, 7, 8, 9, 63, 64, 65, 1000};
+    const CompOp ops[] = {EQ_OP, LT_OP, GT_OP, LE_OP, GE_OP, NE_OP, NO_OP};
+    int32_t intValues[1000];
+    float realValues[1000];
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        intValues[i] = (int32_t) (rand() % 21) - 10;
+        realValues[i] = (float) (rand() % 21 - 10) / 2;
+    }
+    intValues[10] = INT32_MIN;
+    intValues[11] = INT32_MAX;
+    realValues[10] = NAN;
+    realValues[11] = -0.0f;
+    realValues[12] = INFINITY;
+
+    PredicateKernel best = getBestPredicateKernel();
+    cout << "Best kernel: " << (best == PK_AVX2 ? "AVX2" : best == PK_SSE42 ? "SSE4.2" : "scalar") << endl;
+    for (int kernel = PK_SCALAR; kernel <= best; kernel++)
+    {
+        bool set = setPredicateKernel((PredicateKernel) kernel);
+        assert(set && "The CPU should support every kernel up to the best one.");
+        for (unsigned n : lengths)
+        {
+            for (CompOp compOp : ops)
+            {
+                checkKernel(intValues, n, compOp, (int32_t) 0);
+                checkKernel(intValues, n, compOp, (int32_t) INT32_MIN);
+                checkKernel(realValues, n, compOp, 0.0f);
+                checkKernel(realValues, n, compOp, 2.5f);
+                checkKernel(realValues, n, compOp, (float) NAN);
+            }
+        }
+    }
+    if (best != PK_AVX2)
+        assert(!setPredicateKernel(PK_AVX2) && "A kernel the CPU does not support should be refused.");
+    setPredicateKernel(best);
+
+    // Scans evaluate INT and REAL conditions a page at a time
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+
+    // Every 10th record has a null Age and Height, and every 7th is deleted
+    const int numRecords = 3000;
+    void *record = malloc(100);
+    int recordSize = 0;
+    RID rid;
+    int expectedAgeCount = 0;
+    int expectedHeightCount = 0;
+    for (int i = 0; i < numRecords; i++)
+    {
+        memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+        bool null = i % 10 == 0;
+        if (null)
+            nullsIndicator[0] = (1 << 6) | (1 << 5);
+        int age = i % 100;
+        float height = (float) (i % 200) / 2;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", age, height, i, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+
+        if (i % 7 == 0)
+        {
+            rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
+            assert(rc == success && "Deleting a record should not fail.");
+        }
+        else if (!null)
+        {
+            expectedAgeCount += age < 30;
+            expectedHeightCount += height >= 75.5;
+        }
+    }
+
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    attributes.push_back("Age");
+    attributes.push_back("Height");
+
+    int ageValue = 30;
+    RBFM_ScanIterator rbfm_ScanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "Age", LT_OP, &ageValue, attributes, rbfm_ScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    int count = 0;
+    while (rbfm_ScanIterator.getNextRecord(rid, record) != RBFM_EOF)
+    {
+        int salary = *(int *) ((char *) record + 1);
+        int age = *(int *) ((char *) record + 5);
+        assert(*(unsigned char *) record == 0 && "A record meeting the condition has no nulls.");
+        assert(age < 30 && age == salary % 100 && salary % 7 != 0 && "The scan should return the right records.");
+        count++;
+    }
+    rbfm_ScanIterator.close();
+    assert(count == expectedAgeCount && "The scan should return every record meeting the condition.");
+
+    float heightValue = 75.5;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "Height", GE_OP, &heightValue, attributes, rbfm_ScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    count = 0;
+    while (rbfm_ScanIterator.getNextRecord(rid, record) != RBFM_EOF)
+    {
+        float height = *(float *) ((char *) record + 9);
+        assert(height >= 75.5 && "The scan should return the right records.");
+        count++;
+    }
+    rbfm_ScanIterator.close();
+    assert(count == expectedHeightCount && "The scan should return every record meeting the condition.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 17 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the compare kernels of scans
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test17");
+
+    RC rcmain = RBFTest_17(rbfm);
+    return rcmain;
+}
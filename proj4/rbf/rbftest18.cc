@@ -0,0 +1,170 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned numberOfFiles = 4;
+
+string getTestFileName(unsigned i)
+{
+    return "test18_" + to_string(i);
+}
+
+// Open and close a file, and check whether the open found it still open
+void openAndClose(PagedFileManager *pfm, const string &fileName, bool expectHit)
+{
+    unsigned hitCount, missCount, oldHitCount, oldMissCount;
+    pfm->collectStatistics(oldHitCount, oldMissCount);
+
+    FileHandle fileHandle;
+    RC rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    pfm->collectStatistics(hitCount, missCount);
+    if (expectHit)
+        assert(hitCount == oldHitCount + 1 && missCount == oldMissCount && "The file should still be open.");
+    else
+        assert(hitCount == oldHitCount && missCount == oldMissCount + 1 && "The file should have been opened again.");
+}
+
+int RBFTest_18(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File, Close File - the file stays open for the next open **
+    // 3. Open file budget - the least recently used files are closed **
+    // 4. Open File after the file was replaced behind our back **
+    // 5. Destroy File - closes the file **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RBF Test Case 18 *****" << endl;
+
+    RC rc;
+    void *data = malloc(PAGE_SIZE);
+    memset(data, 'a', PAGE_SIZE);
+
+    unsigned openFileCount = pfm->getOpenFileCount();
+    for (unsigned i = 0; i < numberOfFiles; i++)
+    {
+        string fileName = getTestFileName(i);
+        rc = pfm->createFile(fileName);
+        assert(rc == success && "Creating the file should not fail.");
+        rc = createFileShouldSucceed(fileName);
+        assert(rc == success && "Creating the file should not fail.");
+    }
+    pfm->resetStatistics();
+
+    // The first open has to fopen() the file, the next ones find it open
+    openAndClose(pfm, getTestFileName(0), false);
+    assert(pfm->getOpenFileCount() == openFileCount + 1 && "The file should stay open after it is closed.");
+    for (unsigned i = 0; i < 10; i++)
+        openAndClose(pfm, getTestFileName(0), true);
+
+    // Pages written through one handle are there for the next, which shares the FILE*
+    FileHandle fileHandle;
+    rc = pfm->openFile(getTestFileName(0), fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle.appendPage(data);
+    assert(rc == success && "Appending a page should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->openFile(getTestFileName(0), fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getNumberOfPages() == 1 && "The appended page should be in the file.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // With a budget of 2, the least recently closed files go
+    pfm->setOpenFileBudget(2);
+    assert(pfm->getOpenFileBudget() == 2 && "The budget should have been changed.");
+    for (unsigned i = 1; i < numberOfFiles; i++)
+        openAndClose(pfm, getTestFileName(i), false);
+    assert(pfm->getOpenFileCount() <= openFileCount + 2 && "No more files than the budget should stay open.");
+    openAndClose(pfm, getTestFileName(numberOfFiles - 1), true);
+    openAndClose(pfm, getTestFileName(numberOfFiles - 2), true);
+    openAndClose(pfm, getTestFileName(0), false);
+
+    // Files with handles do not count against the budget
+    FileHandle fileHandles[numberOfFiles];
+    for (unsigned i = 0; i < numberOfFiles; i++)
+    {
+        rc = pfm->openFile(getTestFileName(i), fileHandles[i]);
+        assert(rc == success && "Opening the file should not fail.");
+    }
+    for (unsigned i = 0; i < numberOfFiles; i++)
+    {
+        rc = pfm->closeFile(fileHandles[i]);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+    assert(pfm->getOpenFileCount() <= openFileCount + 2 && "No more files than the budget should stay open.");
+
+    // A budget of 0 closes files with their last handle
+    pfm->setOpenFileBudget(0);
+    assert(pfm->getOpenFileCount() == openFileCount && "Every file without handles should be closed.");
+    openAndClose(pfm, getTestFileName(0), false);
+    openAndClose(pfm, getTestFileName(0), false);
+    pfm->setOpenFileBudget(PFM_DEFAULT_OPEN_FILE_BUDGET);
+
+    // Someone else replaces the file while we keep it open: the old FILE* and pages are stale
+    string fileName = getTestFileName(1);
+    openAndClose(pfm, fileName, false);
+    remove(fileName.c_str());
+    FILE *pFile = fopen(fileName.c_str(), "wb");
+    assert(pFile != NULL && "Creating the file behind the manager's back should not fail.");
+    memset(data, 'b', PAGE_SIZE);
+    fwrite(data, PAGE_SIZE, 1, pFile);
+    fwrite(data, PAGE_SIZE, 1, pFile);
+    fclose(pFile);
+    openAndClose(pfm, fileName, false);
+
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getNumberOfPages() == 2 && "The file should have the pages written behind our back.");
+    void *buffer = malloc(PAGE_SIZE);
+    rc = fileHandle.readPage(1, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    assert(memcmp(buffer, data, PAGE_SIZE) == 0 && "The page should hold what was written behind our back.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroying the files closes them
+    for (unsigned i = 0; i < numberOfFiles; i++)
+    {
+        string fileName = getTestFileName(i);
+        rc = pfm->destroyFile(fileName);
+        assert(rc == success && "Destroying the file should not fail.");
+        rc = destroyFileShouldSucceed(fileName);
+        assert(rc == success && "Destroying the file should not fail.");
+    }
+    assert(pfm->getOpenFileCount() == openFileCount && "Destroyed files should be closed.");
+
+    free(data);
+    free(buffer);
+
+    cout << "RBF Test Case 18 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the files kept open between opens
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    for (unsigned i = 0; i < numberOfFiles; i++)
+        remove(getTestFileName(i).c_str());
+
+    RC rcmain = RBFTest_18(pfm);
+    return rcmain;
+}
@@ -0,0 +1,237 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "wal.h"
+#include "test_util.h"
+
+using namespace std;
+
+const string fileName = "test19";
+const string logFileName = "test19.log";
+const int numRecords = 100;
+
+// Size of the file on disk, in pages
+unsigned getFileSizeInPages(const string &fileName)
+{
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) != 0)
+        return 0;
+    return sb.st_size / PAGE_SIZE;
+}
+
+void prepareTestRecord(const vector<Attribute> &recordDescriptor, int i, int salary, void *record, int *recordSize)
+{
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    string name = "Crash" + to_string(i);
+    prepareRecord(recordDescriptor.size(), nullsIndicator, name.length(), name, i, 170.0 + i, salary, record, recordSize);
+    free(nullsIndicator);
+}
+
+// Runs the child as a process that dies without writing back the buffer pool
+void crashAfter(void (*child)(const vector<Attribute> &), const vector<Attribute> &recordDescriptor)
+{
+    cout.flush();
+    pid_t pid = fork();
+    assert(pid >= 0 && "fork() should not fail.");
+    if (pid == 0)
+    {
+        child(recordDescriptor);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "The crashing process should have got to the end.");
+}
+
+// Inserts the records one operation at a time, and only syncs the log
+void insertAndCrash(const vector<Attribute> &recordDescriptor)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    LogManager *log = LogManager::instance();
+
+    // Sync the log every 10 operations, never on time
+    log->setGroupCommit(10, 0);
+    RC rc = log->open(logFileName);
+    assert(rc == success && "Opening the log should not fail.");
+
+    // Closing the new file writes its free space map page
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    log->resetStatistics();
+
+    void *record = malloc(1000);
+    int recordSize;
+    RID rid;
+    for (int i = 0; i < numRecords; i++)
+    {
+        prepareTestRecord(recordDescriptor, i, i, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    free(record);
+
+    // Every insert is logged, but the log is synced once per group, and the pages not at all
+    unsigned recordCount, syncCount;
+    log->collectStatistics(recordCount, syncCount);
+    assert(recordCount >= 2 * numRecords && "Every insert should have logged a page write and a commit.");
+    assert(syncCount == numRecords / 10 && "The log should have been synced once per group of operations.");
+    assert(getFileSizeInPages(fileName) == 1 && "No record page should have reached the file.");
+}
+
+// Changes half of the records and adds more, writes every page back, and dies in the middle of the operation
+void updateAndCrash(const vector<Attribute> &recordDescriptor)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    LogManager *log = LogManager::instance();
+
+    RC rc = log->open(logFileName);
+    assert(rc == success && "Opening the log should not fail.");
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    log->beginOperation();
+    void *record = malloc(1000);
+    int recordSize;
+    RID rid;
+    for (int i = 0; i < numRecords; i += 2)
+    {
+        rid.pageNum = 1;
+        rid.slotNum = i;
+        prepareTestRecord(recordDescriptor, i, -1, record, &recordSize);
+        rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Updating a record should not fail.");
+    }
+    for (int i = 0; i < 10 * numRecords; i++)
+    {
+        prepareTestRecord(recordDescriptor, numRecords + i, -1, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    free(record);
+
+    // The half-done operation reaches the file
+    rc = BufferManager::instance()->flushAll();
+    assert(rc == success && "Writing back the buffer pool should not fail.");
+    assert(getFileSizeInPages(fileName) > 2 && "The new pages should have reached the file.");
+}
+
+// Checks that the file holds exactly the committed records
+void checkRecords(const vector<Attribute> &recordDescriptor)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    FileHandle fileHandle;
+    RC rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *record = malloc(1000);
+    void *returnedData = malloc(1000);
+    int recordSize;
+    RID rid;
+    for (int i = 0; i < numRecords; i++)
+    {
+        rid.pageNum = 1;
+        rid.slotNum = i;
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        prepareTestRecord(recordDescriptor, i, i, record, &recordSize);
+        assert(memcmp(record, returnedData, recordSize) == 0 && "The record should be the committed one.");
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Salary");
+    RBFM_ScanIterator rbfmScanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, rbfmScanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+    int count = 0;
+    while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        assert(*(int *) ((char *) returnedData + 1) >= 0 && "No uncommitted record should be left.");
+        count++;
+    }
+    rbfmScanIterator.close();
+    assert(count == numRecords && "The file should hold every committed record and nothing else.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    free(record);
+    free(returnedData);
+}
+
+int RBFTest_19(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Insert Record, Update Record - each is logged as one operation **
+    // 3. Group commit of the log, while the pages stay in the buffer pool **
+    // 4. Recovery - redo of committed operations lost with the buffer pool **
+    // 5. Recovery - undo of an operation cut short after its pages were written back **
+    // 6. Read Record, Scan
+    // 7. Destroy File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RBF Test Case 19 *****" << endl;
+
+    RC rc;
+    LogManager *log = LogManager::instance();
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    // The inserts are only in the log when the process dies
+    crashAfter(insertAndCrash, recordDescriptor);
+    assert(getFileSizeInPages(fileName) == 1 && "No record page should have reached the file.");
+    rc = log->open(logFileName);
+    assert(rc == success && "Recovery should not fail.");
+    assert(getFileSizeInPages(fileName) == 2 && "Recovery should have written the page of the records.");
+    checkRecords(recordDescriptor);
+    rc = log->close();
+    assert(rc == success && "Closing the log should not fail.");
+    string name = logFileName;
+    assert(!FileExists(name) && "The log should be gone after it is closed.");
+
+    // The updates are in the file but were never committed
+    crashAfter(updateAndCrash, recordDescriptor);
+    rc = log->open(logFileName);
+    assert(rc == success && "Recovery should not fail.");
+    assert(getFileSizeInPages(fileName) == 2 && "Recovery should have cut off the new pages.");
+    checkRecords(recordDescriptor);
+    rc = log->close();
+    assert(rc == success && "Closing the log should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    name = fileName;
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 19 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the write-ahead log and recovery
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove(fileName.c_str());
+    remove(logFileName.c_str());
+
+    RC rcmain = RBFTest_19(pfm);
+    return rcmain;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <map>
+#include <chrono>
+#include <thread>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "pscan.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned numRecords = 20000;
+const unsigned numThreads = 4;
+const unsigned morselPages = 2;
+
+// Age and salary of a record, by RID
+typedef map<pair<unsigned, unsigned>, pair<int, int> > ScanResult;
+
+void addRecord(ScanResult &result, const RID &rid, const void *data)
+{
+    // Null indicator, then Age and Salary
+    int age, salary;
+    memcpy(&age, (char *) data + 1, sizeof(int));
+    memcpy(&salary, (char *) data + 1 + sizeof(int), sizeof(int));
+    auto key = make_pair(rid.pageNum, rid.slotNum);
+    assert(result.find(key) == result.end() && "A record should only be returned once.");
+    result[key] = make_pair(age, salary);
+}
+
+int RBFTest_20(RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Create File, Open File
+    // 2. Insert Record, Delete Record, Update Record
+    // 3. Scan
+    // 4. Parallel Scan - the same records as a scan, on a buffered and a memory mapped handle **
+    // 5. Parallel Scan - idle workers steal morsels from a slow one **
+    // 6. Parallel Scan - errors from a worker, closing before the end **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RBF Test Case 20 *****" << endl;
+
+    RC rc;
+    string fileName = "test20";
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    void *record = malloc(200);
+    int recordSize = 0;
+
+    // Records of different sizes, some deleted, and some moved to other pages by an update
+    vector<RID> rids(numRecords);
+    for (unsigned i = 0; i < numRecords; i++)
+    {
+        string name(i % 20 + 1, 'a' + i % 26);
+        prepareRecord(recordDescriptor.size(), nullsIndicator, name.length(), name, i, 170.1, i * 2, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    for (unsigned i = 0; i < numRecords; i += 7)
+    {
+        rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+        assert(rc == success && "Deleting a record should not fail.");
+    }
+    string longName(100, 'z');
+    for (unsigned i = 1; i < numRecords; i += 11)
+    {
+        if (i % 7 == 0)
+            continue;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, longName.length(), longName, i, 170.1, -i, record, &recordSize);
+        rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Updating a record should not fail.");
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Salary");
+    int ageLimit = 1000;
+
+    // What a scan on one thread finds
+    ScanResult expected;
+    RBFM_ScanIterator rbfm_ScanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "Age", GT_OP, &ageLimit, attributeNames, rbfm_ScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    RID rid;
+    char data[PAGE_SIZE];
+    while (rbfm_ScanIterator.getNextRecord(rid, data) != RBFM_EOF)
+        addRecord(expected, rid, data);
+    rbfm_ScanIterator.close();
+    assert(expected.size() > 0 && "The scan should find records.");
+
+    // The parallel scan finds the same records, and goes through every morsel once
+    unsigned numPages = fileHandle.getNumberOfPages();
+    for (int memoryMapped = 0; memoryMapped <= 1; memoryMapped++)
+    {
+        fileHandle.setMemoryMapped(memoryMapped);
+        RBFM_ParallelScanIterator parallelIterator;
+        rc = rbfm->parallelScan(fileHandle, recordDescriptor, "Age", GT_OP, &ageLimit, attributeNames,
+                parallelIterator, numThreads, morselPages);
+        assert(rc == success && "Starting a parallel scan should not fail.");
+        assert(parallelIterator.getNumberOfWorkers() == numThreads && "The scan should use the threads asked for.");
+
+        ScanResult result;
+        while ((rc = parallelIterator.getNextRecord(rid, data)) == success)
+            addRecord(result, rid, data);
+        assert(rc == RBFM_EOF && "The parallel scan should end with RBFM_EOF.");
+        assert(result == expected && "The parallel scan should find the records the scan finds.");
+
+        unsigned morselCount, stolenCount;
+        parallelIterator.collectStatistics(morselCount, stolenCount);
+        assert(morselCount == (numPages + morselPages - 1) / morselPages && "Every morsel should be scanned once.");
+        parallelIterator.close();
+    }
+    fileHandle.setMemoryMapped(false);
+
+    // Handing the records to a consumer. Worker 0 is held up on its first record, so
+    // the others run out of morsels of their own and take the rest of worker 0's.
+    vector<ScanResult> found(numThreads);
+    vector<unsigned> stolenPages(numThreads, 0);
+    ScanConsumer consumer = [&](unsigned worker, const RID &rid, const void *data) {
+        if (worker == 0 && found[0].empty())
+            this_thread::sleep_for(chrono::milliseconds(200));
+        addRecord(found[worker], rid, data);
+        // Morsels are dealt out in turn
+        if ((rid.pageNum / morselPages) % numThreads == 0 && worker != 0)
+            stolenPages[worker]++;
+        return success;
+    };
+    rc = rbfm->parallelScan(fileHandle, recordDescriptor, "Age", GT_OP, &ageLimit, attributeNames,
+            consumer, numThreads, morselPages);
+    assert(rc == success && "A parallel scan with a consumer should not fail.");
+    ScanResult merged;
+    unsigned stolen = 0;
+    for (unsigned i = 0; i < numThreads; i++)
+    {
+        merged.insert(found[i].begin(), found[i].end());
+        stolen += stolenPages[i];
+    }
+    assert(merged.size() == expected.size() && merged == expected && "The workers should find every record once.");
+    assert(stolen > 0 && "Idle workers should have stolen morsels from the slow one.");
+
+    // The first error from a consumer is what the scan returns
+    const RC consumerError = 42;
+    ScanConsumer failing = [&](unsigned worker, const RID &rid, const void *data) {
+        return rid.pageNum > numPages / 2 ? consumerError : success;
+    };
+    rc = rbfm->parallelScan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, failing, numThreads, morselPages);
+    assert(rc == consumerError && "The consumer's error should be returned.");
+
+    // Unknown attributes are found before any worker starts
+    vector<string> badNames;
+    badNames.push_back("NoSuchAttribute");
+    RBFM_ParallelScanIterator badIterator;
+    rc = rbfm->parallelScan(fileHandle, recordDescriptor, "", NO_OP, NULL, badNames, badIterator, numThreads);
+    assert(rc == RBFM_NO_SUCH_ATTR && "Projecting an unknown attribute should fail.");
+
+    // Closing while the workers wait for room on the queue stops them
+    RBFM_ParallelScanIterator earlyIterator;
+    rc = rbfm->parallelScan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, earlyIterator, numThreads, morselPages);
+    assert(rc == success && "Starting a parallel scan should not fail.");
+    rc = earlyIterator.getNextRecord(rid, data);
+    assert(rc == success && "The parallel scan should return a record.");
+    this_thread::sleep_for(chrono::milliseconds(50));
+    rc = earlyIterator.close();
+    assert(rc == success && "Closing a parallel scan early should not fail.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 20 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main()
+{
+    // To test the parallel scan
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test20");
+
+    RC rcmain = RBFTest_20(rbfm);
+    return rcmain;
+}
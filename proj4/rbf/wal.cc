@@ -0,0 +1,504 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "wal.h"
+
+// Start of the FNV-1a checksum of a record
+#define WAL_CHECKSUM_BASIS 2166136261u
+
+LogManager* LogManager::_log_manager = NULL;
+
+LogManager* LogManager::instance()
+{
+    static LogManager *manager = _log_manager = new LogManager();
+    return manager;
+}
+
+LogManager::LogManager()
+: log(NULL), nextLSN(1), flushedLSN(0), logSize(0), status(SUCCESS), nextOperation(1), operation(0), depth(0),
+  checkpointSize(WAL_DEFAULT_CHECKPOINT_SIZE), groupCommitOperations(WAL_DEFAULT_GROUP_COMMIT_OPERATIONS),
+  groupCommitInterval(WAL_DEFAULT_GROUP_COMMIT_INTERVAL), pendingOperations(0), recordCounter(0), syncCounter(0)
+{
+}
+
+LogManager::~LogManager()
+{
+}
+
+RC LogManager::open(const string &fileName)
+{
+    if (log != NULL)
+        return WAL_OPEN_FAILED;
+
+    // Recovery writes the files behind the buffer pool's back
+    PagedFileManager *pfm = PagedFileManager::instance();
+    lock_guard<recursive_mutex> guard(pfm->filesMutex);
+    for (auto &entry : pfm->files)
+    {
+        if (entry.second->refCount > 0)
+            return WAL_FILES_OPEN;
+    }
+
+    logFileName = fileName;
+    set<string> recoveredFiles;
+    RC rc = recover(recoveredFiles);
+    if (rc)
+        return rc;
+    for (const string &recoveredFile : recoveredFiles)
+        pfm->forgetFile(recoveredFile);
+
+    // Everything in the old log is on disk now, so we start a new one
+    log = fopen(logFileName.c_str(), "wb");
+    if (log == NULL)
+        return WAL_OPEN_FAILED;
+    if (fdatasync(fileno(log)) != 0)
+    {
+        fclose(log);
+        log = NULL;
+        return WAL_SYNC_FAILED;
+    }
+
+    flushedLSN = nextLSN - 1;
+    logSize = 0;
+    status = SUCCESS;
+    depth = 0;
+    touchedPages.clear();
+    writtenFiles.clear();
+    pendingOperations = 0;
+    return SUCCESS;
+}
+
+RC LogManager::close()
+{
+    if (log == NULL)
+        return SUCCESS;
+
+    lock_guard<recursive_mutex> operationGuard(operationMutex);
+    depth = 0;
+    touchedPages.clear();
+    RC rc = checkpoint();
+    lock_guard<mutex> guard(logMutex);
+    fclose(log);
+    log = NULL;
+    if (rc == SUCCESS)
+        remove(logFileName.c_str());
+    return rc;
+}
+
+bool LogManager::isEnabled()
+{
+    return log != NULL;
+}
+
+bool LogManager::beginOperation()
+{
+    if (log == NULL)
+        return false;
+    operationMutex.lock();
+    if (depth++ == 0)
+    {
+        operation = nextOperation++;
+        touchedPages.clear();
+    }
+    return true;
+}
+
+RC LogManager::endOperation()
+{
+    // The mutex was taken by beginOperation() even if close() has stopped logging since
+    RC rc = SUCCESS;
+    if (log != NULL && depth > 0 && --depth == 0)
+        rc = commitOperation();
+    operationMutex.unlock();
+    return rc;
+}
+
+RC LogManager::flush()
+{
+    if (log == NULL)
+        return SUCCESS;
+    lock_guard<mutex> guard(logMutex);
+    return flushLog();
+}
+
+RC LogManager::flushLog()
+{
+    if (status)
+        return status;
+    if (flushedLSN + 1 == nextLSN)
+        return SUCCESS;
+
+    if (fflush(log) != 0)
+        return status = WAL_WRITE_FAILED;
+    if (fdatasync(fileno(log)) != 0)
+        return status = WAL_SYNC_FAILED;
+    flushedLSN = nextLSN - 1;
+    pendingOperations = 0;
+    syncCounter++;
+    return SUCCESS;
+}
+
+RC LogManager::checkpoint()
+{
+    if (log == NULL)
+        return SUCCESS;
+    lock_guard<recursive_mutex> operationGuard(operationMutex);
+    if (status)
+        return status;
+    // The log still has to undo the operation in progress if we crash
+    if (depth > 0)
+        return flush();
+
+    // Every page the log describes goes to disk...
+    RC rc = BufferManager::instance()->flushAll();
+    if (rc)
+        return rc;
+    for (const string &fileName : writtenFiles)
+    {
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        // Destroyed since
+        if (fd < 0)
+            continue;
+        int result = fdatasync(fd);
+        ::close(fd);
+        if (result != 0)
+            return WAL_SYNC_FAILED;
+    }
+    writtenFiles.clear();
+
+    // ...so the log can start over
+    lock_guard<mutex> guard(logMutex);
+    if (fflush(log) != 0 || ftruncate(fileno(log), 0) != 0 || fseek(log, 0, SEEK_SET) != 0)
+        return status = WAL_WRITE_FAILED;
+    if (fdatasync(fileno(log)) != 0)
+        return status = WAL_SYNC_FAILED;
+    flushedLSN = nextLSN - 1;
+    logSize = 0;
+    pendingOperations = 0;
+    syncCounter++;
+    return SUCCESS;
+}
+
+void LogManager::setCheckpointSize(size_t size)
+{
+    checkpointSize = size;
+}
+
+void LogManager::setGroupCommit(unsigned operationThreshold, unsigned intervalMillis)
+{
+    groupCommitOperations = operationThreshold;
+    groupCommitInterval = intervalMillis;
+}
+
+RC LogManager::collectStatistics(unsigned &recordCount, unsigned &syncCount)
+{
+    lock_guard<mutex> guard(logMutex);
+    recordCount = recordCounter;
+    syncCount = syncCounter;
+    return SUCCESS;
+}
+
+void LogManager::resetStatistics()
+{
+    lock_guard<mutex> guard(logMutex);
+    recordCounter = 0;
+    syncCounter = 0;
+}
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+bool LogManager::needsBeforeImage(PagedFile *file, PageNum pageNum)
+{
+    return log != NULL && touchedPages.count(make_pair(file, pageNum)) == 0;
+}
+
+RC LogManager::logPageWrite(PagedFile *file, PageNum pageNum, const void *before, bool newPage, const void *after, LSN &lsn)
+{
+    if (status)
+        return status;
+
+    uint32_t flags = newPage ? LOG_NEW_PAGE : 0;
+    if (touchedPages.insert(make_pair(file, pageNum)).second)
+        flags |= LOG_HAS_BEFORE_IMAGE;
+    else
+        before = NULL;
+    if (newPage)
+        before = NULL;
+
+    RC rc = appendRecord(LOG_PAGE_WRITE, file->fileName, pageNum, flags, before, before ? PAGE_SIZE : 0, after, PAGE_SIZE, lsn);
+    if (rc)
+        return rc;
+    writtenFiles.insert(file->fileName);
+    return SUCCESS;
+}
+
+RC LogManager::flushTo(LSN lsn)
+{
+    if (log == NULL)
+        return SUCCESS;
+    lock_guard<mutex> guard(logMutex);
+    if (lsn <= flushedLSN)
+        return SUCCESS;
+    return flushLog();
+}
+
+RC LogManager::resetFile(const string &fileName)
+{
+    if (log == NULL)
+        return SUCCESS;
+
+    lock_guard<recursive_mutex> operationGuard(operationMutex);
+    for (auto it = touchedPages.begin(); it != touchedPages.end(); )
+        it = it->first->fileName == fileName ? touchedPages.erase(it) : ++it;
+
+    // Nothing in the log since the last checkpoint is about this file
+    if (writtenFiles.erase(fileName) == 0)
+        return SUCCESS;
+
+    // The record has to be on disk before a new file with the same name can be, or recovery
+    // would write the old file's pages into it
+    LSN lsn;
+    RC rc = appendRecord(LOG_FILE_RESET, fileName, 0, 0, NULL, 0, NULL, 0, lsn);
+    if (rc)
+        return rc;
+    return flush();
+}
+
+RC LogManager::commitOperation()
+{
+    // An operation that wrote nothing has nothing to commit
+    if (touchedPages.empty())
+        return status;
+    touchedPages.clear();
+
+    LSN lsn;
+    RC rc = appendRecord(LOG_COMMIT, "", 0, 0, NULL, 0, NULL, 0, lsn);
+    if (rc)
+        return rc;
+
+    // Group commit
+    {
+        lock_guard<mutex> guard(logMutex);
+        if (pendingOperations++ == 0)
+            pendingSince = chrono::steady_clock::now();
+        if ((groupCommitOperations > 0 && pendingOperations >= groupCommitOperations)
+            || (groupCommitInterval > 0 && chrono::steady_clock::now() - pendingSince >= chrono::milliseconds(groupCommitInterval)))
+        {
+            rc = flushLog();
+            if (rc)
+                return rc;
+        }
+        if (logSize < checkpointSize)
+            return SUCCESS;
+    }
+    return checkpoint();
+}
+
+RC LogManager::appendRecord(LogRecordType type, const string &fileName, PageNum pageNum, uint32_t flags,
+        const void *first, uint32_t firstLength, const void *second, uint32_t secondLength, LSN &lsn)
+{
+    lock_guard<mutex> guard(logMutex);
+    if (status)
+        return status;
+
+    LogRecordHeader header;
+    header.type = type;
+    header.lsn = nextLSN;
+    header.operation = operation;
+    header.pageNum = pageNum;
+    header.flags = flags;
+    header.nameLength = fileName.size();
+    header.dataLength = firstLength + secondLength;
+
+    uint32_t sum = checksum((char*) &header + sizeof(uint32_t), sizeof(LogRecordHeader) - sizeof(uint32_t), WAL_CHECKSUM_BASIS);
+    sum = checksum(fileName.data(), fileName.size(), sum);
+    sum = checksum(first, firstLength, sum);
+    header.checksum = checksum(second, secondLength, sum);
+
+    if (fwrite(&header, sizeof(LogRecordHeader), 1, log) != 1
+        || fwrite(fileName.data(), 1, fileName.size(), log) != fileName.size()
+        || (firstLength > 0 && fwrite(first, firstLength, 1, log) != 1)
+        || (secondLength > 0 && fwrite(second, secondLength, 1, log) != 1))
+        return status = WAL_WRITE_FAILED;
+
+    lsn = nextLSN++;
+    logSize += sizeof(LogRecordHeader) + fileName.size() + firstLength + secondLength;
+    recordCounter++;
+    return SUCCESS;
+}
+
+// FNV-1a, carrying on from hash
+uint32_t LogManager::checksum(const void *data, size_t length, uint32_t hash)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= ((const unsigned char*) data)[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// A page write record read back from the log
+struct LoggedPageWrite
+{
+    LSN lsn;
+    uint64_t operation;
+    string fileName;
+    PageNum pageNum;
+    uint32_t flags;
+    long offset;    // of the payload in the log
+};
+
+RC LogManager::recover(set<string> &recoveredFiles)
+{
+    FILE *in = fopen(logFileName.c_str(), "rb");
+    // No log, nothing to recover
+    if (in == NULL)
+        return SUCCESS;
+
+    // Analysis: the page writes, the operations that were committed, and where each file was last reset.
+    // The log ends at the first record that is incomplete or does not match its checksum.
+    vector<LoggedPageWrite> writes;
+    set<uint64_t> committed;
+    unordered_map<string, LSN> lastReset;
+    vector<char> buffer;
+    LogRecordHeader header;
+    while (fread(&header, sizeof(LogRecordHeader), 1, in) == 1)
+    {
+        if (header.nameLength > PATH_MAX || header.dataLength > 2 * PAGE_SIZE)
+            break;
+        buffer.resize(header.nameLength + header.dataLength);
+        if (!buffer.empty() && fread(&buffer[0], buffer.size(), 1, in) != 1)
+            break;
+        uint32_t sum = checksum((char*) &header + sizeof(uint32_t), sizeof(LogRecordHeader) - sizeof(uint32_t), WAL_CHECKSUM_BASIS);
+        if (checksum(buffer.data(), buffer.size(), sum) != header.checksum)
+            break;
+
+        string fileName(buffer.data(), header.nameLength);
+        if (header.type == LOG_COMMIT)
+        {
+            committed.insert(header.operation);
+        }
+        else if (header.type == LOG_FILE_RESET)
+        {
+            lastReset[fileName] = header.lsn;
+        }
+        else if (header.type == LOG_PAGE_WRITE)
+        {
+            LoggedPageWrite write;
+            write.lsn = header.lsn;
+            write.operation = header.operation;
+            write.fileName = fileName;
+            write.pageNum = header.pageNum;
+            write.flags = header.flags;
+            write.offset = ftell(in) - header.dataLength;
+            writes.push_back(write);
+        }
+        nextLSN = max(nextLSN, header.lsn + 1);
+        nextOperation = max(nextOperation, header.operation + 1);
+    }
+
+    unordered_map<string, int> fds;
+    RC rc = SUCCESS;
+    vector<char> page(PAGE_SIZE);
+    // Writes to a file from before it was last reset belong to a file that is gone
+    auto applies = [&](const LoggedPageWrite &write) {
+        auto it = lastReset.find(write.fileName);
+        if (it != lastReset.end() && write.lsn < it->second)
+            return -1;
+        auto fd = fds.find(write.fileName);
+        if (fd == fds.end())
+            fd = fds.insert(make_pair(write.fileName, ::open(write.fileName.c_str(), O_RDWR))).first;
+        return fd->second;
+    };
+    // Reads part of the payload of a page write
+    auto readImage = [&](const LoggedPageWrite &write, bool after) {
+        long offset = write.offset;
+        if (after && (write.flags & LOG_HAS_BEFORE_IMAGE) && !(write.flags & LOG_NEW_PAGE))
+            offset += PAGE_SIZE;
+        return fseek(in, offset, SEEK_SET) == 0 && fread(&page[0], PAGE_SIZE, 1, in) == 1;
+    };
+
+    // Redo: repeat every write of the committed operations, in log order
+    for (const LoggedPageWrite &write : writes)
+    {
+        if (committed.count(write.operation) == 0)
+            continue;
+        int fd = applies(write);
+        if (fd < 0)
+            continue;
+        if (!readImage(write, true) || pwrite(fd, &page[0], PAGE_SIZE, (off_t) PAGE_SIZE * write.pageNum) != PAGE_SIZE)
+        {
+            rc = WAL_RECOVERY_FAILED;
+            break;
+        }
+        recoveredFiles.insert(write.fileName);
+    }
+
+    // Undo: put back what the operations that did not commit found, newest first
+    for (auto it = writes.rbegin(); rc == SUCCESS && it != writes.rend(); ++it)
+    {
+        const LoggedPageWrite &write = *it;
+        if (committed.count(write.operation) > 0 || !(write.flags & LOG_HAS_BEFORE_IMAGE))
+            continue;
+        int fd = applies(write);
+        if (fd < 0)
+            continue;
+        if (write.flags & LOG_NEW_PAGE)
+        {
+            // The page was appended, so the file ends before it
+            struct stat sb;
+            if (fstat(fd, &sb) != 0 || (sb.st_size > (off_t) PAGE_SIZE * write.pageNum && ftruncate(fd, (off_t) PAGE_SIZE * write.pageNum) != 0))
+                rc = WAL_RECOVERY_FAILED;
+        }
+        else if (!readImage(write, false) || pwrite(fd, &page[0], PAGE_SIZE, (off_t) PAGE_SIZE * write.pageNum) != PAGE_SIZE)
+        {
+            rc = WAL_RECOVERY_FAILED;
+        }
+        recoveredFiles.insert(write.fileName);
+    }
+
+    for (auto &fd : fds)
+    {
+        if (fd.second < 0)
+            continue;
+        if (fdatasync(fd.second) != 0 && rc == SUCCESS)
+            rc = WAL_RECOVERY_FAILED;
+        ::close(fd.second);
+    }
+    fclose(in);
+    return rc;
+}
+
+
+LogOperation::LogOperation()
+{
+    begun = LogManager::instance()->beginOperation();
+}
+
+LogOperation::~LogOperation()
+{
+    // There is no undo outside recovery, and what the operation wrote may already be in the
+    // buffer pool, so an operation given up on is committed like any other. Left uncommitted,
+    // recovery would undo it over the operations after it. Its caller returns its own error.
+    if (begun)
+        LogManager::instance()->endOperation();
+}
+
+RC LogOperation::commit()
+{
+    if (!begun)
+        return SUCCESS;
+    begun = false;
+    return LogManager::instance()->endOperation();
+}
@@ -0,0 +1,181 @@
+#ifndef _wal_h_
+#define _wal_h_
+
+#include <string>
+#include <set>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+
+#include "pfm.h"
+
+#define WAL_OPEN_FAILED     1
+#define WAL_WRITE_FAILED    2
+#define WAL_SYNC_FAILED     3
+#define WAL_FILES_OPEN      4
+#define WAL_RECOVERY_FAILED 5
+
+// A checkpoint is taken once the log grows past this size, until LogManager::setCheckpointSize() is called
+#define WAL_DEFAULT_CHECKPOINT_SIZE (64 * 1024 * 1024)
+
+// Group commit triggers until LogManager::setGroupCommit() is called: the log is synced once
+// this many operations are waiting for it, or the oldest of them ended this long ago
+#define WAL_DEFAULT_GROUP_COMMIT_OPERATIONS 256
+#define WAL_DEFAULT_GROUP_COMMIT_INTERVAL 1000  // milliseconds
+
+typedef uint64_t LSN;
+
+typedef enum
+{
+    LOG_PAGE_WRITE = 1,     // after image of a page, and its before image the first time an operation writes it
+    LOG_COMMIT,             // the operation is complete
+    LOG_FILE_RESET          // the file was created or destroyed; earlier records of it no longer apply
+} LogRecordType;
+
+// Flags of a LOG_PAGE_WRITE record
+#define LOG_HAS_BEFORE_IMAGE 1  // the payload starts with the before image
+#define LOG_NEW_PAGE         2  // the page did not exist before the operation (appended)
+
+// Every record is this header, the file name and the payload:
+//  LOG_PAGE_WRITE: [before image, if LOG_HAS_BEFORE_IMAGE and not LOG_NEW_PAGE][after image]
+//  LOG_COMMIT, LOG_FILE_RESET: nothing
+typedef struct LogRecordHeader
+{
+    uint32_t checksum;      // of everything after it, so a torn record at the end of the log is ignored
+    uint32_t type;
+    LSN lsn;
+    uint64_t operation;
+    uint32_t pageNum;
+    uint32_t flags;
+    uint32_t nameLength;
+    uint32_t dataLength;
+} LogRecordHeader;
+
+// Write-ahead log of page writes, in one local log file.
+//
+// Writes between beginOperation() and the matching endOperation() form one atomic operation,
+// e.g. a record insert with its free space map update, or a B+ tree insert with its splits.
+// Operations nest; only the outermost one counts. A page write outside any operation is an
+// operation of its own. Each write logs the after image of the page, plus its before image
+// the first time the operation writes it.
+//
+// The buffer pool keeps the LSN of the last record of each page in its frame, and does not
+// write a page back before the log is on disk up to that LSN. Ended operations reach the
+// disk at a group commit, at a checkpoint or with flush(); pages themselves are written back
+// lazily and never synced one at a time.
+//
+// While logging, operations run one at a time: a thread that begins one waits for the
+// operation of any other thread to end. Before images are whole pages, so undoing an
+// operation would also undo whatever another one did to the same page in between.
+//
+// open() recovers from the log before logging starts: the after images of every complete
+// operation are written again in log order (redo), then the before images of an operation
+// cut short are written back in reverse order and pages it appended are cut off (undo).
+// Page images make both idempotent, so the on-disk page formats need no LSN.
+class LogManager
+{
+public:
+    static LogManager* instance();
+
+    // Recover from logFileName if it exists, then log every page write to it.
+    // No file may be open yet.
+    RC open(const string &logFileName);
+    // Take a checkpoint and stop logging
+    RC close();
+    bool isEnabled();
+
+    // Returns whether an operation was begun, which it is only while logging. Only an
+    // operation that was begun may be ended.
+    bool beginOperation();
+    RC endOperation();
+
+    // Put every ended operation on disk
+    RC flush();
+    // Write back every dirty page, sync the files and empty the log
+    RC checkpoint();
+
+    void setCheckpointSize(size_t size);
+    // 0 turns a trigger off
+    void setGroupCommit(unsigned operationThreshold, unsigned intervalMillis);
+
+    // Records written and syncs of the log since the last resetStatistics()
+    RC collectStatistics(unsigned &recordCount, unsigned &syncCount);
+    void resetStatistics();
+
+    friend class FileHandle;
+    friend class BufferManager;
+    friend class PagedFileManager;
+
+protected:
+    LogManager();
+    ~LogManager();
+
+private:
+    static LogManager *_log_manager;
+
+    // Held by the thread running an operation, from its beginOperation() to its endOperation()
+    recursive_mutex operationMutex;
+    // Guards the log file and the LSNs, never held while waiting for anything else
+    mutex logMutex;
+
+    FILE *log;
+    string logFileName;
+    LSN nextLSN;
+    LSN flushedLSN;
+    size_t logSize;
+    // First error writing the log. Once the log is broken every page write fails.
+    RC status;
+
+    uint64_t nextOperation;
+    uint64_t operation;
+    unsigned depth;
+    // Pages the current operation has written, so their before image is logged only once
+    set<pair<PagedFile*, PageNum> > touchedPages;
+    // Files written since the last checkpoint, which it has to sync
+    set<string> writtenFiles;
+
+    size_t checkpointSize;
+    unsigned groupCommitOperations;
+    unsigned groupCommitInterval;
+    unsigned pendingOperations;
+    chrono::steady_clock::time_point pendingSince;
+
+    unsigned recordCounter;
+    unsigned syncCounter;
+
+    // Called for every page write while logging. before is the page as it is now, or NULL
+    // if it is being appended. lsn is set to the LSN of the record.
+    bool needsBeforeImage(PagedFile *file, PageNum pageNum);
+    RC logPageWrite(PagedFile *file, PageNum pageNum, const void *before, bool newPage, const void *after, LSN &lsn);
+    // Make sure the log is on disk up to lsn, before a page with that LSN is written back
+    RC flushTo(LSN lsn);
+    // The file is about to be created, or has been destroyed
+    RC resetFile(const string &fileName);
+
+    // Log the commit of the operation that is ending, and sync the log if it is time to
+    RC commitOperation();
+    // flush() with logMutex held
+    RC flushLog();
+    RC appendRecord(LogRecordType type, const string &fileName, PageNum pageNum, uint32_t flags,
+            const void *first, uint32_t firstLength, const void *second, uint32_t secondLength, LSN &lsn);
+    RC recover(set<string> &recoveredFiles);
+    static uint32_t checksum(const void *data, size_t length, uint32_t hash);
+};
+
+// Makes everything written while it is in scope one operation of the log. commit() ends it
+// and returns whether its commit was logged; going out of scope without commit(), on an error
+// path, ends it too.
+class LogOperation
+{
+public:
+    LogOperation();
+    ~LogOperation();
+
+    RC commit();
+
+private:
+    bool begun;
+};
+
+#endif
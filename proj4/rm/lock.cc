@@ -0,0 +1,187 @@
+#include <chrono>
+
+#include "lock.h"
+
+// compatible[held][requested]
+static const bool compatible[LM_MODES][LM_MODES] =
+{
+    //           IS     IX     S      X
+    /* IS */  { true,  true,  true,  false },
+    /* IX */  { true,  true,  false, false },
+    /* S  */  { true,  false, true,  false },
+    /* X  */  { false, false, false, false }
+};
+
+LockManager* LockManager::_lock_manager = NULL;
+
+LockManager* LockManager::instance()
+{
+    static LockManager *manager = _lock_manager = new LockManager();
+    return manager;
+}
+
+LockManager::LockManager()
+: timeout(LM_DEFAULT_TIMEOUT), nextOwner(1), waitCounter(0), timeoutCounter(0)
+{
+}
+
+LockManager::~LockManager()
+{
+}
+
+RC LockManager::lockTable(const string &tableName, LockMode mode, LockOwner owner)
+{
+    return lock(tableName, mode, owner);
+}
+
+RC LockManager::unlockTable(const string &tableName, LockMode mode, LockOwner owner)
+{
+    return unlock(tableName, mode, owner);
+}
+
+RC LockManager::lockRecord(const string &tableName, const RID &rid, LockMode mode, LockOwner owner)
+{
+    return lock(getRecordLockName(tableName, rid), mode, owner);
+}
+
+RC LockManager::unlockRecord(const string &tableName, const RID &rid, LockMode mode, LockOwner owner)
+{
+    return unlock(getRecordLockName(tableName, rid), mode, owner);
+}
+
+LockOwner LockManager::newOwner()
+{
+    return nextOwner++;
+}
+
+LockOwner LockManager::currentThread()
+{
+    static thread_local LockOwner owner = instance()->newOwner();
+    return owner;
+}
+
+void LockManager::setTimeout(unsigned millis)
+{
+    lock_guard<mutex> guard(lockMutex);
+    timeout = millis;
+}
+
+RC LockManager::collectStatistics(unsigned &waitCount, unsigned &timeoutCount)
+{
+    lock_guard<mutex> guard(lockMutex);
+    waitCount = waitCounter;
+    timeoutCount = timeoutCounter;
+    return SUCCESS;
+}
+
+void LockManager::resetStatistics()
+{
+    lock_guard<mutex> guard(lockMutex);
+    waitCounter = 0;
+    timeoutCounter = 0;
+}
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+RC LockManager::lock(const string &name, LockMode mode, LockOwner owner)
+{
+    unique_lock<mutex> guard(lockMutex);
+    thread::id self = this_thread::get_id();
+    LockEntry &entry = locks[name];
+
+    if (!isCompatible(entry, mode, self))
+    {
+        waitCounter++;
+        entry.waiters++;
+        bool granted = entry.released.wait_for(guard, chrono::milliseconds(timeout),
+                [&]{ return isCompatible(entry, mode, self); });
+        entry.waiters--;
+        if (!granted)
+        {
+            timeoutCounter++;
+            // The holders may have let go meanwhile, without anyone left to erase the entry
+            if (entry.holders.empty() && entry.waiters == 0)
+                locks.erase(name);
+            return LM_LOCK_TIMEOUT;
+        }
+    }
+
+    LockCounts &counts = entry.holders[owner];
+    counts.count[mode]++;
+    counts.takenBy = self;
+    return SUCCESS;
+}
+
+RC LockManager::unlock(const string &name, LockMode mode, LockOwner owner)
+{
+    lock_guard<mutex> guard(lockMutex);
+    auto it = locks.find(name);
+    if (it == locks.end())
+        return LM_NOT_LOCKED;
+    LockEntry &entry = it->second;
+    auto holder = entry.holders.find(owner);
+    if (holder == entry.holders.end() || holder->second.count[mode] == 0)
+        return LM_NOT_LOCKED;
+
+    holder->second.count[mode]--;
+    if (entry.waiters > 0)
+        entry.released.notify_all();
+    for (unsigned i = 0; i < LM_MODES; i++)
+    {
+        if (holder->second.count[i] > 0)
+            return SUCCESS;
+    }
+
+    // The owner let go of its last lock here
+    entry.holders.erase(holder);
+    if (entry.holders.empty() && entry.waiters == 0)
+        locks.erase(it);
+    return SUCCESS;
+}
+
+bool LockManager::isCompatible(const LockEntry &entry, LockMode mode, thread::id self)
+{
+    for (auto &holder : entry.holders)
+    {
+        if (holder.second.takenBy == self)
+            continue;
+        for (unsigned held = 0; held < LM_MODES; held++)
+        {
+            if (holder.second.count[held] > 0 && !compatible[held][mode])
+                return false;
+        }
+    }
+    return true;
+}
+
+string LockManager::getRecordLockName(const string &tableName, const RID &rid)
+{
+    return tableName + "#" + to_string(rid.pageNum) + "." + to_string(rid.slotNum);
+}
+
+LockHolder::LockHolder(const string &tableName, LockMode mode)
+: tableName(tableName), record(false), mode(mode)
+{
+    rc = LockManager::instance()->lockTable(tableName, mode);
+}
+
+LockHolder::LockHolder(const string &tableName, const RID &rid, LockMode mode)
+: tableName(tableName), rid(rid), record(true), mode(mode)
+{
+    rc = LockManager::instance()->lockRecord(tableName, rid, mode);
+}
+
+LockHolder::~LockHolder()
+{
+    if (rc != SUCCESS)
+        return;
+    if (record)
+        LockManager::instance()->unlockRecord(tableName, rid, mode);
+    else
+        LockManager::instance()->unlockTable(tableName, mode);
+}
+
+RC LockHolder::status() const
+{
+    return rc;
+}
@@ -0,0 +1,120 @@
+#ifndef _lock_h_
+#define _lock_h_
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+#include "../rbf/rbfm.h"
+
+using namespace std;
+
+#define LM_LOCK_TIMEOUT 1
+#define LM_NOT_LOCKED   2
+
+// How long a lock request waits before it gives up, until LockManager::setTimeout() is called.
+// Deadlocks are not detected; one of the threads in the cycle times out instead.
+#define LM_DEFAULT_TIMEOUT 10000  // milliseconds
+
+// Table locks take the intention modes, so that record locks can be taken under them
+typedef enum { IS_LOCK = 0, IX_LOCK, S_LOCK, X_LOCK } LockMode;
+#define LM_MODES 4
+
+// Who a lock is held by, and has to be let go by. Unless told otherwise a lock is held by
+// the calling thread; a lock that may be let go on another thread, like the table lock of
+// a scan, is held by an owner from LockManager::newOwner().
+typedef uint64_t LockOwner;
+
+// Table and record locks.
+//
+// There are no transactions: the RelationManager takes the locks of one call and lets them
+// go when it returns, except that scans hold their table lock until the iterator is closed.
+// A thread never waits for the locks it took, whoever holds them, so a thread can update
+// the table it is scanning. Locks of the same mode can be taken more than once and are let
+// go as many times.
+class LockManager
+{
+public:
+    static LockManager* instance();
+
+    RC lockTable(const string &tableName, LockMode mode, LockOwner owner = currentThread());
+    RC unlockTable(const string &tableName, LockMode mode, LockOwner owner = currentThread());
+    // Records are locked in S or X mode, under an IS or IX lock of their table
+    RC lockRecord(const string &tableName, const RID &rid, LockMode mode, LockOwner owner = currentThread());
+    RC unlockRecord(const string &tableName, const RID &rid, LockMode mode, LockOwner owner = currentThread());
+
+    LockOwner newOwner();
+    // The owner that stands for the calling thread
+    static LockOwner currentThread();
+
+    void setTimeout(unsigned millis);
+
+    // Lock requests that had to wait, and of those the ones that timed out,
+    // since the last resetStatistics()
+    RC collectStatistics(unsigned &waitCount, unsigned &timeoutCount);
+    void resetStatistics();
+
+protected:
+    LockManager();
+    ~LockManager();
+
+private:
+    static LockManager *_lock_manager;
+
+    // How many times an owner holds a lock in each mode, and the thread that took it
+    struct LockCounts
+    {
+        unsigned count[LM_MODES];
+        thread::id takenBy;
+
+        LockCounts() : count() {}
+    };
+
+    // A table or record that is locked or waited for
+    struct LockEntry
+    {
+        map<LockOwner, LockCounts> holders;
+        unsigned waiters;
+        condition_variable released;
+
+        LockEntry() : waiters(0) {}
+    };
+
+    mutex lockMutex;
+    unordered_map<string, LockEntry> locks;
+    unsigned timeout;
+    atomic<LockOwner> nextOwner;
+
+    unsigned waitCounter;
+    unsigned timeoutCounter;
+
+    RC lock(const string &name, LockMode mode, LockOwner owner);
+    RC unlock(const string &name, LockMode mode, LockOwner owner);
+    // Whether mode can be granted on entry, leaving out the locks self took
+    static bool isCompatible(const LockEntry &entry, LockMode mode, thread::id self);
+    static string getRecordLockName(const string &tableName, const RID &rid);
+};
+
+// Holds a table or record lock while it is in scope. status() tells whether it was granted.
+class LockHolder
+{
+public:
+    LockHolder(const string &tableName, LockMode mode);
+    LockHolder(const string &tableName, const RID &rid, LockMode mode);
+    ~LockHolder();
+
+    RC status() const;
+
+private:
+    string tableName;
+    RID rid;
+    bool record;
+    LockMode mode;
+    RC rc;
+};
+
+#endif
@@ -1,5 +1,7 @@
 
 #include "rm.h"
+#include "lock.h"
+#include "../rbf/wal.h"
 
 #include <algorithm>
 #include <cstring>
@@ -9,15 +11,15 @@ RelationManager* RelationManager::_rm = 0;
 
 RelationManager* RelationManager::instance()
 {
-    if(!_rm)
-        _rm = new RelationManager();
-
-    return _rm;
+    static RelationManager *manager = _rm = new RelationManager();
+    return manager;
 }
 
 RelationManager::RelationManager()
-: tableDescriptor(createTableDescriptor()), columnDescriptor(createColumnDescriptor()), indexDescriptor(createIndexDescriptor())
+: tableDescriptor(createTableDescriptor()), columnDescriptor(createColumnDescriptor()), indexDescriptor(createIndexDescriptor()),
+  catalogVersion(0)
 {
+    LockManager::instance();
 }
 
 RelationManager::~RelationManager()
@@ -26,7 +28,11 @@ RelationManager::~RelationManager()
 
 RC RelationManager::createCatalog()
 {
+    LockHolder catalogLock(TABLES_TABLE_NAME, X_LOCK);
+    if (catalogLock.status())
+        return catalogLock.status();
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    invalidateCatalogEntry("");
     // Create both tables and columns tables, return error if either fails
     RC rc;
     rc = rbfm->createFile(getFileName(TABLES_TABLE_NAME));
@@ -69,7 +75,11 @@ RC RelationManager::createCatalog()
 // Just delete the the two catalog files
 RC RelationManager::deleteCatalog()
 {
+    LockHolder catalogLock(TABLES_TABLE_NAME, X_LOCK);
+    if (catalogLock.status())
+        return catalogLock.status();
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    invalidateCatalogEntry("");
 
     RC rc;
 
@@ -90,6 +100,13 @@ RC RelationManager::deleteCatalog()
 
 RC RelationManager::createTable(const string &tableName, const vector<Attribute> &attrs)
 {
+    // Changes to the catalog go one at a time, and nothing else may use the table meanwhile
+    LockHolder catalogLock(TABLES_TABLE_NAME, X_LOCK);
+    if (catalogLock.status())
+        return catalogLock.status();
+    LockHolder tableLock(tableName, X_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
     RC rc;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
@@ -110,6 +127,7 @@ RC RelationManager::createTable(const string &tableName, const vector<Attribute>
 
     // Insert the table's columns into the Columns table
     rc = insertColumns(id, attrs);
+    invalidateCatalogEntry(tableName);
     if (rc)
         return rc;
 
@@ -118,6 +136,13 @@ RC RelationManager::createTable(const string &tableName, const vector<Attribute>
 
 RC RelationManager::deleteTable(const string &tableName)
 {
+    // Changes to the catalog go one at a time, and nothing else may use the table meanwhile
+    LockHolder catalogLock(TABLES_TABLE_NAME, X_LOCK);
+    if (catalogLock.status())
+        return catalogLock.status();
+    LockHolder tableLock(tableName, X_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
@@ -129,6 +154,29 @@ RC RelationManager::deleteTable(const string &tableName)
     if (isSystem)
         return RM_CANNOT_MOD_SYS_TBL;
 
+    // Its indexes go first. Left in the catalog, they would turn up on the
+    // next table that gets the same ID.
+    vector<IndexedAttr> iattrs;
+    rc = getIndexAttributes(tableName, iattrs);
+    if (rc)
+        return rc;
+    for (const IndexedAttr &iattr : iattrs)
+    {
+        rc = destroyIndex(tableName, iattr.attr.name);
+        if (rc)
+            return rc;
+    }
+    vector<CompositeIndex> indexes;
+    rc = getCompositeIndexes(tableName, indexes);
+    if (rc)
+        return rc;
+    for (const CompositeIndex &index : indexes)
+    {
+        rc = destroyIndex(tableName, index.name);
+        if (rc)
+            return rc;
+    }
+
     // Delete the rbfm file holding this table's entries
     rc = rbfm->destroyFile(getFileName(tableName));
     if (rc)
@@ -140,9 +188,21 @@ RC RelationManager::deleteTable(const string &tableName)
     if (rc)
         return rc;
 
+    // The cached entry goes once the rows are gone. Dropped before, a getAttributes()
+    // in between could read the rows back into the cache, where they would stay.
+    rc = deleteCatalogRows(id);
+    invalidateCatalogEntry(tableName);
+    return rc;
+}
+
+// Deletes the rows of the table with the given ID from the Tables and Columns tables
+RC RelationManager::deleteCatalogRows(int32_t tableID)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
     // Open tables file
     FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    RC rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
 
@@ -150,19 +210,19 @@ RC RelationManager::deleteTable(const string &tableName)
     // Use empty projection because we only care about RID
     RBFM_ScanIterator rbfm_si;
     vector<string> projection; // Empty
-    void *value = &id;
-
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
+    void *value = &tableID;
 
     RID rid;
-    rc = rbfm_si.getNextRecord(rid, NULL);
-    if (rc)
-        return rc;
-
+    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
+    if (rc == SUCCESS)
+        rc = rbfm_si.getNextRecord(rid, NULL);
     // Delete RID from table and close file
-    rbfm->deleteRecord(fileHandle, tableDescriptor, rid);
-    rbfm->closeFile(fileHandle);
+    if (rc == SUCCESS)
+        rc = rbfm->deleteRecord(fileHandle, tableDescriptor, rid);
     rbfm_si.close();
+    rbfm->closeFile(fileHandle);
+    if (rc)
+        return rc;
 
     // Delete from Columns table
     rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
@@ -170,38 +230,80 @@ RC RelationManager::deleteTable(const string &tableName)
         return rc;
 
     // Find all of the entries whose table-id equal this table's ID
-    rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-
-    while((rc = rbfm_si.getNextRecord(rid, NULL)) == SUCCESS)
+    rc = rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
+    if (rc == SUCCESS)
     {
-        // Delete each result with the returned RID
-        rc = rbfm->deleteRecord(fileHandle, columnDescriptor, rid);
-        if (rc)
-            return rc;
+        while((rc = rbfm_si.getNextRecord(rid, NULL)) == SUCCESS)
+        {
+            // Delete each result with the returned RID
+            rc = rbfm->deleteRecord(fileHandle, columnDescriptor, rid);
+            if (rc)
+                break;
+        }
+        if (rc == RBFM_EOF)
+            rc = SUCCESS;
     }
-    if (rc != RBFM_EOF)
-        return rc;
 
-    rbfm->closeFile(fileHandle);
     rbfm_si.close();
-
-    return SUCCESS;
+    rbfm->closeFile(fileHandle);
+    return rc;
 }
 
 // Fills the given attribute vector with the recordDescriptor of tableName
 RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &attrs)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     // Clear out any old values
     attrs.clear();
-    RC rc;
 
-    int32_t id;
-    rc = getTableID(tableName, id);
+    // The entry is copied before another thread can drop it
+    lock_guard<recursive_mutex> guard(catalogMutex);
+    const CatalogEntry *entry;
+    RC rc = getCatalogEntry(tableName, entry);
     if (rc)
         return rc;
 
-    void *value = &id;
+    attrs = entry->attrs;
+    return SUCCESS;
+}
+
+RC RelationManager::getIndexAttributes(const string &tableName, vector<IndexedAttr> &iattrs)
+{
+    // Clear out any old values
+    iattrs.clear();
+
+    lock_guard<recursive_mutex> guard(catalogMutex);
+    const CatalogEntry *entry;
+    RC rc = getCatalogEntry(tableName, entry);
+    if (rc)
+        return rc;
+
+    iattrs = entry->indexes;
+    return SUCCESS;
+}
+
+RC RelationManager::getCompositeIndexes(const string &tableName, vector<CompositeIndex> &indexes)
+{
+    indexes.clear();
+
+    lock_guard<recursive_mutex> guard(catalogMutex);
+    const CatalogEntry *entry;
+    RC rc = getCatalogEntry(tableName, entry);
+    if (rc)
+        return rc;
+
+    indexes = entry->compositeIndexes;
+    return SUCCESS;
+}
+
+// Reads the recordDescriptor of the table with the given ID from the Columns table
+RC RelationManager::readColumns(int32_t tableID, vector<Attribute> &attrs)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    // Clear out any old values
+    attrs.clear();
+    RC rc;
+
+    void *value = &tableID;
 
     // We need to get the three values that make up an Attribute: name, type, length
     // We also need the position of each attribute in the row
@@ -217,7 +319,7 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
     if (rc)
         return rc;
 
-    // Scan through the Column table for all entries whose table-id equals tableName's table id.
+    // Scan through the Column table for all entries whose table-id equals tableID.
     rc = rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
     if (rc)
         return rc;
@@ -292,19 +394,17 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
     return SUCCESS;
 }
 
-RC RelationManager::getIndexAttributes(const string &tableName, vector<IndexedAttr> &iattrs)
+// Reads the indexes of the table with the given ID from the Indexes table: the attributes
+// with an index of their own, and the composite indexes
+RC RelationManager::readIndexes(int32_t tableID, vector<IndexedAttr> &iattrs, vector<CompositeIndex> &compositeIndexes)
 {
   RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
   // Clear out any old values
   iattrs.clear();
+  compositeIndexes.clear();
   RC rc;
 
-  int32_t id;
-  rc = getTableID(tableName, id);
-  if (rc)
-      return rc;
-
-  void *value = &id;
+  void *value = &tableID;
 
   // We need to get the one values to indicate which value is the index in index file.
   // We also need the position of each attribute in the row
@@ -314,19 +414,21 @@ RC RelationManager::getIndexAttributes(const string &tableName, vector<IndexedAt
   projection.push_back(INDEXES_COL_COLUMN_TYPE);
   projection.push_back(INDEXES_COL_COLUMN_LENGTH);
   projection.push_back(INDEXES_COL_COLUMN_POSITION);
+  projection.push_back(INDEXES_COL_INDEX_NAME);
+  projection.push_back(INDEXES_COL_KEY_POSITION);
 
   FileHandle fileHandle;
   rc = rbfm->openFile(getFileName(INDEXES_TABLE_NAME), fileHandle);
   if (rc)
       return rc;
 
-  // Scan through the Index table for all entries whose table-id equals tableName's table id.
+  // Scan through the Index table for all entries whose table-id equals tableID.
   rc = rbfm->scan(fileHandle, indexDescriptor, INDEXES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
   if (rc)
       return rc;
 
   RID rid;
-  void *data = malloc(INDEXES_COL_COLUMN_NAME_SIZE);
+  void *data = malloc(INDEXES_RECORD_DATA_SIZE);
 
   // IndexedAttr is an attr with a position. The position will be used to sort the vector
   while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
@@ -366,18 +468,52 @@ RC RelationManager::getIndexAttributes(const string &tableName, vector<IndexedAt
       offset += INT_SIZE;
       attr.pos = pos;
 
-      iattrs.push_back(attr);
+      // Read in the index name and the place of the attribute in its key
+      int32_t indexNameLen;
+      memcpy(&indexNameLen, (char*) data + offset, VARCHAR_LENGTH_SIZE);
+      offset += VARCHAR_LENGTH_SIZE;
+      string indexName((char*) data + offset, indexNameLen);
+      offset += indexNameLen;
+      int32_t keyPos;
+      memcpy(&keyPos, (char*) data + offset, INT_SIZE);
+      offset += INT_SIZE;
+
+      // An index named after its attribute is on that attribute alone
+      if (indexName == attr.attr.name)
+      {
+          iattrs.push_back(attr);
+          continue;
+      }
+      unsigned i = 0;
+      while (i < compositeIndexes.size() && compositeIndexes[i].name != indexName)
+          i++;
+      if (i == compositeIndexes.size())
+      {
+          compositeIndexes.push_back(CompositeIndex());
+          compositeIndexes[i].name = indexName;
+      }
+      if (compositeIndexes[i].attrs.size() <= (unsigned) keyPos)
+          compositeIndexes[i].attrs.resize(keyPos + 1);
+      compositeIndexes[i].attrs[keyPos] = attr;
   }
   // Do cleanup
   rbfm_si.close();
   rbfm->closeFile(fileHandle);
   free(data);
+  // If we ended on an error, return that error
+  if (rc != RBFM_EOF)
+      return rc;
 
-  return rc;
+  return SUCCESS;
 }
 
 RC RelationManager::insertTuple(const string &tableName, const void *data, RID &rid)
 {
+    // Locks come before the log operation, which other threads wait for
+    LockHolder tableLock(tableName, IX_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
+    LogOperation operation;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
@@ -409,12 +545,111 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
 
     // insert this tuple into all index Manager file
     rc = insertIndexTuple(tableName, recordDescriptor, data, rid);
+    if (rc)
+      return rc;
 
-    return rc;
+    return operation.commit();
+}
+
+RC RelationManager::insertTuples(const string &tableName, const vector<const void*> &data, vector<RID> &rids)
+{
+    LockHolder tableLock(tableName, IX_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
+    LogOperation operation;
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    IndexManager *im = IndexManager::instance();
+    RC rc;
+
+    // Everything we need from the catalog, looked up once for all the tuples
+    const CatalogEntry *entry;
+    rc = getCatalogEntry(tableName, entry);
+    if (rc)
+        return rc;
+    // If this is a system table, we cannot modify it
+    if (entry->system)
+        return RM_CANNOT_MOD_SYS_TBL;
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    if (rc)
+        return rc;
+    rc = rbfm->insertRecords(fileHandle, entry->attrs, data, rids);
+    rbfm->closeFile(fileHandle);
+    if (rc)
+        return rc;
+
+    // Each index gets the new entries in key order, so the ones that go in the same leaf go in together
+    void *value = malloc(PAGE_SIZE);
+    if (value == NULL)
+        return RBFM_MALLOC_FAILED;
+    for (const IndexedAttr &iattr : entry->indexes)
+    {
+        IX_ExternalSorter sorter;
+        sorter.initialize(iattr.attr);
+        for (unsigned i = 0; i < data.size() && rc == SUCCESS; i++)
+        {
+            // Null values are not indexed
+            if (getFieldFromRecord(iattr.attr.name, entry->attrs, data[i], value))
+                continue;
+            rc = sorter.addEntry(value, rids[i]);
+        }
+
+        IXFileHandle ixfileHandle;
+        if (rc == SUCCESS)
+            rc = im->openFile(getIndexFileName(tableName, iattr.attr.name), ixfileHandle);
+        if (rc == SUCCESS)
+        {
+            rc = im->insertEntries(ixfileHandle, iattr.attr, sorter);
+            im->closeFile(ixfileHandle);
+        }
+        sorter.close();
+        if (rc)
+            break;
+    }
+
+    // And each composite index, with its keys encoded as it stores them
+    for (unsigned j = 0; j < entry->compositeIndexes.size() && rc == SUCCESS; j++)
+    {
+        const CompositeIndex &index = entry->compositeIndexes[j];
+        IX_KeySchema schema = getKeySchema(index);
+        IX_ExternalSorter sorter;
+        sorter.initialize(schema.getKeyAttribute());
+        string key;
+        for (unsigned i = 0; i < data.size() && rc == SUCCESS; i++)
+        {
+            if (getKeyFromRecord(index, entry->attrs, data[i], value))
+                continue;
+            schema.encode(value, index.attrs.size(), key);
+            rc = sorter.addEntry(key.data(), rids[i]);
+        }
+
+        IXFileHandle ixfileHandle;
+        if (rc == SUCCESS)
+            rc = im->openFile(getIndexFileName(tableName, index.name), ixfileHandle);
+        if (rc == SUCCESS)
+        {
+            rc = im->insertEntries(ixfileHandle, schema.getKeyAttribute(), sorter);
+            im->closeFile(ixfileHandle);
+        }
+        sorter.close();
+    }
+
+    free(value);
+    if (rc)
+        return rc;
+    return operation.commit();
 }
 
 RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
 {
+    LockHolder tableLock(tableName, IX_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
+    LockHolder recordLock(tableName, rid, X_LOCK);
+    if (recordLock.status())
+        return recordLock.status();
+    LogOperation operation;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
@@ -440,23 +675,29 @@ RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
 
     void* data = malloc(PAGE_SIZE);
     rc = readTuple(tableName, rid, data);
-    if (rc)
-      return rc;
-
-    rc = deleteIndexTuple(tableName, recordDescriptor, data, rid);
+    if (rc == SUCCESS)
+      rc = deleteIndexTuple(tableName, recordDescriptor, data, rid);
     free(data);
-    if (rc)
-      return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
+    if (rc == SUCCESS)
+      rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
     rbfm->closeFile(fileHandle);
+    if (rc)
+      return rc;
 
-    return rc;
+    return operation.commit();
 }
 
 RC RelationManager::updateTuple(const string &tableName, const void *data, const RID &rid)
 {
+    LockHolder tableLock(tableName, IX_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
+    LockHolder recordLock(tableName, rid, X_LOCK);
+    if (recordLock.status())
+        return recordLock.status();
+    LogOperation operation;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
@@ -483,27 +724,30 @@ RC RelationManager::updateTuple(const string &tableName, const void *data, const
     // handle index files.
     void* oldData = malloc(PAGE_SIZE);
     rc = readTuple(tableName, rid, oldData);
-    if (rc)
-      return rc;
-
-    rc = deleteIndexTuple(tableName, recordDescriptor, oldData, rid);
+    if (rc == SUCCESS)
+      rc = deleteIndexTuple(tableName, recordDescriptor, oldData, rid);
     free(oldData);
-    if (rc)
-      return rc;
-
-    rc = insertIndexTuple(tableName, recordDescriptor, data, rid);
-    if (rc)
-      return rc;
+    if (rc == SUCCESS)
+      rc = insertIndexTuple(tableName, recordDescriptor, data, rid);
 
     // Let rbfm do all the work
-    rc = rbfm->updateRecord(fileHandle, recordDescriptor, data, rid);
+    if (rc == SUCCESS)
+      rc = rbfm->updateRecord(fileHandle, recordDescriptor, data, rid);
     rbfm->closeFile(fileHandle);
+    if (rc)
+      return rc;
 
-    return rc;
+    return operation.commit();
 }
 
 RC RelationManager::readTuple(const string &tableName, const RID &rid, void *data)
 {
+    LockHolder tableLock(tableName, IS_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
+    LockHolder recordLock(tableName, rid, S_LOCK);
+    if (recordLock.status())
+        return recordLock.status();
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
@@ -534,6 +778,12 @@ RC RelationManager::printTuple(const vector<Attribute> &attrs, const void *data)
 
 RC RelationManager::readAttribute(const string &tableName, const RID &rid, const string &attributeName, void *data)
 {
+    LockHolder tableLock(tableName, IS_LOCK);
+    if (tableLock.status())
+        return tableLock.status();
+    LockHolder recordLock(tableName, rid, S_LOCK);
+    if (recordLock.status())
+        return recordLock.status();
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
@@ -656,6 +906,16 @@ vector<Attribute> RelationManager::createIndexDescriptor()
   attr.name = INDEXES_COL_COLUMN_POSITION;
   attr.type = TypeInt;
   attr.length = (AttrLength)INT_SIZE;
+  id.push_back(attr);
+
+  attr.name = INDEXES_COL_INDEX_NAME;
+  attr.type = TypeVarChar;
+  attr.length = (AttrLength)INDEXES_COL_INDEX_NAME_SIZE;
+  id.push_back(attr);
+
+  attr.name = INDEXES_COL_KEY_POSITION;
+  attr.type = TypeInt;
+  attr.length = (AttrLength)INT_SIZE;
   id.push_back(attr);
 
 	return id;
@@ -729,6 +989,24 @@ void RelationManager::prepareColumnsRecordData(int32_t id, int32_t pos, Attribut
     offset += INT_SIZE;
 }
 
+// Prepares the Indexes table entry for attribute attr, at pos in the table, of the index
+// indexName, at keyPos in its key
+void RelationManager::prepareIndexesRecordData(int32_t id, int32_t pos, const Attribute &attr, const string &indexName, int32_t keyPos, void *data)
+{
+    // The same as a Columns table entry, followed by the index name and key position
+    prepareColumnsRecordData(id, pos, attr, data);
+    unsigned offset = 1 + 4 * INT_SIZE + VARCHAR_LENGTH_SIZE + attr.name.length();
+
+    int32_t name_len = indexName.length();
+    memcpy((char*) data + offset, &name_len, VARCHAR_LENGTH_SIZE);
+    offset += VARCHAR_LENGTH_SIZE;
+    memcpy((char*) data + offset, indexName.c_str(), name_len);
+    offset += name_len;
+
+    memcpy((char*) data + offset, &keyPos, INT_SIZE);
+    offset += INT_SIZE;
+}
+
 // Insert the given columns into the Columns table
 RC RelationManager::insertColumns(int32_t id, const vector<Attribute> &recordDescriptor)
 {
@@ -822,47 +1100,74 @@ RC RelationManager::getNextTableID(int32_t &table_id)
 // Gets the table ID of the given tableName
 RC RelationManager::getTableID(const string &tableName, int32_t &tableID)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    RC rc;
-
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    lock_guard<recursive_mutex> guard(catalogMutex);
+    const CatalogEntry *entry;
+    RC rc = getCatalogEntry(tableName, entry);
     if (rc)
         return rc;
 
-    // We only care about the table ID
-    vector<string> projection;
-    projection.push_back(TABLES_COL_TABLE_ID);
+    tableID = entry->id;
+    return SUCCESS;
+}
 
-    // Fill value with the string tablename in api format (without null indicator)
-    void *value = malloc(4 + TABLES_COL_TABLE_NAME_SIZE);
-    int32_t name_len = tableName.length();
-    memcpy(value, &name_len, INT_SIZE);
-    memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
+// Determine if table tableName is a system table. Set the boolean argument as the result
+RC RelationManager::isSystemTable(bool &system, const string &tableName)
+{
+    lock_guard<recursive_mutex> guard(catalogMutex);
+    const CatalogEntry *entry;
+    RC rc = getCatalogEntry(tableName, entry);
+    // A table that does not exist is not a system table
+    if (rc == RBFM_EOF)
+    {
+        system = false;
+        return SUCCESS;
+    }
+    if (rc)
+        return rc;
 
-    // Find the table entries whose table-name field matches tableName
-    RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
+    system = entry->system;
+    return SUCCESS;
+}
 
-    // There will only be one such entry, so we use if rather than while
-    RID rid;
-    void *data = malloc (1 + INT_SIZE);
-    if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+uint64_t RelationManager::getCatalogVersion() const
+{
+    return catalogVersion;
+}
+
+RC RelationManager::getCatalogEntry(const string &tableName, const CatalogEntry *&entry)
+{
+    lock_guard<recursive_mutex> guard(catalogMutex);
+    auto it = catalogCache.find(tableName);
+    if (it == catalogCache.end())
     {
-        int32_t tid;
-        fromAPI(tid, data);
-        tableID = tid;
+        CatalogEntry newEntry;
+        RC rc = readTableEntry(tableName, newEntry.id, newEntry.system);
+        if (rc)
+            return rc;
+        rc = readColumns(newEntry.id, newEntry.attrs);
+        if (rc)
+            return rc;
+        rc = readIndexes(newEntry.id, newEntry.indexes, newEntry.compositeIndexes);
+        if (rc)
+            return rc;
+        it = catalogCache.insert(make_pair(tableName, newEntry)).first;
     }
+    entry = &it->second;
+    return SUCCESS;
+}
 
-    free(data);
-    free(value);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-    return rc;
+void RelationManager::invalidateCatalogEntry(const string &tableName)
+{
+    lock_guard<recursive_mutex> guard(catalogMutex);
+    if (tableName.empty())
+        catalogCache.clear();
+    else
+        catalogCache.erase(tableName);
+    catalogVersion++;
 }
 
-// Determine if table tableName is a system table. Set the boolean argument as the result
-RC RelationManager::isSystemTable(bool &system, const string &tableName)
+// Reads the table ID and system flag of the given tableName from the Tables table
+RC RelationManager::readTableEntry(const string &tableName, int32_t &tableID, bool &system)
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     FileHandle fileHandle;
@@ -872,31 +1177,33 @@ RC RelationManager::isSystemTable(bool &system, const string &tableName)
     if (rc)
         return rc;
 
-    // We only care about system column
+    // We only care about the table ID and the system column
     vector<string> projection;
+    projection.push_back(TABLES_COL_TABLE_ID);
     projection.push_back(TABLES_COL_SYSTEM);
 
-    // Set up value to be tableName in API format (without null indicator)
-    void *value = malloc(5 + TABLES_COL_TABLE_NAME_SIZE);
+    // Fill value with the string tablename in api format (without null indicator)
+    void *value = malloc(4 + TABLES_COL_TABLE_NAME_SIZE);
     int32_t name_len = tableName.length();
     memcpy(value, &name_len, INT_SIZE);
     memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
 
-    // Find table whose table-name is equal to tableName
+    // Find the table entries whose table-name field matches tableName
     RBFM_ScanIterator rbfm_si;
     rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
 
+    // There will only be one such entry, so we use if rather than while
     RID rid;
-    void *data = malloc (1 + INT_SIZE);
+    void *data = malloc (1 + 2 * INT_SIZE);
     if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
     {
-        // Parse the system field from that table entry
-        int32_t tmp;
-        fromAPI(tmp, data);
+        // Neither field is ever null
+        int32_t tid, tmp;
+        memcpy(&tid, (char*) data + 1, INT_SIZE);
+        memcpy(&tmp, (char*) data + 1 + INT_SIZE, INT_SIZE);
+        tableID = tid;
         system = tmp == 1;
     }
-    if (rc == RBFM_EOF)
-        rc = SUCCESS;
 
     free(data);
     free(value);
@@ -913,28 +1220,50 @@ RC RelationManager::insertIndexTuple(const string& tableName, const vector<Attri
   getIndexAttributes(tableName, iattrs);
 
   // insert this tuple into all index file.
+  IndexManager *im = IndexManager::instance();
+  void* value = malloc(PAGE_SIZE);
   for (auto iattr : iattrs) {
-    void* value = malloc(PAGE_SIZE);
     memset(value, 0, PAGE_SIZE);
-    rc = getFieldFromRecord(iattr.attr.name, recordDescriptor, data, value);
-    if (rc)
+    if (getFieldFromRecord(iattr.attr.name, recordDescriptor, data, value))
       continue;
 
     IXFileHandle ixfileHandle;
-    IndexManager *im = IndexManager::instance();
-
     rc = im->openFile(getIndexFileName(tableName, iattr.attr.name), ixfileHandle);
+    if (rc == SUCCESS)
+    {
+      rc = im->insertEntry(ixfileHandle, recordDescriptor[iattr.pos], value, rid);
+      RC closeRC = im->closeFile(ixfileHandle);
+      if (rc == SUCCESS)
+        rc = closeRC;
+    }
     if (rc)
+    {
+      free(value);
       return rc;
-    rc = im->insertEntry(ixfileHandle, recordDescriptor[iattr.pos], value, rid);
-    if (rc)
-      return rc;
-    rc = im->closeFile(ixfileHandle);
-      return rc;
-    free(value);
+    }
   }
+  free(value);
+
+  // and every composite index it has all the attributes of
+  vector<CompositeIndex> indexes;
+  getCompositeIndexes(tableName, indexes);
+  void *key = malloc(PAGE_SIZE);
+  rc = SUCCESS;
+  for (const CompositeIndex &index : indexes) {
+    if (getKeyFromRecord(index, recordDescriptor, data, key))
+      continue;
 
-  return SUCCESS;
+    IXFileHandle ixfileHandle;
+    rc = im->openFile(getIndexFileName(tableName, index.name), ixfileHandle);
+    if (rc)
+      break;
+    rc = im->insertEntry(ixfileHandle, getKeySchema(index), key, rid);
+    im->closeFile(ixfileHandle);
+    if (rc)
+      break;
+  }
+  free(key);
+  return rc;
 }
 
 RC RelationManager::deleteIndexTuple(const string& tableName, const vector<Attribute> recordDescriptor, const void* data, const RID& rid)
@@ -945,28 +1274,50 @@ RC RelationManager::deleteIndexTuple(const string& tableName, const vector<Attri
   getIndexAttributes(tableName, iattrs);
 
   // insert this tuple into all index file.
+  IndexManager *im = IndexManager::instance();
+  void* value = malloc(PAGE_SIZE);
   for (auto iattr : iattrs) {
-    void* value = malloc(PAGE_SIZE);
     memset(value, 0, PAGE_SIZE);
-    rc = getFieldFromRecord(iattr.attr.name, recordDescriptor, data, value);
-    if (rc)
+    if (getFieldFromRecord(iattr.attr.name, recordDescriptor, data, value))
       continue;
 
     IXFileHandle ixfileHandle;
-    IndexManager *im = IndexManager::instance();
-
     rc = im->openFile(getIndexFileName(tableName, iattr.attr.name), ixfileHandle);
+    if (rc == SUCCESS)
+    {
+      rc = im->deleteEntry(ixfileHandle, recordDescriptor[iattr.pos], value, rid);
+      RC closeRC = im->closeFile(ixfileHandle);
+      if (rc == SUCCESS)
+        rc = closeRC;
+    }
     if (rc)
+    {
+      free(value);
       return rc;
-    rc = im->deleteEntry(ixfileHandle, recordDescriptor[iattr.pos], value, rid);
-    if (rc)
-      return rc;
-    rc = im->closeFile(ixfileHandle);
-      return rc;
-    free(value);
+    }
   }
+  free(value);
+
+  // and every composite index it has all the attributes of
+  vector<CompositeIndex> indexes;
+  getCompositeIndexes(tableName, indexes);
+  void *key = malloc(PAGE_SIZE);
+  rc = SUCCESS;
+  for (const CompositeIndex &index : indexes) {
+    if (getKeyFromRecord(index, recordDescriptor, data, key))
+      continue;
 
-  return SUCCESS;
+    IXFileHandle ixfileHandle;
+    rc = im->openFile(getIndexFileName(tableName, index.name), ixfileHandle);
+    if (rc)
+      break;
+    rc = im->deleteEntry(ixfileHandle, getKeySchema(index), key, rid);
+    im->closeFile(ixfileHandle);
+    if (rc)
+      break;
+  }
+  free(key);
+  return rc;
 }
 
 RC RelationManager::getFieldFromRecord(const string attrName, const vector<Attribute> recordDescriptor, const void* data, void* value)
@@ -1003,6 +1354,88 @@ RC RelationManager::getFieldFromRecord(const string attrName, const vector<Attri
   return -1;
 }
 
+RC RelationManager::getKeyFromRecord(const CompositeIndex &index, const vector<Attribute> &recordDescriptor, const void *data, void *key)
+{
+  IndexManager *im = IndexManager::instance();
+  char *value = (char*) key;
+  for (const IndexedAttr &iattr : index.attrs) {
+    if (getFieldFromRecord(iattr.attr.name, recordDescriptor, data, value))
+      return -1;
+    value += im->getKeySize(iattr.attr, value);
+  }
+  return SUCCESS;
+}
+
+RC RelationManager::loadIndex(const string &tableName, const CompositeIndex &index, IXFileHandle &ixfh)
+{
+  IndexManager *im = IndexManager::instance();
+  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+  vector<Attribute> recordDescriptor;
+  RC rc = getAttributes(tableName, recordDescriptor);
+  if (rc)
+    return rc;
+  FileHandle fh;
+  if ((rc = rbfm->openFile(getFileName(tableName), fh)))
+    return rc;
+
+  // Only the attributes of the key are read, in key order
+  vector<Attribute> keyAttrs;
+  vector<string> projection;
+  for (const IndexedAttr &iattr : index.attrs) {
+    keyAttrs.push_back(iattr.attr);
+    projection.push_back(iattr.attr.name);
+  }
+  RBFM_ScanIterator rbfm_si;
+  if ((rc = rbfm->scan(fh, recordDescriptor, "", NO_OP, NULL, projection, rbfm_si))) {
+    rbfm->closeFile(fh);
+    return rc;
+  }
+
+  // The key of an index on one attribute is its value, a composite key is encoded
+  bool composite = index.attrs.size() > 1;
+  IX_KeySchema schema = getKeySchema(index);
+  Attribute keyAttr = composite ? schema.getKeyAttribute() : keyAttrs[0];
+
+  // Collect every key, then build the index bottom-up from them in sorted order
+  void *data = malloc(PAGE_SIZE);
+  void *values = malloc(PAGE_SIZE);
+  string key;
+  RID rid;
+  IX_ExternalSorter sorter;
+  sorter.initialize(keyAttr);
+  while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS) {
+    // Null values are not indexed
+    if (getKeyFromRecord(index, keyAttrs, data, values))
+      continue;
+    if (composite) {
+      schema.encode(values, index.attrs.size(), key);
+      rc = sorter.addEntry(key.data(), rid);
+    } else
+      rc = sorter.addEntry(values, rid);
+    if (rc) {
+      rc = RM_CREATE_INDEX_FAILED;
+      break;
+    }
+  }
+  if (rc == RBFM_EOF)
+    rc = im->bulkLoad(ixfh, keyAttr, sorter) ? RM_CREATE_INDEX_FAILED : SUCCESS;
+
+  sorter.close();
+  rbfm_si.close();
+  rbfm->closeFile(fh);
+  free(data);
+  free(values);
+  return rc;
+}
+
+IX_KeySchema RelationManager::getKeySchema(const CompositeIndex &index)
+{
+  vector<Attribute> attrs;
+  for (const IndexedAttr &iattr : index.attrs)
+    attrs.push_back(iattr.attr);
+  return IX_KeySchema(attrs);
+}
+
 void RelationManager::toAPI(const string &str, void *data)
 {
     int32_t len = str.length();
@@ -1085,23 +1518,34 @@ RC RelationManager::scan(const string &tableName,
       const vector<string> &attributeNames,
       RM_ScanIterator &rm_ScanIterator)
 {
+    // The table stays locked until the iterator is closed
+    RC rc = rm_ScanIterator.lockTable(tableName);
+    if (rc)
+        return rc;
+
     // Open the file for the given tableName
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    RC rc = rbfm->openFile(getFileName(tableName), rm_ScanIterator.fileHandle);
+    rc = rbfm->openFile(getFileName(tableName), rm_ScanIterator.fileHandle);
     if (rc)
+    {
+        rm_ScanIterator.unlockTable();
         return rc;
+    }
 
     // grab the record descriptor for the given tableName
     vector<Attribute> recordDescriptor;
     rc = getAttributes(tableName, recordDescriptor);
-    if (rc)
-        return rc;
 
     // Use the underlying rbfm_scaniterator to do all the work
-    rc = rbfm->scan(rm_ScanIterator.fileHandle, recordDescriptor, conditionAttribute,
-                     compOp, value, attributeNames, rm_ScanIterator.rbfm_iter);
+    if (rc == SUCCESS)
+        rc = rbfm->scan(rm_ScanIterator.fileHandle, recordDescriptor, conditionAttribute,
+                         compOp, value, attributeNames, rm_ScanIterator.rbfm_iter);
     if (rc)
+    {
+        rbfm->closeFile(rm_ScanIterator.fileHandle);
+        rm_ScanIterator.unlockTable();
         return rc;
+    }
 
     return SUCCESS;
 }
@@ -1118,11 +1562,43 @@ RC RM_ScanIterator::close()
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     rbfm_iter.close();
     rbfm->closeFile(fileHandle);
+    unlockTable();
+    return SUCCESS;
+}
+
+RM_ScanIterator::~RM_ScanIterator()
+{
+    unlockTable();
+}
+
+RC RM_ScanIterator::lockTable(const string &tableName)
+{
+    unlockTable();
+    LockManager *lm = LockManager::instance();
+    lockOwner = lm->newOwner();
+    RC rc = lm->lockTable(tableName, S_LOCK, lockOwner);
+    if (rc)
+        return rc;
+    lockedTable = tableName;
+    locked = true;
     return SUCCESS;
 }
 
+void RM_ScanIterator::unlockTable()
+{
+    if (locked)
+        LockManager::instance()->unlockTable(lockedTable, S_LOCK, lockOwner);
+    locked = false;
+}
+
 RC RelationManager::createIndex(const string &tableName, const string &attributeName)
 {
+  LockHolder catalogLock(TABLES_TABLE_NAME, X_LOCK);
+  if (catalogLock.status())
+    return catalogLock.status();
+  LockHolder tableLock(tableName, X_LOCK);
+  if (tableLock.status())
+    return tableLock.status();
   /* ------------------- Check availability of index ------------------*/
   // Check if the tableName is system table
   RC rc;
@@ -1141,69 +1617,126 @@ RC RelationManager::createIndex(const string &tableName, const string &attribute
     return RM_INDEX_EXISTENCE_ERR;
 
   /* --------------- Insert each record value into Index table ---------------*/
-  // Prepare for obtain all record value
+  vector<Attribute> recordDescriptor;
+  if ((rc = getAttributes(tableName, recordDescriptor)))
+    return rc;
+  size_t i = 0;
+  for (; i < recordDescriptor.size(); ++i) {
+    if (recordDescriptor[i].name == attributeName)
+      break;
+  }
+  CompositeIndex index;
+  index.name = attributeName;
+  IndexedAttr iattr;
+  iattr.pos = i;
+  iattr.attr = recordDescriptor[i];
+  index.attrs.push_back(iattr);
+
   IndexManager *im = IndexManager::instance();
-  RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-  FileHandle fh;
-  IXFileHandle ixfh;
-  RBFM_ScanIterator rbfm_si;
-  RID rid;
-  if ((rc = im->createFile(getIndexFileName(tableName, attributeName))))
+  string indexFileName = getIndexFileName(tableName, attributeName);
+  if ((rc = im->createFile(indexFileName)))
     return rc;
-	if ((rc = im->openFile(getIndexFileName(tableName, attributeName), ixfh)))
+  IXFileHandle ixfh;
+  if ((rc = im->openFile(indexFileName, ixfh)) == SUCCESS) {
+    rc = loadIndex(tableName, index, ixfh);
+    im->closeFile(ixfh);
+  }
+  // A partial index file would keep the index from being created again
+  if (rc) {
+    im->destroyFile(indexFileName);
     return rc;
-	if ((rc = rbfm->openFile(getFileName(tableName), fh)))
+  }
+
+	// Insert index into INDEXES table
+  int tableID;
+  getTableID(tableName, tableID);
+  rc = insertIndex(tableID, recordDescriptor[i], i, attributeName, 0);
+  invalidateCatalogEntry(tableName);
+	if (rc)
     return rc;
 
-  vector<Attribute> recordDescriptor;
-  getAttributes(tableName, recordDescriptor);
-  vector<string> projection;
-  projection.push_back(attributeName);
+	return SUCCESS;
+}
 
-  // Scan all records in table and insert into index
-  if ((rc = rbfm->scan(fh, recordDescriptor, attributeName, NO_OP, NULL, projection, rbfm_si)))
+RC RelationManager::createIndex(const string &tableName, const string &indexName, const vector<string> &attributeNames)
+{
+  LockHolder catalogLock(TABLES_TABLE_NAME, X_LOCK);
+  if (catalogLock.status())
+    return catalogLock.status();
+  LockHolder tableLock(tableName, X_LOCK);
+  if (tableLock.status())
+    return tableLock.status();
+  /* ------------------- Check availability of index ------------------*/
+  RC rc;
+  bool isSystem;
+  if ((rc = isSystemTable(isSystem, tableName)))
     return rc;
+  if (isSystem)
+    return RM_CANNOT_MOD_SYS_TBL;
 
-  vector<Attribute> attrs;
-  if ((rc = getAttributes(tableName, attrs)))
-    return rc;
+  // The name of an attribute is taken by the index on it alone
+  if (indexName.empty() || indexName.length() > INDEXES_COL_INDEX_NAME_SIZE || attributeNames.size() < 2)
+    return RM_INDEX_KEY_INVALID;
+  if (indexExistsInAttributes(tableName, indexName) == SUCCESS)
+    return RM_INDEX_EXISTENCE_ERR;
+  if (indexExistsInIndex(tableName, indexName, false) != RM_INDEX_EXISTENCE_ERR)
+    return RM_INDEX_EXISTENCE_ERR;
 
-  size_t i = 0;
-  for (; i < attrs.size(); ++i) {
-    if (attrs[i].name == attributeName)
-      break;
+  // Each attribute of the key once, in the given order
+  vector<Attribute> recordDescriptor;
+  if ((rc = getAttributes(tableName, recordDescriptor)))
+    return rc;
+  CompositeIndex index;
+  index.name = indexName;
+  for (const string &attributeName : attributeNames) {
+    IndexedAttr iattr;
+    iattr.pos = -1;
+    for (unsigned i = 0; i < recordDescriptor.size(); ++i) {
+      if (recordDescriptor[i].name == attributeName)
+        iattr.pos = i;
+    }
+    if (iattr.pos == -1)
+      return RM_COLUMN_NON_EXIST;
+    for (const IndexedAttr &other : index.attrs) {
+      if (other.pos == iattr.pos)
+        return RM_INDEX_KEY_INVALID;
+    }
+    iattr.attr = recordDescriptor[iattr.pos];
+    index.attrs.push_back(iattr);
   }
-  void *data = calloc(1 + recordDescriptor[i].length, 1);
 
-  while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS) {
-    int8_t nullIndicator;
-    memcpy(&nullIndicator, data, 1);
-    if (nullIndicator)
-      continue;
-
-    if (im->insertEntry(ixfh, recordDescriptor[i], (char*) data + 1, rid))
-      return RM_CREATE_INDEX_FAILED;
+  /* --------------- Insert each record value into Index table ---------------*/
+  IndexManager *im = IndexManager::instance();
+  string indexFileName = getIndexFileName(tableName, indexName);
+  if ((rc = im->createFile(indexFileName)))
+    return rc;
+  IXFileHandle ixfh;
+  if ((rc = im->openFile(indexFileName, ixfh)) == SUCCESS) {
+    rc = loadIndex(tableName, index, ixfh);
+    im->closeFile(ixfh);
   }
-
-  if (rc != RBFM_EOF)
+  if (rc) {
+    im->destroyFile(indexFileName);
     return rc;
+  }
 
-  rbfm->closeFile(fh);
-	im->closeFile(ixfh);
-	rbfm_si.close();
-	free(data);
-
-	// Insert index into INDEXES table
+  // Insert a row for each attribute of the key into INDEXES table
   int tableID;
   getTableID(tableName, tableID);
-	if ((rc = insertIndex(tableID, recordDescriptor[i], i)))
-    return rc;
-
-	return SUCCESS;
+  for (unsigned k = 0; k < index.attrs.size() && rc == SUCCESS; ++k)
+    rc = insertIndex(tableID, index.attrs[k].attr, index.attrs[k].pos, indexName, k);
+  invalidateCatalogEntry(tableName);
+  return rc;
 }
 
 RC RelationManager::destroyIndex(const string &tableName, const string &attributeName)
 {
+  LockHolder catalogLock(TABLES_TABLE_NAME, X_LOCK);
+  if (catalogLock.status())
+    return catalogLock.status();
+  LockHolder tableLock(tableName, X_LOCK);
+  if (tableLock.status())
+    return tableLock.status();
   /* ------------------- Check availability of index ------------------*/
   // Check if the tableName is system table
   RC rc;
@@ -1213,12 +1746,11 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
   if (isSystem)
     return RM_CANNOT_MOD_SYS_TBL;
 
-  // Check if the index exists in attributes of the record: Expect SUCCESS -> Exists
-  if (indexExistsInAttributes(tableName, attributeName) != SUCCESS)
-    return RM_INDEX_EXISTENCE_ERR;
-
-  // Check if the index table already exists: Expect SUCCESS -> Exists
-  if (indexExistsInIndex(tableName, attributeName, true) != SUCCESS)
+  // Check if the index table already exists: Expect SUCCESS -> Exists.
+  // attributeName is the name of the index, whether on that attribute or composite.
+  rc = indexExistsInIndex(tableName, attributeName, true);
+  invalidateCatalogEntry(tableName);
+  if (rc != SUCCESS)
     return RM_INDEX_EXISTENCE_ERR;
 
   // Delete index file
@@ -1229,7 +1761,7 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
   return SUCCESS;
 }
 
-RC RelationManager::insertIndex(int tableID, const Attribute &attr, int position)
+RC RelationManager::insertIndex(int tableID, const Attribute &attr, int position, const string &indexName, int keyPosition)
 {
 	RC rc;
   FileHandle fh;
@@ -1240,7 +1772,7 @@ RC RelationManager::insertIndex(int tableID, const Attribute &attr, int position
     return rc;
 
 	void *data = malloc(INDEXES_RECORD_DATA_SIZE);
-	prepareColumnsRecordData(tableID, position, attr, data);
+	prepareIndexesRecordData(tableID, position, attr, indexName, keyPosition, data);
 	if ((rc = rbfm->insertRecord(fh, indexDescriptor, data, uselessRID)))
     return rc;
 
@@ -1280,13 +1812,14 @@ RC RelationManager::indexExistsInIndex(const string &tableName, const string &at
 
   RBFM_ScanIterator rbfm_si;
   vector<string> projection;
-  projection.push_back(INDEXES_COL_COLUMN_NAME);
+  projection.push_back(INDEXES_COL_INDEX_NAME);
   void *value = &tableID;
   if ((rc = rbfm->scan(fh, indexDescriptor, INDEXES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si)))
     return rc;
 
   RID rid;
   void *data = malloc(INDEXES_RECORD_DATA_SIZE);
+  bool found = false;
   while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS) {
     int size;
     memcpy(&size, (char*)data + 1, VARCHAR_LENGTH_SIZE);
@@ -1294,26 +1827,25 @@ RC RelationManager::indexExistsInIndex(const string &tableName, const string &at
     indexName[size] = '\0';
     memcpy(indexName, (char*)data + 1 + VARCHAR_LENGTH_SIZE, size);
 
-    // Found the same index Name
+    // Found the same index Name. A composite index has a row for each of its attributes,
+    // which are all deleted while the file is still open.
     if(strcmp(indexName, attributeName.c_str()) == 0) {
-			rbfm_si.close();
-			rbfm->closeFile(fh);
-			free(data);
-      if (deleteFlag) {
-        if (rbfm->deleteRecord(fh, indexDescriptor, rid) != SUCCESS)
-          return -1;
+      found = true;
+      if (!deleteFlag)
+        break;
+      if (rbfm->deleteRecord(fh, indexDescriptor, rid) != SUCCESS) {
+        rc = -1;
+        break;
       }
-			return SUCCESS;
 		}
   }
 
   rbfm_si.close();
   rbfm->closeFile(fh);
   free(data);
-  if (rc == RM_EOF)
-    return RM_INDEX_EXISTENCE_ERR;
-  else
+  if (rc != SUCCESS && rc != RM_EOF)
     return rc;
+  return found ? SUCCESS : RM_INDEX_EXISTENCE_ERR;
 }
 
 RC RelationManager::indexScan(const string &tableName,
@@ -1324,10 +1856,14 @@ RC RelationManager::indexScan(const string &tableName,
                       bool highKeyInclusive,
                       RM_IndexScanIterator &rm_IndexScanIterator)
 {
+  // The table stays locked until the iterator is closed
+  RC rc = rm_IndexScanIterator.lockTable(tableName);
+  if (rc)
+    return rc;
+
   // Open the file for the given tableName
   IndexManager *im = IndexManager::instance();
-  rm_IndexScanIterator.ix_iter.fileHandle = new IXFileHandle();
-  RC rc = im->openFile(getIndexFileName(tableName, attributeName), *rm_IndexScanIterator.ix_iter.fileHandle);
+  rc = rm_IndexScanIterator.openIndex(getIndexFileName(tableName, attributeName));
   if (rc)
     return rc;
 
@@ -1335,7 +1871,10 @@ RC RelationManager::indexScan(const string &tableName,
   vector<Attribute> recordDescriptor;
 	rc = getAttributes(tableName, recordDescriptor);
 	if (rc)
+  {
+    rm_IndexScanIterator.closeIndex();
     return rc;
+  }
 
 	int attrPos = -1;
 	for(unsigned i = 0; i < recordDescriptor.size(); ++i) {
@@ -1343,20 +1882,67 @@ RC RelationManager::indexScan(const string &tableName,
 			attrPos = i;
 			break;
 		}
-		if (i == recordDescriptor.size() -1)
-      return RM_COLUMN_NON_EXIST;
 	}
 
   if (attrPos == -1)
+  {
+    rm_IndexScanIterator.closeIndex();
     return RM_COLUMN_NON_EXIST;
+  }
 
-	rc = im->scan(*rm_IndexScanIterator.ix_iter.fileHandle, recordDescriptor[attrPos], lowKey, highKey, lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator.ix_iter);
+	rc = im->scan(*rm_IndexScanIterator.indexFile, recordDescriptor[attrPos], lowKey, highKey, lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator.ix_iter);
 	if(rc)
+  {
+    rm_IndexScanIterator.closeIndex();
     return rc;
+  }
 
 	return SUCCESS;
 }
 
+RC RelationManager::indexScan(const string &tableName,
+                      const string &indexName,
+                      const void *lowKey,
+                      unsigned lowCount,
+                      const void *highKey,
+                      unsigned highCount,
+                      bool lowKeyInclusive,
+                      bool highKeyInclusive,
+                      RM_IndexScanIterator &rm_IndexScanIterator)
+{
+  // The table stays locked until the iterator is closed
+  RC rc = rm_IndexScanIterator.lockTable(tableName);
+  if (rc)
+    return rc;
+
+  vector<CompositeIndex> indexes;
+  rc = getCompositeIndexes(tableName, indexes);
+  if (rc)
+  {
+    rm_IndexScanIterator.unlockTable();
+    return rc;
+  }
+  unsigned i = 0;
+  while (i < indexes.size() && indexes[i].name != indexName)
+    i++;
+  if (i == indexes.size())
+  {
+    rm_IndexScanIterator.unlockTable();
+    return RM_INDEX_EXISTENCE_ERR;
+  }
+
+  IndexManager *im = IndexManager::instance();
+  rc = rm_IndexScanIterator.openIndex(getIndexFileName(tableName, indexName));
+  if (rc)
+    return rc;
+
+  rc = im->scan(*rm_IndexScanIterator.indexFile, getKeySchema(indexes[i]), lowKey, lowCount,
+      highKey, highCount, lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator.ix_iter);
+  if (rc)
+    rm_IndexScanIterator.closeIndex();
+  return rc;
+}
+
 RC RM_IndexScanIterator::getNextEntry(RID &rid, void *key)
 {
   return ix_iter.getNextEntry(rid, key);
@@ -1364,8 +1950,56 @@ RC RM_IndexScanIterator::getNextEntry(RID &rid, void *key)
 
 RC RM_IndexScanIterator::close()
 {
-  IndexManager *im = IndexManager::instance();
   ix_iter.close();
-  im->closeFile(*ix_iter.fileHandle);
+  closeIndex();
+  return SUCCESS;
+}
+
+RM_IndexScanIterator::~RM_IndexScanIterator()
+{
+  closeIndex();
+}
+
+RC RM_IndexScanIterator::openIndex(const string &fileName)
+{
+  indexFile = new IXFileHandle();
+  RC rc = IndexManager::instance()->openFile(fileName, *indexFile);
+  if (rc)
+  {
+    delete indexFile;
+    indexFile = NULL;
+    unlockTable();
+  }
+  return rc;
+}
+
+void RM_IndexScanIterator::closeIndex()
+{
+  if (indexFile != NULL)
+  {
+    IndexManager::instance()->closeFile(*indexFile);
+    delete indexFile;
+    indexFile = NULL;
+  }
+  unlockTable();
+}
+
+RC RM_IndexScanIterator::lockTable(const string &tableName)
+{
+  unlockTable();
+  LockManager *lm = LockManager::instance();
+  lockOwner = lm->newOwner();
+  RC rc = lm->lockTable(tableName, S_LOCK, lockOwner);
+  if (rc)
+    return rc;
+  lockedTable = tableName;
+  locked = true;
   return SUCCESS;
 }
+
+void RM_IndexScanIterator::unlockTable()
+{
+  if (locked)
+    LockManager::instance()->unlockTable(lockedTable, S_LOCK, lockOwner);
+  locked = false;
+}
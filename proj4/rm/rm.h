@@ -4,9 +4,12 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
 
 #include "../rbf/rbfm.h"
 #include "../ix/ix.h"
+#include "lock.h"
 
 using namespace std;
 
@@ -46,15 +49,24 @@ using namespace std;
 #define INDEXES_TABLE_NAME           "Indexes"
 #define INDEXES_TABLE_ID             3
 
+// Format for Indexes table, one row for each attribute of each index:
+// (table-id:int, column-name:varchar(50), column-type:int, column-length:int, column-position:int,
+//  index-name:varchar(50), key-position:int)
+// An index on a single attribute is named after it. A composite index has a row for each of
+// its attributes, with key-position giving their order in the key.
+
 #define INDEXES_COL_TABLE_ID         "table-id"
 #define INDEXES_COL_COLUMN_NAME      "column-name"
 #define INDEXES_COL_COLUMN_TYPE      "column-type"
 #define INDEXES_COL_COLUMN_LENGTH    "column-length"
 #define INDEXES_COL_COLUMN_POSITION  "column-position"
+#define INDEXES_COL_INDEX_NAME       "index-name"
+#define INDEXES_COL_KEY_POSITION     "key-position"
 #define INDEXES_COL_COLUMN_NAME_SIZE 50
+#define INDEXES_COL_INDEX_NAME_SIZE  50
 
-// 1 null byte, 4 integer fields and a varchar
-#define INDEXES_RECORD_DATA_SIZE 1 + 5 * INT_SIZE + INDEXES_COL_COLUMN_NAME_SIZE
+// 1 null byte, 5 integer fields and 2 varchars
+#define INDEXES_RECORD_DATA_SIZE 1 + 7 * INT_SIZE + INDEXES_COL_COLUMN_NAME_SIZE + INDEXES_COL_INDEX_NAME_SIZE
 
 # define RM_EOF (-1)  // end of a scan operator
 
@@ -63,6 +75,7 @@ using namespace std;
 #define RM_INDEX_EXISTENCE_ERR 3
 #define RM_CREATE_INDEX_FAILED 4
 #define RM_COLUMN_NON_EXIST    5
+#define RM_INDEX_KEY_INVALID   6
 
 typedef struct IndexedAttr
 {
@@ -70,11 +83,29 @@ typedef struct IndexedAttr
     Attribute attr;
 } IndexedAttr;
 
+// An index whose keys are made of several attributes of a table, compared on the first of
+// them, then on the second and so on (see IX_KeySchema)
+typedef struct CompositeIndex
+{
+    string name;
+    vector<IndexedAttr> attrs;  // in key order
+} CompositeIndex;
+
+// What the catalog says about one table, as cached by the RelationManager
+typedef struct CatalogEntry
+{
+    int32_t id;
+    bool system;
+    vector<Attribute> attrs;
+    vector<IndexedAttr> indexes;
+    vector<CompositeIndex> compositeIndexes;
+} CatalogEntry;
+
 // RM_ScanIterator is an iteratr to go through tuples
 class RM_ScanIterator {
 public:
-  RM_ScanIterator() {};
-  ~RM_ScanIterator() {};
+  RM_ScanIterator() : locked(false) {};
+  ~RM_ScanIterator();
 
   // "data" follows the same format as RelationManager::insertTuple()
   RC getNextTuple(RID &rid, void *data);
@@ -84,13 +115,20 @@ public:
 private:
   RBFM_ScanIterator rbfm_iter;
   FileHandle fileHandle;
+  // The table is share locked from scan() until close(), which may be on another thread
+  string lockedTable;
+  LockOwner lockOwner;
+  bool locked;
+
+  RC lockTable(const string &tableName);
+  void unlockTable();
 };
 
 // RM_IndexScanIterator is an iterator to go through index entries
 class RM_IndexScanIterator {
  public:
-  RM_IndexScanIterator() {};  	// Constructor
-  ~RM_IndexScanIterator() {}; 	// Destructor
+  RM_IndexScanIterator() : indexFile(NULL), locked(false) {};  	// Constructor
+  ~RM_IndexScanIterator(); 	// Destructor
 
   // "key" follows the same format as in IndexManager::insertEntry()
   RC getNextEntry(RID &rid, void *key);  	// Get next matching entry
@@ -99,9 +137,24 @@ class RM_IndexScanIterator {
   friend class RelationManager;
  private:
   IX_ScanIterator ix_iter;
+  // The index file, open from indexScan() until close()
+  IXFileHandle *indexFile;
+  // The table is share locked from indexScan() until close(), which may be on another thread
+  string lockedTable;
+  LockOwner lockOwner;
+  bool locked;
+
+  RC lockTable(const string &tableName);
+  void unlockTable();
+  RC openIndex(const string &fileName);
+  // Closes the index file and unlocks the table, for a scan that is closed or failed to start
+  void closeIndex();
 };
 
 // Relation Manager
+//
+// Safe to use from several threads. Each call locks the table it works on, and the records
+// it reads or changes, with the LockManager (see lock.h).
 class RelationManager
 {
 public:
@@ -119,8 +172,15 @@ public:
 
   RC getIndexAttributes(const string &tableName, vector<IndexedAttr> &iattrs);
 
+  RC getCompositeIndexes(const string &tableName, vector<CompositeIndex> &indexes);
+
   RC insertTuple(const string &tableName, const void *data, RID &rid);
 
+  // Inserts every tuple of data, and puts their RIDs in rids in the same order.
+  // Same as calling insertTuple() on each of them, but pages of the table and of its
+  // indexes are written once for all the tuples that go on them.
+  RC insertTuples(const string &tableName, const vector<const void*> &data, vector<RID> &rids);
+
   RC deleteTuple(const string &tableName, const RID &rid);
 
   RC updateTuple(const string &tableName, const void *data, const RID &rid);
@@ -146,6 +206,11 @@ public:
 
   RC createIndex(const string &tableName, const string &attributeName);
 
+  // Creates an index named indexName on two or more attributes of the table, in the given order.
+  // Tuples with a null in any of them are not indexed. The name cannot be that of an attribute.
+  RC createIndex(const string &tableName, const string &indexName, const vector<string> &attributeNames);
+
+  // Destroys the index on attributeName, or the composite index of that name
   RC destroyIndex(const string &tableName, const string &attributeName);
 
   // indexScan returns an iterator to allow the caller to go through qualified entries in index
@@ -157,6 +222,22 @@ public:
                         bool highKeyInclusive,
                         RM_IndexScanIterator &rm_IndexScanIterator);
 
+  // indexScan over a composite index. lowKey and highKey hold the values of its first lowCount
+  // and highCount attributes; a key counts as equal to a bound it starts with. Keys come out
+  // as the values of every attribute of the index, one after the other. See IndexManager::scan.
+  RC indexScan(const string &tableName,
+                        const string &indexName,
+                        const void *lowKey,
+                        unsigned lowCount,
+                        const void *highKey,
+                        unsigned highCount,
+                        bool lowKeyInclusive,
+                        bool highKeyInclusive,
+                        RM_IndexScanIterator &rm_IndexScanIterator);
+
+  // Goes up every time the catalog changes
+  uint64_t getCatalogVersion() const;
+
 protected:
   RelationManager();
   ~RelationManager();
@@ -167,6 +248,13 @@ private:
   const vector<Attribute> columnDescriptor;
   const vector<Attribute> indexDescriptor;
 
+  // Catalog cache: the entry of a table is read from Tables, Columns and Indexes the
+  // first time the table is used, and dropped when the table or its indexes change
+  unordered_map<string, CatalogEntry> catalogCache;
+  uint64_t catalogVersion;
+  // Guards catalogCache. An entry stays put while its table is locked, or while this is held.
+  recursive_mutex catalogMutex;
+
   // Convert tableName to file name (append extension)
   static string getFileName(const char *tableName);
   static string getFileName(const string &tableName);
@@ -180,12 +268,13 @@ private:
   // Prepare an entry for the Table/Column table
   void prepareTablesRecordData(int32_t id, bool system, const string &tableName, void *data);
   void prepareColumnsRecordData(int32_t id, int32_t pos, Attribute attr, void *data);
+  void prepareIndexesRecordData(int32_t id, int32_t pos, const Attribute &attr, const string &indexName, int32_t keyPos, void *data);
 
   // Given a table ID and recordDescriptor, creates entries in Column table
   RC insertColumns(int32_t id, const vector<Attribute> &recordDescriptor);
   // Given table ID, system flag, and table name, creates entry in Table table
   RC insertTable(int32_t id, int32_t system, const string &tableName);
-  RC insertIndex(int32_t id, const Attribute &attr, int position);
+  RC insertIndex(int32_t id, const Attribute &attr, int position, const string &indexName, int keyPosition);
 
   // Get next table ID for creating table
   RC getNextTableID(int32_t &table_id);
@@ -194,10 +283,28 @@ private:
 
   RC isSystemTable(bool &system, const string &tableName);
 
+  // Catalog entry of tableName, from the cache or else from the catalog tables
+  RC getCatalogEntry(const string &tableName, const CatalogEntry *&entry);
+  // Drops the cached entry of tableName, or every entry if tableName is empty
+  void invalidateCatalogEntry(const string &tableName);
+  RC deleteCatalogRows(int32_t tableID);
+
+  // Read the catalog tables
+  RC readTableEntry(const string &tableName, int32_t &tableID, bool &system);
+  RC readColumns(int32_t tableID, vector<Attribute> &attrs);
+  RC readIndexes(int32_t tableID, vector<IndexedAttr> &iattrs, vector<CompositeIndex> &compositeIndexes);
+
   RC insertIndexTuple(const string& tableName, const vector<Attribute> recordDescriptor, const void* data, const RID& rid);
 
   RC deleteIndexTuple(const string& tableName, const vector<Attribute> recordDescriptor, const void* data, const RID& rid);
 
+  // Copies the values of the attributes of a composite index out of the tuple data, one after
+  // the other, as IndexManager takes them. Returns -1 if any of them is null.
+  RC getKeyFromRecord(const CompositeIndex &index, const vector<Attribute> &recordDescriptor, const void *data, void *key);
+  static IX_KeySchema getKeySchema(const CompositeIndex &index);
+  // Scans the table and bulk loads the keys of index into the open index file
+  RC loadIndex(const string &tableName, const CompositeIndex &index, IXFileHandle &ixfh);
+
   // Utility functions for converting single values to/from api format
   // Useful when using ScanIterators
   void fromAPI(float &real, void *data);
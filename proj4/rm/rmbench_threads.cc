@@ -0,0 +1,123 @@
+#include <iomanip>
+#include <chrono>
+#include <thread>
+
+#include "rm_test_util.h"
+#include "lock.h"
+
+// Multi-threaded throughput benchmark
+// For 1, 2, 4, ... up to maxThreads threads, each thread inserts opsPerThread tuples into
+// the same indexed table, reads every one back and updates every other one. Reports the
+// operations per second and how many lock requests had to wait.
+// Threads on different tuples only meet on page latches and on the buffer pool, which
+// every page access goes through, so that is where the scaling levels off.
+//
+// Usage: ./rmbench_threads [maxThreads] [opsPerThread]
+
+const string tableName = "bench_threads";
+
+void worker(int threadNum, unsigned opsPerThread)
+{
+    vector<Attribute> attrs;
+    rm->getAttributes(tableName, attrs);
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    int tupleSize = 0;
+    string name = "Bench" + to_string(threadNum);
+
+    vector<RID> rids(opsPerThread);
+    for (unsigned i = 0; i < opsPerThread; i++)
+    {
+        int age = threadNum * opsPerThread + i;
+        prepareTuple(attrs.size(), nullsIndicator, name.length(), name, age, 170.5, age, tuple, &tupleSize);
+        RC rc = rm->insertTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+    for (unsigned i = 0; i < opsPerThread; i++)
+    {
+        RC rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+    }
+    for (unsigned i = 0; i < opsPerThread; i += 2)
+    {
+        int age = threadNum * opsPerThread + i;
+        prepareTuple(attrs.size(), nullsIndicator, name.length(), name, age, 170.5, -age, tuple, &tupleSize);
+        RC rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    }
+
+    free(nullsIndicator);
+    free(tuple);
+    free(returnedData);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned maxThreads = 8;
+    unsigned opsPerThread = 20000;
+    if (argc > 1)
+        maxThreads = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        opsPerThread = strtoul(argv[2], NULL, 10);
+
+    // Fails harmlessly if the catalog is already there
+    rm->createCatalog();
+    LockManager *lm = LockManager::instance();
+
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.name = "EmpName";
+    attr.type = TypeVarChar;
+    attr.length = 30;
+    attrs.push_back(attr);
+    attr.name = "Age";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "Height";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+    attr.name = "Salary";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+
+    cout << setw(10) << "threads" << setw(16) << "operations" << setw(16) << "ops/sec" << setw(16) << "lock waits" << endl;
+
+    for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        rm->destroyIndex(tableName, "Age");
+        rm->deleteTable(tableName);
+        RC rc = rm->createTable(tableName, attrs);
+        assert(rc == success && "Creating the table should not fail.");
+        rc = rm->createIndex(tableName, "Age");
+        assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+        lm->resetStatistics();
+        auto start = chrono::steady_clock::now();
+
+        vector<thread> threads;
+        for (unsigned t = 0; t < numThreads; t++)
+            threads.push_back(thread(worker, t, opsPerThread));
+        for (thread &t : threads)
+            t.join();
+
+        auto end = chrono::steady_clock::now();
+        unsigned waitCount, timeoutCount;
+        lm->collectStatistics(waitCount, timeoutCount);
+
+        // Each thread inserts, reads and updates half of its tuples
+        unsigned operations = numThreads * (opsPerThread * 2 + (opsPerThread + 1) / 2);
+        double seconds = chrono::duration<double>(end - start).count();
+        cout << setw(10) << numThreads
+             << setw(16) << operations
+             << setw(16) << fixed << setprecision(0) << operations / seconds
+             << setw(16) << waitCount << endl;
+    }
+
+    rm->destroyIndex(tableName, "Age");
+    rm->deleteTable(tableName);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "rm_test_util.h"
+
+// Moves the catalog files out of the way, or back. While they are away, anything
+// that reads the catalog from disk fails.
+void hideCatalog(bool hide)
+{
+    const char *files[] = {"Tables.t", "Columns.t", "Indexes.t"};
+    for (const char *file : files)
+    {
+        string hidden = string(file) + ".hidden";
+        int rc = hide ? rename(file, hidden.c_str()) : rename(hidden.c_str(), file);
+        assert(rc == 0 && "Moving a catalog file should not fail.");
+    }
+}
+
+RC TEST_RM_16(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Single tuple operations without reading the catalog **
+    // 2. Create Index, Destroy Index - the cached index list follows **
+    // 3. Delete Table, Create Table - the cached attributes follow **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 16 *****" << endl;
+
+    RID rid;
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    assert(attrs.size() == 4 && "The table should have 4 attributes.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    // Once the table has been used, its catalog entry is in memory
+    hideCatalog(true);
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Tester", 20, 170.5, 5000, tuple, &tupleSize);
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not need the catalog files.");
+    rc = rm->readTuple(tableName, rid, returnedData);
+    assert(rc == success && "RelationManager::readTuple() should not need the catalog files.");
+    assert(memcmp(tuple, returnedData, tupleSize) == 0 && "The returned tuple is not correct.");
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Tester", 21, 170.5, 6000, tuple, &tupleSize);
+    rc = rm->updateTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::updateTuple() should not need the catalog files.");
+    rc = rm->deleteTuple(tableName, rid);
+    assert(rc == success && "RelationManager::deleteTuple() should not need the catalog files.");
+    hideCatalog(false);
+
+    // Creating an index changes the catalog
+    uint64_t version = rm->getCatalogVersion();
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    assert(rm->getCatalogVersion() > version && "Creating an index should change the catalog version.");
+
+    vector<IndexedAttr> iattrs;
+    rc = rm->getIndexAttributes(tableName, iattrs);
+    assert(rc == success && "RelationManager::getIndexAttributes() should not fail.");
+    assert(iattrs.size() == 1 && iattrs[0].attr.name == "Age" && "The new index should be listed.");
+
+    // The index is maintained from the cached entry too
+    hideCatalog(true);
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Tester", 30, 180.5, 7000, tuple, &tupleSize);
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not need the catalog files.");
+
+    RM_IndexScanIterator rmisi;
+    int age = 30;
+    rc = rm->indexScan(tableName, "Age", &age, &age, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    int count = 0;
+    RID indexRid;
+    while (rmisi.getNextEntry(indexRid, returnedData) != RM_EOF)
+    {
+        assert(indexRid.pageNum == rid.pageNum && indexRid.slotNum == rid.slotNum && "The index should point at the tuple.");
+        count++;
+    }
+    rmisi.close();
+    assert(count == 1 && "The index should hold the new tuple.");
+    hideCatalog(false);
+
+    version = rm->getCatalogVersion();
+    rc = rm->destroyIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+    assert(rm->getCatalogVersion() > version && "Destroying an index should change the catalog version.");
+    rc = rm->getIndexAttributes(tableName, iattrs);
+    assert(rc == success && "RelationManager::getIndexAttributes() should not fail.");
+    assert(iattrs.size() == 0 && "The destroyed index should not be listed.");
+
+    // A table created again under the same name has its new attributes
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc != success && "A deleted table should have no attributes.");
+
+    vector<Attribute> newAttrs;
+    Attribute attr;
+    attr.name = "Id";
+    attr.type = TypeInt;
+    attr.length = (AttrLength)4;
+    newAttrs.push_back(attr);
+    rc = rm->createTable(tableName, newAttrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    assert(attrs.size() == 1 && attrs[0].name == "Id" && "The table should have its new attributes.");
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(tuple);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "***** Test Case 16 Finished. The result will be examined. *****" << endl << endl;
+
+    return success;
+}
+
+int main()
+{
+    // Catalog cache
+    rm->deleteTable("tbl_catalog");
+    RC rcmain = createTable("tbl_catalog");
+    rcmain = TEST_RM_16("tbl_catalog");
+
+    return rcmain;
+}
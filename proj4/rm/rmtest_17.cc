@@ -0,0 +1,132 @@
+#include "rm_test_util.h"
+
+// Scans the whole index on attributeName, checks each entry against the tuple it points
+// at, and returns the number of entries
+int checkIndex(const string &tableName, const string &attributeName, AttrType type)
+{
+    RM_IndexScanIterator rmisi;
+    RC rc = rm->indexScan(tableName, attributeName, NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+
+    void *key = malloc(200);
+    void *previousKey = malloc(200);
+    void *value = malloc(200);
+    int count = 0;
+    RID rid;
+    while (rmisi.getNextEntry(rid, key) != RM_EOF)
+    {
+        rc = rm->readAttribute(tableName, rid, attributeName, value);
+        assert(rc == success && "RelationManager::readAttribute() should not fail.");
+        assert(*(unsigned char *) value == 0 && "An indexed value should not be null.");
+        if (type == TypeInt)
+        {
+            assert(*(int *) key == *(int *) ((char *) value + 1) && "The entry should point at a tuple with its key.");
+            assert((count == 0 || *(int *) previousKey <= *(int *) key) && "The entries should come in key order.");
+            *(int *) previousKey = *(int *) key;
+        }
+        else
+        {
+            int length = *(int *) key;
+            assert(length == *(int *) ((char *) value + 1) && memcmp((char *) key + 4, (char *) value + 5, length) == 0
+                   && "The entry should point at a tuple with its key.");
+        }
+        count++;
+    }
+    rmisi.close();
+
+    free(key);
+    free(previousKey);
+    free(value);
+    return count;
+}
+
+RC TEST_RM_17(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Create Index
+    // 2. Insert Tuples - many tuples at once, into the table and its indexes **
+    // 3. Read Tuple
+    // 4. Index Scan - the indexes hold every new tuple with a value **
+    // 5. Insert Tuples into a system table fails **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 17 *****" << endl;
+
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = rm->createIndex(tableName, "EmpName");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+
+    // Every 10th tuple has a null Age, which is left out of the Age index.
+    // The ages go down, so the index gets them in the opposite order of the tuples.
+    const int numTuples = 2000;
+    vector<const void*> tuples;
+    vector<int> sizes;
+    for (int i = 0; i < numTuples; i++)
+    {
+        memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+        if (i % 10 == 0)
+            nullsIndicator[0] = 1 << 6;
+        string name = "Tester" + to_string(i % 37);
+        int tupleSize = 0;
+        void *tuple = malloc(200);
+        prepareTuple(attrs.size(), nullsIndicator, name.length(), name, numTuples - i, 160.5 + i % 20, i, tuple, &tupleSize);
+        tuples.push_back(tuple);
+        sizes.push_back(tupleSize);
+    }
+
+    vector<RID> rids;
+    rc = rm->insertTuples(tableName, tuples, rids);
+    assert(rc == success && "RelationManager::insertTuples() should not fail.");
+    assert(rids.size() == (unsigned) numTuples && "Every tuple should get a RID.");
+
+    void *returnedData = malloc(200);
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        assert(memcmp(tuples[i], returnedData, sizes[i]) == 0 && "The returned tuple is not correct.");
+    }
+
+    assert(checkIndex(tableName, "Age", TypeInt) == numTuples - numTuples / 10 && "The Age index should hold every tuple with an age.");
+    assert(checkIndex(tableName, "EmpName", TypeVarChar) == numTuples && "The EmpName index should hold every tuple.");
+
+    // Tuples inserted one at a time afterwards go in the same indexes
+    RID rid;
+    rc = rm->insertTuple(tableName, tuples[1], rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    assert(checkIndex(tableName, "EmpName", TypeVarChar) == numTuples + 1 && "The EmpName index should hold the new tuple.");
+
+    // System tables cannot be modified
+    vector<RID> systemRids;
+    rc = rm->insertTuples("Tables", tuples, systemRids);
+    assert(rc != success && "RelationManager::insertTuples() on a system table should fail.");
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    for (const void *tuple : tuples)
+        free((void *) tuple);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "***** Test Case 17 Finished. The result will be examined. *****" << endl << endl;
+
+    return success;
+}
+
+int main()
+{
+    // Batched inserts
+    rm->deleteTable("tbl_batch");
+    RC rcmain = createTable("tbl_batch");
+    rcmain = TEST_RM_17("tbl_batch");
+
+    return rcmain;
+}
@@ -0,0 +1,165 @@
+#include <thread>
+
+#include "rm_test_util.h"
+#include "lock.h"
+
+const int numThreads = 4;
+const int tuplesPerThread = 500;
+
+// Inserts its own tuples, reads each back, and gives every other one a new salary
+void worker(const string &tableName, int threadNum, vector<RID> *rids)
+{
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    int tupleSize = 0;
+
+    for (int i = 0; i < tuplesPerThread; i++)
+    {
+        int age = threadNum * tuplesPerThread + i;
+        string name = "Thread" + to_string(threadNum);
+        prepareTuple(attrs.size(), nullsIndicator, name.length(), name, age, 170.5, age, tuple, &tupleSize);
+        RID rid;
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids->push_back(rid);
+
+        rc = rm->readTuple(tableName, rid, returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        assert(memcmp(tuple, returnedData, tupleSize) == 0 && "The returned tuple is not correct.");
+    }
+
+    for (int i = 0; i < tuplesPerThread; i += 2)
+    {
+        int age = threadNum * tuplesPerThread + i;
+        string name = "Thread" + to_string(threadNum);
+        prepareTuple(attrs.size(), nullsIndicator, name.length(), name, age, 170.5, -age, tuple, &tupleSize);
+        rc = rm->updateTuple(tableName, tuple, (*rids)[i]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    }
+
+    free(nullsIndicator);
+    free(tuple);
+    free(returnedData);
+}
+
+// Tries to insert while the main thread holds a scan of the table open
+void blockedInsert(const string &tableName, RC *result)
+{
+    vector<Attribute> attrs;
+    rm->getAttributes(tableName, attrs);
+    unsigned char nullsIndicator[1] = {0};
+    void *tuple = malloc(200);
+    int tupleSize = 0;
+    prepareTuple(attrs.size(), nullsIndicator, 7, "Blocked", -1, 170.5, 0, tuple, &tupleSize);
+    RID rid;
+    *result = rm->insertTuple(tableName, tuple, rid);
+    free(tuple);
+}
+
+RC TEST_RM_18(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Create Index
+    // 2. Insert Tuple, Read Tuple, Update Tuple - from several threads at once **
+    // 3. Scan, Index Scan - every tuple of every thread is there, and in the index **
+    // 4. A scan keeps the table locked until it is closed **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 18 *****" << endl;
+
+    RC rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    // The threads split the index and the table pages under each other
+    vector<RID> rids[numThreads];
+    vector<thread> threads;
+    for (int t = 0; t < numThreads; t++)
+        threads.push_back(thread(worker, tableName, t, &rids[t]));
+    for (thread &t : threads)
+        t.join();
+
+    // Every tuple is there once, with the salary its thread left it with
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Salary");
+    RM_ScanIterator rmsi;
+    rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    void *returnedData = malloc(200);
+    RID rid;
+    vector<bool> seen(numThreads * tuplesPerThread, false);
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        int age = *(int *) ((char *) returnedData + 1);
+        int salary = *(int *) ((char *) returnedData + 5);
+        assert(age >= 0 && age < numThreads * tuplesPerThread && !seen[age] && "Each tuple should be there once.");
+        assert(salary == (age % 2 == 0 ? -age : age) && "The tuple should have its last salary.");
+        seen[age] = true;
+    }
+    rmsi.close();
+    for (unsigned i = 0; i < seen.size(); i++)
+        assert(seen[i] && "Every tuple should be there.");
+
+    // The index has one entry for each of them, in order
+    RM_IndexScanIterator rmisi;
+    rc = rm->indexScan(tableName, "Age", NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    int key;
+    int count = 0;
+    while (rmisi.getNextEntry(rid, &key) != RM_EOF)
+    {
+        assert(key == count && "The index should hold every age in order.");
+        rc = rm->readAttribute(tableName, rid, "Age", returnedData);
+        assert(rc == success && "RelationManager::readAttribute() should not fail.");
+        assert(*(int *) ((char *) returnedData + 1) == key && "The entry should point at a tuple with its key.");
+        count++;
+    }
+    rmisi.close();
+    assert(count == numThreads * tuplesPerThread && "The index should hold every tuple.");
+
+    // While a scan is open, an insert from another thread waits for it, and gives up
+    LockManager *lm = LockManager::instance();
+    lm->setTimeout(100);
+    lm->resetStatistics();
+    rc = rm->scan(tableName, "", NO_OP, NULL, attributeNames, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    RC insertResult = success;
+    thread blocked(blockedInsert, tableName, &insertResult);
+    blocked.join();
+    assert(insertResult == LM_LOCK_TIMEOUT && "The insert should time out while the table is scanned.");
+
+    // Once it is closed, the insert goes through
+    rmsi.close();
+    thread unblocked(blockedInsert, tableName, &insertResult);
+    unblocked.join();
+    assert(insertResult == success && "The insert should succeed once the scan is closed.");
+
+    unsigned waitCount, timeoutCount;
+    lm->collectStatistics(waitCount, timeoutCount);
+    assert(waitCount == 1 && timeoutCount == 1 && "Only the blocked insert should have waited.");
+    lm->setTimeout(LM_DEFAULT_TIMEOUT);
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    free(returnedData);
+
+    cout << "***** Test Case 18 Finished. The result will be examined. *****" << endl << endl;
+
+    return success;
+}
+
+int main()
+{
+    // Several threads using the same table
+    rm->deleteTable("tbl_concurrent");
+    RC rcmain = createTable("tbl_concurrent");
+    rcmain = TEST_RM_18("tbl_concurrent");
+
+    return rcmain;
+}
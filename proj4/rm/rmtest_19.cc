@@ -0,0 +1,218 @@
+#include "rm_test_util.h"
+
+// Scans the (Age, EmpName) index for the given age, checks each entry against the tuple it
+// points at, and returns the number of entries
+int checkAge(const string &tableName, int age)
+{
+    RM_IndexScanIterator rmisi;
+    RC rc = rm->indexScan(tableName, "age_name", &age, 1, &age, 1, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+
+    char key[200];
+    char value[200];
+    string previousName;
+    int count = 0;
+    RID rid;
+    while (rmisi.getNextEntry(rid, key) != RM_EOF)
+    {
+        int keyAge = *(int *) key;
+        int length = *(int *) (key + 4);
+        string name(key + 8, length);
+        assert(keyAge == age && "Only entries with the age should be returned.");
+        assert((count == 0 || previousName <= name) && "The entries of an age should come in name order.");
+        previousName = name;
+
+        rc = rm->readAttribute(tableName, rid, "Age", value);
+        assert(rc == success && "RelationManager::readAttribute() should not fail.");
+        assert(*(unsigned char *) value == 0 && *(int *) (value + 1) == age && "The entry should point at a tuple with its age.");
+        rc = rm->readAttribute(tableName, rid, "EmpName", value);
+        assert(rc == success && "RelationManager::readAttribute() should not fail.");
+        assert(*(int *) (value + 1) == length && memcmp(value + 5, name.data(), length) == 0 && "The entry should point at a tuple with its name.");
+        count++;
+    }
+    rmisi.close();
+    return count;
+}
+
+RC TEST_RM_19(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Insert Tuples
+    // 2. Create Index - on two attributes, from the tuples already there, and nothing left of a failed one **
+    // 3. Get Composite Indexes - the index and its attributes are in the catalog **
+    // 4. Index Scan - every tuple with a value in the first attribute **
+    // 5. Insert Tuple, Update Tuple, Delete Tuple - the index follows **
+    // 6. Destroy Index, Delete Table **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 19 *****" << endl;
+
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+
+    // Every 10th tuple has a null Age, which is left out of the index
+    const int numTuples = 1500;
+    const int numAges = 20;
+    int ageCount[numAges] = {0};
+    vector<const void*> tuples;
+    for (int i = 0; i < numTuples; i++)
+    {
+        memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+        if (i % 10 == 0)
+            nullsIndicator[0] = 1 << 6;
+        else
+            ageCount[i % numAges]++;
+        string name = "Tester" + to_string((i * 7) % 37);
+        int tupleSize = 0;
+        void *tuple = malloc(200);
+        prepareTuple(attrs.size(), nullsIndicator, name.length(), name, i % numAges, 160.5, i, tuple, &tupleSize);
+        tuples.push_back(tuple);
+    }
+    vector<RID> rids;
+    rc = rm->insertTuples(tableName, tuples, rids);
+    assert(rc == success && "RelationManager::insertTuples() should not fail.");
+
+    // Names that are taken, and keys that are not two attributes of the table, are turned down
+    vector<string> key;
+    key.push_back("Age");
+    rc = rm->createIndex(tableName, "age_name", key);
+    assert(rc != success && "An index on one attribute should be created by name of the attribute.");
+    key.push_back("Age");
+    rc = rm->createIndex(tableName, "age_name", key);
+    assert(rc != success && "An attribute should not be in a key twice.");
+    key[1] = "Weight";
+    rc = rm->createIndex(tableName, "age_name", key);
+    assert(rc != success && "The attributes should be in the table.");
+    key[1] = "EmpName";
+    rc = rm->createIndex(tableName, "Salary", key);
+    assert(rc != success && "An index should not be named after an attribute.");
+
+    // An index that cannot be built leaves no file behind, and can be created later
+    string tableFile = tableName + ".t";
+    string hiddenFile = tableFile + ".hidden";
+    assert(rename(tableFile.c_str(), hiddenFile.c_str()) == 0 && "Moving the table file should not fail.");
+    rc = rm->createIndex(tableName, "age_name", key);
+    assert(rc != success && "An index should not be built without the table file.");
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc != success && "An index should not be built without the table file.");
+    assert(rename(hiddenFile.c_str(), tableFile.c_str()) == 0 && "Moving the table file should not fail.");
+    FILE *file = fopen((tableName + ".age_name.i").c_str(), "r");
+    assert(file == NULL && "A failed index should not leave its file.");
+    file = fopen((tableName + ".Age.i").c_str(), "r");
+    assert(file == NULL && "A failed index should not leave its file.");
+
+    uint64_t version = rm->getCatalogVersion();
+    rc = rm->createIndex(tableName, "age_name", key);
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    assert(rm->getCatalogVersion() > version && "Creating an index should change the catalog version.");
+    rc = rm->createIndex(tableName, "age_name", key);
+    assert(rc != success && "An index should not be created twice.");
+
+    // Another index changes the catalog, which is read back from the Indexes table
+    rc = rm->createIndex(tableName, "Salary");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    vector<CompositeIndex> indexes;
+    rc = rm->getCompositeIndexes(tableName, indexes);
+    assert(rc == success && "RelationManager::getCompositeIndexes() should not fail.");
+    assert(indexes.size() == 1 && indexes[0].name == "age_name" && "The new index should be listed.");
+    assert(indexes[0].attrs.size() == 2 && indexes[0].attrs[0].attr.name == "Age" && indexes[0].attrs[1].attr.name == "EmpName"
+           && "The attributes of the index should be listed in order.");
+    vector<IndexedAttr> iattrs;
+    rc = rm->getIndexAttributes(tableName, iattrs);
+    assert(rc == success && "RelationManager::getIndexAttributes() should not fail.");
+    assert(iattrs.size() == 1 && iattrs[0].attr.name == "Salary" && "Only the index on Salary is on a single attribute.");
+
+    for (int age = 0; age < numAges; age++)
+        assert(checkAge(tableName, age) == ageCount[age] && "The index should hold every tuple with the age.");
+
+    // Ages 5 to 9, without 5, and ages 5 and 6 on names from Tester3 on
+    int low = 5;
+    int high = 9;
+    RM_IndexScanIterator rmisi;
+    rc = rm->indexScan(tableName, "age_name", &low, 1, &high, 1, false, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    char returnedKey[200];
+    RID rid;
+    int count = 0;
+    while (rmisi.getNextEntry(rid, returnedKey) != RM_EOF)
+        count++;
+    rmisi.close();
+    assert(count == ageCount[6] + ageCount[7] + ageCount[8] + ageCount[9] && "The scan should return the ages in the range.");
+
+    char lowKey[200];
+    int nameLength = 7;
+    memcpy(lowKey, &low, 4);
+    memcpy(lowKey + 4, &nameLength, 4);
+    memcpy(lowKey + 8, "Tester3", nameLength);
+    high = 6;
+    rc = rm->indexScan(tableName, "age_name", lowKey, 2, &high, 1, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    count = 0;
+    while (rmisi.getNextEntry(rid, returnedKey) != RM_EOF)
+    {
+        string name(returnedKey + 8, *(int *) (returnedKey + 4));
+        assert((*(int *) returnedKey == 6 || name >= "Tester3") && "The scan should start from the name.");
+        count++;
+    }
+    rmisi.close();
+    assert(count > ageCount[6] && count < ageCount[5] + ageCount[6] && "The scan should return part of age 5 and all of age 6.");
+
+    // Single tuples go in and out of the index. The update takes the first tuple from a null age to 3.
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Tester", 3, 170.5, 7000, tuple, &tupleSize);
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    rc = rm->updateTuple(tableName, tuple, rids[0]);
+    assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    ageCount[3] += 2;
+    for (int i = 1; i < numTuples; i += 20)
+    {
+        rc = rm->deleteTuple(tableName, rids[i]);
+        assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+        ageCount[i % numAges]--;
+    }
+    for (int age = 0; age < numAges; age++)
+        assert(checkAge(tableName, age) == ageCount[age] && "The index should follow the changes to the tuples.");
+
+    // The index goes, with its file
+    rc = rm->destroyIndex(tableName, "age_name");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+    rc = rm->getCompositeIndexes(tableName, indexes);
+    assert(rc == success && indexes.size() == 0 && "The destroyed index should not be listed.");
+    rc = rm->indexScan(tableName, "age_name", NULL, 0, NULL, 0, true, true, rmisi);
+    assert(rc != success && "A destroyed index should not be scanned.");
+    rc = rm->destroyIndex(tableName, "age_name");
+    assert(rc != success && "An index should not be destroyed twice.");
+
+    // And with the table
+    rc = rm->createIndex(tableName, "age_name", key);
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    file = fopen((tableName + ".age_name.i").c_str(), "r");
+    assert(file == NULL && "The index file should be destroyed with the table.");
+
+    for (const void *t : tuples)
+        free((void *) t);
+    free(tuple);
+    free(nullsIndicator);
+
+    cout << "***** Test Case 19 Finished. The result will be examined. *****" << endl << endl;
+
+    return success;
+}
+
+int main()
+{
+    // Composite indexes
+    rm->deleteTable("tbl_composite");
+    RC rcmain = createTable("tbl_composite");
+    rcmain = TEST_RM_19("tbl_composite");
+
+    return rcmain;
+}